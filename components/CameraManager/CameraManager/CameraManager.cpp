@@ -1,7 +1,41 @@
 #include "CameraManager.hpp"
+#include <FrameMetadata.hpp>
+#include <algorithm>
 
 const char* CAMERA_MANAGER_TAG = "[CAMERA_MANAGER]";
 
+// OV2640 DSP window registers (bank 0), see ov2640_regs.h
+constexpr int OV2640_XOFFL = 0x53;
+constexpr int OV2640_YOFFL = 0x54;
+constexpr int OV2640_VHYX = 0x55;
+// ov2640_sensor_mode_t, its set_res_raw takes the mode in place of startX
+constexpr int OV2640_MODE_CIF = 2;
+// OV3660 line length of the widest mode in ov3660_settings.h, long enough for any window
+constexpr int OV3660_HTS = 2300;
+// lines between two binned OV3660 frames, same as set_framesize leaves
+constexpr int OV3660_BINNED_VBLANK = 9;
+// JPEG frame buffers are sized for this, the largest frame any profile streams
+constexpr framesize_t JPEG_BUFFER_FRAMESIZE = FRAMESIZE_320X320;
+
+// what a sensor call cost on the SCCB bus, so slow paths show up in the log
+static void logSccbCost(const char* what, const camera_sccb_stats_t& before, const int64_t start_us)
+{
+    const int64_t took_us = esp_timer_get_time() - start_us;
+    camera_sccb_stats_t after = {};
+    esp_camera_get_sccb_stats(&after);
+    ESP_LOGI(CAMERA_MANAGER_TAG, "%s took %lld us, SCCB: %lu transactions, %lu bytes, %lu shadow hits", what, static_cast<long long>(took_us),
+             static_cast<unsigned long>(after.transactions - before.transactions), static_cast<unsigned long>(after.bytes - before.bytes),
+             static_cast<unsigned long>(after.shadow_hits - before.shadow_hits));
+}
+
+// the driver keeps what was last set in status, the streams send it along with every frame
+static void publishSensorMetadata(const sensor_t* sensor)
+{
+    if (!sensor)
+        return;
+    FrameMetadata::publishSensor(sensor->status.aec_value, sensor->status.agc_gain, sensor->status.aec, sensor->status.agc);
+}
+
 struct CameraProfile
 {
     framesize_t default_framesize;  // default resolution for this sensor
@@ -166,20 +200,104 @@ void CameraManager::setupCameraPinout()
         .ledc_channel = LEDC_CHANNEL_0,
 
         .pixel_format = PIXFORMAT_JPEG,   // YUV422,GRAYSCALE,RGB565,JPEG
-        .frame_size = FRAMESIZE_320X320,  // QQVGA-UXGA, For ESP32, do not use sizes above QVGA when not JPEG. The performance of the ESP32-S series has
+        .frame_size = JPEG_BUFFER_FRAMESIZE,  // QQVGA-UXGA, For ESP32, do not use sizes above QVGA when not JPEG. The performance of the ESP32-S series has
                                           // improved a lot, but JPEG mode always gives better frame rates.
 
-        .jpeg_quality = 8,  // 0-63, for OV series camera sensors, lower number means higher quality // Below 6 stability problems
+        .jpeg_quality = CONFIG_CAMERA_JPEG_QUALITY,  // 0-63, for OV series camera sensors, lower number means higher quality // Below 6 stability problems
         .fb_count = 2,      // When jpeg mode is used, if fb_count more than one, the driver will work in continuous mode.
         .fb_location = CAMERA_FB_IN_DRAM,
         .grab_mode = CAMERA_GRAB_LATEST,  // was CAMERA_GRAB_LATEST; new mode reduces frame skips at cost of minor latency
     };
 }
 
+// what the driver allocates per frame buffer, a JPEG bigger than this gets dropped
+size_t CameraManager::jpegFrameBytes() const
+{
+#ifdef CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_AUTO
+    return resolution[config.frame_size].width * resolution[config.frame_size].height / 5;
+#else
+    return CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE;
+#endif
+}
+
+// UVC sends straight out of the camera frame buffers, so the memory the old 200 KB transfer
+// buffer took can hold more of them instead. More buffers means the sensor keeps capturing while
+// USB still holds one frame on the wire and the next one waiting.
+void CameraManager::planUvcFrameBuffers()
+{
+#if CONFIG_GENERAL_INCLUDE_UVC_MODE
+    if (projectConfig->getDeviceMode() != StreamingMode::UVC)
+    {
+        return;
+    }
+
+    // the driver pads every buffer for DMA alignment
+    const size_t buffer_bytes = this->jpegFrameBytes() + 64;
+    const size_t base_count = config.fb_count;
+    const size_t extra = std::min<size_t>(CONFIG_CAMERA_UVC_FB_BUDGET_KB * 1024 / buffer_bytes, CONFIG_CAMERA_UVC_FB_COUNT_MAX - base_count);
+    if (extra == 0)
+    {
+        ESP_LOGI(CAMERA_MANAGER_TAG, "UVC frame buffers: %u x %u B in DRAM", static_cast<unsigned>(base_count), static_cast<unsigned>(buffer_bytes));
+        return;
+    }
+
+    // whatever isn't frame buffers still needs room in internal RAM, the USB stack and our tasks live there
+    constexpr size_t DRAM_HEADROOM = 48 * 1024;
+    const size_t wanted = base_count + extra;
+    const size_t dram_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+    const size_t dram_block = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+    const size_t dram_fits = dram_block >= buffer_bytes && dram_free > DRAM_HEADROOM ? (dram_free - DRAM_HEADROOM) / buffer_bytes : 0;
+
+    if (dram_fits >= wanted)
+    {
+        config.fb_count = wanted;
+        config.fb_location = CAMERA_FB_IN_DRAM;
+    }
+    else if (esp_psram_is_initialized() && heap_caps_get_free_size(MALLOC_CAP_SPIRAM) >= wanted * buffer_bytes)
+    {
+        // slower to read than DRAM but the whole set fits
+        config.fb_count = wanted;
+        config.fb_location = CAMERA_FB_IN_PSRAM;
+    }
+    else
+    {
+        config.fb_count = std::max(base_count, std::min(wanted, dram_fits));
+        config.fb_location = CAMERA_FB_IN_DRAM;
+    }
+
+    ESP_LOGI(CAMERA_MANAGER_TAG, "UVC frame buffers: %u x %u B in %s (budget %d KB, DRAM free %u B)", static_cast<unsigned>(config.fb_count),
+             static_cast<unsigned>(buffer_bytes), config.fb_location == CAMERA_FB_IN_PSRAM ? "PSRAM" : "DRAM", CONFIG_CAMERA_UVC_FB_BUDGET_KB,
+             static_cast<unsigned>(dram_free));
+#endif
+}
+
+// the streams feed every frame into the controller, it comes back here when the quality has to change
+void CameraManager::setupRateControl()
+{
+    JpegRateControl::Settings settings;
+#if CONFIG_CAMERA_JPEG_RATE_CONTROL
+    settings.enabled = true;
+    settings.worst_quality = CONFIG_CAMERA_JPEG_QUALITY_WORST;
+#else
+    settings.enabled = false;
+    settings.worst_quality = CONFIG_CAMERA_JPEG_QUALITY;
+#endif
+    settings.best_quality = CONFIG_CAMERA_JPEG_QUALITY;
+    settings.max_frame_bytes = this->jpegFrameBytes();
+
+    JpegRateControl::controller().configure(
+        settings, [](int quality, void* context) { static_cast<CameraManager*>(context)->setJpegQuality(quality); }, this);
+    ESP_LOGI(CAMERA_MANAGER_TAG, "JPEG rate control %s, quality %d-%d, frame buffer %u B", settings.enabled ? "on" : "off", settings.best_quality,
+             settings.worst_quality, static_cast<unsigned>(settings.max_frame_bytes));
+}
+
 void CameraManager::setupCameraSensor()
 {
     ESP_LOGI(CAMERA_MANAGER_TAG, "Setting up camera sensor");
 
+    camera_sccb_stats_t sccb_before = {};
+    esp_camera_get_sccb_stats(&sccb_before);
+    const int64_t start_us = esp_timer_get_time();
     camera_sensor = esp_camera_sensor_get();
 
     // OV2640-only: fixes corrupted jpegs, https://github.com/espressif/esp32-camera/issues/203
@@ -236,6 +354,7 @@ void CameraManager::setupCameraSensor()
     }
 
     apply_profile(camera_sensor, profile);
+    publishSensorMetadata(camera_sensor);
 
     // Harden DPC thresholds for thermal operation (Tj > 50 degC).
     // The defaults in sensor_default_regs are calibrated for Tj ~25 degC; on
@@ -255,18 +374,24 @@ void CameraManager::setupCameraSensor()
     }
 
     framesize_t sensor_default = profile ? profile->default_framesize : FRAMESIZE_240X240;
+    // raw frames have to fit the buffers esp_camera_init sized for config.frame_size
+    if (config.pixel_format != PIXFORMAT_JPEG)
+    {
+        sensor_default = config.frame_size;
+    }
     if (camera_sensor)
     {
         ESP_LOGI(CAMERA_MANAGER_TAG, "Applying sensor default framesize %d for PID 0x%02x", sensor_default, camera_sensor->id.PID);
         camera_sensor->set_framesize(camera_sensor, sensor_default);
     }
-    ESP_LOGI(CAMERA_MANAGER_TAG, "Setting up camera sensor done");
+    logSccbCost("Setting up camera sensor", sccb_before, start_us);
 }
 
 bool CameraManager::setupCamera()
 {
     ESP_LOGI(CAMERA_MANAGER_TAG, "Setting up camera pinout");
     this->setupCameraPinout();
+    this->planUvcFrameBuffers();
     ESP_LOGI(CAMERA_MANAGER_TAG, "Initializing camera...");
 
     if (auto const hasCameraBeenInitialized = esp_camera_init(&config); hasCameraBeenInitialized == ESP_OK)
@@ -387,6 +512,8 @@ bool CameraManager::setupCamera()
 #endif
 
     this->setupCameraSensor();
+    this->setupRateControl();
+    this->applyStoredVieWindow();
     return true;
 }
 
@@ -407,6 +534,7 @@ void CameraManager::loadConfigData()
     xSemaphoreTake(sensor_mutex, portMAX_DELAY);
     camera_sensor->set_quality(camera_sensor, cameraConfig.quality);
     camera_sensor->set_agc_gain(camera_sensor, cameraConfig.brightness);
+    publishSensorMetadata(camera_sensor);
     xSemaphoreGive(sensor_mutex);
     ESP_LOGD(CAMERA_MANAGER_TAG, "Loading camera config data done");
 }
@@ -415,15 +543,105 @@ int CameraManager::setCameraResolution(const framesize_t frameSize)
 {
     if (!camera_sensor) return -1;
     xSemaphoreTake(sensor_mutex, portMAX_DELAY);
+    camera_sccb_stats_t sccb_before = {};
+    esp_camera_get_sccb_stats(&sccb_before);
+    const int64_t start_us = esp_timer_get_time();
     int ret = -1;
-    if (camera_sensor->pixformat == PIXFORMAT_JPEG)
+    // raw buffers only hold the frame size they were allocated for, anything else goes through setPixelFormat
+    if (camera_sensor->pixformat == PIXFORMAT_JPEG || frameSize == config.frame_size)
     {
         ret = camera_sensor->set_framesize(camera_sensor, frameSize);
     }
+
+    // set_framesize programs the whole readout again, put the window back if it still fits
+    if (ret == 0 && window.width != 0)
+    {
+        const VieWindow bounds = this->getVieWindowBounds();
+        const bool fits = bounds.width != 0 && window.offset_x + window.width <= bounds.width && window.offset_y + window.height <= bounds.height;
+        const bool uvc_size_ok = projectConfig->getDeviceMode() != StreamingMode::UVC ||
+                                 (window.width == resolution[frameSize].width && window.height == resolution[frameSize].height);
+        if (!fits || !uvc_size_ok || this->programVieWindow(window, false) != 0)
+        {
+            ESP_LOGW(CAMERA_MANAGER_TAG, "Window %dx%d doesn't fit frame size %d, streaming the full frame", window.width, window.height, frameSize);
+            window = {};
+        }
+    }
+    if (ret == 0)
+    {
+        logSccbCost("Frame size change", sccb_before, start_us);
+    }
     xSemaphoreGive(sensor_mutex);
     return ret;
 }
 
+int CameraManager::setPixelFormat(const pixformat_t format, const framesize_t frameSize)
+{
+    if (!camera_sensor) return -1;
+    const framesize_t buffer_size = format == PIXFORMAT_JPEG ? JPEG_BUFFER_FRAMESIZE : frameSize;
+    if (format == config.pixel_format && buffer_size == config.frame_size)
+    {
+        return this->setCameraResolution(frameSize);
+    }
+
+    // the driver picks the DMA mode and frame buffer size in esp_camera_init, so this is a full restart,
+    // at whatever XCLK we're running now. If the new format doesn't come up the old one goes back.
+    xSemaphoreTake(sensor_mutex, portMAX_DELAY);
+    const pixformat_t previous_format = config.pixel_format;
+    const framesize_t previous_size = config.frame_size;
+    config.pixel_format = format;
+    config.frame_size = buffer_size;
+    esp_camera_deinit();
+    esp_err_t ret = esp_camera_init(&config);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(CAMERA_MANAGER_TAG, "Camera restart with pixformat %d failed: %s, keeping pixformat %d", format, esp_err_to_name(ret), previous_format);
+        config.pixel_format = previous_format;
+        config.frame_size = previous_size;
+        if (esp_camera_init(&config) != ESP_OK)
+        {
+            camera_sensor = nullptr;
+            xSemaphoreGive(sensor_mutex);
+            constexpr auto event = SystemEvent{EventSource::CAMERA, CameraState_e::Camera_Error};
+            xQueueSend(this->eventQueue, &event, 10);
+            return -1;
+        }
+    }
+    // the sensor came back with its defaults, ours go on top again
+    this->setupCameraSensor();
+    xSemaphoreGive(sensor_mutex);
+
+    if (ret != ESP_OK)
+    {
+        return -1;
+    }
+    ESP_LOGI(CAMERA_MANAGER_TAG, "Camera restarted with pixformat %d, frame buffers for frame size %d", format, buffer_size);
+    return this->setCameraResolution(frameSize);
+}
+
+int CameraManager::setXclkFrequency(const uint32_t frequency_hz)
+{
+    if (!camera_sensor) return -1;
+    // the sensor driver only takes whole MHz
+    const uint32_t mhz = frequency_hz / 1000000U;
+    if (mhz == 0) return -1;
+    if (mhz * 1000000U == config.xclk_freq_hz) return 0;
+
+    xSemaphoreTake(sensor_mutex, portMAX_DELAY);
+    int ret = camera_sensor->set_xclk(camera_sensor, config.ledc_timer, static_cast<int>(mhz));
+    xSemaphoreGive(sensor_mutex);
+    if (ret != 0)
+    {
+        ESP_LOGW(CAMERA_MANAGER_TAG, "Failed to switch XCLK to %lu MHz", static_cast<unsigned long>(mhz));
+        return ret;
+    }
+
+    config.xclk_freq_hz = mhz * 1000000U;
+    ESP_LOGI(CAMERA_MANAGER_TAG, "XCLK switched to %lu Hz", static_cast<unsigned long>(config.xclk_freq_hz));
+    // same as the override at setup, give the PLL a moment to relock before anything touches the sensor
+    vTaskDelay(pdMS_TO_TICKS(50));
+    return 0;
+}
+
 int CameraManager::setVFlip(const int direction)
 {
     if (!camera_sensor) return -1;
@@ -442,8 +660,145 @@ int CameraManager::setHFlip(const int direction)
     return ret;
 }
 
-int CameraManager::setVieWindow(int offsetX, int offsetY, int outputX, int outputY)
+int CameraManager::setJpegQuality(const int quality)
+{
+    if (!camera_sensor) return -1;
+    xSemaphoreTake(sensor_mutex, portMAX_DELAY);
+    int ret = camera_sensor->set_quality(camera_sensor, quality);
+    xSemaphoreGive(sensor_mutex);
+    return ret;
+}
+
+VieWindow CameraManager::getVieWindowBounds() const
+{
+    VieWindow bounds;
+    if (!camera_sensor) return bounds;
+
+    switch (camera_sensor->id.PID)
+    {
+        case OV2640_PID:
+            // every frame size up to CIF gets scaled out of the 400x296 CIF readout
+            if (camera_sensor->status.framesize <= FRAMESIZE_CIF)
+            {
+                bounds.width = 400;
+                bounds.height = 296;
+            }
+            break;
+        case OV3660_PID:
+            // sizes up to half the array read it out binned 2x2, windows sit on that grid
+            if (camera_sensor->status.binning)
+            {
+                bounds.width = 1024;
+                bounds.height = 768;
+            }
+            break;
+        default:
+            break;
+    }
+    return bounds;
+}
+
+// expects the sensor mutex to be held
+int CameraManager::programVieWindow(const VieWindow& target, const bool moved)
 {
-    // todo safariMonkey made a PoC, implement it here
+    sensor_t* s = camera_sensor;
+    if (s->id.PID == OV2640_PID)
+    {
+        if (moved)
+        {
+            // same size somewhere else, only the DSP offsets change, no DSP bypass, PLL or pixformat rewrite like set_window does
+            const int size_x = target.width / 4;
+            const int size_y = target.height / 4;
+            int ret = s->set_reg(s, OV2640_XOFFL, 0xff, target.offset_x & 0xff);
+            if (ret == 0) ret = s->set_reg(s, OV2640_YOFFL, 0xff, target.offset_y & 0xff);
+            if (ret == 0)
+                ret = s->set_reg(s, OV2640_VHYX, 0xff,
+                                 ((size_y >> 1) & 0x80) | ((target.offset_y >> 4) & 0x70) | ((size_x >> 5) & 0x08) | ((target.offset_x >> 8) & 0x07));
+            return ret;
+        }
+        // window and output the same size, so the DSP crops and doesn't scale
+        // the OV2640 reads out the whole CIF frame either way, this makes frames smaller but not faster
+        return s->set_res_raw(s, OV2640_MODE_CIF, 0, 0, 0, 0, target.offset_x, target.offset_y, target.width, target.height, target.width, target.height,
+                              false, false);
+    }
+
+    // OV3660, only the window's rows and columns of the array get read out, binned 2x2. The frame gets as many
+    // lines shorter as the window is, that's where the frame rate comes from. The address window carries the
+    // same 32x12 pixel border for the ISP that the full frame modes have, moving it is the same few registers.
+    const int start_x = target.offset_x * 2;
+    const int start_y = target.offset_y * 2;
+    const int end_x = (target.offset_x + target.width) * 2 - 1 + 32;
+    const int end_y = (target.offset_y + target.height) * 2 - 1 + 12;
+    const int total_y = (end_y - start_y + 1) / 2 + OV3660_BINNED_VBLANK;
+    return s->set_res_raw(s, start_x, start_y, end_x, end_y, 8, 2, OV3660_HTS, total_y, target.width, target.height, false, true);
+}
+
+int CameraManager::setVieWindow(const int offsetX, const int offsetY, const int outputX, const int outputY)
+{
+    if (!camera_sensor) return -1;
+
+    if (outputX == 0 || outputY == 0)
+    {
+        if (window.width == 0) return 0;
+        xSemaphoreTake(sensor_mutex, portMAX_DELAY);
+        const int ret = camera_sensor->set_framesize(camera_sensor, camera_sensor->status.framesize);
+        xSemaphoreGive(sensor_mutex);
+        if (ret == 0)
+        {
+            window = {};
+            ESP_LOGI(CAMERA_MANAGER_TAG, "Window cleared, streaming the full frame");
+        }
+        return ret;
+    }
+
+    const VieWindow bounds = this->getVieWindowBounds();
+    if (bounds.width == 0)
+    {
+        ESP_LOGW(CAMERA_MANAGER_TAG, "Sensor can't window at this frame size");
+        return -1;
+    }
+    // JPEG works in 8x8 blocks, the OV2640 DSP in steps of 4
+    if (outputX % 8 != 0 || outputY % 8 != 0 || outputX < 64 || outputY < 64 || offsetX < 0 || offsetY < 0 || offsetX + outputX > bounds.width ||
+        offsetY + outputY > bounds.height)
+    {
+        ESP_LOGW(CAMERA_MANAGER_TAG, "Window %dx%d at %d,%d doesn't fit the %dx%d readout", outputX, outputY, offsetX, offsetY, bounds.width, bounds.height);
+        return -1;
+    }
+    // a UVC host decodes at the size it committed to, there the window can only move
+    const framesize_t framesize = camera_sensor->status.framesize;
+    if (projectConfig->getDeviceMode() == StreamingMode::UVC && (outputX != resolution[framesize].width || outputY != resolution[framesize].height))
+    {
+        ESP_LOGW(CAMERA_MANAGER_TAG, "UVC streams %ux%u, the window has to be the same size", resolution[framesize].width, resolution[framesize].height);
+        return -1;
+    }
+
+    const VieWindow target{offsetX, offsetY, outputX, outputY};
+    const bool moved = window.width == outputX && window.height == outputY;
+    xSemaphoreTake(sensor_mutex, portMAX_DELAY);
+    const int64_t start_us = esp_timer_get_time();
+    const int ret = this->programVieWindow(target, moved);
+    const int64_t took_us = esp_timer_get_time() - start_us;
+    xSemaphoreGive(sensor_mutex);
+
+    if (ret != 0)
+    {
+        ESP_LOGE(CAMERA_MANAGER_TAG, "Sensor refused window %dx%d at %d,%d", outputX, outputY, offsetX, offsetY);
+        return ret;
+    }
+    window = target;
+    ESP_LOGI(CAMERA_MANAGER_TAG, "Window %dx%d at %d,%d %s in %lld us", outputX, outputY, offsetX, offsetY, moved ? "moved" : "set",
+             static_cast<long long>(took_us));
     return 0;
+}
+
+void CameraManager::applyStoredVieWindow()
+{
+    const CameraConfig_t& cameraConfig = projectConfig->getCameraConfig();
+    if (cameraConfig.window_width == 0 || cameraConfig.window_height == 0) return;
+
+    if (this->setVieWindow(cameraConfig.window_x, cameraConfig.window_y, cameraConfig.window_width, cameraConfig.window_height) != 0)
+    {
+        ESP_LOGW(CAMERA_MANAGER_TAG, "Stored window %ux%u at %u,%u doesn't fit this sensor, streaming the full frame", cameraConfig.window_width,
+                 cameraConfig.window_height, cameraConfig.window_x, cameraConfig.window_y);
+    }
 }
\ No newline at end of file
@@ -4,8 +4,10 @@
 
 #include "driver/gpio.h"
 #include "esp_camera.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
 #include "esp_psram.h"
+#include "esp_timer.h"
 #include "sdkconfig.h"
 
 #include "freertos/FreeRTOS.h"
@@ -13,11 +15,22 @@
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 
+#include <JpegRateControl.hpp>
 #include <ProjectConfig.hpp>
 #include <StateManager.hpp>
 
 #define OV5640_XCLK_FREQ_HZ CONFIG_CAMERA_WIFI_XCLK_FREQ
 
+// a region of interest cut out of the sensor readout at 1:1, in readout pixels
+// (400x296 on the OV2640, the binned 1024x768 array on the OV3660), a width of 0 is the whole frame
+struct VieWindow
+{
+    int offset_x = 0;
+    int offset_y = 0;
+    int width = 0;
+    int height = 0;
+};
+
 class CameraManager
 {
    private:
@@ -26,19 +39,43 @@ class CameraManager
     std::shared_ptr<ProjectConfig> projectConfig;
     QueueHandle_t eventQueue;
     camera_config_t config;
+    VieWindow window;
 
    public:
     CameraManager(std::shared_ptr<ProjectConfig> projectConfig, QueueHandle_t eventQueue);
     int setCameraResolution(framesize_t frameSize);
+    // JPEG or one of the raw formats, switching between them restarts the driver with new frame buffers,
+    // raw ones sized for exactly frameSize. Nothing may hold or wait for a frame while this runs.
+    int setPixelFormat(pixformat_t format, framesize_t frameSize);
+    // live XCLK switch, call setCameraResolution afterwards so the sensor PLL gets reprogrammed
+    int setXclkFrequency(uint32_t frequency_hz);
+    uint32_t getXclkFrequency() const
+    {
+        return config.xclk_freq_hz;
+    }
     bool setupCamera();
     int setVFlip(int direction);
     int setHFlip(int direction);
+    // the window becomes the frame, outputX x outputY big, 0x0 goes back to the full frame
+    // the same size somewhere else only moves it, without reprogramming the sensor
     int setVieWindow(int offsetX, int offsetY, int outputX, int outputY);
+    VieWindow getVieWindow() const
+    {
+        return window;
+    }
+    // the readout the window has to fit in, width 0 if the sensor or frame size can't do windows
+    VieWindow getVieWindowBounds() const;
+    int setJpegQuality(int quality);
 
    private:
     void loadConfigData();
     void setupCameraPinout();
     void setupCameraSensor();
+    size_t jpegFrameBytes() const;
+    void planUvcFrameBuffers();
+    void setupRateControl();
+    int programVieWindow(const VieWindow& target, bool moved);
+    void applyStoredVieWindow();
 };
 
 #endif  // CAMERAMANAGER_HPP
\ No newline at end of file
@@ -0,0 +1,305 @@
+#include "CommandJobs.hpp"
+#include <algorithm>
+#include "esp_log.h"
+#include "freertos/task.h"
+
+static const char* TAG = "[JOBS]";
+
+namespace
+{
+// collects the handler's output, past MAX_RESULT_SIZE it only remembers that there was more
+class ResultSink : public ResponseSink
+{
+   public:
+    void write(const char* data, size_t length) override
+    {
+        if (overflowed || text.size() + length > CommandJobs::MAX_RESULT_SIZE)
+        {
+            overflowed = true;
+            return;
+        }
+        text.append(data, length);
+    }
+
+    std::string text;
+    bool overflowed = false;
+};
+
+const char* stateName(CommandJobs::State state)
+{
+    switch (state)
+    {
+    case CommandJobs::State::Queued:
+        return "queued";
+    case CommandJobs::State::Running:
+        return "running";
+    case CommandJobs::State::Done:
+        return "done";
+    default:
+        return "free";
+    }
+}
+}  // namespace
+
+bool CommandJobs::start()
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (this->queue != nullptr)
+        return true;
+
+    // set before the worker exists, it goes straight for it
+    this->queue = xQueueCreate(MAX_JOBS, sizeof(uint8_t));
+    if (this->queue == nullptr)
+        return false;
+
+    // the handlers used to run on the serial task, they get the same stack here
+    if (xTaskCreate(&CommandJobs::workerTask, "CommandJobs", 1024 * 6, this, 1, nullptr) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to start the job worker, long commands will block their transport");
+        vQueueDelete(this->queue);
+        this->queue = nullptr;
+        return false;
+    }
+    return true;
+}
+
+uint32_t CommandJobs::submit(std::string_view name, Handler handler, const std::shared_ptr<DependencyRegistry>& registry, const nlohmann::json& payload,
+                             const Notify& notify)
+{
+    uint8_t slot = MAX_JOBS;
+    uint32_t id = 0;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        if (this->queue == nullptr)
+            return 0;
+
+        // a free slot, otherwise the oldest finished job makes room, one that still waits to be pushed only if nothing else can
+        // a transport that went away (the usb-jtag one once cdc takes over) must not keep its slots forever
+        const auto evictable = [this](size_t i) { return !this->jobs[i].notify.owner || this->jobs[i].delivered; };
+        for (size_t i = 0; i < MAX_JOBS; i++)
+        {
+            const auto& job = this->jobs[i];
+            if (job.state == State::Free)
+            {
+                slot = static_cast<uint8_t>(i);
+                break;
+            }
+            if (job.state != State::Done)
+                continue;
+            if (slot == MAX_JOBS || evictable(i) > evictable(slot) || (evictable(i) == evictable(slot) && job.id < this->jobs[slot].id))
+                slot = static_cast<uint8_t>(i);
+        }
+        if (slot == MAX_JOBS)
+            return 0;
+
+        auto& job = this->jobs[slot];
+        id = this->next_id++;
+        if (this->next_id == 0)
+            this->next_id = 1;
+
+        job.id = id;
+        job.state = State::Queued;
+        job.progress = 0;
+        job.name = name;
+        job.handler = handler;
+        job.registry = registry;
+        job.payload = payload;
+        job.status = CommandResult::Status::SUCCESS;
+        job.result.clear();
+        job.result.shrink_to_fit();
+        job.notify = notify;
+        job.delivered = false;
+    }
+
+    // never blocks, there are never more queued slots than the queue is long
+    xQueueSend(this->queue, &slot, 0);
+    return id;
+}
+
+void CommandJobs::reportProgress(uint8_t percent)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (this->running < MAX_JOBS)
+        this->jobs[this->running].progress = std::min<uint8_t>(percent, 100);
+}
+
+void CommandJobs::workerTask(void* arg)
+{
+    auto* self = static_cast<CommandJobs*>(arg);
+    uint8_t slot;
+    while (true)
+    {
+        if (xQueueReceive(self->queue, &slot, portMAX_DELAY) == pdTRUE && slot < MAX_JOBS)
+            self->run(slot);
+    }
+}
+
+void CommandJobs::run(size_t slot)
+{
+    Handler handler;
+    std::shared_ptr<DependencyRegistry> registry;
+    nlohmann::json payload;
+    uint32_t id;
+    std::string_view name;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        auto& job = this->jobs[slot];
+        job.state = State::Running;
+        this->running = slot;
+        handler = job.handler;
+        registry = std::move(job.registry);
+        payload = std::move(job.payload);
+        id = job.id;
+        name = job.name;
+    }
+
+    ESP_LOGI(TAG, "Running job %lu (%.*s)", static_cast<unsigned long>(id), static_cast<int>(name.size()), name.data());
+
+    ResultSink sink;
+    ResponseWriter writer(sink);
+    auto status = handler(registry, payload, writer);
+    writer.flush();
+
+    if (sink.overflowed)
+    {
+        status = CommandResult::Status::FAILURE;
+        sink.text = "\"Result too large\"";
+    }
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    auto& job = this->jobs[slot];
+    job.status = status;
+    job.result = std::move(sink.text);
+    job.progress = 100;
+    job.state = State::Done;
+    this->running = MAX_JOBS;
+}
+
+const CommandJobs::Job* CommandJobs::find(uint32_t id) const
+{
+    for (const auto& job : this->jobs)
+    {
+        if (job.state != State::Free && job.id == id)
+            return &job;
+    }
+    return nullptr;
+}
+
+void CommandJobs::writeJob(const Job& job, const std::string* result, ResponseWriter& writer)
+{
+    writer.beginObject();
+    writer.key("command");
+    writer.value(job.name);
+    writer.key("id");
+    writer.value(job.id);
+    writer.key("progress");
+    writer.value(job.progress);
+    if (result != nullptr)
+    {
+        writer.key("result");
+        // kept as the json its command wrote, it only has to be taken apart again for cbor
+        if (writer.getEncoding() == ResponseWriter::Encoding::Json && !result->empty())
+        {
+            writer.raw(*result);
+        }
+        else
+        {
+            const auto parsed = nlohmann::json::parse(*result, nullptr, false);
+            if (parsed.is_discarded())
+                writer.nullValue();
+            else
+                writer.value(parsed);
+        }
+    }
+    writer.key("state");
+    writer.value(stateName(job.state));
+    if (job.state == State::Done)
+    {
+        writer.key("status");
+        writer.value(job.status == CommandResult::Status::SUCCESS ? "success" : "error");
+    }
+    writer.endObject();
+}
+
+bool CommandJobs::writeStatus(uint32_t id, ResponseWriter& writer) const
+{
+    // copied out, the writer may block on the transport and the worker shouldn't have to wait for that
+    Job snapshot;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        const Job* job = this->find(id);
+        if (job == nullptr)
+            return false;
+
+        snapshot.id = job->id;
+        snapshot.state = job->state;
+        snapshot.progress = job->progress;
+        snapshot.name = job->name;
+        snapshot.status = job->status;
+        snapshot.result = job->result;
+    }
+
+    writeJob(snapshot, snapshot.state == State::Done ? &snapshot.result : nullptr, writer);
+    return true;
+}
+
+void CommandJobs::writeAll(ResponseWriter& writer) const
+{
+    std::array<Job, MAX_JOBS> snapshot{};
+    size_t count = 0;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        for (const auto& job : this->jobs)
+        {
+            if (job.state == State::Free)
+                continue;
+            auto& copy = snapshot[count++];
+            copy.id = job.id;
+            copy.state = job.state;
+            copy.progress = job.progress;
+            copy.name = job.name;
+            copy.status = job.status;
+        }
+    }
+
+    // oldest first, four slots don't need more than an insertion sort
+    for (size_t i = 1; i < count; i++)
+    {
+        for (size_t j = i; j > 0 && snapshot[j - 1].id > snapshot[j].id; j--)
+            std::swap(snapshot[j - 1], snapshot[j]);
+    }
+
+    writer.beginObject();
+    writer.key("jobs");
+    writer.beginArray();
+    for (size_t i = 0; i < count; i++)
+        writeJob(snapshot[i], nullptr, writer);
+    writer.endArray();
+    writer.endObject();
+}
+
+uint32_t CommandJobs::findUndelivered(const void* owner, uint32_t& request_id) const
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    const Job* oldest = nullptr;
+    for (const auto& job : this->jobs)
+    {
+        if (job.state == State::Done && !job.delivered && job.notify.owner == owner && owner != nullptr && (!oldest || job.id < oldest->id))
+            oldest = &job;
+    }
+    if (oldest == nullptr)
+        return 0;
+
+    request_id = oldest->notify.request_id;
+    return oldest->id;
+}
+
+void CommandJobs::markDelivered(uint32_t id)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    for (auto& job : this->jobs)
+    {
+        if (job.state != State::Free && job.id == id)
+            job.delivered = true;
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+#ifndef COMMAND_JOBS_HPP
+#define COMMAND_JOBS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <nlohmann-json.hpp>
+#include <string>
+#include <string_view>
+#include "CommandResult.hpp"
+#include "DependencyRegistry.hpp"
+#include "ResponseWriter.hpp"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+// Commands that take seconds - a wifi scan, a connection attempt - run on a worker task of their own.
+// Whoever received the command gets a job id right away and goes back to answering the rest, the worker
+// runs the handler into a buffer and get_job_status hands out the progress and, once it's done, the result.
+//
+// A handful of slots, a finished job stays around until a new one needs its slot,
+// so a result can be fetched again if the answer got lost on the way.
+//
+// Jobs started by a line with an "id" also remember the transport it came in on (the owner) and that id,
+// the transport pushes the result back tagged with it once the job is done, instead of the host polling for it.
+class CommandJobs
+{
+   public:
+    static constexpr size_t MAX_JOBS = 4;
+    // a scan in a crowded room comes to about 6 KB
+    static constexpr size_t MAX_RESULT_SIZE = 8 * 1024;
+
+    using Handler = CommandResult::Status (*)(const std::shared_ptr<DependencyRegistry>&, const nlohmann::json&, ResponseWriter&);
+
+    enum class State : uint8_t
+    {
+        Free,
+        Queued,
+        Running,
+        Done,
+    };
+
+    // starts the worker task, until then nothing gets queued and the commands run where they were received
+    bool start();
+    bool isRunning() const
+    {
+        return this->queue != nullptr;
+    }
+
+    // who a job's result gets pushed to, nobody for untagged requests
+    // no member initializers, they'd keep the {} default argument below from compiling inside the class
+    struct Notify
+    {
+        const void* owner;
+        uint32_t request_id;
+    };
+
+    // the job id, 0 if the worker isn't running or every slot is still busy
+    uint32_t submit(std::string_view name, Handler handler, const std::shared_ptr<DependencyRegistry>& registry, const nlohmann::json& payload,
+                    const Notify& notify = {});
+
+    // for the handler of the running job, how far along it is in percent
+    // a no-op when the handler runs outside of a job
+    void reportProgress(uint8_t percent);
+
+    // {"command", "id", "progress", "result", "state", "status"}, the last two once the job is done
+    // false if there's no such job, it never existed or its slot went to a newer one
+    bool writeStatus(uint32_t id, ResponseWriter& writer) const;
+    // {"jobs": [...]} with every job that's still around, without the results
+    void writeAll(ResponseWriter& writer) const;
+
+    // a finished job owner has yet to push, 0 if there's none, the id of the request that started it goes into request_id
+    uint32_t findUndelivered(const void* owner, uint32_t& request_id) const;
+    void markDelivered(uint32_t id);
+
+   private:
+    struct Job
+    {
+        uint32_t id = 0;
+        State state = State::Free;
+        uint8_t progress = 0;
+        std::string_view name;
+        Handler handler = nullptr;
+        std::shared_ptr<DependencyRegistry> registry;
+        nlohmann::json payload;
+        CommandResult::Status status = CommandResult::Status::SUCCESS;
+        // the handler's data as json text
+        std::string result;
+        Notify notify{};
+        bool delivered = false;
+    };
+
+    static void workerTask(void* arg);
+    void run(size_t slot);
+    const Job* find(uint32_t id) const;
+    static void writeJob(const Job& job, const std::string* result, ResponseWriter& writer);
+
+    mutable std::mutex lock;
+    std::array<Job, MAX_JOBS> jobs{};
+    uint32_t next_id = 1;
+    // slot of the job the worker is on, MAX_JOBS while it waits
+    size_t running = MAX_JOBS;
+    // slot numbers, in the order the jobs came in
+    QueueHandle_t queue = nullptr;
+};
+
+#endif
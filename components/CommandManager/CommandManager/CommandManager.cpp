@@ -1,167 +1,430 @@
 #include "CommandManager.hpp"
+#include <array>
+#include <cstdio>
 #include <cstdlib>
+#include <optional>
+#include <type_traits>
 
-std::unordered_map<std::string, CommandType> commandTypeMap = {
-    {"ping", CommandType::PING},
-    {"pause", CommandType::PAUSE},
-    {"set_wifi", CommandType::SET_WIFI},
-    {"update_wifi", CommandType::UPDATE_WIFI},
-    {"update_ota_credentials", CommandType::UPDATE_OTA_CREDENTIALS},
-    {"delete_network", CommandType::DELETE_NETWORK},
-    {"update_ap_wifi", CommandType::UPDATE_AP_WIFI},
-    {"set_mdns", CommandType::SET_MDNS},
-    {"get_mdns_name", CommandType::GET_MDNS_NAME},
-    {"update_camera", CommandType::UPDATE_CAMERA},
-    {"save_config", CommandType::SAVE_CONFIG},
-    {"get_config", CommandType::GET_CONFIG},
-    {"reset_config", CommandType::RESET_CONFIG},
-    {"restart_device", CommandType::RESTART_DEVICE},
-    {"scan_networks", CommandType::SCAN_NETWORKS},
-    {"start_streaming", CommandType::START_STREAMING},
-    {"get_wifi_status", CommandType::GET_WIFI_STATUS},
-    {"connect_wifi", CommandType::CONNECT_WIFI},
-    {"switch_mode", CommandType::SWITCH_MODE},
-    {"get_device_mode", CommandType::GET_DEVICE_MODE},
-    {"set_led_duty_cycle", CommandType::SET_LED_DUTY_CYCLE},
-    {"get_led_duty_cycle", CommandType::GET_LED_DUTY_CYCLE},
-    {"set_fan_duty_cycle", CommandType::SET_FAN_DUTY_CYCLE},
-    {"get_fan_duty_cycle", CommandType::GET_FAN_DUTY_CYCLE},
-    {"get_serial", CommandType::GET_SERIAL},
-    {"get_led_current", CommandType::GET_LED_CURRENT},
-    {"get_battery_status", CommandType::GET_BATTERY_STATUS},
-    {"get_who_am_i", CommandType::GET_WHO_AM_I},
-    {"set_debug_log_enabled", CommandType::SET_DEBUG_LOG_ENABLED},
-    {"get_debug_log_enabled", CommandType::GET_DEBUG_LOG_ENABLED},
-    {"get_logs", CommandType::GET_LOGS},
-    {"get_persistent_logs", CommandType::GET_PERSISTENT_LOGS},
-    {"clear_persistent_logs", CommandType::CLEAR_PERSISTENT_LOGS},
+namespace
+{
+// writes the "data" value of the result and reports how it went
+using CommandHandler = CommandResult::Status (*)(const std::shared_ptr<DependencyRegistry>&, const nlohmann::json&, ResponseWriter&);
+
+template <auto Handler>
+CommandResult callHandler(const std::shared_ptr<DependencyRegistry>& registry, const nlohmann::json& json)
+{
+    using HandlerType = decltype(Handler);
+    if constexpr (std::is_invocable_v<HandlerType, std::shared_ptr<DependencyRegistry>, const nlohmann::json&>)
+        return Handler(registry, json);
+    else if constexpr (std::is_invocable_v<HandlerType, std::shared_ptr<DependencyRegistry>>)
+        return Handler(registry);
+    else if constexpr (std::is_invocable_v<HandlerType, const nlohmann::json&>)
+        return Handler(json);
+    else
+        return Handler();
+}
+
+// handlers come in a few shapes, this irons them out into one so they all fit in the table
+// the ones with big outputs write straight into the response, the rest hand back a CommandResult we serialize
+template <auto Handler>
+CommandResult::Status invokeHandler(const std::shared_ptr<DependencyRegistry>& registry, const nlohmann::json& json, ResponseWriter& writer)
+{
+    if constexpr (std::is_invocable_v<decltype(Handler), std::shared_ptr<DependencyRegistry>, const nlohmann::json&, ResponseWriter&>)
+    {
+        return Handler(registry, json, writer);
+    }
+    else if constexpr (std::is_invocable_v<decltype(Handler), std::shared_ptr<DependencyRegistry>, ResponseWriter&>)
+    {
+        return Handler(registry, writer);
+    }
+    else
+    {
+        const CommandResult result = callHandler<Handler>(registry, json);
+        writer.value(result.getData());
+        return result.isSuccess() ? CommandResult::Status::SUCCESS : CommandResult::Status::FAILURE;
+    }
+}
+
+struct CommandDescriptor
+{
+    std::string_view name;
+    CommandType type;
+    CommandHandler handler;
+    // takes seconds, runs as a job once the worker is up
+    bool async = false;
+};
+
+constexpr CommandDescriptor COMMANDS[] = {
+    {"ping", CommandType::PING, invokeHandler<PingCommand>},
+    {"pause", CommandType::PAUSE, invokeHandler<PauseCommand>},
+    {"set_wifi", CommandType::SET_WIFI, invokeHandler<setWiFiCommand>},
+    {"update_wifi", CommandType::UPDATE_WIFI, invokeHandler<updateWiFiCommand>},
+    {"update_ota_credentials", CommandType::UPDATE_OTA_CREDENTIALS, invokeHandler<updateOTACredentialsCommand>},
+    {"delete_network", CommandType::DELETE_NETWORK, invokeHandler<deleteWiFiCommand>},
+    {"update_ap_wifi", CommandType::UPDATE_AP_WIFI, invokeHandler<updateAPWiFiCommand>},
+    {"set_mdns", CommandType::SET_MDNS, invokeHandler<setMDNSCommand>},
+    {"get_mdns_name", CommandType::GET_MDNS_NAME, invokeHandler<getMDNSNameCommand>},
+    {"update_camera", CommandType::UPDATE_CAMERA, invokeHandler<updateCameraCommand>},
+    {"save_config", CommandType::SAVE_CONFIG, invokeHandler<saveConfigCommand>},
+    {"get_config", CommandType::GET_CONFIG, invokeHandler<getConfigCommand>},
+    {"reset_config", CommandType::RESET_CONFIG, invokeHandler<resetConfigCommand>},
+    {"restart_device", CommandType::RESTART_DEVICE, invokeHandler<restartDeviceCommand>},
+    {"scan_networks", CommandType::SCAN_NETWORKS, invokeHandler<scanNetworksCommand>, true},
+    {"start_streaming", CommandType::START_STREAMING, invokeHandler<startStreamingCommand>},
+    {"get_wifi_status", CommandType::GET_WIFI_STATUS, invokeHandler<getWiFiStatusCommand>},
+    {"connect_wifi", CommandType::CONNECT_WIFI, invokeHandler<connectWiFiCommand>, true},
+    {"switch_mode", CommandType::SWITCH_MODE, invokeHandler<switchModeCommand>},
+    {"get_device_mode", CommandType::GET_DEVICE_MODE, invokeHandler<getDeviceModeCommand>},
+    {"set_led_duty_cycle", CommandType::SET_LED_DUTY_CYCLE, invokeHandler<updateLEDDutyCycleCommand>},
+    {"get_led_duty_cycle", CommandType::GET_LED_DUTY_CYCLE, invokeHandler<getLEDDutyCycleCommand>},
+    {"set_fan_duty_cycle", CommandType::SET_FAN_DUTY_CYCLE, invokeHandler<updateFanDutyCycleCommand>},
+    {"get_fan_duty_cycle", CommandType::GET_FAN_DUTY_CYCLE, invokeHandler<getFanDutyCycleCommand>},
+    {"get_serial", CommandType::GET_SERIAL, invokeHandler<getSerialNumberCommand>},
+    {"get_led_current", CommandType::GET_LED_CURRENT, invokeHandler<getLEDCurrentCommand>},
+    {"get_battery_status", CommandType::GET_BATTERY_STATUS, invokeHandler<getBatteryStatusCommand>},
+    {"get_who_am_i", CommandType::GET_WHO_AM_I, invokeHandler<getInfoCommand>},
+    {"set_debug_log_enabled", CommandType::SET_DEBUG_LOG_ENABLED, invokeHandler<setDebugLogEnabledCommand>},
+    {"get_debug_log_enabled", CommandType::GET_DEBUG_LOG_ENABLED, invokeHandler<getDebugLogEnabledCommand>},
+    {"get_logs", CommandType::GET_LOGS, invokeHandler<getLogsCommand>},
+    {"get_persistent_logs", CommandType::GET_PERSISTENT_LOGS, invokeHandler<getPersistentLogsCommand>},
+    {"clear_persistent_logs", CommandType::CLEAR_PERSISTENT_LOGS, invokeHandler<clearPersistentLogsCommand>},
+    {"get_stream_stats", CommandType::GET_STREAM_STATS, invokeHandler<getStreamStatsCommand>},
+    {"set_vie_window", CommandType::SET_VIE_WINDOW, invokeHandler<setVieWindowCommand>},
+    {"get_vie_window", CommandType::GET_VIE_WINDOW, invokeHandler<getVieWindowCommand>},
+    {"get_job_status", CommandType::GET_JOB_STATUS, invokeHandler<getJobStatusCommand>},
 };
 
-std::function<CommandResult()> CommandManager::createCommand(const CommandType type, const nlohmann::json& json) const
-{
-    switch (type)
-    {
-    case CommandType::PING:
-        return {PingCommand};
-    case CommandType::PAUSE:
-        return [json] { return PauseCommand(json); };
-    case CommandType::UPDATE_OTA_CREDENTIALS:
-        return [this, json] { return updateOTACredentialsCommand(this->registry, json); };
-    case CommandType::SET_WIFI:
-        return [this, json] { return setWiFiCommand(this->registry, json); };
-    case CommandType::UPDATE_WIFI:
-        return [this, json] { return updateWiFiCommand(this->registry, json); };
-    case CommandType::UPDATE_AP_WIFI:
-        return [this, json] { return updateAPWiFiCommand(this->registry, json); };
-    case CommandType::DELETE_NETWORK:
-        return [this, json] { return deleteWiFiCommand(this->registry, json); };
-    case CommandType::SET_MDNS:
-        return [this, json] { return setMDNSCommand(this->registry, json); };
-    case CommandType::GET_MDNS_NAME:
-        return [this] { return getMDNSNameCommand(this->registry); };
-    case CommandType::UPDATE_CAMERA:
-        return [this, json] { return updateCameraCommand(this->registry, json); };
-    case CommandType::GET_CONFIG:
-        return [this] { return getConfigCommand(this->registry); };
-    case CommandType::SAVE_CONFIG:
-        return [this] { return saveConfigCommand(this->registry); };
-    case CommandType::RESET_CONFIG:
-        return [this, json] { return resetConfigCommand(this->registry, json); };
-    case CommandType::RESTART_DEVICE:
-        return restartDeviceCommand;
-    case CommandType::SCAN_NETWORKS:
-        return [this, json] { return scanNetworksCommand(this->registry, json); };
-    case CommandType::START_STREAMING:
-        return startStreamingCommand;
-    case CommandType::GET_WIFI_STATUS:
-        return [this] { return getWiFiStatusCommand(this->registry); };
-    case CommandType::CONNECT_WIFI:
-        return [this] { return connectWiFiCommand(this->registry); };
-    case CommandType::SWITCH_MODE:
-        return [this, json] { return switchModeCommand(this->registry, json); };
-    case CommandType::GET_DEVICE_MODE:
-        return [this] { return getDeviceModeCommand(this->registry); };
-    case CommandType::SET_LED_DUTY_CYCLE:
-        return [this, json] { return updateLEDDutyCycleCommand(this->registry, json); };
-    case CommandType::GET_LED_DUTY_CYCLE:
-        return [this] { return getLEDDutyCycleCommand(this->registry); };
-    case CommandType::SET_FAN_DUTY_CYCLE:
-        return [this, json] { return updateFanDutyCycleCommand(this->registry, json); };
-    case CommandType::GET_FAN_DUTY_CYCLE:
-        return [this] { return getFanDutyCycleCommand(this->registry); };
-    case CommandType::GET_SERIAL:
-        return [this] { return getSerialNumberCommand(this->registry); };
-    case CommandType::GET_LED_CURRENT:
-        return [this] { return getLEDCurrentCommand(this->registry); };
-    case CommandType::GET_BATTERY_STATUS:
-        return [this] { return getBatteryStatusCommand(this->registry); };
-    case CommandType::GET_WHO_AM_I:
-        return [this] { return getInfoCommand(this->registry); };
-    case CommandType::SET_DEBUG_LOG_ENABLED:
-        return [this, json] { return setDebugLogEnabledCommand(this->registry, json); };
-    case CommandType::GET_DEBUG_LOG_ENABLED:
-        return [this] { return getDebugLogEnabledCommand(this->registry); };
-    case CommandType::GET_LOGS:
-        return [this] { return getLogsCommand(this->registry); };
-    case CommandType::GET_PERSISTENT_LOGS:
-        return [this] { return getPersistentLogsCommand(this->registry); };
-    case CommandType::CLEAR_PERSISTENT_LOGS:
-        return [this] { return clearPersistentLogsCommand(this->registry); };
-    default:
+constexpr size_t COMMAND_COUNT = std::size(COMMANDS);
+constexpr size_t COMMAND_NAME_MAX_LENGTH = 32;
+
+// perfect hash over the command names, the seed is picked at compile time so that
+// no two names land in the same slot - a lookup is one hash, one table read and one compare
+constexpr size_t HASH_SLOTS = 128;
+static_assert(COMMAND_COUNT < HASH_SLOTS / 2, "command table is getting full, bump HASH_SLOTS");
+
+constexpr uint32_t hashCommandName(std::string_view name, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ seed;
+    for (const char c : name)
+    {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+constexpr bool seedIsPerfect(uint32_t seed)
+{
+    std::array<bool, HASH_SLOTS> taken{};
+    for (const auto& command : COMMANDS)
+    {
+        const size_t slot = hashCommandName(command.name, seed) % HASH_SLOTS;
+        if (taken[slot])
+            return false;
+        taken[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t findPerfectSeed()
+{
+    for (uint32_t seed = 0; seed < 4096; seed++)
+    {
+        if (seedIsPerfect(seed))
+            return seed;
+    }
+    return UINT32_MAX;
+}
+
+constexpr uint32_t HASH_SEED = findPerfectSeed();
+static_assert(HASH_SEED != UINT32_MAX, "no collision free seed for the command names, bump HASH_SLOTS");
+
+constexpr auto COMMAND_SLOTS = []
+{
+    std::array<int8_t, HASH_SLOTS> slots{};
+    slots.fill(-1);
+    for (size_t i = 0; i < COMMAND_COUNT; i++)
+        slots[hashCommandName(COMMANDS[i].name, HASH_SEED) % HASH_SLOTS] = static_cast<int8_t>(i);
+    return slots;
+}();
+
+constexpr size_t COMMAND_TYPE_COUNT = static_cast<size_t>(CommandType::GET_JOB_STATUS) + 1;
+
+// the rest api dispatches by type, so keep a direct type -> descriptor index around too
+constexpr auto COMMANDS_BY_TYPE = []
+{
+    std::array<int8_t, COMMAND_TYPE_COUNT> types{};
+    types.fill(-1);
+    for (size_t i = 0; i < COMMAND_COUNT; i++)
+        types[static_cast<size_t>(COMMANDS[i].type)] = static_cast<int8_t>(i);
+    return types;
+}();
+
+const CommandDescriptor* findCommand(std::string_view name)
+{
+    const int8_t index = COMMAND_SLOTS[hashCommandName(name, HASH_SEED) % HASH_SLOTS];
+    if (index < 0 || COMMANDS[index].name != name)
+        return nullptr;
+    return &COMMANDS[index];
+}
+
+const CommandDescriptor* findCommand(CommandType type)
+{
+    const auto slot = static_cast<size_t>(type);
+    if (slot >= COMMAND_TYPE_COUNT || COMMANDS_BY_TYPE[slot] < 0)
+        return nullptr;
+    return &COMMANDS[COMMANDS_BY_TYPE[slot]];
+}
+
+// resolves the "command" member of a request entry, escapes and all, without allocating
+const CommandDescriptor* findCommand(const RequestParser& parser, int nameToken, char (&buffer)[COMMAND_NAME_MAX_LENGTH])
+{
+    const int length = parser.copyString(nameToken, buffer, sizeof(buffer));
+    if (length < 0)
         return nullptr;
+    return findCommand(std::string_view(buffer, length));
+}
+
+void writeInvalidJson(const RequestParser& parser, ResponseWriter& writer)
+{
+    char message[96];
+    snprintf(message, sizeof(message), "Invalid JSON - %s at offset %u", parser.errorMessage(), static_cast<unsigned>(parser.errorOffset()));
+
+    writer.beginObject();
+    writer.key("error");
+    writer.value(message);
+    writer.endObject();
+}
+
+// the handler's data, or for the long ones {"job_id": ..., "state": "queued"} and the handler runs on the job worker
+CommandResult::Status runCommand(const CommandDescriptor& command, const std::shared_ptr<DependencyRegistry>& registry, CommandJobs& jobs,
+                                 const nlohmann::json& payload, ResponseWriter& writer, const CommandJobs::Notify& notify = {})
+{
+    if (!command.async || !jobs.isRunning())
+        return command.handler(registry, payload, writer);
+
+    const uint32_t id = jobs.submit(command.name, command.handler, registry, payload, notify);
+    if (id == 0)
+    {
+        writer.value("Too many jobs in flight, try again once one of them is done");
+        return CommandResult::Status::FAILURE;
     }
+
+    writer.beginObject();
+    writer.key("job_id");
+    writer.value(id);
+    writer.key("state");
+    writer.value("queued");
+    writer.endObject();
+    return CommandResult::Status::SUCCESS;
+}
+
+// {"data": ..., "status": ...}, same key order nlohmann used to give us
+CommandResult::Status writeResult(const CommandDescriptor& command, const std::shared_ptr<DependencyRegistry>& registry, CommandJobs& jobs,
+                                  const nlohmann::json& payload, ResponseWriter& writer, const CommandJobs::Notify& notify = {})
+{
+    writer.beginObject();
+    writer.key("data");
+    const auto status = runCommand(command, registry, jobs, payload, writer, notify);
+    writer.key("status");
+    writer.value(status == CommandResult::Status::SUCCESS ? "success" : "error");
+    writer.endObject();
+    return status;
 }
 
-CommandManagerResponse CommandManager::executeFromJson(const std::string_view json) const
+// every answer to a tagged line starts with its id, so a host with several lines in flight knows which one it is
+void beginAnswer(ResponseWriter& writer, const std::optional<uint32_t>& requestId)
 {
-    if (!nlohmann::json::accept(json))
+    writer.beginObject();
+    if (requestId)
     {
-        return CommandManagerResponse(nlohmann::json{{"error", "Initial JSON Parse - Invalid JSON"}});
+        writer.key("id");
+        writer.value(*requestId);
     }
+}
+}  // namespace
 
-    nlohmann::json parsedJson = nlohmann::json::parse(json);
-    if (!parsedJson.contains("commands") || !parsedJson["commands"].is_array() || parsedJson["commands"].empty())
+CommandManager::CommandManager(const std::shared_ptr<DependencyRegistry>& DependencyRegistry)
+    : registry(DependencyRegistry), jobs(std::make_shared<CommandJobs>())
+{
+    // get_job_status finds the jobs the same way every other command finds what it works with
+    this->registry->registerService<CommandJobs>(DependencyType::command_jobs, this->jobs);
+}
+
+bool CommandManager::startJobs()
+{
+    return this->jobs->start();
+}
+
+void CommandManager::executeFromJson(const std::string_view json, ResponseWriter& writer, const void* owner) const
+{
+    // one pass over the line, the tokens stay on our stack
+    RequestParser parser;
+    if (!parser.parse(json))
+    {
+        writeInvalidJson(parser, writer);
+        return;
+    }
+
+    std::optional<uint32_t> requestId;
+    const int idToken = parser.findMember(parser.root(), "id");
+    if (idToken != RequestParser::NOT_FOUND)
     {
-        return CommandManagerResponse(CommandResult::getErrorResult("Commands missing"));
+        const auto id = parser.token(idToken).type == JsonTokenType::Number ? parser.toJson(idToken) : nlohmann::json();
+        if (!id.is_number_unsigned() || id.get<uint64_t>() > UINT32_MAX)
+        {
+            writer.beginObject();
+            writer.key("error");
+            writer.value("Invalid id - has to be an unsigned 32 bit integer");
+            writer.endObject();
+            return;
+        }
+        requestId = id.get<uint32_t>();
     }
+    // the jobs of a tagged line push their results back over the transport it came in on
+    const CommandJobs::Notify notify = requestId ? CommandJobs::Notify{owner, *requestId} : CommandJobs::Notify{};
 
-    nlohmann::json results = nlohmann::json::array();
+    const int commands = parser.findMember(parser.root(), "commands");
+    const int firstCommand = parser.firstChild(commands);
+    if (commands == RequestParser::NOT_FOUND || parser.token(commands).type != JsonTokenType::Array || firstCommand == RequestParser::NOT_FOUND)
+    {
+        beginAnswer(writer, requestId);
+        writer.key("data");
+        writer.value("Commands missing");
+        writer.key("status");
+        writer.value("error");
+        writer.endObject();
+        return;
+    }
 
-    for (auto& commandObject : parsedJson["commands"].items())
+    // check the whole batch before running anything, so a typo in the last entry
+    // doesn't leave the first ones half applied
+    char name[COMMAND_NAME_MAX_LENGTH];
+    for (int entry = firstCommand; entry != RequestParser::NOT_FOUND; entry = parser.nextSibling(commands, entry))
     {
-        auto commandData = commandObject.value();
-        if (!commandData.contains("command"))
+        const int nameToken = parser.findMember(entry, "command");
+        if (nameToken == RequestParser::NOT_FOUND || parser.token(nameToken).type != JsonTokenType::String)
         {
-            return CommandManagerResponse({{"command", "Unknown command"}, {"error", "Missing command type"}});
+            beginAnswer(writer, requestId);
+            writer.key("command");
+            writer.value("Unknown command");
+            writer.key("error");
+            writer.value("Missing command type");
+            writer.endObject();
+            return;
         }
 
-        const auto commandName = commandData["command"].get<std::string>();
-        if (!commandTypeMap.contains(commandName))
+        if (findCommand(parser, nameToken, name) == nullptr)
         {
-            return CommandManagerResponse({{"command", commandName}, {"error", "Unknown command"}});
+            beginAnswer(writer, requestId);
+            writer.key("command");
+            // the token text is already valid json string content, echo it as it came in
+            writer.beginString();
+            writer.raw(parser.raw(nameToken));
+            writer.endString();
+            writer.key("error");
+            writer.value("Unknown command");
+            writer.endObject();
+            return;
         }
+    }
 
-        const auto commandType = commandTypeMap.at(commandName);
-        const auto commandPayload = commandData.contains("data") ? commandData["data"] : nlohmann::json::object();
+    static const nlohmann::json emptyPayload = nlohmann::json::object();
 
-        auto command = createCommand(commandType, commandPayload);
-        results.push_back({
-            {"command", commandName},
-            {"result", command()},
-        });
+    beginAnswer(writer, requestId);
+    writer.key("results");
+    writer.beginArray();
+    for (int entry = firstCommand; entry != RequestParser::NOT_FOUND; entry = parser.nextSibling(commands, entry))
+    {
+        const auto command = findCommand(parser, parser.findMember(entry, "command"), name);
+        const int data = parser.findMember(entry, "data");
+
+        writer.beginObject();
+        writer.key("command");
+        writer.value(command->name);
+        writer.key("result");
+        // only the payload becomes a nlohmann::json, the envelope never does
+        if (data == RequestParser::NOT_FOUND)
+            writeResult(*command, this->registry, *this->jobs, emptyPayload, writer, notify);
+        else
+            writeResult(*command, this->registry, *this->jobs, parser.toJson(data), writer, notify);
+        writer.endObject();
     }
-    auto response = nlohmann::json{{"results", results}};
-    return CommandManagerResponse(response);
+    writer.endArray();
+    writer.endObject();
 }
 
-CommandManagerResponse CommandManager::executeFromType(const CommandType type, const std::string_view json) const
+CommandResult::Status CommandManager::executeBinary(const std::string_view name, const uint8_t* cbor, size_t length, ResponseWriter& writer) const
 {
-    const auto command = createCommand(type, json);
+    const auto command = findCommand(name);
+    if (command == nullptr)
+    {
+        writer.value("Unknown command");
+        return CommandResult::Status::FAILURE;
+    }
+
+    if (length == 0)
+    {
+        static const nlohmann::json emptyPayload = nlohmann::json::object();
+        return runCommand(*command, this->registry, *this->jobs, emptyPayload, writer);
+    }
 
+    // payloads are a handful of bytes, nlohmann already knows cbor
+    const auto payload = nlohmann::json::from_cbor(cbor, cbor + length, true, false);
+    if (payload.is_discarded())
+    {
+        writer.value("Invalid CBOR payload");
+        return CommandResult::Status::FAILURE;
+    }
+    return runCommand(*command, this->registry, *this->jobs, payload, writer);
+}
+
+bool CommandManager::executeFromType(const CommandType type, const std::string_view json, ResponseWriter& writer) const
+{
+    const auto command = findCommand(type);
     if (command == nullptr)
     {
-        return CommandManagerResponse({{"command", type}, {"error", "Unknown command"}});
+        writer.beginObject();
+        writer.key("command");
+        writer.value(static_cast<int>(type));
+        writer.key("error");
+        writer.value("Unknown command");
+        writer.endObject();
+        return false;
+    }
+
+    // rest requests without a body are fine, the handlers treat that like an empty payload
+    RequestParser parser;
+    const bool hasBody = json.find_first_not_of(" \t\r\n") != std::string_view::npos;
+    if (hasBody && !parser.parse(json))
+    {
+        writeInvalidJson(parser, writer);
+        return false;
     }
 
-    return CommandManagerResponse(nlohmann::json{{"result", command()}});
-}
\ No newline at end of file
+    const nlohmann::json payload = hasBody ? parser.toJson(parser.root()) : nlohmann::json::object();
+
+    writer.beginObject();
+    writer.key("result");
+    const auto status = writeResult(*command, this->registry, *this->jobs, payload, writer);
+    writer.endObject();
+    return status == CommandResult::Status::SUCCESS;
+}
+
+bool CommandManager::writeFinishedJob(const void* owner, ResponseWriter& writer) const
+{
+    uint32_t requestId = 0;
+    const uint32_t job = this->jobs->findUndelivered(owner, requestId);
+    if (job == 0)
+        return false;
+
+    writer.beginObject();
+    writer.key("id");
+    writer.value(requestId);
+    writer.key("job");
+    if (!this->jobs->writeStatus(job, writer))
+        writer.nullValue();
+    writer.endObject();
+    this->jobs->markDelivered(job);
+    return true;
+}
@@ -3,21 +3,24 @@
 
 #include <CameraManager.hpp>
 #include <ProjectConfig.hpp>
-#include <functional>
 #include <memory>
 #include <nlohmann-json.hpp>
 #include <optional>
 #include <string>
-#include <unordered_map>
+#include "CommandJobs.hpp"
 #include "CommandResult.hpp"
 #include "CommandSchema.hpp"
 #include "DependencyRegistry.hpp"
+#include "RequestParser.hpp"
+#include "ResponseWriter.hpp"
 #include "commands/camera_commands.hpp"
 #include "commands/config_commands.hpp"
 #include "commands/device_commands.hpp"
+#include "commands/job_commands.hpp"
 #include "commands/mdns_commands.hpp"
 #include "commands/scan_commands.hpp"
 #include "commands/simple_commands.hpp"
+#include "commands/stream_commands.hpp"
 #include "commands/wifi_commands.hpp"
 
 enum class CommandType
@@ -56,18 +59,36 @@ enum class CommandType
     GET_LOGS,
     GET_PERSISTENT_LOGS,
     CLEAR_PERSISTENT_LOGS,
+    GET_STREAM_STATS,
+    SET_VIE_WINDOW,
+    GET_VIE_WINDOW,
+    GET_JOB_STATUS,
 };
 
 class CommandManager
 {
     std::shared_ptr<DependencyRegistry> registry;
+    std::shared_ptr<CommandJobs> jobs;
 
    public:
-    explicit CommandManager(const std::shared_ptr<DependencyRegistry>& DependencyRegistry) : registry(DependencyRegistry) {};
-    std::function<CommandResult()> createCommand(const CommandType type, const nlohmann::json& json) const;
+    explicit CommandManager(const std::shared_ptr<DependencyRegistry>& DependencyRegistry);
 
-    CommandManagerResponse executeFromJson(std::string_view json) const;
-    CommandManagerResponse executeFromType(CommandType type, std::string_view json) const;
+    // from here on scan_networks and connect_wifi answer with a job id and run on the job worker,
+    // before that (and on the host benches that never call it) they run on the caller's task like any other command
+    bool startJobs();
+
+    // both stream the response into the writer, the caller flushes it once they're done
+    // a line can carry an "id", its answer then starts with the same id and owner - the transport it came in on -
+    // gets the results of the jobs it started pushed through writeFinishedJob() once they're done
+    void executeFromJson(std::string_view json, ResponseWriter& writer, const void* owner = nullptr) const;
+    // one command of the binary serial protocol, the payload is the cbor encoded "data" and may be empty
+    // only the handler's data gets written, without the json envelope, the caller reports the status
+    CommandResult::Status executeBinary(std::string_view name, const uint8_t* cbor, size_t length, ResponseWriter& writer) const;
+    // returns whether the command succeeded, the rest api picks its status code from that
+    bool executeFromType(CommandType type, std::string_view json, ResponseWriter& writer) const;
+    // {"id": <id of the line that started it>, "job": <what get_job_status says>} for the next finished job owner
+    // hasn't pushed yet, false once there's none
+    bool writeFinishedJob(const void* owner, ResponseWriter& writer) const;
 };
 
 #endif
\ No newline at end of file
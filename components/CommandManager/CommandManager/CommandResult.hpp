@@ -23,7 +23,7 @@ class CommandResult
     Status status;
 
    public:
-    CommandResult(nlohmann::json data, const Status status) : data(data), status(status) {}
+    CommandResult(nlohmann::json data, const Status status) : data(std::move(data)), status(status) {}
 
     bool isSuccess() const
     {
@@ -32,15 +32,15 @@ class CommandResult
 
     static CommandResult getSuccessResult(nlohmann::json message)
     {
-        return CommandResult(message, Status::SUCCESS);
+        return CommandResult(std::move(message), Status::SUCCESS);
     }
 
     static CommandResult getErrorResult(nlohmann::json message)
     {
-        return CommandResult(message, Status::FAILURE);
+        return CommandResult(std::move(message), Status::FAILURE);
     }
 
-    nlohmann::json getData() const
+    const nlohmann::json& getData() const
     {
         return this->data;
     }
@@ -55,8 +55,8 @@ class CommandManagerResponse
     nlohmann::json data;
 
    public:
-    CommandManagerResponse(nlohmann::json data) : data(data) {}
-    nlohmann::json getData() const
+    CommandManagerResponse(nlohmann::json data) : data(std::move(data)) {}
+    const nlohmann::json& getData() const
     {
         return this->data;
     }
@@ -12,7 +12,8 @@ enum class DependencyType
     led_manager,
     fan_manager,
     monitoring_manager,
-    log_manager
+    log_manager,
+    command_jobs
 };
 
 class DependencyRegistry
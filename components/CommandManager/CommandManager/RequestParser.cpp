@@ -0,0 +1,714 @@
+#include "RequestParser.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <limits>
+#include <new>
+
+namespace
+{
+bool isHex(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+uint32_t hexValue(std::string_view text)
+{
+    uint32_t value = 0;
+    for (const char c : text)
+    {
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+            value |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            value |= c - 'a' + 10;
+        else
+            value |= c - 'A' + 10;
+    }
+    return value;
+}
+
+// length of the utf-8 sequence starting at text[0], 0 if it's not valid
+// same rules nlohmann uses - no overlong forms, no surrogates, nothing past U+10FFFF
+size_t utf8SequenceLength(std::string_view text)
+{
+    const auto byte = [&](size_t i) { return static_cast<uint8_t>(text[i]); };
+    const auto continuation = [&](size_t i) { return i < text.size() && (byte(i) & 0xC0) == 0x80; };
+
+    const uint8_t lead = byte(0);
+    if (lead < 0x80)
+        return 1;
+    if (lead >= 0xC2 && lead <= 0xDF)
+        return continuation(1) ? 2 : 0;
+    if (lead >= 0xE0 && lead <= 0xEF)
+    {
+        if (!continuation(1) || !continuation(2))
+            return 0;
+        if ((lead == 0xE0 && byte(1) < 0xA0) || (lead == 0xED && byte(1) > 0x9F))
+            return 0;
+        return 3;
+    }
+    if (lead >= 0xF0 && lead <= 0xF4)
+    {
+        if (!continuation(1) || !continuation(2) || !continuation(3))
+            return 0;
+        if ((lead == 0xF0 && byte(1) < 0x90) || (lead == 0xF4 && byte(1) > 0x8F))
+            return 0;
+        return 4;
+    }
+    return 0;
+}
+
+// walks an already validated string body and hands every decoded byte to out
+// out returns false to stop early
+template <typename Out>
+bool decodeString(std::string_view raw, Out&& out)
+{
+    for (size_t i = 0; i < raw.size(); i++)
+    {
+        if (raw[i] != '\\')
+        {
+            if (!out(raw[i]))
+                return false;
+            continue;
+        }
+
+        const char escape = raw[++i];
+        char decoded = 0;
+        switch (escape)
+        {
+        case '"':
+        case '\\':
+        case '/':
+            decoded = escape;
+            break;
+        case 'b':
+            decoded = '\b';
+            break;
+        case 'f':
+            decoded = '\f';
+            break;
+        case 'n':
+            decoded = '\n';
+            break;
+        case 'r':
+            decoded = '\r';
+            break;
+        case 't':
+            decoded = '\t';
+            break;
+        case 'u':
+        {
+            uint32_t codepoint = hexValue(raw.substr(i + 1, 4));
+            i += 4;
+            if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+            {
+                // the parser made sure a low surrogate follows
+                const uint32_t low = hexValue(raw.substr(i + 3, 4));
+                codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                i += 6;
+            }
+
+            char utf8[4];
+            size_t length = 0;
+            if (codepoint < 0x80)
+            {
+                utf8[length++] = static_cast<char>(codepoint);
+            }
+            else if (codepoint < 0x800)
+            {
+                utf8[length++] = static_cast<char>(0xC0 | (codepoint >> 6));
+                utf8[length++] = static_cast<char>(0x80 | (codepoint & 0x3F));
+            }
+            else if (codepoint < 0x10000)
+            {
+                utf8[length++] = static_cast<char>(0xE0 | (codepoint >> 12));
+                utf8[length++] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+                utf8[length++] = static_cast<char>(0x80 | (codepoint & 0x3F));
+            }
+            else
+            {
+                utf8[length++] = static_cast<char>(0xF0 | (codepoint >> 18));
+                utf8[length++] = static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+                utf8[length++] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+                utf8[length++] = static_cast<char>(0x80 | (codepoint & 0x3F));
+            }
+            for (size_t j = 0; j < length; j++)
+            {
+                if (!out(utf8[j]))
+                    return false;
+            }
+            continue;
+        }
+        default:
+            break;
+        }
+
+        if (!out(decoded))
+            return false;
+    }
+    return true;
+}
+}  // namespace
+
+bool RequestParser::parse(std::string_view input)
+{
+    this->source = input;
+    this->position = 0;
+    this->token_count = 0;
+    this->parse_error = RequestParseError::None;
+    this->error_offset = 0;
+
+    // offsets are 16 bit, command lines are capped at 1 KB by the serial buffers anyway
+    if (input.size() > std::numeric_limits<uint16_t>::max())
+        return this->fail(RequestParseError::TooLong);
+
+    this->skipWhitespace();
+    if (this->position >= this->source.size())
+        return this->fail(RequestParseError::Empty);
+
+    if (!this->parseValue(0))
+        return false;
+
+    this->skipWhitespace();
+    // serial lines may still carry a NUL terminator from the receive buffer
+    while (this->position < this->source.size() && this->source[this->position] == '\0')
+        this->position++;
+
+    if (this->position != this->source.size())
+        return this->fail(RequestParseError::TrailingCharacters);
+
+    return true;
+}
+
+const char* RequestParser::errorMessage() const
+{
+    switch (this->parse_error)
+    {
+    case RequestParseError::None:
+        return "no error";
+    case RequestParseError::Empty:
+        return "empty input";
+    case RequestParseError::UnexpectedEnd:
+        return "unexpected end of input";
+    case RequestParseError::UnexpectedCharacter:
+        return "unexpected character";
+    case RequestParseError::InvalidString:
+        return "invalid string";
+    case RequestParseError::InvalidNumber:
+        return "invalid number";
+    case RequestParseError::InvalidLiteral:
+        return "invalid literal";
+    case RequestParseError::TrailingCharacters:
+        return "unexpected data after the end of the request";
+    case RequestParseError::TooManyTokens:
+        return "request too complex";
+    case RequestParseError::TooDeep:
+        return "request nested too deep";
+    case RequestParseError::TooLong:
+        return "request too long";
+    }
+    return "unknown error";
+}
+
+bool RequestParser::fail(RequestParseError error)
+{
+    // only the first error counts, everything after it is fallout
+    if (this->parse_error == RequestParseError::None)
+    {
+        this->parse_error = error;
+        this->error_offset = this->position;
+    }
+    return false;
+}
+
+void RequestParser::skipWhitespace()
+{
+    while (this->position < this->source.size())
+    {
+        const char c = this->source[this->position];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+            break;
+        this->position++;
+    }
+}
+
+// every token takes at least one byte of the input and all but the last one a separator after it,
+// so half the input rounded up is as many as there can be
+bool RequestParser::growTokens()
+{
+    const size_t capacity = (this->source.size() + 1) / 2;
+    if (capacity <= this->token_capacity)
+        return false;
+
+    auto grown = std::unique_ptr<JsonToken[]>(new (std::nothrow) JsonToken[capacity]);
+    if (!grown)
+        return false;
+    std::copy(this->tokens, this->tokens + this->token_count, grown.get());
+    this->heap_tokens = std::move(grown);
+    this->tokens = this->heap_tokens.get();
+    this->token_capacity = capacity;
+    return true;
+}
+
+int RequestParser::allocateToken(JsonTokenType type)
+{
+    if (this->token_count >= this->token_capacity && !this->growTokens())
+    {
+        this->fail(RequestParseError::TooManyTokens);
+        return NOT_FOUND;
+    }
+
+    const int index = this->token_count++;
+    this->tokens[index] = JsonToken{type, 0, static_cast<uint16_t>(this->position), 0, static_cast<uint16_t>(index + 1)};
+    return index;
+}
+
+bool RequestParser::parseValue(size_t depth)
+{
+    if (depth > MAX_DEPTH)
+        return this->fail(RequestParseError::TooDeep);
+
+    this->skipWhitespace();
+    if (this->position >= this->source.size())
+        return this->fail(RequestParseError::UnexpectedEnd);
+
+    switch (this->source[this->position])
+    {
+    case '{':
+        return this->parseObject(depth);
+    case '[':
+        return this->parseArray(depth);
+    case '"':
+        return this->parseString(JsonTokenType::String);
+    case 't':
+        return this->parseLiteral("true", JsonTokenType::True);
+    case 'f':
+        return this->parseLiteral("false", JsonTokenType::False);
+    case 'n':
+        return this->parseLiteral("null", JsonTokenType::Null);
+    default:
+    {
+        const char c = this->source[this->position];
+        if (c == '-' || (c >= '0' && c <= '9'))
+            return this->parseNumber();
+        return this->fail(RequestParseError::UnexpectedCharacter);
+    }
+    }
+}
+
+bool RequestParser::parseObject(size_t depth)
+{
+    const int index = this->allocateToken(JsonTokenType::Object);
+    if (index == NOT_FOUND)
+        return false;
+
+    this->position++;  // {
+    this->skipWhitespace();
+    if (this->position < this->source.size() && this->source[this->position] == '}')
+    {
+        this->position++;
+    }
+    else
+    {
+        while (true)
+        {
+            this->skipWhitespace();
+            if (this->position >= this->source.size())
+                return this->fail(RequestParseError::UnexpectedEnd);
+            if (this->source[this->position] != '"')
+                return this->fail(RequestParseError::UnexpectedCharacter);
+            if (!this->parseString(JsonTokenType::String))
+                return false;
+
+            this->skipWhitespace();
+            if (this->position >= this->source.size())
+                return this->fail(RequestParseError::UnexpectedEnd);
+            if (this->source[this->position] != ':')
+                return this->fail(RequestParseError::UnexpectedCharacter);
+            this->position++;
+
+            if (!this->parseValue(depth + 1))
+                return false;
+
+            this->skipWhitespace();
+            if (this->position >= this->source.size())
+                return this->fail(RequestParseError::UnexpectedEnd);
+            const char c = this->source[this->position++];
+            if (c == '}')
+                break;
+            if (c != ',')
+            {
+                this->position--;
+                return this->fail(RequestParseError::UnexpectedCharacter);
+            }
+        }
+    }
+
+    this->tokens[index].length = static_cast<uint16_t>(this->position - this->tokens[index].start);
+    this->tokens[index].next = this->token_count;
+    return true;
+}
+
+bool RequestParser::parseArray(size_t depth)
+{
+    const int index = this->allocateToken(JsonTokenType::Array);
+    if (index == NOT_FOUND)
+        return false;
+
+    this->position++;  // [
+    this->skipWhitespace();
+    if (this->position < this->source.size() && this->source[this->position] == ']')
+    {
+        this->position++;
+    }
+    else
+    {
+        while (true)
+        {
+            if (!this->parseValue(depth + 1))
+                return false;
+
+            this->skipWhitespace();
+            if (this->position >= this->source.size())
+                return this->fail(RequestParseError::UnexpectedEnd);
+            const char c = this->source[this->position++];
+            if (c == ']')
+                break;
+            if (c != ',')
+            {
+                this->position--;
+                return this->fail(RequestParseError::UnexpectedCharacter);
+            }
+        }
+    }
+
+    this->tokens[index].length = static_cast<uint16_t>(this->position - this->tokens[index].start);
+    this->tokens[index].next = this->token_count;
+    return true;
+}
+
+bool RequestParser::parseString(JsonTokenType type)
+{
+    const int index = this->allocateToken(type);
+    if (index == NOT_FOUND)
+        return false;
+
+    this->position++;  // opening quote
+    const size_t start = this->position;
+    uint8_t flags = 0;
+
+    while (true)
+    {
+        if (this->position >= this->source.size())
+            return this->fail(RequestParseError::UnexpectedEnd);
+
+        const char c = this->source[this->position];
+        if (c == '"')
+            break;
+
+        if (static_cast<uint8_t>(c) < 0x20)
+            return this->fail(RequestParseError::InvalidString);
+
+        if (c == '\\')
+        {
+            flags |= FLAG_ESCAPED;
+            if (this->position + 1 >= this->source.size())
+                return this->fail(RequestParseError::UnexpectedEnd);
+
+            const char escape = this->source[this->position + 1];
+            if (escape == 'u')
+            {
+                const auto readCodepoint = [&](size_t at, uint32_t& codepoint)
+                {
+                    if (at + 6 > this->source.size() || this->source[at] != '\\' || this->source[at + 1] != 'u')
+                        return false;
+                    for (size_t i = at + 2; i < at + 6; i++)
+                    {
+                        if (!isHex(this->source[i]))
+                            return false;
+                    }
+                    codepoint = hexValue(this->source.substr(at + 2, 4));
+                    return true;
+                };
+
+                uint32_t codepoint = 0;
+                if (!readCodepoint(this->position, codepoint))
+                    return this->fail(RequestParseError::InvalidString);
+                this->position += 6;
+
+                if (codepoint >= 0xDC00 && codepoint <= 0xDFFF)
+                    return this->fail(RequestParseError::InvalidString);
+                if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+                {
+                    uint32_t low = 0;
+                    if (!readCodepoint(this->position, low) || low < 0xDC00 || low > 0xDFFF)
+                        return this->fail(RequestParseError::InvalidString);
+                    this->position += 6;
+                }
+                continue;
+            }
+
+            switch (escape)
+            {
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+                this->position += 2;
+                continue;
+            default:
+                this->position++;
+                return this->fail(RequestParseError::InvalidString);
+            }
+        }
+
+        const size_t sequence = utf8SequenceLength(this->source.substr(this->position));
+        if (sequence == 0)
+            return this->fail(RequestParseError::InvalidString);
+        this->position += sequence;
+    }
+
+    this->tokens[index].flags = flags;
+    this->tokens[index].start = static_cast<uint16_t>(start);
+    this->tokens[index].length = static_cast<uint16_t>(this->position - start);
+    this->position++;  // closing quote
+    return true;
+}
+
+bool RequestParser::parseNumber()
+{
+    const int index = this->allocateToken(JsonTokenType::Number);
+    if (index == NOT_FOUND)
+        return false;
+
+    const auto digit = [&]() { return this->position < this->source.size() && this->source[this->position] >= '0' && this->source[this->position] <= '9'; };
+
+    uint8_t flags = FLAG_INTEGER;
+    const size_t start = this->position;
+    if (this->source[this->position] == '-')
+    {
+        flags |= FLAG_NEGATIVE;
+        this->position++;
+    }
+
+    if (!digit())
+        return this->fail(RequestParseError::InvalidNumber);
+    if (this->source[this->position] == '0')
+    {
+        this->position++;
+    }
+    else
+    {
+        while (digit())
+            this->position++;
+    }
+
+    if (this->position < this->source.size() && this->source[this->position] == '.')
+    {
+        flags &= ~FLAG_INTEGER;
+        this->position++;
+        if (!digit())
+            return this->fail(RequestParseError::InvalidNumber);
+        while (digit())
+            this->position++;
+    }
+
+    if (this->position < this->source.size() && (this->source[this->position] == 'e' || this->source[this->position] == 'E'))
+    {
+        flags &= ~FLAG_INTEGER;
+        this->position++;
+        if (this->position < this->source.size() && (this->source[this->position] == '+' || this->source[this->position] == '-'))
+            this->position++;
+        if (!digit())
+            return this->fail(RequestParseError::InvalidNumber);
+        while (digit())
+            this->position++;
+    }
+
+    this->tokens[index].flags = flags;
+    this->tokens[index].length = static_cast<uint16_t>(this->position - start);
+    return true;
+}
+
+bool RequestParser::parseLiteral(std::string_view literal, JsonTokenType type)
+{
+    if (this->source.substr(this->position, literal.size()) != literal)
+        return this->fail(RequestParseError::InvalidLiteral);
+
+    const int index = this->allocateToken(type);
+    if (index == NOT_FOUND)
+        return false;
+
+    this->tokens[index].length = static_cast<uint16_t>(literal.size());
+    this->position += literal.size();
+    return true;
+}
+
+int RequestParser::firstChild(int index) const
+{
+    if (index < 0 || index >= this->token_count)
+        return NOT_FOUND;
+
+    const JsonToken& parent = this->tokens[index];
+    if (parent.type != JsonTokenType::Object && parent.type != JsonTokenType::Array)
+        return NOT_FOUND;
+
+    return index + 1 < parent.next ? index + 1 : NOT_FOUND;
+}
+
+int RequestParser::nextSibling(int parent, int child) const
+{
+    if (parent < 0 || child < 0)
+        return NOT_FOUND;
+
+    // in objects we hop over the value as well, so this always lands on the next key
+    int next = this->tokens[child].next;
+    if (this->tokens[parent].type == JsonTokenType::Object)
+        next = this->tokens[next].next;
+
+    return next < this->tokens[parent].next ? next : NOT_FOUND;
+}
+
+int RequestParser::findMember(int object, std::string_view key) const
+{
+    if (object < 0 || this->tokens[object].type != JsonTokenType::Object)
+        return NOT_FOUND;
+
+    for (int child = this->firstChild(object); child != NOT_FOUND; child = this->nextSibling(object, child))
+    {
+        if (this->stringEquals(child, key))
+            return child + 1;
+    }
+    return NOT_FOUND;
+}
+
+std::string_view RequestParser::raw(int index) const
+{
+    if (index < 0 || index >= this->token_count)
+        return {};
+    return this->source.substr(this->tokens[index].start, this->tokens[index].length);
+}
+
+bool RequestParser::stringEquals(int index, std::string_view text) const
+{
+    if (index < 0 || this->tokens[index].type != JsonTokenType::String)
+        return false;
+
+    const std::string_view value = this->raw(index);
+    if (!(this->tokens[index].flags & FLAG_ESCAPED))
+        return value == text;
+
+    size_t matched = 0;
+    const bool complete = decodeString(value,
+                                       [&](char c)
+                                       {
+                                           if (matched >= text.size() || text[matched] != c)
+                                               return false;
+                                           matched++;
+                                           return true;
+                                       });
+    return complete && matched == text.size();
+}
+
+int RequestParser::copyString(int index, char* buffer, size_t size) const
+{
+    if (index < 0 || this->tokens[index].type != JsonTokenType::String || size == 0)
+        return NOT_FOUND;
+
+    size_t length = 0;
+    const bool complete = decodeString(this->raw(index),
+                                       [&](char c)
+                                       {
+                                           if (length + 1 >= size)
+                                               return false;
+                                           buffer[length++] = c;
+                                           return true;
+                                       });
+    buffer[length] = '\0';
+    return complete ? static_cast<int>(length) : NOT_FOUND;
+}
+
+nlohmann::json RequestParser::toJson(int index) const
+{
+    if (index < 0 || index >= this->token_count)
+        return nullptr;
+
+    const JsonToken& token = this->tokens[index];
+    switch (token.type)
+    {
+    case JsonTokenType::Object:
+    {
+        nlohmann::json object = nlohmann::json::object();
+        for (int key = this->firstChild(index); key != NOT_FOUND; key = this->nextSibling(index, key))
+        {
+            std::string name;
+            name.reserve(this->tokens[key].length);
+            decodeString(this->raw(key),
+                         [&](char c)
+                         {
+                             name.push_back(c);
+                             return true;
+                         });
+            object[std::move(name)] = this->toJson(key + 1);
+        }
+        return object;
+    }
+    case JsonTokenType::Array:
+    {
+        nlohmann::json array = nlohmann::json::array();
+        for (int child = this->firstChild(index); child != NOT_FOUND; child = this->nextSibling(index, child))
+            array.push_back(this->toJson(child));
+        return array;
+    }
+    case JsonTokenType::String:
+    {
+        std::string value;
+        value.reserve(token.length);
+        decodeString(this->raw(index),
+                     [&](char c)
+                     {
+                         value.push_back(c);
+                         return true;
+                     });
+        return value;
+    }
+    case JsonTokenType::Number:
+    {
+        // same typing nlohmann's own parser does: unsigned if it fits, signed if negative, double otherwise
+        const std::string_view text = this->raw(index);
+        if (token.flags & FLAG_INTEGER)
+        {
+            if (token.flags & FLAG_NEGATIVE)
+            {
+                int64_t value = 0;
+                if (std::from_chars(text.data(), text.data() + text.size(), value).ec == std::errc())
+                    return value;
+            }
+            else
+            {
+                uint64_t value = 0;
+                if (std::from_chars(text.data(), text.data() + text.size(), value).ec == std::errc())
+                    return value;
+            }
+        }
+
+        char buffer[64];
+        const std::string_view clipped = text.substr(0, sizeof(buffer) - 1);
+        clipped.copy(buffer, clipped.size());
+        buffer[clipped.size()] = '\0';
+        return std::strtod(buffer, nullptr);
+    }
+    case JsonTokenType::True:
+        return true;
+    case JsonTokenType::False:
+        return false;
+    case JsonTokenType::Null:
+        return nullptr;
+    }
+    return nullptr;
+}
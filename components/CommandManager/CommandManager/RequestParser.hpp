@@ -0,0 +1,137 @@
+#pragma once
+#ifndef REQUEST_PARSER_HPP
+#define REQUEST_PARSER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <nlohmann-json.hpp>
+#include <string_view>
+
+// Single pass, validating JSON tokenizer for incoming command requests.
+//
+// The whole line is checked and split into tokens in one go, the tokens go into a fixed array
+// that lives wherever the parser lives (usually the caller's stack), so looking at the envelope -
+// the "commands" array, the command names, where "data" starts - doesn't allocate anything.
+// A request with more tokens than that, a long batch say, moves them to the heap once, into room
+// for as many as the input could possibly hold.
+// Only the payloads handlers actually get are turned into nlohmann::json, straight from the tokens.
+
+enum class JsonTokenType : uint8_t
+{
+    Object,
+    Array,
+    String,
+    Number,
+    True,
+    False,
+    Null,
+};
+
+enum class RequestParseError : uint8_t
+{
+    None,
+    Empty,
+    UnexpectedEnd,
+    UnexpectedCharacter,
+    InvalidString,
+    InvalidNumber,
+    InvalidLiteral,
+    TrailingCharacters,
+    TooManyTokens,
+    TooDeep,
+    TooLong,
+};
+
+struct JsonToken
+{
+    JsonTokenType type;
+    uint8_t flags;
+    // offset and length in the source, strings without the quotes
+    uint16_t start;
+    uint16_t length;
+    // index of the first token after this value and everything nested in it
+    uint16_t next;
+};
+
+class RequestParser
+{
+   public:
+    // a full set_wifi request is ~20 tokens, a batch of six getters about the same, anything bigger goes to the heap
+    static constexpr size_t INLINE_TOKENS = 64;
+    static constexpr size_t MAX_DEPTH = 12;
+    static constexpr int NOT_FOUND = -1;
+
+    RequestParser() = default;
+    // tokens may point into the parser itself
+    RequestParser(const RequestParser&) = delete;
+    RequestParser& operator=(const RequestParser&) = delete;
+
+    bool parse(std::string_view input);
+
+    RequestParseError error() const
+    {
+        return parse_error;
+    }
+    size_t errorOffset() const
+    {
+        return error_offset;
+    }
+    const char* errorMessage() const;
+
+    const JsonToken& token(int index) const
+    {
+        return tokens[index];
+    }
+    int root() const
+    {
+        return token_count > 0 ? 0 : NOT_FOUND;
+    }
+
+    // for objects and arrays, walks the direct children
+    // for objects these are the keys, the value of a key is always key + 1
+    int firstChild(int index) const;
+    int nextSibling(int parent, int child) const;
+    int findMember(int object, std::string_view key) const;
+
+    // raw text of the token, strings come back without quotes but still escaped
+    std::string_view raw(int index) const;
+    // compares a string token against plain text, resolving escapes if there are any
+    bool stringEquals(int index, std::string_view text) const;
+    // copies a string token's text into buffer with escapes resolved, returns the decoded length
+    // or NOT_FOUND if it's not a string or doesn't fit
+    int copyString(int index, char* buffer, size_t size) const;
+
+    // builds a nlohmann::json out of the value at index, used for handler payloads
+    nlohmann::json toJson(int index) const;
+
+   private:
+    static constexpr uint8_t FLAG_ESCAPED = 1 << 0;
+    static constexpr uint8_t FLAG_INTEGER = 1 << 1;
+    static constexpr uint8_t FLAG_NEGATIVE = 1 << 2;
+
+    void skipWhitespace();
+    bool parseValue(size_t depth);
+    bool parseObject(size_t depth);
+    bool parseArray(size_t depth);
+    bool parseString(JsonTokenType type);
+    bool parseNumber();
+    bool parseLiteral(std::string_view literal, JsonTokenType type);
+    int allocateToken(JsonTokenType type);
+    bool growTokens();
+    bool fail(RequestParseError error);
+
+    std::string_view source;
+    size_t position = 0;
+
+    JsonToken inline_tokens[INLINE_TOKENS];
+    std::unique_ptr<JsonToken[]> heap_tokens;
+    JsonToken* tokens = inline_tokens;
+    size_t token_capacity = INLINE_TOKENS;
+    uint16_t token_count = 0;
+
+    RequestParseError parse_error = RequestParseError::None;
+    size_t error_offset = 0;
+};
+
+#endif
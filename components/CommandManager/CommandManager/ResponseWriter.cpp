@@ -0,0 +1,442 @@
+#include "ResponseWriter.hpp"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+// cbor major types and the simple values we use, RFC 8949
+constexpr uint8_t CBOR_UNSIGNED = 0;
+constexpr uint8_t CBOR_NEGATIVE = 1;
+constexpr uint8_t CBOR_TEXT = 3;
+constexpr uint8_t CBOR_INDEFINITE_TEXT = 0x7F;
+constexpr uint8_t CBOR_INDEFINITE_ARRAY = 0x9F;
+constexpr uint8_t CBOR_INDEFINITE_MAP = 0xBF;
+constexpr uint8_t CBOR_FALSE = 0xF4;
+constexpr uint8_t CBOR_TRUE = 0xF5;
+constexpr uint8_t CBOR_NULL = 0xF6;
+constexpr uint8_t CBOR_DOUBLE = 0xFB;
+constexpr uint8_t CBOR_BREAK = 0xFF;
+}  // namespace
+
+void ResponseWriter::put(char c)
+{
+    if (this->buffered == CHUNK_SIZE)
+        this->flush();
+    this->buffer[this->buffered++] = c;
+    this->total_bytes++;
+}
+
+void ResponseWriter::put(std::string_view text)
+{
+    while (!text.empty())
+    {
+        if (this->buffered == CHUNK_SIZE)
+            this->flush();
+
+        const size_t length = std::min(text.size(), CHUNK_SIZE - this->buffered);
+        std::memcpy(this->buffer + this->buffered, text.data(), length);
+        this->buffered += length;
+        this->total_bytes += length;
+        text.remove_prefix(length);
+    }
+}
+
+void ResponseWriter::flush()
+{
+    if (this->buffered == 0)
+        return;
+
+    this->sink.write(this->buffer, this->buffered);
+    this->buffered = 0;
+}
+
+// the smallest head that fits the argument, like every decoder expects for canonical cbor
+void ResponseWriter::putCborHead(uint8_t major, uint64_t argument)
+{
+    const uint8_t type = major << 5;
+    if (argument < 24)
+    {
+        this->put(static_cast<char>(type | argument));
+        return;
+    }
+
+    int bytes;
+    uint8_t info;
+    if (argument <= UINT8_MAX)
+    {
+        bytes = 1;
+        info = 24;
+    }
+    else if (argument <= UINT16_MAX)
+    {
+        bytes = 2;
+        info = 25;
+    }
+    else if (argument <= UINT32_MAX)
+    {
+        bytes = 4;
+        info = 26;
+    }
+    else
+    {
+        bytes = 8;
+        info = 27;
+    }
+
+    this->put(static_cast<char>(type | info));
+    for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8)
+        this->put(static_cast<char>(argument >> shift));
+}
+
+void ResponseWriter::putCborText(std::string_view text)
+{
+    this->putCborHead(CBOR_TEXT, text.size());
+    this->put(text);
+}
+
+void ResponseWriter::beforeValue()
+{
+    // the value of a key follows its colon directly
+    if (this->after_key)
+    {
+        this->after_key = false;
+        return;
+    }
+
+    if (this->depth == 0 || this->depth > MAX_DEPTH)
+        return;
+
+    const uint32_t bit = 1u << (this->depth - 1);
+    if (this->has_elements & bit)
+        this->put(',');
+    this->has_elements |= bit;
+}
+
+void ResponseWriter::push()
+{
+    this->depth++;
+    if (this->depth <= MAX_DEPTH)
+        this->has_elements &= ~(1u << (this->depth - 1));
+}
+
+void ResponseWriter::pop()
+{
+    if (this->depth > 0)
+        this->depth--;
+}
+
+void ResponseWriter::beginObject()
+{
+    if (this->encoding == Encoding::Cbor)
+    {
+        this->put(static_cast<char>(CBOR_INDEFINITE_MAP));
+        return;
+    }
+
+    this->beforeValue();
+    this->put('{');
+    this->push();
+}
+
+void ResponseWriter::endObject()
+{
+    if (this->encoding == Encoding::Cbor)
+    {
+        this->put(static_cast<char>(CBOR_BREAK));
+        return;
+    }
+
+    this->pop();
+    this->put('}');
+}
+
+void ResponseWriter::beginArray()
+{
+    if (this->encoding == Encoding::Cbor)
+    {
+        this->put(static_cast<char>(CBOR_INDEFINITE_ARRAY));
+        return;
+    }
+
+    this->beforeValue();
+    this->put('[');
+    this->push();
+}
+
+void ResponseWriter::endArray()
+{
+    if (this->encoding == Encoding::Cbor)
+    {
+        this->put(static_cast<char>(CBOR_BREAK));
+        return;
+    }
+
+    this->pop();
+    this->put(']');
+}
+
+void ResponseWriter::key(std::string_view name)
+{
+    if (this->encoding == Encoding::Cbor)
+    {
+        this->putCborText(name);
+        return;
+    }
+
+    this->beforeValue();
+    this->put('"');
+    this->writeEscaped(name);
+    this->put("\":");
+    this->after_key = true;
+}
+
+void ResponseWriter::value(std::string_view text)
+{
+    if (this->encoding == Encoding::Cbor)
+    {
+        this->putCborText(text);
+        return;
+    }
+
+    this->beforeValue();
+    this->put('"');
+    this->writeEscaped(text);
+    this->put('"');
+}
+
+void ResponseWriter::value(bool flag)
+{
+    if (this->encoding == Encoding::Cbor)
+    {
+        this->put(static_cast<char>(flag ? CBOR_TRUE : CBOR_FALSE));
+        return;
+    }
+
+    this->beforeValue();
+    this->put(flag ? std::string_view("true") : std::string_view("false"));
+}
+
+void ResponseWriter::value(double number)
+{
+    if (this->encoding == Encoding::Cbor)
+    {
+        // keep nan and infinity as null, a client shouldn't see different values depending on the encoding
+        if (!std::isfinite(number))
+        {
+            this->put(static_cast<char>(CBOR_NULL));
+            return;
+        }
+        this->put(static_cast<char>(CBOR_DOUBLE));
+        const auto bits = std::bit_cast<uint64_t>(number);
+        for (int shift = 56; shift >= 0; shift -= 8)
+            this->put(static_cast<char>(bits >> shift));
+        return;
+    }
+
+    this->beforeValue();
+
+    // same as nlohmann, there's no json for nan or infinity
+    if (!std::isfinite(number))
+    {
+        this->put("null");
+        return;
+    }
+
+    char digits[32];
+    const auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), number);
+    if (ec != std::errc())
+    {
+        this->put("null");
+        return;
+    }
+
+    const std::string_view text(digits, end - digits);
+    this->put(text);
+    // and same as nlohmann, keep a float looking like a float
+    if (text.find_first_of(".e") == std::string_view::npos)
+        this->put(".0");
+}
+
+void ResponseWriter::nullValue()
+{
+    if (this->encoding == Encoding::Cbor)
+    {
+        this->put(static_cast<char>(CBOR_NULL));
+        return;
+    }
+
+    this->beforeValue();
+    this->put("null");
+}
+
+void ResponseWriter::writeInteger(int64_t number)
+{
+    if (this->encoding == Encoding::Cbor)
+    {
+        // negative n is stored as -1 - n
+        if (number < 0)
+            this->putCborHead(CBOR_NEGATIVE, ~static_cast<uint64_t>(number));
+        else
+            this->putCborHead(CBOR_UNSIGNED, static_cast<uint64_t>(number));
+        return;
+    }
+
+    this->beforeValue();
+    char digits[24];
+    const auto result = std::to_chars(digits, digits + sizeof(digits), number);
+    this->put(std::string_view(digits, result.ptr - digits));
+}
+
+void ResponseWriter::writeUnsigned(uint64_t number)
+{
+    if (this->encoding == Encoding::Cbor)
+    {
+        this->putCborHead(CBOR_UNSIGNED, number);
+        return;
+    }
+
+    this->beforeValue();
+    char digits[24];
+    const auto result = std::to_chars(digits, digits + sizeof(digits), number);
+    this->put(std::string_view(digits, result.ptr - digits));
+}
+
+void ResponseWriter::beginString()
+{
+    this->in_string = true;
+    if (this->encoding == Encoding::Cbor)
+    {
+        this->put(static_cast<char>(CBOR_INDEFINITE_TEXT));
+        return;
+    }
+
+    this->beforeValue();
+    this->put('"');
+}
+
+void ResponseWriter::stringPart(std::string_view text)
+{
+    if (this->encoding == Encoding::Cbor)
+    {
+        // every part is its own definite length chunk, empty ones are just noise
+        if (!text.empty())
+            this->putCborText(text);
+        return;
+    }
+
+    this->writeEscaped(text);
+}
+
+void ResponseWriter::endString()
+{
+    this->in_string = false;
+    this->put(this->encoding == Encoding::Cbor ? static_cast<char>(CBOR_BREAK) : '"');
+}
+
+void ResponseWriter::raw(std::string_view text)
+{
+    if (this->encoding == Encoding::Cbor)
+    {
+        if (this->in_string && !text.empty())
+            this->putCborText(text);
+        return;
+    }
+
+    // right after a key the text is that key's value, already serialized
+    this->after_key = false;
+    this->put(text);
+}
+
+void ResponseWriter::writeEscaped(std::string_view text)
+{
+    static constexpr char HEX[] = "0123456789abcdef";
+
+    size_t clean_start = 0;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        const auto c = static_cast<uint8_t>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+
+        // copy the run of characters that didn't need escaping in one go
+        this->put(text.substr(clean_start, i - clean_start));
+        clean_start = i + 1;
+
+        switch (c)
+        {
+        case '"':
+            this->put("\\\"");
+            break;
+        case '\\':
+            this->put("\\\\");
+            break;
+        case '\b':
+            this->put("\\b");
+            break;
+        case '\f':
+            this->put("\\f");
+            break;
+        case '\n':
+            this->put("\\n");
+            break;
+        case '\r':
+            this->put("\\r");
+            break;
+        case '\t':
+            this->put("\\t");
+            break;
+        default:
+        {
+            const char escaped[] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0x0F]};
+            this->put(std::string_view(escaped, sizeof(escaped)));
+            break;
+        }
+        }
+    }
+    this->put(text.substr(clean_start));
+}
+
+void ResponseWriter::value(const nlohmann::json& json)
+{
+    switch (json.type())
+    {
+    case nlohmann::json::value_t::object:
+        this->beginObject();
+        for (auto item = json.begin(); item != json.end(); ++item)
+        {
+            this->key(item.key());
+            this->value(item.value());
+        }
+        this->endObject();
+        break;
+    case nlohmann::json::value_t::array:
+        this->beginArray();
+        for (const auto& item : json)
+            this->value(item);
+        this->endArray();
+        break;
+    case nlohmann::json::value_t::string:
+        this->value(std::string_view(json.get_ref<const std::string&>()));
+        break;
+    case nlohmann::json::value_t::boolean:
+        this->value(json.get<bool>());
+        break;
+    case nlohmann::json::value_t::number_integer:
+        this->writeInteger(json.get<int64_t>());
+        break;
+    case nlohmann::json::value_t::number_unsigned:
+        this->writeUnsigned(json.get<uint64_t>());
+        break;
+    case nlohmann::json::value_t::number_float:
+        this->value(json.get<double>());
+        break;
+    case nlohmann::json::value_t::binary:
+    case nlohmann::json::value_t::discarded:
+    case nlohmann::json::value_t::null:
+        this->nullValue();
+        break;
+    }
+}
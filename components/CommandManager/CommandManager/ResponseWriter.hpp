@@ -0,0 +1,130 @@
+#pragma once
+#ifndef RESPONSE_WRITER_HPP
+#define RESPONSE_WRITER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <nlohmann-json.hpp>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Where a response ends up - the usb-jtag driver, the tinyusb cdc fifo, a mongoose connection.
+// write() gets called with at most ResponseWriter::CHUNK_SIZE bytes at a time.
+class ResponseSink
+{
+   public:
+    virtual ~ResponseSink() = default;
+    virtual void write(const char* data, size_t length) = 0;
+};
+
+// Streaming JSON writer, command responses get emitted straight into a fixed chunk buffer
+// that is handed to the sink whenever it fills up. No DOM, no dump() into a string,
+// so the memory a response needs doesn't depend on how big it is.
+//
+// Commas and colons are taken care of, callers only describe the structure:
+//   writer.beginObject();
+//   writer.key("ssid");
+//   writer.value(network.ssid);
+//   writer.endObject();
+//
+// The same calls can produce CBOR instead, for the binary serial protocol. Objects, arrays and
+// pieced together strings become indefinite length items there, so nothing has to be counted up front.
+class ResponseWriter
+{
+   public:
+    static constexpr size_t CHUNK_SIZE = 256;
+    // nesting is tracked in a 32 bit mask, responses don't come anywhere near that
+    static constexpr size_t MAX_DEPTH = 32;
+
+    enum class Encoding : uint8_t
+    {
+        Json,
+        Cbor,
+    };
+
+    explicit ResponseWriter(ResponseSink& sink, Encoding encoding = Encoding::Json) : sink(sink), encoding(encoding) {}
+    ResponseWriter(const ResponseWriter&) = delete;
+    ResponseWriter& operator=(const ResponseWriter&) = delete;
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    void key(std::string_view name);
+
+    void value(std::string_view text);
+    void value(const char* text)
+    {
+        value(std::string_view(text));
+    }
+    void value(const std::string& text)
+    {
+        value(std::string_view(text));
+    }
+    void value(bool flag);
+    void value(double number);
+    void nullValue();
+
+    template <typename T>
+        requires(std::is_integral_v<T> && !std::is_same_v<T, bool>)
+    void value(T number)
+    {
+        if constexpr (std::is_signed_v<T>)
+            writeInteger(static_cast<int64_t>(number));
+        else
+            writeUnsigned(static_cast<uint64_t>(number));
+    }
+
+    // for handlers that still hand back a nlohmann::json, serialized the same way dump() would
+    void value(const nlohmann::json& json);
+
+    // a string value that arrives in pieces, like a log file read line by line
+    void beginString();
+    void stringPart(std::string_view text);
+    void endString();
+
+    // bytes outside of the json structure, like the trailing newline on the serial protocol,
+    // already escaped text between beginString() and endString(), or a value that's json already, right after its key
+    // cbor has no use for the former, so there only the string content makes it through
+    void raw(std::string_view text);
+
+    // hands whatever is buffered to the sink, call once the response is complete
+    void flush();
+
+    size_t bytesWritten() const
+    {
+        return total_bytes;
+    }
+
+    Encoding getEncoding() const
+    {
+        return encoding;
+    }
+
+   private:
+    void beforeValue();
+    void push();
+    void pop();
+    void writeInteger(int64_t number);
+    void writeUnsigned(uint64_t number);
+    void writeEscaped(std::string_view text);
+    void put(char c);
+    void put(std::string_view text);
+    void putCborHead(uint8_t major, uint64_t argument);
+    void putCborText(std::string_view text);
+
+    ResponseSink& sink;
+    Encoding encoding;
+    char buffer[CHUNK_SIZE];
+    size_t buffered = 0;
+    size_t total_bytes = 0;
+
+    // one bit per nesting level, set once the level got its first element
+    uint32_t has_elements = 0;
+    size_t depth = 0;
+    bool after_key = false;
+    bool in_string = false;
+};
+
+#endif
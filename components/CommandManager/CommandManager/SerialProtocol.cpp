@@ -0,0 +1,245 @@
+#include "SerialProtocol.hpp"
+#include "CommandManager.hpp"
+
+namespace
+{
+// command responses leave as a run of RESPONSE_CHUNK frames, one per writer chunk
+class FrameSink : public ResponseSink
+{
+   public:
+    FrameSink(ResponseSink& sink, uint8_t seq) : sink(sink), seq(seq) {}
+
+    void write(const char* data, size_t length) override
+    {
+        SerialProtocol::writeFrame(this->sink, SerialProtocol::FrameType::ResponseChunk, this->seq, reinterpret_cast<const uint8_t*>(data), length);
+    }
+
+   private:
+    ResponseSink& sink;
+    uint8_t seq;
+};
+
+bool isLineEnd(uint8_t byte)
+{
+    return byte == '\n' || byte == '\r';
+}
+}  // namespace
+
+SerialProtocol::SerialProtocol(const CommandManager& commandManager, uint8_t* buffer, size_t size)
+    : commandManager(commandManager), buffer(buffer), size(size)
+{
+}
+
+uint16_t SerialProtocol::crc16(const uint8_t* data, size_t length, uint16_t crc)
+{
+    // polynomial 0x1021 a nibble at a time, 32 bytes of table instead of 512
+    static constexpr uint16_t TABLE[16] = {0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+                                           0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF};
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = (crc << 4) ^ TABLE[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ TABLE[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+void SerialProtocol::writeFrame(ResponseSink& sink, FrameType type, uint8_t seq, const uint8_t* payload, size_t length)
+{
+    const uint8_t header[] = {FRAME_SYNC, static_cast<uint8_t>(type), seq, static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8)};
+    uint16_t crc = crc16(header + 1, sizeof(header) - 1);
+    crc = crc16(payload, length, crc);
+    const uint8_t trailer[] = {static_cast<uint8_t>(crc), static_cast<uint8_t>(crc >> 8)};
+
+    sink.write(reinterpret_cast<const char*>(header), sizeof(header));
+    if (length > 0)
+        sink.write(reinterpret_cast<const char*>(payload), length);
+    sink.write(reinterpret_cast<const char*>(trailer), sizeof(trailer));
+}
+
+void SerialProtocol::receive(const uint8_t* data, size_t length, ResponseSink& sink)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        const uint8_t byte = data[i];
+        switch (this->state)
+        {
+            case State::Idle:
+                if (byte == FRAME_SYNC)
+                {
+                    this->state = State::FrameType;
+                }
+                else if (!isLineEnd(byte))
+                {
+                    this->buffer[0] = byte;
+                    this->position = 1;
+                    this->state = State::Line;
+                }
+                break;
+
+            case State::Line:
+                if (isLineEnd(byte))
+                {
+                    this->executeLine(sink);
+                    this->state = State::Idle;
+                }
+                else if (this->position >= this->size)
+                {
+                    // answer what we've got, it'll come back as invalid json so the host knows it was cut off
+                    this->executeLine(sink);
+                    this->state = State::DiscardLine;
+                }
+                else
+                {
+                    this->buffer[this->position++] = byte;
+                }
+                break;
+
+            case State::DiscardLine:
+                if (isLineEnd(byte))
+                    this->state = State::Idle;
+                break;
+
+            default:
+                this->receiveFrameByte(byte, sink);
+                break;
+        }
+    }
+}
+
+void SerialProtocol::receiveFrameByte(uint8_t byte, ResponseSink& sink)
+{
+    switch (this->state)
+    {
+        case State::FrameType:
+            this->frame_type = byte;
+            this->state = State::FrameSeq;
+            break;
+
+        case State::FrameSeq:
+            this->frame_seq = byte;
+            this->state = State::FrameLengthLow;
+            break;
+
+        case State::FrameLengthLow:
+            this->frame_length = byte;
+            this->state = State::FrameLengthHigh;
+            break;
+
+        case State::FrameLengthHigh:
+            this->frame_length |= static_cast<uint16_t>(byte) << 8;
+            this->position = 0;
+            this->state = this->frame_length > 0 ? State::FramePayload : State::FrameCrcLow;
+            break;
+
+        case State::FramePayload:
+            // an oversized payload still gets walked over, so we stay in sync with the host and can NACK it
+            if (this->position < this->size)
+                this->buffer[this->position] = byte;
+            if (++this->position == this->frame_length)
+                this->state = State::FrameCrcLow;
+            break;
+
+        case State::FrameCrcLow:
+            this->frame_crc = byte;
+            this->state = State::FrameCrcHigh;
+            break;
+
+        case State::FrameCrcHigh:
+        {
+            this->frame_crc |= static_cast<uint16_t>(byte) << 8;
+            this->state = State::Idle;
+
+            if (this->frame_length > this->size)
+            {
+                this->nack(sink, NackReason::TooLong);
+                break;
+            }
+
+            const uint8_t header[] = {this->frame_type, this->frame_seq, static_cast<uint8_t>(this->frame_length),
+                                      static_cast<uint8_t>(this->frame_length >> 8)};
+            const uint16_t crc = crc16(this->buffer, this->frame_length, crc16(header, sizeof(header)));
+            if (crc != this->frame_crc)
+            {
+                this->nack(sink, NackReason::BadCrc);
+                break;
+            }
+
+            this->executeFrame(sink);
+            break;
+        }
+
+        default:
+            this->state = State::Idle;
+            break;
+    }
+}
+
+void SerialProtocol::idle()
+{
+    if (this->state != State::Idle && this->state != State::Line && this->state != State::DiscardLine)
+        this->state = State::Idle;
+}
+
+void SerialProtocol::executeLine(ResponseSink& sink)
+{
+    ResponseWriter writer(sink);
+    this->commandManager.executeFromJson(std::string_view(reinterpret_cast<const char*>(this->buffer), this->position), writer, this);
+    writer.raw("\n");
+    writer.flush();
+    this->position = 0;
+}
+
+void SerialProtocol::poll(ResponseSink& sink)
+{
+    ResponseWriter writer(sink);
+    while (this->commandManager.writeFinishedJob(this, writer))
+    {
+        writer.raw("\n");
+        writer.flush();
+    }
+}
+
+void SerialProtocol::executeFrame(ResponseSink& sink)
+{
+    switch (static_cast<FrameType>(this->frame_type))
+    {
+        case FrameType::Hello:
+        {
+            // what we speak and the largest request payload we take
+            const uint8_t payload[] = {VERSION, static_cast<uint8_t>(this->size), static_cast<uint8_t>(this->size >> 8)};
+            writeFrame(sink, FrameType::HelloAck, this->frame_seq, payload, sizeof(payload));
+            break;
+        }
+
+        case FrameType::Command:
+        {
+            const size_t name_length = this->frame_length > 0 ? this->buffer[0] : 0;
+            if (name_length == 0 || 1 + name_length > this->frame_length)
+            {
+                this->nack(sink, NackReason::BadPayload);
+                break;
+            }
+
+            const std::string_view name(reinterpret_cast<const char*>(this->buffer + 1), name_length);
+            FrameSink frameSink(sink, this->frame_seq);
+            ResponseWriter writer(frameSink, ResponseWriter::Encoding::Cbor);
+            const auto status =
+                this->commandManager.executeBinary(name, this->buffer + 1 + name_length, this->frame_length - 1 - name_length, writer);
+            writer.flush();
+
+            const uint8_t result[] = {static_cast<uint8_t>(status == CommandResult::Status::SUCCESS ? 0 : 1)};
+            writeFrame(sink, FrameType::ResponseEnd, this->frame_seq, result, sizeof(result));
+            break;
+        }
+
+        default:
+            this->nack(sink, NackReason::UnknownType);
+            break;
+    }
+}
+
+void SerialProtocol::nack(ResponseSink& sink, NackReason reason)
+{
+    const uint8_t payload[] = {static_cast<uint8_t>(reason)};
+    writeFrame(sink, FrameType::Nack, this->frame_seq, payload, sizeof(payload));
+}
@@ -0,0 +1,112 @@
+#pragma once
+#ifndef SERIAL_PROTOCOL_HPP
+#define SERIAL_PROTOCOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "ResponseWriter.hpp"
+
+class CommandManager;
+
+// Everything that comes in over a serial transport - usb-jtag, uart, the tinyusb cdc - goes through here.
+// Two protocols share the wire and the first byte of every message picks one:
+//
+//   json lines     {"commands":[...]}\n, answered with a newline terminated json line, what every tool speaks today
+//   binary frames  for hosts that asked for them with a HELLO frame, cbor instead of json text
+//                  and a crc, so a frame that lost bytes gets a NACK instead of a garbled answer
+//
+// A frame on the wire, both directions:
+//
+//   0xA5 | type | seq | length (u16 le) | payload[length] | crc16 (u16 le)
+//
+// The crc is CRC-16/CCITT-FALSE over everything between the sync byte and the crc. Responses carry the
+// seq of the request they answer. 0xA5 can't start a json line, so neither side has to switch modes.
+//
+// A COMMAND payload is one command: name length (u8) | name | cbor encoded "data", the data is optional.
+// The answer is the handler's data, cbor encoded and streamed as RESPONSE_CHUNK frames of at most
+// ResponseWriter::CHUNK_SIZE bytes, then a RESPONSE_END whose one byte payload is 0 for success, 1 for error.
+// No envelope either way, a batch is several COMMAND frames sent back to back.
+//
+// A json line can carry an "id" - {"id":7,"commands":[...]} - and gets it back in front of its answer, {"id":7,"results":[...]}.
+// Lines still run one after the other, but the long commands of a tagged line only answer with their job id and
+// once such a job is done poll() pushes {"id":7,"job":{...}} - what get_job_status would say - on its own.
+// So a host can keep several lines in flight and match whatever comes back by id instead of by order.
+// How many is up to the host, the bound is the rx buffer of the transport (1 KB on the uart, which has no flow control),
+// frames and untagged lines never get anything pushed.
+class SerialProtocol
+{
+   public:
+    static constexpr uint8_t FRAME_SYNC = 0xA5;
+    static constexpr uint8_t VERSION = 1;
+    // sync, type, seq, length and crc
+    static constexpr size_t FRAME_OVERHEAD = 7;
+
+    enum class FrameType : uint8_t
+    {
+        // host -> device
+        Hello = 0x01,
+        Command = 0x02,
+        // device -> host
+        HelloAck = 0x81,
+        ResponseChunk = 0x82,
+        ResponseEnd = 0x83,
+        Nack = 0xEE,
+    };
+
+    enum class NackReason : uint8_t
+    {
+        BadCrc = 1,
+        TooLong = 2,
+        UnknownType = 3,
+        BadPayload = 4,
+    };
+
+    // buffer holds one line or one frame payload, whichever is in flight
+    SerialProtocol(const CommandManager& commandManager, uint8_t* buffer, size_t size);
+
+    // consumes everything, whatever completes along the way gets executed and answered into sink
+    void receive(const uint8_t* data, size_t length, ResponseSink& sink);
+    // nothing arrived for a while, a frame that's still half way in lost bytes somewhere, forget it
+    // lines are left alone, someone may be typing them into a terminal
+    void idle();
+    // pushes the results of the finished jobs our tagged lines started, call it whenever the transport isn't busy receiving
+    void poll(ResponseSink& sink);
+
+    static uint16_t crc16(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF);
+    static void writeFrame(ResponseSink& sink, FrameType type, uint8_t seq, const uint8_t* payload, size_t length);
+
+   private:
+    enum class State : uint8_t
+    {
+        Idle,
+        Line,
+        // the line didn't fit, skip to its end so the tail doesn't run as a command of its own
+        DiscardLine,
+        FrameType,
+        FrameSeq,
+        FrameLengthLow,
+        FrameLengthHigh,
+        FramePayload,
+        FrameCrcLow,
+        FrameCrcHigh,
+    };
+
+    void receiveFrameByte(uint8_t byte, ResponseSink& sink);
+    void executeLine(ResponseSink& sink);
+    void executeFrame(ResponseSink& sink);
+    void nack(ResponseSink& sink, NackReason reason);
+
+    const CommandManager& commandManager;
+    uint8_t* buffer;
+    size_t size;
+
+    State state = State::Idle;
+    size_t position = 0;
+
+    uint8_t frame_type = 0;
+    uint8_t frame_seq = 0;
+    uint16_t frame_length = 0;
+    uint16_t frame_crc = 0;
+};
+
+#endif
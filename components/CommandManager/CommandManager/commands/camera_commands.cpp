@@ -12,4 +12,94 @@ CommandResult updateCameraCommand(std::shared_ptr<DependencyRegistry> registry,
         payload.brightness.has_value() ? payload.brightness.value() : oldConfig.brightness);
 
     return CommandResult::getSuccessResult("Config updated");
-}
\ No newline at end of file
+}
+
+static void writeWindow(ResponseWriter& writer, const VieWindow& window, const VieWindow& bounds)
+{
+    writer.key("offset_x");
+    writer.value(window.offset_x);
+    writer.key("offset_y");
+    writer.value(window.offset_y);
+    writer.key("width");
+    writer.value(window.width);
+    writer.key("height");
+    writer.value(window.height);
+    writer.key("readout_width");
+    writer.value(bounds.width);
+    writer.key("readout_height");
+    writer.value(bounds.height);
+}
+
+CommandResult::Status setVieWindowCommand(std::shared_ptr<DependencyRegistry> registry, const nlohmann::json& json, ResponseWriter& writer)
+{
+    for (const char* field : {"width", "height"})
+    {
+        if (!json.contains(field) || !json[field].is_number_integer())
+        {
+            writer.value("Invalid payload - width and height are required integers");
+            return CommandResult::Status::FAILURE;
+        }
+    }
+    for (const char* field : {"offset_x", "offset_y"})
+    {
+        if (json.contains(field) && !json[field].is_number_integer())
+        {
+            writer.value("Invalid payload - offsets have to be integers");
+            return CommandResult::Status::FAILURE;
+        }
+    }
+
+    const auto cameraManager = registry->resolve<CameraManager>(DependencyType::camera_manager);
+    const VieWindow current = cameraManager->getVieWindow();
+    const int width = json["width"].get<int>();
+    const int height = json["height"].get<int>();
+    const int offset_x = json.contains("offset_x") ? json["offset_x"].get<int>() : current.offset_x;
+    const int offset_y = json.contains("offset_y") ? json["offset_y"].get<int>() : current.offset_y;
+
+    const VieWindow bounds = cameraManager->getVieWindowBounds();
+    if ((width != 0 || height != 0) && bounds.width == 0)
+    {
+        writer.value("Camera can't crop at this frame size");
+        return CommandResult::Status::FAILURE;
+    }
+    if ((width != 0 || height != 0) &&
+        (width < 64 || height < 64 || width % 8 != 0 || height % 8 != 0 || offset_x < 0 || offset_y < 0 || offset_x + width > bounds.width ||
+         offset_y + height > bounds.height))
+    {
+        writer.value("Invalid payload - the window has to be at least 64x64, a multiple of 8 and inside the readout");
+        return CommandResult::Status::FAILURE;
+    }
+
+    if (cameraManager->setVieWindow(offset_x, offset_y, width, height) != 0)
+    {
+        writer.value("Camera refused the window");
+        return CommandResult::Status::FAILURE;
+    }
+
+    const VieWindow applied = cameraManager->getVieWindow();
+    const auto projectConfig = registry->resolve<ProjectConfig>(DependencyType::project_config);
+    projectConfig->setCameraWindow(applied.offset_x, applied.offset_y, applied.width, applied.height);
+
+    writer.beginObject();
+    writeWindow(writer, applied, bounds);
+    writer.endObject();
+    return CommandResult::Status::SUCCESS;
+}
+
+CommandResult::Status getVieWindowCommand(std::shared_ptr<DependencyRegistry> registry, ResponseWriter& writer)
+{
+    const auto cameraManager = registry->resolve<CameraManager>(DependencyType::camera_manager);
+    // averaged over the last frames the stream pulled, so give it a second after moving the window, zeros without a stream
+    const JpegRateControl::Status rate = JpegRateControl::controller().status();
+
+    writer.beginObject();
+    writeWindow(writer, cameraManager->getVieWindow(), cameraManager->getVieWindowBounds());
+    writer.key("fps");
+    writer.value(rate.frame_interval_us ? 1000000.0 / rate.frame_interval_us : 0.0);
+    writer.key("frame_bytes");
+    writer.value(rate.average_bytes);
+    writer.key("quality");
+    writer.value(rate.quality);
+    writer.endObject();
+    return CommandResult::Status::SUCCESS;
+}
@@ -1,6 +1,7 @@
 #ifndef CAMERA_COMMANDS_HPP
 #define CAMERA_COMMANDS_HPP
 #include <CameraManager.hpp>
+#include <JpegRateControl.hpp>
 #include <ProjectConfig.hpp>
 #include <memory>
 #include <nlohmann-json.hpp>
@@ -9,9 +10,13 @@
 #include "CommandResult.hpp"
 #include "CommandSchema.hpp"
 #include "DependencyRegistry.hpp"
+#include "ResponseWriter.hpp"
 
 CommandResult updateCameraCommand(std::shared_ptr<DependencyRegistry> registry, const nlohmann::json& json);
 
-#endif
+// crops the frame to {"offset_x", "offset_y", "width", "height"} on the sensor and stores it, width and height 0 go back to the full frame
+CommandResult::Status setVieWindowCommand(std::shared_ptr<DependencyRegistry> registry, const nlohmann::json& json, ResponseWriter& writer);
+// the current window, the readout it sits in and the frame rate and size measured with it
+CommandResult::Status getVieWindowCommand(std::shared_ptr<DependencyRegistry> registry, ResponseWriter& writer);
 
-// add cropping command
\ No newline at end of file
+#endif
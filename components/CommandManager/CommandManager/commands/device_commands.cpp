@@ -1,5 +1,6 @@
 #include "device_commands.hpp"
 #include <cstdio>
+#include <cstring>
 #include "LEDManager.hpp"
 #include "MonitoringManager.hpp"
 #include "FanManager.hpp"
@@ -351,13 +352,14 @@ CommandResult getDebugLogEnabledCommand(std::shared_ptr<DependencyRegistry> regi
 #endif
 }
 
-CommandResult getLogsCommand(std::shared_ptr<DependencyRegistry> registry)
+CommandResult::Status getLogsCommand(std::shared_ptr<DependencyRegistry> registry, ResponseWriter& writer)
 {
 #if CONFIG_DEBUG_LOG_ENABLE
     auto lm = registry->resolve<LogManager>(DependencyType::log_manager);
     if (!lm)
     {
-        return CommandResult::getErrorResult("LogManager unavailable");
+        writer.value("LogManager unavailable");
+        return CommandResult::Status::FAILURE;
     }
 
     auto entries = lm->getRecentLogs();
@@ -366,48 +368,60 @@ CommandResult getLogsCommand(std::shared_ptr<DependencyRegistry> registry)
     const size_t max_entries = 20;
     size_t start = entries.size() > max_entries ? entries.size() - max_entries : 0;
 
-    nlohmann::json logs = nlohmann::json::array();
+    writer.beginObject();
+    writer.key("count");
+    writer.value(static_cast<int>(entries.size()));
+    writer.key("enabled");
+    writer.value(lm->isEnabled());
+    writer.key("logs");
+    writer.beginArray();
     for (size_t i = start; i < entries.size(); i++)
     {
         const auto& e = entries[i];
+        writer.beginObject();
+        writer.key("l");
+        writer.value(e.level == ESP_LOG_ERROR ? "E" : "W");
         // Truncate message to 120 chars to limit response size
-        char msg[121];
-        strncpy(msg, e.message, 120);
-        msg[120] = '\0';
-        logs.push_back({
-            {"t", e.timestamp_ms},
-            {"l", e.level == ESP_LOG_ERROR ? "E" : "W"},
-            {"m", msg},
-        });
+        writer.key("m");
+        writer.value(std::string_view(e.message, strnlen(e.message, 120)));
+        writer.key("t");
+        writer.value(e.timestamp_ms);
+        writer.endObject();
     }
-
-    return CommandResult::getSuccessResult(nlohmann::json{{"enabled", lm->isEnabled()}, {"count", (int)entries.size()}, {"logs", logs}});
+    writer.endArray();
+    writer.endObject();
+    return CommandResult::Status::SUCCESS;
 #else
     (void)registry;
-    return CommandResult::getErrorResult("Debug logging disabled");
+    writer.value("Debug logging disabled");
+    return CommandResult::Status::FAILURE;
 #endif
 }
 
-CommandResult getPersistentLogsCommand(std::shared_ptr<DependencyRegistry> registry)
+CommandResult::Status getPersistentLogsCommand(std::shared_ptr<DependencyRegistry> registry, ResponseWriter& writer)
 {
 #if CONFIG_DEBUG_LOG_ENABLE
     auto lm = registry->resolve<LogManager>(DependencyType::log_manager);
     if (!lm)
     {
-        return CommandResult::getErrorResult("LogManager unavailable");
+        writer.value("LogManager unavailable");
+        return CommandResult::Status::FAILURE;
     }
 
-    std::string logs = lm->getPersistentLogs();
-    // Truncate to 3KB to stay within CDC transfer limits
-    if (logs.size() > 3072)
-    {
-        logs = logs.substr(logs.size() - 3072);
-        logs = "[truncated]\n" + logs;
-    }
-    return CommandResult::getSuccessResult(nlohmann::json{{"enabled", lm->isEnabled()}, {"logs", logs}});
+    writer.beginObject();
+    writer.key("enabled");
+    writer.value(lm->isEnabled());
+    writer.key("logs");
+    // Keep the last 3KB to stay within CDC transfer limits, the files go out as they're read
+    writer.beginString();
+    lm->readPersistentLogs(3072, [&writer](std::string_view part) { writer.stringPart(part); });
+    writer.endString();
+    writer.endObject();
+    return CommandResult::Status::SUCCESS;
 #else
     (void)registry;
-    return CommandResult::getErrorResult("Debug logging disabled");
+    writer.value("Debug logging disabled");
+    return CommandResult::Status::FAILURE;
 #endif
 }
 
@@ -2,6 +2,7 @@
 #include "DependencyRegistry.hpp"
 #include "OpenIrisTasks.hpp"
 #include "ProjectConfig.hpp"
+#include "ResponseWriter.hpp"
 #include "esp_timer.h"
 #include "main_globals.hpp"
 
@@ -34,8 +35,9 @@ CommandResult getBatteryStatusCommand(std::shared_ptr<DependencyRegistry> regist
 CommandResult getInfoCommand(std::shared_ptr<DependencyRegistry> registry);
 
 // Debug logs
-CommandResult getLogsCommand(std::shared_ptr<DependencyRegistry> registry);
-CommandResult getPersistentLogsCommand(std::shared_ptr<DependencyRegistry> registry);
+// these two can get long, so they write straight into the response
+CommandResult::Status getLogsCommand(std::shared_ptr<DependencyRegistry> registry, ResponseWriter& writer);
+CommandResult::Status getPersistentLogsCommand(std::shared_ptr<DependencyRegistry> registry, ResponseWriter& writer);
 CommandResult clearPersistentLogsCommand(std::shared_ptr<DependencyRegistry> registry);
 CommandResult setDebugLogEnabledCommand(std::shared_ptr<DependencyRegistry> registry, const nlohmann::json& json);
 CommandResult getDebugLogEnabledCommand(std::shared_ptr<DependencyRegistry> registry);
\ No newline at end of file
@@ -0,0 +1,30 @@
+#include "job_commands.hpp"
+
+CommandResult::Status getJobStatusCommand(std::shared_ptr<DependencyRegistry> registry, const nlohmann::json& json, ResponseWriter& writer)
+{
+    auto jobs = registry->resolve<CommandJobs>(DependencyType::command_jobs);
+    if (!jobs)
+    {
+        writer.value("Jobs are not available");
+        return CommandResult::Status::FAILURE;
+    }
+
+    if (!json.contains("id"))
+    {
+        jobs->writeAll(writer);
+        return CommandResult::Status::SUCCESS;
+    }
+
+    if (!json["id"].is_number_unsigned())
+    {
+        writer.value("Invalid payload - id has to be a job id");
+        return CommandResult::Status::FAILURE;
+    }
+
+    if (!jobs->writeStatus(json["id"].get<uint32_t>(), writer))
+    {
+        writer.value("Unknown job");
+        return CommandResult::Status::FAILURE;
+    }
+    return CommandResult::Status::SUCCESS;
+}
@@ -0,0 +1,14 @@
+#ifndef JOB_COMMANDS_HPP
+#define JOB_COMMANDS_HPP
+
+#include <nlohmann-json.hpp>
+#include "CommandJobs.hpp"
+#include "CommandResult.hpp"
+#include "DependencyRegistry.hpp"
+#include "ResponseWriter.hpp"
+
+// {"id": 3} reports how far job 3 got and, once it's done, what its command answered
+// without an id it lists every job that's still around, without the results
+CommandResult::Status getJobStatusCommand(std::shared_ptr<DependencyRegistry> registry, const nlohmann::json& json, ResponseWriter& writer);
+
+#endif
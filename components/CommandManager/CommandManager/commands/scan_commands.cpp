@@ -1,15 +1,24 @@
 #include "scan_commands.hpp"
+#include "CommandJobs.hpp"
 #include "sdkconfig.h"
 
-CommandResult scanNetworksCommand(std::shared_ptr<DependencyRegistry> registry, const nlohmann::json& json)
+// run as a job the scan shows up in get_job_status channel by channel
+static void reportScanProgress(void* context, uint8_t channel, uint8_t channels)
+{
+    static_cast<CommandJobs*>(context)->reportProgress(static_cast<uint8_t>(channel * 100 / channels));
+}
+
+CommandResult::Status scanNetworksCommand(std::shared_ptr<DependencyRegistry> registry, const nlohmann::json& json, ResponseWriter& writer)
 {
 #if !CONFIG_GENERAL_ENABLE_WIRELESS
-    return CommandResult::getErrorResult("Not supported by current firmware");
+    writer.value("Not supported by current firmware");
+    return CommandResult::Status::FAILURE;
 #endif
     auto wifiManager = registry->resolve<WiFiManager>(DependencyType::wifi_manager);
     if (!wifiManager)
     {
-        return CommandResult::getErrorResult("Not supported by current firmware");
+        writer.value("Not supported by current firmware");
+        return CommandResult::Status::FAILURE;
     }
 
     // Extract timeout from JSON if provided, default to 15000ms (15 seconds)
@@ -19,24 +28,32 @@ CommandResult scanNetworksCommand(std::shared_ptr<DependencyRegistry> registry,
         timeout_ms = json["timeout_ms"].get<int>();
     }
 
-    auto networks = wifiManager->ScanNetworks(timeout_ms);
-
-    nlohmann::json result;
-    std::vector<nlohmann::json> networksJson;
+    auto jobs = registry->resolve<CommandJobs>(DependencyType::command_jobs);
+    auto networks = jobs ? wifiManager->ScanNetworks(timeout_ms, reportScanProgress, jobs.get()) : wifiManager->ScanNetworks(timeout_ms);
 
+    // keys in the same order nlohmann sorted them into
+    writer.beginObject();
+    writer.key("networks");
+    writer.beginArray();
     for (const auto& network : networks)
     {
-        nlohmann::json networkItem;
-        networkItem["ssid"] = network.ssid;
-        networkItem["channel"] = network.channel;
-        networkItem["rssi"] = network.rssi;
         char mac_str[18];
         sprintf(mac_str, "%02x:%02x:%02x:%02x:%02x:%02x", network.mac[0], network.mac[1], network.mac[2], network.mac[3], network.mac[4], network.mac[5]);
-        networkItem["mac_address"] = mac_str;
-        networkItem["auth_mode"] = network.auth_mode;
-        networksJson.push_back(networkItem);
-    }
 
-    result["networks"] = networksJson;
-    return CommandResult::getSuccessResult(result);
-}
\ No newline at end of file
+        writer.beginObject();
+        writer.key("auth_mode");
+        writer.value(static_cast<int>(network.auth_mode));
+        writer.key("channel");
+        writer.value(network.channel);
+        writer.key("mac_address");
+        writer.value(mac_str);
+        writer.key("rssi");
+        writer.value(network.rssi);
+        writer.key("ssid");
+        writer.value(network.ssid);
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+    return CommandResult::Status::SUCCESS;
+}
@@ -6,8 +6,10 @@
 #include <wifiManager.hpp>
 #include "CommandResult.hpp"
 #include "DependencyRegistry.hpp"
+#include "ResponseWriter.hpp"
 #include "esp_log.h"
 
-CommandResult scanNetworksCommand(std::shared_ptr<DependencyRegistry> registry, const nlohmann::json& json);
+// a full scan can list dozens of networks, so this one writes straight into the response
+CommandResult::Status scanNetworksCommand(std::shared_ptr<DependencyRegistry> registry, const nlohmann::json& json, ResponseWriter& writer);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "stream_commands.hpp"
+
+static void writeHistogram(ResponseWriter& writer, const FrameTelemetry::HistogramSnapshot& histogram)
+{
+    writer.beginObject();
+    writer.key("count");
+    writer.value(histogram.count);
+    writer.key("p50_us");
+    writer.value(histogram.percentile(50));
+    writer.key("p90_us");
+    writer.value(histogram.percentile(90));
+    writer.key("p99_us");
+    writer.value(histogram.percentile(99));
+    writer.key("max_us");
+    writer.value(histogram.max_us);
+    writer.key("buckets");
+    writer.beginArray();
+    for (const uint32_t bucket : histogram.buckets)
+        writer.value(bucket);
+    writer.endArray();
+    writer.endObject();
+}
+
+CommandResult::Status getStreamStatsCommand(std::shared_ptr<DependencyRegistry> registry, const nlohmann::json& json, ResponseWriter& writer)
+{
+    (void)registry;
+
+    bool reset = false;
+    if (json.contains("reset"))
+    {
+        if (!json["reset"].is_boolean())
+        {
+            writer.value("Invalid payload - reset has to be a boolean");
+            return CommandResult::Status::FAILURE;
+        }
+        reset = json["reset"].get<bool>();
+    }
+
+    writer.beginObject();
+    // bucket i counts frames below bucket_bounds_us[i], the extra last bucket everything above
+    writer.key("bucket_bounds_us");
+    writer.beginArray();
+    for (const uint32_t bound : FrameTelemetry::BUCKET_BOUNDS_US)
+        writer.value(bound);
+    writer.endArray();
+
+    for (size_t transport = 0; transport < FrameTelemetry::TRANSPORT_COUNT; transport++)
+    {
+        const auto transport_id = static_cast<FrameTelemetry::Transport>(transport);
+        writer.key(FrameTelemetry::transportName(transport_id));
+        writer.beginObject();
+        for (size_t stage = 0; stage < FrameTelemetry::STAGE_COUNT; stage++)
+        {
+            const auto stage_id = static_cast<FrameTelemetry::Stage>(stage);
+            writer.key(FrameTelemetry::stageName(stage_id));
+            writeHistogram(writer, FrameTelemetry::snapshot(transport_id, stage_id));
+        }
+        writer.endObject();
+    }
+
+    // how long a stream takes to come up, per transport
+    writer.key("stream_start");
+    writer.beginObject();
+    for (size_t transport = 0; transport < FrameTelemetry::TRANSPORT_COUNT; transport++)
+    {
+        const auto transport_id = static_cast<FrameTelemetry::Transport>(transport);
+        writer.key(FrameTelemetry::transportName(transport_id));
+        writer.beginObject();
+        for (size_t stage = 0; stage < FrameTelemetry::START_STAGE_COUNT; stage++)
+        {
+            const auto stage_id = static_cast<FrameTelemetry::StartStage>(stage);
+            writer.key(FrameTelemetry::startStageName(stage_id));
+            writeHistogram(writer, FrameTelemetry::startSnapshot(transport_id, stage_id));
+        }
+        writer.endObject();
+    }
+    writer.endObject();
+
+    const JpegRateControl::Status rate = JpegRateControl::controller().status();
+    writer.key("rate_control");
+    writer.beginObject();
+    writer.key("quality");
+    writer.value(rate.quality);
+    writer.key("target_bytes");
+    writer.value(rate.target_bytes);
+    writer.key("average_bytes");
+    writer.value(rate.average_bytes);
+    writer.key("link_bytes_per_second");
+    writer.value(rate.link_bytes_per_second);
+    writer.key("frame_interval_us");
+    writer.value(rate.frame_interval_us);
+    writer.key("adjustments");
+    writer.value(rate.adjustments);
+    writer.key("overflow_guards");
+    writer.value(rate.overflow_guards);
+    writer.endObject();
+    writer.endObject();
+
+    if (reset)
+        FrameTelemetry::reset();
+
+    return CommandResult::Status::SUCCESS;
+}
@@ -0,0 +1,15 @@
+#ifndef STREAM_COMMANDS_HPP
+#define STREAM_COMMANDS_HPP
+
+#include <FrameTelemetry.hpp>
+#include <JpegRateControl.hpp>
+#include <nlohmann-json.hpp>
+#include "CommandResult.hpp"
+#include "DependencyRegistry.hpp"
+#include "ResponseWriter.hpp"
+
+// per-stage frame latency histograms of the UVC and HTTP streams, how long their starts took and where the JPEG rate control stands,
+// {"reset": true} clears the histograms after reading
+CommandResult::Status getStreamStatsCommand(std::shared_ptr<DependencyRegistry> registry, const nlohmann::json& json, ResponseWriter& writer);
+
+#endif
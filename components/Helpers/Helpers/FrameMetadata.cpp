@@ -0,0 +1,96 @@
+#include "FrameMetadata.hpp"
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+
+namespace FrameMetadata
+{
+namespace
+{
+// exposure in the low half, gain and flags above it, so a frame never sees the exposure of one
+// setting with the gain of another
+std::atomic<uint32_t> sensor_word{0};
+std::atomic<uint8_t> led_duty{0};
+// UINT16_MAX until the first measurement
+std::atomic<uint16_t> led_current_ma{UINT16_MAX};
+
+void put_le16(uint8_t* out, uint16_t value)
+{
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void put_le32(uint8_t* out, uint32_t value)
+{
+    put_le16(out, static_cast<uint16_t>(value));
+    put_le16(out + 2, static_cast<uint16_t>(value >> 16));
+}
+}  // namespace
+
+void publishSensor(uint16_t exposure, uint8_t gain, bool auto_exposure, bool auto_gain)
+{
+    const uint8_t flags = (auto_exposure ? AUTO_EXPOSURE : 0) | (auto_gain ? AUTO_GAIN : 0);
+    sensor_word.store(exposure | static_cast<uint32_t>(gain) << 16 | static_cast<uint32_t>(flags) << 24, std::memory_order_relaxed);
+}
+
+void publishLedDuty(uint8_t percent)
+{
+    led_duty.store(percent, std::memory_order_relaxed);
+}
+
+void publishLedCurrent(float milliamps)
+{
+    uint16_t value = UINT16_MAX;
+    if (milliamps >= 0)
+        value = milliamps >= UINT16_MAX - 1 ? UINT16_MAX - 1 : static_cast<uint16_t>(milliamps + 0.5f);
+    led_current_ma.store(value, std::memory_order_relaxed);
+}
+
+Record capture(uint32_t sequence)
+{
+    const uint32_t sensor = sensor_word.load(std::memory_order_relaxed);
+    const uint16_t current = led_current_ma.load(std::memory_order_relaxed);
+
+    Record record;
+    record.sequence = sequence;
+    record.exposure = static_cast<uint16_t>(sensor);
+    record.gain = static_cast<uint8_t>(sensor >> 16);
+    record.flags = static_cast<uint8_t>(sensor >> 24);
+    record.led_duty = led_duty.load(std::memory_order_relaxed);
+    if (current != UINT16_MAX)
+    {
+        record.led_current_ma = current;
+        record.flags |= LED_CURRENT;
+    }
+    return record;
+}
+
+size_t encode(const Record& record, uint8_t* out, size_t size)
+{
+    if (size < WIRE_SIZE)
+        return 0;
+
+    out[0] = WIRE_SIZE;
+    out[1] = WIRE_VERSION;
+    put_le32(&out[2], record.sequence);
+    put_le16(&out[6], record.exposure);
+    out[8] = record.gain;
+    out[9] = record.flags;
+    out[10] = record.led_duty;
+    out[11] = 0;
+    put_le16(&out[12], record.led_current_ma);
+    return WIRE_SIZE;
+}
+
+size_t formatHeaders(const Record& record, char* out, size_t size)
+{
+    int len = snprintf(out, size, "X-Frame: %" PRIu32 "\r\nX-Exposure: %u%s\r\nX-Gain: %u%s\r\nX-LED-Duty: %u\r\n", record.sequence,
+                       record.exposure, (record.flags & AUTO_EXPOSURE) ? " auto" : "", record.gain, (record.flags & AUTO_GAIN) ? " auto" : "",
+                       record.led_duty);
+    if (len > 0 && static_cast<size_t>(len) < size && (record.flags & LED_CURRENT))
+        len += snprintf(out + len, size - len, "X-LED-Current: %u\r\n", record.led_current_ma);
+    if (len < 0 || static_cast<size_t>(len) >= size)
+        return 0;
+    return static_cast<size_t>(len);
+}
+}  // namespace FrameMetadata
@@ -0,0 +1,57 @@
+#pragma once
+#ifndef FRAME_METADATA_HPP
+#define FRAME_METADATA_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// What the sensor and the illuminator were doing when a frame was taken, sent along with every frame
+// so trackers don't have to poll the command channel for it.
+//
+// Whoever changes a value publishes it here (CameraManager the exposure and gain, LEDManager the
+// illuminator duty, MonitoringManager the measured LED current), each into its own atomic word.
+// Taking a record for a frame is a few relaxed loads, no locks, so the stream paths do it on every frame.
+//
+// HTTP clients get the record as extra headers on every multipart part, UVC hosts as a vendor block
+// behind PTS/SCR in the payload header of each frame's first payload.
+namespace FrameMetadata
+{
+enum Flags : uint8_t
+{
+    AUTO_EXPOSURE = 1 << 0,  // exposure is the sensor's own, the value is only the last manual setting
+    AUTO_GAIN = 1 << 1,      // same for the gain
+    LED_CURRENT = 1 << 2,    // led_current_ma holds a measurement
+};
+
+struct Record
+{
+    uint32_t sequence = 0;        // frames the camera driver completed, a gap means frames dropped before anyone took them
+    uint16_t exposure = 0;        // aec_value, in sensor lines
+    uint8_t gain = 0;             // agc_gain
+    uint8_t flags = 0;
+    uint8_t led_duty = 0;         // illuminator PWM duty, percent
+    uint16_t led_current_ma = 0;  // filtered illuminator current
+};
+
+// bytes encode() writes, version 1:
+//   0 bLength, 1 version, 2-5 sequence, 6-7 exposure, 8 gain, 9 flags, 10 led duty, 11 reserved,
+//   12-13 led current, all little endian
+constexpr size_t WIRE_SIZE = 14;
+constexpr uint8_t WIRE_VERSION = 1;
+
+void publishSensor(uint16_t exposure, uint8_t gain, bool auto_exposure, bool auto_gain);
+void publishLedDuty(uint8_t percent);
+// negative means no measurement
+void publishLedCurrent(float milliamps);
+
+// the record for a frame with the driver's sequence number, safe from any task or core
+Record capture(uint32_t sequence);
+
+// returns the bytes written, 0 if out is too small
+size_t encode(const Record& record, uint8_t* out, size_t size);
+// X-Frame, X-Exposure, X-Gain, X-LED-Duty and X-LED-Current (only when measured) header lines,
+// returns the length like snprintf, 0 if it doesn't fit
+size_t formatHeaders(const Record& record, char* out, size_t size);
+}  // namespace FrameMetadata
+
+#endif  // FRAME_METADATA_HPP
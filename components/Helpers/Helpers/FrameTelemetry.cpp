@@ -0,0 +1,169 @@
+#include "FrameTelemetry.hpp"
+#include <algorithm>
+
+namespace FrameTelemetry
+{
+namespace
+{
+std::array<std::array<LatencyHistogram, STAGE_COUNT>, TRANSPORT_COUNT> histograms;
+std::array<std::array<LatencyHistogram, START_STAGE_COUNT>, TRANSPORT_COUNT> start_histograms;
+
+LatencyHistogram& histogramFor(Transport transport, Stage stage)
+{
+    return histograms[static_cast<size_t>(transport)][static_cast<size_t>(stage)];
+}
+
+LatencyHistogram& startHistogramFor(Transport transport, StartStage stage)
+{
+    return start_histograms[static_cast<size_t>(transport)][static_cast<size_t>(stage)];
+}
+
+void recordInterval(LatencyHistogram& histogram, int64_t from_us, int64_t to_us)
+{
+    if (from_us <= 0 || to_us < from_us)
+        return;
+
+    const int64_t latency = to_us - from_us;
+    histogram.record(latency > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(latency));
+}
+
+void recordStage(Transport transport, Stage stage, int64_t from_us, int64_t to_us)
+{
+    recordInterval(histogramFor(transport, stage), from_us, to_us);
+}
+}  // namespace
+
+uint32_t HistogramSnapshot::percentile(uint32_t percent) const
+{
+    if (this->count == 0)
+        return 0;
+
+    // rank of the sample we're after, rounded up so p99 of 10 frames is the slowest one
+    const uint64_t rank = (static_cast<uint64_t>(this->count) * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++)
+    {
+        seen += this->buckets[i];
+        if (seen >= rank && this->buckets[i] > 0)
+            return i < BUCKET_BOUNDS_US.size() ? std::min(BUCKET_BOUNDS_US[i], this->max_us) : this->max_us;
+    }
+    return this->max_us;
+}
+
+size_t LatencyHistogram::bucketFor(uint32_t latency_us)
+{
+    // ten bounds, a linear walk is as quick as a binary search here
+    size_t bucket = 0;
+    while (bucket < BUCKET_BOUNDS_US.size() && latency_us >= BUCKET_BOUNDS_US[bucket])
+        bucket++;
+    return bucket;
+}
+
+void LatencyHistogram::record(uint32_t latency_us)
+{
+    this->buckets[bucketFor(latency_us)].fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t current = this->max_us.load(std::memory_order_relaxed);
+    while (latency_us > current && !this->max_us.compare_exchange_weak(current, latency_us, std::memory_order_relaxed))
+    {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto& bucket : this->buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    this->max_us.store(0, std::memory_order_relaxed);
+}
+
+HistogramSnapshot LatencyHistogram::snapshot() const
+{
+    HistogramSnapshot result;
+    for (size_t i = 0; i < BUCKET_COUNT; i++)
+    {
+        result.buckets[i] = this->buckets[i].load(std::memory_order_relaxed);
+        result.count += result.buckets[i];
+    }
+    result.max_us = this->max_us.load(std::memory_order_relaxed);
+    return result;
+}
+
+void record(Transport transport, const FrameTiming& timing)
+{
+    recordStage(transport, Stage::Capture, timing.vsync_us, timing.eof_us);
+    recordStage(transport, Stage::Queue, timing.eof_us, timing.taken_us);
+    recordStage(transport, Stage::Handoff, timing.taken_us, timing.start_us);
+    recordStage(transport, Stage::Transfer, timing.start_us, timing.complete_us);
+    recordStage(transport, Stage::Total, timing.vsync_us, timing.complete_us);
+}
+
+HistogramSnapshot snapshot(Transport transport, Stage stage)
+{
+    return histogramFor(transport, stage).snapshot();
+}
+
+void recordStart(Transport transport, StartStage stage, int64_t from_us, int64_t to_us)
+{
+    recordInterval(startHistogramFor(transport, stage), from_us, to_us);
+}
+
+HistogramSnapshot startSnapshot(Transport transport, StartStage stage)
+{
+    return startHistogramFor(transport, stage).snapshot();
+}
+
+void reset()
+{
+    for (auto& stages : histograms)
+        for (auto& histogram : stages)
+            histogram.reset();
+    for (auto& stages : start_histograms)
+        for (auto& histogram : stages)
+            histogram.reset();
+}
+
+std::string_view transportName(Transport transport)
+{
+    switch (transport)
+    {
+        case Transport::UVC:
+            return "uvc";
+        case Transport::HTTP:
+            return "http";
+        default:
+            return "unknown";
+    }
+}
+
+std::string_view stageName(Stage stage)
+{
+    switch (stage)
+    {
+        case Stage::Capture:
+            return "capture";
+        case Stage::Queue:
+            return "queue";
+        case Stage::Handoff:
+            return "handoff";
+        case Stage::Transfer:
+            return "transfer";
+        case Stage::Total:
+            return "total";
+        default:
+            return "unknown";
+    }
+}
+
+std::string_view startStageName(StartStage stage)
+{
+    switch (stage)
+    {
+        case StartStage::Configure:
+            return "configure";
+        case StartStage::FirstFrame:
+            return "first_frame";
+        default:
+            return "unknown";
+    }
+}
+}  // namespace FrameTelemetry
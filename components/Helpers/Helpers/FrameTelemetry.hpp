@@ -0,0 +1,106 @@
+#pragma once
+#ifndef FRAME_TELEMETRY_HPP
+#define FRAME_TELEMETRY_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Per-stage latency of every frame that leaves the device, from the sensor's VSYNC to the last byte
+// handed to the transport. Recording is a handful of relaxed atomic increments so it's fine to call
+// from the UVC and HTTP paths on every frame, no locks, no allocations.
+//
+//   capture  - VSYNC -> DMA EOF, how long the sensor took to push the frame out
+//   queue    - DMA EOF -> esp_camera_fb_get() returned, time spent waiting in the driver's queue
+//   handoff  - fb_get -> transport started sending, our own overhead
+//   transfer - transport start -> transport complete, USB or the socket
+//   total    - VSYNC -> transport complete
+//
+// Stream starts get their own histograms, from the host asking for a stream to
+//   configure   - the sensor running what the host asked for (UVC commit, frame size and clock)
+//   first_frame - the first frame of the new stream handed over completely
+namespace FrameTelemetry
+{
+enum class Transport : uint8_t
+{
+    UVC,
+    HTTP,
+    COUNT,
+};
+
+enum class Stage : uint8_t
+{
+    Capture,
+    Queue,
+    Handoff,
+    Transfer,
+    Total,
+    COUNT,
+};
+
+enum class StartStage : uint8_t
+{
+    Configure,
+    FirstFrame,
+    COUNT,
+};
+
+constexpr size_t TRANSPORT_COUNT = static_cast<size_t>(Transport::COUNT);
+constexpr size_t STAGE_COUNT = static_cast<size_t>(Stage::COUNT);
+constexpr size_t START_STAGE_COUNT = static_cast<size_t>(StartStage::COUNT);
+
+// esp_timer timestamps of one frame, 0 means the point wasn't reached or isn't known
+struct FrameTiming
+{
+    int64_t vsync_us = 0;
+    int64_t eof_us = 0;
+    int64_t taken_us = 0;
+    int64_t start_us = 0;
+    int64_t complete_us = 0;
+};
+
+// upper bounds of the buckets, roughly doubling, the last bucket takes everything above 133ms
+constexpr std::array<uint32_t, 10> BUCKET_BOUNDS_US = {250, 500, 1000, 2000, 4000, 8000, 16000, 33000, 66000, 133000};
+constexpr size_t BUCKET_COUNT = BUCKET_BOUNDS_US.size() + 1;
+
+struct HistogramSnapshot
+{
+    std::array<uint32_t, BUCKET_COUNT> buckets{};
+    uint32_t count = 0;
+    uint32_t max_us = 0;
+
+    // upper bound of the bucket the percentile falls into, clamped to the max we've seen
+    uint32_t percentile(uint32_t percent) const;
+};
+
+class LatencyHistogram
+{
+   public:
+    void record(uint32_t latency_us);
+    void reset();
+    // not a consistent cut across buckets while frames keep coming in, close enough for stats
+    HistogramSnapshot snapshot() const;
+
+    static size_t bucketFor(uint32_t latency_us);
+
+   private:
+    std::array<std::atomic<uint32_t>, BUCKET_COUNT> buckets{};
+    std::atomic<uint32_t> max_us{0};
+};
+
+// stages with a missing or out of order timestamp are skipped, the rest still get counted
+void record(Transport transport, const FrameTiming& timing);
+HistogramSnapshot snapshot(Transport transport, Stage stage);
+// from_us is when the host asked for the stream, skipped like a stage if the timestamps don't make sense
+void recordStart(Transport transport, StartStage stage, int64_t from_us, int64_t to_us);
+HistogramSnapshot startSnapshot(Transport transport, StartStage stage);
+void reset();
+
+std::string_view transportName(Transport transport);
+std::string_view stageName(Stage stage);
+std::string_view startStageName(StartStage stage);
+}  // namespace FrameTelemetry
+
+#endif  // FRAME_TELEMETRY_HPP
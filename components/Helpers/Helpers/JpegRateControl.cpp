@@ -0,0 +1,182 @@
+#include "JpegRateControl.hpp"
+#include <algorithm>
+
+namespace JpegRateControl
+{
+namespace
+{
+Controller instance;
+}  // namespace
+
+Controller& controller()
+{
+    return instance;
+}
+
+void Controller::configure(const Settings& settings, ApplyQuality apply, void* context)
+{
+    this->settings = settings;
+    this->apply = apply;
+    this->apply_context = context;
+    this->quality.store(settings.best_quality, std::memory_order_relaxed);
+    this->adjustments.store(0, std::memory_order_relaxed);
+    this->overflow_guards.store(0, std::memory_order_relaxed);
+    this->restart();
+}
+
+void Controller::restart()
+{
+    this->window_position = 0;
+    this->window_filled = 0;
+    this->settle = 0;
+    this->last_captured_us = 0;
+    this->overflows_known = false;
+    this->frame_interval_us.store(0, std::memory_order_relaxed);
+    this->average_bytes.store(0, std::memory_order_relaxed);
+
+    // every stream starts out at the best quality the link turns out to take
+    if (this->settings.enabled && this->quality.load(std::memory_order_relaxed) != this->settings.best_quality)
+        this->changeQuality(this->settings.best_quality);
+}
+
+void Controller::setLinkRate(size_t link, uint32_t bytes_per_second)
+{
+    if (link < MAX_LINKS)
+        this->link_rates[link].store(bytes_per_second, std::memory_order_relaxed);
+}
+
+uint32_t Controller::linkRate() const
+{
+    uint32_t slowest = 0;
+    for (const auto& rate : this->link_rates)
+    {
+        const uint32_t value = rate.load(std::memory_order_relaxed);
+        if (value != 0 && (slowest == 0 || value < slowest))
+            slowest = value;
+    }
+    return slowest;
+}
+
+uint32_t Controller::targetBytes() const
+{
+    uint64_t target = this->settings.max_frame_bytes ? this->settings.max_frame_bytes * 85ULL / 100 : UINT32_MAX;
+
+    const uint32_t rate = this->linkRate();
+    const uint32_t interval = this->frame_interval_us.load(std::memory_order_relaxed);
+    if (rate != 0 && interval != 0)
+        target = std::min<uint64_t>(target, static_cast<uint64_t>(rate) * interval / 1000000 * this->settings.headroom_percent / 100);
+
+    return static_cast<uint32_t>(std::min<uint64_t>(target, UINT32_MAX));
+}
+
+int Controller::changeQuality(int quality)
+{
+    quality = std::clamp(quality, this->settings.best_quality, this->settings.worst_quality);
+    this->quality.store(quality, std::memory_order_relaxed);
+    this->adjustments.fetch_add(1, std::memory_order_relaxed);
+    // frames in flight still have the old quality, don't judge the new one by them
+    this->settle = SETTLE_FRAMES;
+    this->window_filled = 0;
+    if (this->apply)
+        this->apply(quality, this->apply_context);
+    return quality;
+}
+
+bool Controller::overflowed(uint32_t overflows)
+{
+    // the counter runs for as long as the driver does, only what's new since the last look counts
+    const bool grew = this->overflows_known && overflows != this->last_overflows;
+    this->last_overflows = overflows;
+    this->overflows_known = true;
+    return grew;
+}
+
+int Controller::onCaptureFailed(uint32_t overflows)
+{
+    if (!this->settings.enabled || !this->overflowed(overflows))
+        return -1;
+
+    const int current = this->quality.load(std::memory_order_relaxed);
+    if (current >= this->settings.worst_quality)
+        return -1;
+    // nothing fits anymore, and every try costs the whole capture timeout
+    this->overflow_guards.fetch_add(1, std::memory_order_relaxed);
+    return this->changeQuality(current + 8);
+}
+
+int Controller::onFrame(size_t frame_bytes, int64_t captured_us, uint32_t overflows)
+{
+    // frame rate and size are tracked either way, get_vie_window reports them
+    const bool dropped = this->overflowed(overflows);
+
+    if (this->last_captured_us != 0 && captured_us > this->last_captured_us)
+    {
+        const uint32_t interval = static_cast<uint32_t>(std::min<int64_t>(captured_us - this->last_captured_us, UINT32_MAX));
+        const uint32_t average = this->frame_interval_us.load(std::memory_order_relaxed);
+        // a dropped frame or two shouldn't halve the budget, smooth it out
+        this->frame_interval_us.store(average ? (average * 7 + interval) / 8 : interval, std::memory_order_relaxed);
+    }
+    this->last_captured_us = captured_us;
+
+    // drops while settling were most likely still captured at the old quality
+    if (this->settle > 0)
+    {
+        this->settle--;
+        return -1;
+    }
+
+    const uint32_t bytes = static_cast<uint32_t>(std::min<size_t>(frame_bytes, UINT32_MAX));
+    this->window[this->window_position] = bytes;
+    this->window_position = (this->window_position + 1) % WINDOW;
+    this->window_filled = std::min(this->window_filled + 1, WINDOW);
+
+    uint64_t sum = 0;
+    for (size_t i = 0; i < this->window_filled; i++)
+    {
+        // the newest window_filled entries, older ones belong to the quality before
+        sum += this->window[(this->window_position + WINDOW - 1 - i) % WINDOW];
+    }
+    const uint32_t average = static_cast<uint32_t>(sum / this->window_filled);
+    this->average_bytes.store(average, std::memory_order_relaxed);
+
+    if (!this->settings.enabled)
+        return -1;
+
+    const int current = this->quality.load(std::memory_order_relaxed);
+
+    // a frame didn't fit or came this close to the buffer size and the next one may not, don't wait for the average
+    if (dropped || (this->settings.max_frame_bytes != 0 && bytes >= this->settings.max_frame_bytes * 95ULL / 100))
+    {
+        if (current >= this->settings.worst_quality)
+            return -1;
+        this->overflow_guards.fetch_add(1, std::memory_order_relaxed);
+        return this->changeQuality(current + 4);
+    }
+
+    const uint64_t target = this->targetBytes();
+    // over budget is acted on after half a window, the further over the bigger the step
+    if (this->window_filled >= WINDOW / 2 && average > target && current < this->settings.worst_quality)
+    {
+        const int step = average > target * 3 / 2 ? 4 : average > target * 6 / 5 ? 2 : 1;
+        return this->changeQuality(current + step);
+    }
+    // better quality only with a full window under budget, one step of quality is worth roughly 5-10%
+    if (this->window_filled == WINDOW && average < target * 85 / 100 && current > this->settings.best_quality)
+        return this->changeQuality(current - 1);
+
+    return -1;
+}
+
+Status Controller::status() const
+{
+    return {
+        .quality = this->quality.load(std::memory_order_relaxed),
+        .target_bytes = this->targetBytes(),
+        .average_bytes = this->average_bytes.load(std::memory_order_relaxed),
+        .link_bytes_per_second = this->linkRate(),
+        .frame_interval_us = this->frame_interval_us.load(std::memory_order_relaxed),
+        .adjustments = this->adjustments.load(std::memory_order_relaxed),
+        .overflow_guards = this->overflow_guards.load(std::memory_order_relaxed),
+    };
+}
+}  // namespace JpegRateControl
@@ -0,0 +1,107 @@
+#pragma once
+#ifndef JPEG_RATE_CONTROL_HPP
+#define JPEG_RATE_CONTROL_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Keeps JPEG frames within what the link can carry by moving the sensor's quality setting.
+//
+// Every captured frame is fed in with its size. The controller knows how fast frames come and how many
+// bytes per second each link takes (the USB budget for UVC, the measured send rate of every HTTP client),
+// which gives a byte budget per frame. The average of the last few frames is held against that budget:
+// over it the quality gets worse right away, well under it the quality creeps back towards the best one.
+// A single frame close to the camera's frame buffer size bumps the quality immediately, the next one
+// might not fit anymore. Frames that didn't fit never show up here, the driver drops them, so callers pass
+// in its overflow counter and a step up in it is taken as a frame way over budget.
+//
+// Bright IR scenes easily triple the frame size, without this the link stalls and latency piles up.
+namespace JpegRateControl
+{
+// link 0 is UVC, 1.. are the HTTP stream clients
+constexpr size_t MAX_LINKS = 8;
+// frames averaged before deciding on better quality, worse quality needs only half of them
+constexpr size_t WINDOW = 8;
+// frames ignored after a change, the sensor needs a frame or two to switch quality
+constexpr uint32_t SETTLE_FRAMES = 2;
+
+struct Settings
+{
+    bool enabled = true;
+    // OV sensors, 0-63, lower is better
+    int best_quality = 8;
+    int worst_quality = 30;
+    // frame buffer size, anything bigger gets dropped by the driver
+    uint32_t max_frame_bytes = 0;
+    // share of the link budget frames may use, the rest is slack for headers and bursts
+    uint32_t headroom_percent = 85;
+};
+
+struct Status
+{
+    int quality = 0;
+    uint32_t target_bytes = 0;
+    uint32_t average_bytes = 0;
+    uint32_t link_bytes_per_second = 0;
+    uint32_t frame_interval_us = 0;
+    uint32_t adjustments = 0;
+    // quality bumped because a frame came close to the frame buffer size or didn't fit
+    uint32_t overflow_guards = 0;
+};
+
+// applies the quality to the sensor, registered by whoever owns it
+using ApplyQuality = void (*)(int quality, void* context);
+
+class Controller
+{
+   public:
+    void configure(const Settings& settings, ApplyQuality apply, void* context);
+    // a new stream, forget frame sizes and rate and start over at the best quality
+    void restart();
+
+    // bytes per second a link takes, 0 once it's gone, the slowest one sets the budget
+    void setLinkRate(size_t link, uint32_t bytes_per_second);
+
+    // one captured frame, returns the quality the sensor got switched to or -1 if it stays
+    // overflows is the driver's running count of frames dropped for not fitting the frame buffer
+    // only ever called from the one task that's pulling frames
+    int onFrame(size_t frame_bytes, int64_t captured_us, uint32_t overflows);
+    // no frame came at all, if that's down to overflows this is the only chance to react
+    int onCaptureFailed(uint32_t overflows);
+
+    Status status() const;
+
+   private:
+    uint32_t linkRate() const;
+    uint32_t targetBytes() const;
+    int changeQuality(int quality);
+    bool overflowed(uint32_t overflows);
+
+    Settings settings;
+    ApplyQuality apply = nullptr;
+    void* apply_context = nullptr;
+
+    std::array<std::atomic<uint32_t>, MAX_LINKS> link_rates{};
+
+    std::array<uint32_t, WINDOW> window{};
+    size_t window_position = 0;
+    size_t window_filled = 0;
+    uint32_t settle = 0;
+    int64_t last_captured_us = 0;
+    uint32_t last_overflows = 0;
+    bool overflows_known = false;
+
+    std::atomic<int> quality{0};
+    std::atomic<uint32_t> frame_interval_us{0};
+    std::atomic<uint32_t> average_bytes{0};
+    std::atomic<uint32_t> adjustments{0};
+    std::atomic<uint32_t> overflow_guards{0};
+};
+
+// the one every camera frame goes through
+Controller& controller();
+}  // namespace JpegRateControl
+
+#endif  // JPEG_RATE_CONTROL_HPP
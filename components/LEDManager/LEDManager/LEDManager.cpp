@@ -71,6 +71,7 @@ void LEDManager::setup()
                                           .hpoint = 0};
 
     ESP_ERROR_CHECK(ledc_channel_config(&ledc_channel));
+    FrameMetadata::publishLedDuty(deviceConfig.led_external_pwm_duty_cycle);
 #endif
 
     ESP_LOGD(LED_MANAGER_TAG, "Done.");
@@ -152,6 +153,7 @@ void LEDManager::updateState(const LEDStates_e newState)
         {
             ESP_ERROR_CHECK_WITHOUT_ABORT(ledc_set_duty(LEDC_LOW_SPEED_MODE, EXTERNAL_LED_CHANNEL, storedExternalDuty));
             ESP_ERROR_CHECK_WITHOUT_ABORT(ledc_update_duty(LEDC_LOW_SPEED_MODE, EXTERNAL_LED_CHANNEL));
+            FrameMetadata::publishLedDuty((storedExternalDuty * 100 + 127) / 255);
             hasStoredExternalDuty = false;
         }
     }
@@ -176,6 +178,7 @@ void LEDManager::toggleLED(const bool state) const
         uint32_t duty = (state == LED_ON) ? ((50 * 255) / 100) : 0;
         ESP_ERROR_CHECK_WITHOUT_ABORT(ledc_set_duty(LEDC_LOW_SPEED_MODE, EXTERNAL_LED_CHANNEL, duty));
         ESP_ERROR_CHECK_WITHOUT_ABORT(ledc_update_duty(LEDC_LOW_SPEED_MODE, EXTERNAL_LED_CHANNEL));
+        FrameMetadata::publishLedDuty(state == LED_ON ? 50 : 0);
     }
 #endif
 }
@@ -190,6 +193,7 @@ void LEDManager::setExternalLEDDutyCycle(uint8_t dutyPercent)
     // We configured a dedicated channel in setup with LEDC_LOW_SPEED_MODE
     ESP_ERROR_CHECK_WITHOUT_ABORT(ledc_set_duty(LEDC_LOW_SPEED_MODE, EXTERNAL_LED_CHANNEL, dutyCycle));
     ESP_ERROR_CHECK_WITHOUT_ABORT(ledc_update_duty(LEDC_LOW_SPEED_MODE, EXTERNAL_LED_CHANNEL));
+    FrameMetadata::publishLedDuty(dutyPercent);
 #else
     (void)dutyPercent;  // unused
     ESP_LOGW(LED_MANAGER_TAG, "CONFIG_LED_EXTERNAL_CONTROL not enabled; ignoring duty update");
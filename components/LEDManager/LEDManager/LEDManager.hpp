@@ -11,6 +11,7 @@
 #endif
 
 #include <esp_log.h>
+#include <FrameMetadata.hpp>
 #include <ProjectConfig.hpp>
 #include <StateManager.hpp>
 #include <algorithm>
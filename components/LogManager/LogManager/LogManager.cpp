@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <cstdio>
 #include <cstring>
+#include <sys/stat.h>
 #include "esp_spiffs.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
@@ -270,15 +271,59 @@ std::vector<LogEntry> LogManager::getRecentLogs() const
 }
 
 std::string LogManager::getPersistentLogs() const
+{
+    std::string result;
+    readPersistentLogs(SIZE_MAX, [&result](std::string_view part) { result.append(part); });
+    return result;
+}
+
+void LogManager::readPersistentLogs(size_t max_bytes, const std::function<void(std::string_view)>& emit) const
 {
     if (!spiffs_mounted_)
-        return "SPIFFS not mounted";
+    {
+        emit("SPIFFS not mounted");
+        return;
+    }
 
     // Flush any pending entries before reading
     const_cast<LogManager*>(this)->flushPendingLogs();
 
-    std::string result;
     const int max_boots = CONFIG_DEBUG_LOG_PERSISTENT_BOOTS;
+    const auto bootHeader = [](int boot, char* header, size_t size) { return snprintf(header, size, "--- boot -%d ---\n", boot); };
+
+    // First pass only sizes things up, so we know how much of the oldest logs to skip
+    size_t total = 0;
+    for (int i = max_boots - 1; i >= 0; i--)
+    {
+        char path[32];
+        snprintf(path, sizeof(path), "/logs/log_%d.txt", i);
+
+        struct stat st;
+        if (stat(path, &st) != 0)
+            continue;
+
+        char header[32];
+        total += bootHeader(i, header, sizeof(header)) + st.st_size;
+    }
+
+    if (total == 0)
+    {
+        emit("No persistent logs available");
+        return;
+    }
+
+    size_t skip = total > max_bytes ? total - max_bytes : 0;
+    if (skip > 0)
+        emit("[truncated]\n");
+
+    const auto emitTail = [&](std::string_view part)
+    {
+        const size_t skipped = std::min(skip, part.size());
+        skip -= skipped;
+        part.remove_prefix(skipped);
+        if (!part.empty())
+            emit(part);
+    };
 
     // Read from oldest to newest
     for (int i = max_boots - 1; i >= 0; i--)
@@ -290,22 +335,17 @@ std::string LogManager::getPersistentLogs() const
         if (!f)
             continue;
 
-        result += "--- boot -";
-        result += std::to_string(i);
-        result += " ---\n";
+        char header[32];
+        emitTail(std::string_view(header, bootHeader(i, header, sizeof(header))));
 
-        char line[256];
-        while (fgets(line, sizeof(line), f))
+        char chunk[256];
+        size_t read = 0;
+        while ((read = fread(chunk, 1, sizeof(chunk), f)) > 0)
         {
-            result += line;
+            emitTail(std::string_view(chunk, read));
         }
         fclose(f);
     }
-
-    if (result.empty())
-        result = "No persistent logs available";
-
-    return result;
 }
 
 bool LogManager::clearPersistentLogs()
@@ -3,6 +3,7 @@
 #define LOGMANAGER_HPP
 
 #include <atomic>
+#include <functional>
 #include <mutex>
 #include <string>
 #include <vector>
@@ -34,6 +35,9 @@ class LogManager
 
     // Retrieve persistent logs from SPIFFS (last N boots)
     std::string getPersistentLogs() const;
+    // Same text as getPersistentLogs(), but handed out in small pieces as the files are read.
+    // Keeps only the last max_bytes, prefixed with "[truncated]\n" if anything got cut.
+    void readPersistentLogs(size_t max_bytes, const std::function<void(std::string_view)>& emit) const;
     bool clearPersistentLogs();
 
     // Custom vprintf hook – called by esp_log
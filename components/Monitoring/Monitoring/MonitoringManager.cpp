@@ -7,6 +7,7 @@
  */
 
 #include "MonitoringManager.hpp"
+#include <FrameMetadata.hpp>
 #include <esp_log.h>
 #include "sdkconfig.h"
 
@@ -106,6 +107,7 @@ void MonitoringManager::run()
         {
             float ma = cm_.getCurrentMilliAmps();
             last_current_ma_.store(ma);
+            FrameMetadata::publishLedCurrent(ma);
             next_tick_led = now_tick + led_period;
         }
         if (CurrentMonitor::isEnabled())
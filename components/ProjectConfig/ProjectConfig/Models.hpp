@@ -151,6 +151,11 @@ struct CameraConfig_t : BaseConfigModel
     uint8_t framesize;
     uint8_t quality;
     uint8_t brightness;
+    // region of interest cropped on the sensor, in readout pixels, a width of 0 streams the whole frame
+    uint16_t window_x;
+    uint16_t window_y;
+    uint16_t window_width;
+    uint16_t window_height;
 
     void load()
     {
@@ -159,6 +164,10 @@ struct CameraConfig_t : BaseConfigModel
         this->framesize = this->pref->getInt("framesize", 7);
         this->quality = this->pref->getInt("quality", 7);
         this->brightness = this->pref->getInt("brightness", 2);
+        this->window_x = this->pref->getInt("window_x", 0);
+        this->window_y = this->pref->getInt("window_y", 0);
+        this->window_width = this->pref->getInt("window_w", 0);
+        this->window_height = this->pref->getInt("window_h", 0);
     };
 
     void save() const
@@ -168,14 +177,19 @@ struct CameraConfig_t : BaseConfigModel
         this->pref->putInt("framesize", this->framesize);
         this->pref->putInt("quality", this->quality);
         this->pref->putInt("brightness", this->brightness);
+        this->pref->putInt("window_x", this->window_x);
+        this->pref->putInt("window_y", this->window_y);
+        this->pref->putInt("window_w", this->window_width);
+        this->pref->putInt("window_h", this->window_height);
     };
 
     std::string toRepresentation()
     {
         return Helpers::format_string(
             "\"camera_config\": {\"vflip\": %d,\"framesize\": %d,\"href\": "
-            "%d,\"quality\": %d,\"brightness\": %d}",
-            this->vflip, this->framesize, this->href, this->quality, this->brightness);
+            "%d,\"quality\": %d,\"brightness\": %d,\"window\": {\"offset_x\": %d,\"offset_y\": %d,\"width\": %d,\"height\": %d}}",
+            this->vflip, this->framesize, this->href, this->quality, this->brightness, this->window_x, this->window_y, this->window_width,
+            this->window_height);
     };
 };
 
@@ -151,6 +151,16 @@ void ProjectConfig::setCameraConfig(const uint8_t vflip, const uint8_t framesize
     ESP_LOGD(CONFIGURATION_TAG, "Updating Camera config");
 }
 
+void ProjectConfig::setCameraWindow(const uint16_t offsetX, const uint16_t offsetY, const uint16_t width, const uint16_t height)
+{
+    ESP_LOGD(CONFIGURATION_TAG, "Updating camera window");
+    this->config.camera.window_x = offsetX;
+    this->config.camera.window_y = offsetY;
+    this->config.camera.window_width = width;
+    this->config.camera.window_height = height;
+    this->config.camera.save();
+}
+
 void ProjectConfig::setWifiConfig(const std::string& networkName, const std::string& ssid, const std::string& bssid, const std::string& password,
                                   uint8_t channel, uint8_t power)
 {
@@ -39,6 +39,7 @@ class ProjectConfig
     void setFanDutyCycleConfig(int fan_pwm_duty_cycle);
     void setMDNSConfig(const std::string& hostname);
     void setCameraConfig(uint8_t vflip, uint8_t framesize, uint8_t href, uint8_t quality, uint8_t brightness);
+    void setCameraWindow(uint16_t offsetX, uint16_t offsetY, uint16_t width, uint16_t height);
     void setWifiConfig(const std::string& networkName, const std::string& ssid, const std::string& bssid, const std::string& password, uint8_t channel,
                        uint8_t power);
 
@@ -1,5 +1,9 @@
 #include "RestAPI.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
 #include <utility>
 
 #define PATCH_METHOD "PATCH"
@@ -7,105 +11,254 @@
 #define GET_METHOD "GET"
 #define DELETE_METHOD "DELETE"
 
-bool getIsSuccess(const nlohmann::json& response)
+// appends straight to the connection's send buffer, mongoose flushes it on the next poll
+class MongooseSink : public ResponseSink
 {
-    // since the commandManager will be returning CommandManagerResponse to simplify parsing on the clients end
-    // we can slightly its json representation, and extract the status from there
-    // note: This will only work for commands executed with CommandManager::executeFromType().
-    if (!response.contains("result"))
+   public:
+    explicit MongooseSink(mg_connection* connection) : connection(connection) {}
+
+    void write(const char* data, size_t length) override
     {
-        return false;
+        mg_send(this->connection, data, length);
     }
 
-    return response.at("result").at("status").get<std::string>() == "success";
+   private:
+    mg_connection* connection;
+};
+
+// last time a connection did anything, kept in the connection's own data so there's nothing to clean up
+static void touchConnection(mg_connection* connection, uint64_t now)
+{
+    memcpy(connection->data, &now, sizeof(now));
 }
 
-RestAPI::RestAPI(std::string url, std::shared_ptr<CommandManager> commandManager) : command_manager(commandManager)
+static uint64_t lastActivity(const mg_connection* connection)
 {
-    // until we stumble on a simpler way to handle the commands over the rest api
-    // the formula will be like this:
-    // each command gets its own endpoint
-    // each endpoint must include the action it performs in its path
-    // for example
-    // /get/ for getters
-    // /set/ for posts
-    // /delete/ for deletes
-    // /update/ for updates
-    // additional actions on the resource should be appended after the resource name
-    // like for example /api/set/config/save/
-    //
-    // one endpoint must not contain more than one action
+    uint64_t last;
+    memcpy(&last, connection->data, sizeof(last));
+    return last;
+}
 
-    this->url = std::move(url);
+static const char* getStatusText(int code)
+{
+    switch (code)
+    {
+    case 200:
+        return "OK";
+    case 400:
+        return "Bad Request";
+    case 401:
+        return "Unauthorized";
+    case 500:
+        return "Internal Server Error";
+    default:
+        return "OK";
+    }
+}
+
+template <size_t N>
+static constexpr std::array<Route, N> sortedRoutes(std::array<Route, N> routes)
+{
+    std::sort(routes.begin(), routes.end(), [](const Route& a, const Route& b) { return a.path < b.path; });
+    return routes;
+}
+
+template <size_t N>
+static constexpr bool routesAreUnique(const std::array<Route, N>& routes)
+{
+    return std::adjacent_find(routes.begin(), routes.end(), [](const Route& a, const Route& b) { return a.path == b.path; }) == routes.end();
+}
+
+// until we stumble on a simpler way to handle the commands over the rest api
+// the formula will be like this:
+// each command gets its own endpoint
+// each endpoint must include the action it performs in its path
+// for example
+// /get/ for getters
+// /set/ for posts
+// /delete/ for deletes
+// /update/ for updates
+// additional actions on the resource should be appended after the resource name
+// like for example /api/set/config/save/
+//
+// one endpoint must not contain more than one action
+
+// sorted by path at compile time, a request is one binary search away from its command
+static constexpr auto ROUTES = sortedRoutes(std::array{
     // updates via PATCH
-    routes.emplace("/api/update/wifi/", RequestBaseData(PATCH_METHOD, CommandType::UPDATE_WIFI, 200, 400));
-    routes.emplace("/api/update/device/mode/", RequestBaseData(PATCH_METHOD, CommandType::SWITCH_MODE, 200, 400));
-    routes.emplace("/api/update/camera/", RequestBaseData(PATCH_METHOD, CommandType::UPDATE_CAMERA, 200, 400));
-    routes.emplace("/api/update/ota/credentials", RequestBaseData(PATCH_METHOD, CommandType::UPDATE_OTA_CREDENTIALS, 200, 400));
-    routes.emplace("/api/update/ap/", RequestBaseData(PATCH_METHOD, CommandType::UPDATE_AP_WIFI, 200, 400));
-    routes.emplace("/api/update/led_duty_cycle/", RequestBaseData(PATCH_METHOD, CommandType::SET_LED_DUTY_CYCLE, 200, 400));
-    routes.emplace("/api/update/fan_duty_cycle/", RequestBaseData(PATCH_METHOD, CommandType::SET_FAN_DUTY_CYCLE, 200, 400));
+    Route{"/api/update/wifi/", PATCH_METHOD, CommandType::UPDATE_WIFI, 200, 400},
+    Route{"/api/update/device/mode/", PATCH_METHOD, CommandType::SWITCH_MODE, 200, 400},
+    Route{"/api/update/camera/", PATCH_METHOD, CommandType::UPDATE_CAMERA, 200, 400},
+    Route{"/api/update/camera/window/", PATCH_METHOD, CommandType::SET_VIE_WINDOW, 200, 400},
+    Route{"/api/update/ota/credentials", PATCH_METHOD, CommandType::UPDATE_OTA_CREDENTIALS, 200, 400},
+    Route{"/api/update/ap/", PATCH_METHOD, CommandType::UPDATE_AP_WIFI, 200, 400},
+    Route{"/api/update/led_duty_cycle/", PATCH_METHOD, CommandType::SET_LED_DUTY_CYCLE, 200, 400},
+    Route{"/api/update/fan_duty_cycle/", PATCH_METHOD, CommandType::SET_FAN_DUTY_CYCLE, 200, 400},
 
     // POST will set the data
-    routes.emplace("/api/set/pause/", RequestBaseData(POST_METHOD, CommandType::PAUSE, 200, 400));
-    routes.emplace("/api/set/wifi/", RequestBaseData(POST_METHOD, CommandType::SET_WIFI, 200, 400));
-    routes.emplace("/api/set/mdns/", RequestBaseData(POST_METHOD, CommandType::SET_MDNS, 200, 400));
-    routes.emplace("/api/set/config/save/", RequestBaseData(POST_METHOD, CommandType::SAVE_CONFIG, 200, 400));
-    routes.emplace("/api/set/wifi/connect/", RequestBaseData(POST_METHOD, CommandType::CONNECT_WIFI, 200, 400));
+    Route{"/api/set/pause/", POST_METHOD, CommandType::PAUSE, 200, 400},
+    Route{"/api/set/wifi/", POST_METHOD, CommandType::SET_WIFI, 200, 400},
+    Route{"/api/set/mdns/", POST_METHOD, CommandType::SET_MDNS, 200, 400},
+    Route{"/api/set/config/save/", POST_METHOD, CommandType::SAVE_CONFIG, 200, 400},
+    Route{"/api/set/wifi/connect/", POST_METHOD, CommandType::CONNECT_WIFI, 200, 400},
 
     // resets via POST as well
-    routes.emplace("/api/reset/config/", RequestBaseData(POST_METHOD, CommandType::RESET_CONFIG, 200, 400));
+    Route{"/api/reset/config/", POST_METHOD, CommandType::RESET_CONFIG, 200, 400},
 
     // gets via GET
-    routes.emplace("/api/get/config/", RequestBaseData(GET_METHOD, CommandType::GET_CONFIG, 200, 400));
-    routes.emplace("/api/get/mdns/", RequestBaseData(GET_METHOD, CommandType::GET_MDNS_NAME, 200, 400));
-    routes.emplace("/api/get/led_duty_cycle/", RequestBaseData(GET_METHOD, CommandType::GET_LED_DUTY_CYCLE, 200, 400));
-    routes.emplace("/api/get/fan_duty_cycle/", RequestBaseData(GET_METHOD, CommandType::GET_FAN_DUTY_CYCLE, 200, 400));
-    routes.emplace("/api/get/serial_number/", RequestBaseData(GET_METHOD, CommandType::GET_SERIAL, 200, 400));
-    routes.emplace("/api/get/led_current/", RequestBaseData(GET_METHOD, CommandType::GET_LED_CURRENT, 200, 400));
-    routes.emplace("/api/get/who_am_i/", RequestBaseData(GET_METHOD, CommandType::GET_WHO_AM_I, 200, 400));
+    Route{"/api/get/config/", GET_METHOD, CommandType::GET_CONFIG, 200, 400},
+    Route{"/api/get/mdns/", GET_METHOD, CommandType::GET_MDNS_NAME, 200, 400},
+    Route{"/api/get/led_duty_cycle/", GET_METHOD, CommandType::GET_LED_DUTY_CYCLE, 200, 400},
+    Route{"/api/get/fan_duty_cycle/", GET_METHOD, CommandType::GET_FAN_DUTY_CYCLE, 200, 400},
+    Route{"/api/get/serial_number/", GET_METHOD, CommandType::GET_SERIAL, 200, 400},
+    Route{"/api/get/led_current/", GET_METHOD, CommandType::GET_LED_CURRENT, 200, 400},
+    Route{"/api/get/who_am_i/", GET_METHOD, CommandType::GET_WHO_AM_I, 200, 400},
+    Route{"/api/get/camera/window/", GET_METHOD, CommandType::GET_VIE_WINDOW, 200, 400},
+    // ?id=N for one job, the id is what scan_networks or connect_wifi answered with, without it every job
+    Route{"/api/get/job/", GET_METHOD, CommandType::GET_JOB_STATUS, 200, 400},
 
     // deletes via DELETE
-    routes.emplace("/api/delete/wifi", RequestBaseData(DELETE_METHOD, CommandType::DELETE_NETWORK, 200, 400));
+    Route{"/api/delete/wifi", DELETE_METHOD, CommandType::DELETE_NETWORK, 200, 400},
 
     // reboots via POST
-    routes.emplace("/api/reboot/device/", RequestBaseData(GET_METHOD, CommandType::RESTART_DEVICE, 200, 500));
+    Route{"/api/reboot/device/", GET_METHOD, CommandType::RESTART_DEVICE, 200, 500},
 
     // heartbeat via GET
-    routes.emplace("/api/ping/", RequestBaseData(GET_METHOD, CommandType::PING, 200, 400));
+    Route{"/api/ping/", GET_METHOD, CommandType::PING, 200, 400},
+});
+static_assert(routesAreUnique(ROUTES), "two routes with the same path");
+
+RestAPI::RestAPI(std::string url, std::shared_ptr<CommandManager> commandManager) : command_manager(commandManager)
+{
+    this->url = std::move(url);
+}
+
+static const Route* findRoute(std::string_view path)
+{
+    const auto route = std::lower_bound(ROUTES.begin(), ROUTES.end(), path, [](const Route& route, std::string_view path) { return route.path < path; });
+    return route != ROUTES.end() && route->path == path ? &*route : nullptr;
+}
+
+// a GET has no body, so /api/get/job/?id=N becomes the {"id":N} the command takes.
+// An id that isn't a number goes through as null and the command answers it with an error
+static std::string_view jobStatusPayload(const mg_str& query, char* buffer, size_t size)
+{
+    char id[16];
+    const int length = mg_http_get_var(&query, "id", id, sizeof(id));
+    // -1 is no query at all, -4 a query without an id
+    if (length == -1 || length == -4)
+        return {};
+    const bool number = length > 0 && std::all_of(id, id + length, [](char c) { return c >= '0' && c <= '9'; });
+    const int written = snprintf(buffer, size, "{\"id\":%s}", number ? id : "null");
+    return std::string_view(buffer, static_cast<size_t>(written));
 }
 
 void RestAPI::begin()
 {
-    mg_log_set(MG_LL_DEBUG);
+    // debug logging prints a few lines per request over the console, which costs more than the request itself
+    mg_log_set(MG_LL_ERROR);
     mg_mgr_init(&mgr);
     // every route is handled through this class, with commands themselves by a command manager
     // hence we pass a pointer to this in mg_http_listen
-    mg_http_listen(&mgr, this->url.c_str(), (mg_event_handler_t)RestAPIHelpers::event_handler, this);
+    this->listener = mg_http_listen(&mgr, this->url.c_str(), (mg_event_handler_t)RestAPIHelpers::event_handler, this);
+    if (this->listener == nullptr)
+        ESP_LOGE("[RestAPI]", "Failed to listen on %s", this->url.c_str());
+    // other tasks have things to send too (frames, log lines), the pipe lets them cut the select() short
+    if (!mg_wakeup_init(&mgr))
+        ESP_LOGE("[RestAPI]", "Failed to set up the wake-up pipe");
+}
+
+bool RestAPI::listen(const char* url)
+{
+    if (mg_http_listen(&mgr, url, (mg_event_handler_t)RestAPIHelpers::event_handler, this) == nullptr)
+    {
+        ESP_LOGE("[RestAPI]", "Failed to listen on %s", url);
+        return false;
+    }
+    return true;
+}
+
+bool RestAPI::addHandler(std::string_view path, ConnectionHandler handler, void* context)
+{
+    for (size_t i = 0; i < this->handler_count; i++)
+    {
+        if (this->handlers[i].path == path)
+        {
+            this->handlers[i] = ConnectionHandlerData{path, handler, context};
+            return true;
+        }
+    }
+    if (this->handler_count == MAX_HANDLERS)
+    {
+        ESP_LOGE("[RestAPI]", "No room for a handler on %.*s", static_cast<int>(path.size()), path.data());
+        return false;
+    }
+    this->handlers[this->handler_count++] = ConnectionHandlerData{path, handler, context};
+    return true;
+}
+
+void RestAPI::wake()
+{
+    // the listener only stands in as the target, it ignores the wake-up, select() returning is the point
+    if (this->listener != nullptr)
+        mg_wakeup(&mgr, this->listener->id, "", 0);
+}
+
+uint16_t RestAPI::port() const
+{
+    return this->listener != nullptr ? mg_ntohs(this->listener->loc.port) : 0;
 }
 
 void RestAPI::handle_request(struct mg_connection* connection, int event, void* event_data)
 {
+    // clients like the tuning UI keep their connection open between requests, that's what makes them cheap,
+    // but one that went away without closing would hold on to its socket forever
+    if (event == MG_EV_ACCEPT || event == MG_EV_READ)
+    {
+        touchConnection(connection, mg_millis());
+        return;
+    }
+    if (event == MG_EV_POLL)
+    {
+        const uint64_t now = *static_cast<uint64_t*>(event_data);
+        if (!connection->is_listening && now - lastActivity(connection) > IDLE_TIMEOUT_MS)
+            connection->is_draining = 1;
+        return;
+    }
+
     if (event == MG_EV_HTTP_MSG)
     {
-        auto const* message = static_cast<struct mg_http_message*>(event_data);
-        auto const uri = std::string(message->uri.buf, message->uri.len);
+        auto* message = static_cast<struct mg_http_message*>(event_data);
+        // everything stays a view into the connection's receive buffer, mongoose drops the request from it once we return
+        const std::string_view uri(message->uri.buf, message->uri.len);
 
-        if (this->routes.find(uri) == this->routes.end())
+        for (size_t i = 0; i < this->handler_count; i++)
+        {
+            if (this->handlers[i].path == uri)
+            {
+                this->handlers[i].handler(connection, message, this->handlers[i].context);
+                return;
+            }
+        }
+
+        const Route* route = findRoute(uri);
+        if (route == nullptr)
         {
             mg_http_reply(connection, 404, "", "Wrong URL");
             return;
         }
 
-        auto const base_request_params = this->routes.at(uri);
+        std::string_view body(message->body.buf, message->body.len);
+        char query_payload[32];
+        if (route->command_type == CommandType::GET_JOB_STATUS)
+            body = jobStatusPayload(message->query, query_payload, sizeof(query_payload));
 
-        auto* context = new RequestContext{
+        const RequestContext context{
             .connection = connection,
-            .method = std::string(message->method.buf, message->method.len),
-            .body = std::string(message->body.buf, message->body.len),
+            .method = std::string_view(message->method.buf, message->method.len),
+            .body = body,
         };
-        this->handle_endpoint_command(context, base_request_params.allowed_method, base_request_params.command_type, base_request_params.success_code,
-                                      base_request_params.error_code);
+        this->handle_endpoint_command(context, *route);
     }
 }
 
@@ -115,30 +268,46 @@ void RestAPIHelpers::event_handler(struct mg_connection* connection, int event,
     rest_api_handler->handle_request(connection, event, event_data);
 }
 
-void RestAPI::poll()
+void RestAPI::poll(int timeout_ms)
 {
-    mg_mgr_poll(&mgr, 100);
+    // mongoose sits in select() on all of its sockets, so this returns as soon as a request comes in,
+    // and right after handling it the socket is writable and the next call sends the response out
+    mg_mgr_poll(&mgr, timeout_ms);
 }
 
 void HandleRestAPIPollTask(void* pvParameter)
 {
     auto* rest_api_handler = static_cast<RestAPI*>(pvParameter);
+    // no delay between polls, the blocking select is what keeps this task asleep
     while (true)
     {
         rest_api_handler->poll();
-        vTaskDelay(1000);
     }
 }
 
-void RestAPI::handle_endpoint_command(RequestContext* context, std::string allowed_method, CommandType command_type, int success_code, int error_code)
+void RestAPI::handle_endpoint_command(const RequestContext& context, const Route& route)
 {
-    if (context->method != allowed_method)
+    if (context.method != route.method)
     {
-        mg_http_reply(context->connection, 401, JSON_RESPONSE, "{%m:%m}", MG_ESC("error"), "Method not allowed");
+        mg_http_reply(context.connection, 401, JSON_RESPONSE, "{%m:%m}", MG_ESC("error"), MG_ESC("Method not allowed"));
         return;
     }
 
-    const nlohmann::json result = command_manager->executeFromType(command_type, context->body);
-    const auto code = getIsSuccess(result) ? success_code : error_code;
-    mg_http_reply(context->connection, code, JSON_RESPONSE, result.dump().c_str());
+    // the status code depends on how the command went, so the body goes out first
+    // and the headers get slotted in front of it once we know
+    mg_connection* connection = context.connection;
+    const size_t body_start = connection->send.len;
+
+    MongooseSink sink(connection);
+    ResponseWriter writer(sink);
+    const bool success = command_manager->executeFromType(route.command_type, context.body, writer);
+    writer.flush();
+
+    const auto code = success ? route.success_code : route.error_code;
+    char headers[128];
+    const int headers_length = snprintf(headers, sizeof(headers), "HTTP/1.1 %d %s\r\n" JSON_RESPONSE "Content-Length: %u\r\n\r\n", code, getStatusText(code),
+                                        static_cast<unsigned>(writer.bytesWritten()));
+    mg_iobuf_add(&connection->send, body_start, headers, headers_length);
+    // mg_http_reply does this for us, mongoose doesn't parse the next request on a keep-alive connection until it's cleared
+    connection->is_resp = 0;
 }
\ No newline at end of file
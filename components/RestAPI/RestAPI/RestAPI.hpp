@@ -3,49 +3,85 @@
 #define RESTAPI_HPP
 #include <mongoose.h>
 #include <CommandManager.hpp>
+#include <array>
 #include <memory>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 
 #include "esp_log.h"
 
 #define JSON_RESPONSE "Content-Type: application/json\r\n"
 
+// views into the request mongoose holds in the connection's receive buffer, only good while it's being handled
 struct RequestContext
 {
     mg_connection* connection;
-    std::string method;
-    std::string body;
+    std::string_view method;
+    std::string_view body;
 };
 
-struct RequestBaseData
+struct Route
 {
-    std::string allowed_method;
+    std::string_view path;
+    std::string_view method;
     CommandType command_type;
     int success_code;
     int error_code;
-    RequestBaseData(std::string allowed_method, CommandType command_type, int success_code, int error_code)
-        : allowed_method(allowed_method), command_type(command_type), success_code(success_code), error_code(error_code) {};
 };
 
+// takes over a connection for a path that isn't a command, like the stream or the log socket.
+// Called with the request that came in, it can answer it and switch connection->fn to its own handler
+// to keep getting that connection's events
+typedef void (*ConnectionHandler)(mg_connection* connection, mg_http_message* message, void* context);
+
+struct ConnectionHandlerData
+{
+    std::string_view path;
+    ConnectionHandler handler;
+    void* context;
+};
+
+// The device's only HTTP server. One mongoose manager, one task, every port that gets listen()ed on
+// serves the same paths: the command routes in RestAPI.cpp plus whatever other components add with addHandler().
 class RestAPI
 {
-    typedef std::unordered_map<std::string, RequestBaseData> route_map;
+    // "/" and "/ws" so far
+    static constexpr size_t MAX_HANDLERS = 4;
+
     std::string url;
-    route_map routes;
+    // the command routes are a constexpr table in RestAPI.cpp, these are the ones added at runtime
+    std::array<ConnectionHandlerData, MAX_HANDLERS> handlers{};
+    size_t handler_count = 0;
 
     mg_mgr mgr;
+    mg_connection* listener = nullptr;
     std::shared_ptr<CommandManager> command_manager;
 
    private:
-    void handle_endpoint_command(RequestContext* context, std::string allowed_method, CommandType command_type, int success_code, int error_code);
+    void handle_endpoint_command(const RequestContext& context, const Route& route);
 
    public:
+    // how long poll() blocks when no socket has anything to do, requests don't wait for it,
+    // it only bounds how often idle keep-alive connections get checked
+    static constexpr int POLL_TIMEOUT_MS = 1000;
+    // keep-alive connections nobody used for this long get closed, lwip only has a handful of sockets
+    static constexpr uint64_t IDLE_TIMEOUT_MS = 30000;
+
     // this will also need command manager
     RestAPI(std::string url, std::shared_ptr<CommandManager> command_manager);
     void begin();
+    // another port on the same loop, returns false if it couldn't listen
+    bool listen(const char* url);
+    // handler gets every request for exactly this path, on every port. path isn't copied, it has to outlive
+    // the server (a literal), returns false once MAX_HANDLERS are taken
+    bool addHandler(std::string_view path, ConnectionHandler handler, void* context);
+    // gets poll() out of its wait from any task, e.g. once a new frame is there to send
+    void wake();
     void handle_request(struct mg_connection* connection, int event, void* event_data);
-    void poll();
+    // waits until a socket is ready (or timeout_ms passed) and handles whatever came in
+    void poll(int timeout_ms = POLL_TIMEOUT_MS);
+    // the port we ended up listening on, useful with port 0
+    uint16_t port() const;
 };
 
 namespace RestAPIHelpers
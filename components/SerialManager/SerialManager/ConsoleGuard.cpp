@@ -0,0 +1,117 @@
+#include "ConsoleGuard.hpp"
+#include <cstdio>
+#include <cstring>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+namespace
+{
+// a wifi scan logs a handful of lines, a long response shouldn't cost us any of them
+constexpr size_t HELD_SIZE = 2048;
+
+// only guards the bookkeeping, nobody prints while holding it so a logging task never waits for the console
+SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+vprintf_like_t previous = nullptr;
+bool holding = false;
+// lines going to the console right now, directly or replayed, a response doesn't start before they're out
+size_t printing = 0;
+// one NUL terminated line per log call, LogManager picks the level of what it gets from the start of the text
+char held[HELD_SIZE];
+size_t held_length = 0;
+size_t dropped = 0;
+
+int print(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    const int written = previous(format, args);
+    va_end(args);
+    return written;
+}
+
+void donePrinting()
+{
+    xSemaphoreTake(lock, portMAX_DELAY);
+    printing--;
+    xSemaphoreGive(lock);
+}
+}  // namespace
+
+void ConsoleGuard::install()
+{
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (previous == nullptr)
+        previous = esp_log_set_vprintf(&ConsoleGuard::logHook);
+    xSemaphoreGive(lock);
+}
+
+ConsoleGuard::ConsoleGuard()
+{
+    xSemaphoreTake(lock, portMAX_DELAY);
+    holding = previous != nullptr;
+    xSemaphoreGive(lock);
+
+    // a log line that's being printed right now finishes before the response starts, new ones get held
+    while (true)
+    {
+        xSemaphoreTake(lock, portMAX_DELAY);
+        const bool idle = printing == 0;
+        xSemaphoreGive(lock);
+        if (idle)
+            break;
+        vTaskDelay(1);
+    }
+}
+
+ConsoleGuard::~ConsoleGuard()
+{
+    // nothing is added to held once holding is off, and the next guard waits for the replay to finish,
+    // so the buffer can be read after letting go of the lock
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (!holding)
+    {
+        xSemaphoreGive(lock);
+        return;
+    }
+    holding = false;
+    const size_t length = held_length;
+    const size_t dropped_lines = dropped;
+    held_length = 0;
+    dropped = 0;
+    printing++;
+    xSemaphoreGive(lock);
+
+    // one call per line, the way they were logged
+    for (size_t offset = 0; offset < length; offset += std::strlen(held + offset) + 1)
+        print("%s", held + offset);
+    if (dropped_lines > 0)
+        print("[CONSOLE] %u log lines dropped while a response went out\n", static_cast<unsigned>(dropped_lines));
+    donePrinting();
+}
+
+int ConsoleGuard::logHook(const char* format, va_list args)
+{
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (!holding)
+    {
+        printing++;
+        xSemaphoreGive(lock);
+        const int written = previous(format, args);
+        donePrinting();
+        return written;
+    }
+
+    // a line that doesn't fit anymore is dropped whole, half a line would only confuse whoever reads it
+    const size_t room = HELD_SIZE - held_length;
+    const int length = vsnprintf(held + held_length, room, format, args);
+    if (length < 0 || static_cast<size_t>(length) >= room)
+    {
+        dropped++;
+        xSemaphoreGive(lock);
+        return 0;
+    }
+    held_length += length + 1;
+    xSemaphoreGive(lock);
+    return length;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#ifndef CONSOLE_GUARD_HPP
+#define CONSOLE_GUARD_HPP
+
+#include <cstdarg>
+#include "esp_log.h"
+
+// The serial transport and esp_log share the console. A log line from another task - the job worker
+// scanning, the camera - written while a response is going out lands in the middle of that response
+// and the host can parse neither of them.
+// While a ConsoleGuard is alive log output is held back, it goes out once the guard is gone, between
+// two responses. Whoever logs never waits for a response to finish, past a couple of KB lines get dropped.
+class ConsoleGuard
+{
+   public:
+    // hooks esp_log, whatever was hooked before (LogManager) still gets every line, the held ones once they go out
+    static void install();
+
+    ConsoleGuard();
+    ~ConsoleGuard();
+    ConsoleGuard(const ConsoleGuard&) = delete;
+    ConsoleGuard& operator=(const ConsoleGuard&) = delete;
+
+   private:
+    static int logHook(const char* format, va_list args);
+};
+
+#endif
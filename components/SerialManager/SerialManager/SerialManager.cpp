@@ -3,10 +3,12 @@
 #include "main_globals.hpp"
 
 SerialManager::SerialManager(std::shared_ptr<CommandManager> commandManager, esp_timer_handle_t* timerHandle)
-    : commandManager(commandManager), timerHandle(timerHandle)
+    : commandManager(commandManager),
+      timerHandle(timerHandle),
+      data(static_cast<uint8_t*>(malloc(BUF_SIZE))),
+      temp_data(static_cast<uint8_t*>(malloc(BUF_SIZE))),
+      protocol(*commandManager, data, BUF_SIZE)
 {
-    this->data = static_cast<uint8_t*>(malloc(BUF_SIZE));
-    this->temp_data = static_cast<uint8_t*>(malloc(BUF_SIZE));
 }
 
 // Function to notify that a command was received during startup
@@ -28,6 +30,8 @@ void SerialManager::notify_startup_command_received()
 void HandleSerialManagerTask(void* pvParameters)
 {
     auto const serialManager = static_cast<SerialManager*>(pvParameters);
+    // responses and logs share this console, see ConsoleGuard
+    ConsoleGuard::install();
     while (true)
     {
         serialManager->try_receive();
@@ -4,7 +4,9 @@
 
 #include <stdio.h>
 #include <CommandManager.hpp>
+#include <ConsoleGuard.hpp>
 #include <ProjectConfig.hpp>
+#include <SerialProtocol.hpp>
 #include <memory>
 #include <string>
 #include "driver/gpio.h"
@@ -45,6 +47,8 @@ class SerialManager
     esp_timer_handle_t* timerHandle;
     uint8_t* data;
     uint8_t* temp_data;
+    // json lines and binary frames, assembled in data
+    SerialProtocol protocol;
 };
 
 void HandleSerialManagerTask(void* pvParameters);
@@ -32,54 +32,48 @@ void SerialManager::setup()
     }
 }
 
-void uart_write_bytes_chunked(uart_port_t uart_num, const void* src, size_t size)
+// the response goes out in writer sized chunks, uart_write_bytes blocks until each one is queued
+class UartSink : public ResponseSink
 {
-    while (size > 0)
+   public:
+    explicit UartSink(uart_port_t uart_num) : uart_num(uart_num) {}
+
+    void write(const char* data, size_t length) override
     {
-        auto to_write = size > BUF_SIZE ? BUF_SIZE : size;
-        auto written = uart_write_bytes(uart_num, src, to_write);
-        src += written;
-        size -= written;
+        uart_write_bytes(this->uart_num, data, length);
     }
-}
+
+   private:
+    uart_port_t uart_num;
+};
 
 void SerialManager::try_receive()
 {
-    static auto current_position = 0;
     const auto uart_num = static_cast<uart_port_t>(CONFIG_UART_PORT_NUMBER);
     int len = uart_read_bytes(uart_num, this->temp_data, BUF_SIZE, 1000 / 20);
 
     // If driver is uninstalled or an error occurs, abort read gracefully
-    if (len <= 0)
+    if (len < 0)
     {
         return;
     }
 
-    if (len > 0)
+    UartSink sink(uart_num);
+    if (len == 0)
     {
-        notify_startup_command_received();
+        this->protocol.idle();
+        ConsoleGuard guard;
+        this->protocol.poll(sink);
+        return;
     }
 
-    // since we've got something on the serial port
-    // we gotta keep reading until we've got the whole message
-    // we will submit the command once we get a newline, a return or the buffer is full
-    for (auto i = 0; i < len; i++)
-    {
-        this->data[current_position++] = this->temp_data[i];
-        // if we're at the end of the buffer, try to process the command anyway
-        // if we've got a new line, we've finished sending the commands, process them
-        if (current_position >= BUF_SIZE || this->data[current_position - 1] == '\n' || this->data[current_position - 1] == '\r')
-        {
-            data[current_position - 1] = '\0';
-            current_position = 0;
-
-            const nlohmann::json result = this->commandManager->executeFromJson(std::string_view(reinterpret_cast<const char*>(this->data)));
-            const auto resultMessage = result.dump();
-            // todo check if this works
-            // uart_write_bytes_chunked(uart_num, resultMessage.c_str(), resultMessage.length())s
-            uart_write_bytes(uart_num, resultMessage.c_str(), resultMessage.length());
-        }
-    }
+    notify_startup_command_received();
+
+    // lines and frames can arrive in pieces, the protocol keeps whatever is incomplete for the next read
+    // logs wait until the answers are out in case the console is on this uart
+    ConsoleGuard guard;
+    this->protocol.receive(this->temp_data, len, sink);
+    this->protocol.poll(sink);
 }
 
 void SerialManager::shutdown()
@@ -2,6 +2,7 @@
 #include "driver/usb_serial_jtag.h"
 #include "esp_log.h"
 #include "esp_vfs_usb_serial_jtag.h"
+#include "freertos/semphr.h"
 #include "main_globals.hpp"
 #include "soc/usb_serial_jtag_reg.h"
 
@@ -38,9 +39,43 @@ void usb_serial_jtag_write_bytes_chunked(const char* data, size_t len, size_t ti
 #endif
 }
 
+class UsbSerialJtagSink : public ResponseSink
+{
+   public:
+    void write(const char* data, size_t length) override
+    {
+        usb_serial_jtag_write_bytes_chunked(data, length, 1000 / 20);
+    }
+};
+
+// tud_cdc_write only takes what fits into the tx fifo, so keep pushing until the chunk is out
+// if the host stops reading we give up after a while instead of blocking the task forever
+class CdcSink : public ResponseSink
+{
+   public:
+    void write(const char* data, size_t length) override
+    {
+        int stalled_ms = 0;
+        while (length > 0 && stalled_ms < CDC_WRITE_TIMEOUT_MS)
+        {
+            const auto written = tud_cdc_write(data, length);
+            data += written;
+            length -= written;
+            if (length > 0)
+            {
+                tud_cdc_write_flush();
+                vTaskDelay(pdMS_TO_TICKS(1));
+                stalled_ms = written > 0 ? 0 : stalled_ms + 1;
+            }
+        }
+    }
+
+   private:
+    static constexpr int CDC_WRITE_TIMEOUT_MS = 200;
+};
+
 void SerialManager::try_receive()
 {
-    static auto current_position = 0;
     int len = usb_serial_jtag_read_bytes(this->temp_data, 256, 1000 / 20);
 
     // If driver is uninstalled or an error occurs, abort read gracefully
@@ -49,34 +84,23 @@ void SerialManager::try_receive()
         return;
     }
 
-    if (len > 0)
+    UsbSerialJtagSink sink;
+    if (len == 0)
     {
-        // Notify main that a command was received during startup
-        notify_startup_command_received();
+        this->protocol.idle();
+        ConsoleGuard guard;
+        this->protocol.poll(sink);
+        return;
     }
 
-    // since we've got something on the serial port
-    // we gotta keep reading until we've got the whole message
-    // we will submit the command once we get a newline, a return or the buffer is full
-    for (auto i = 0; i < len; i++)
-    {
-        const char c = this->temp_data[i];
+    // Notify main that a command was received during startup
+    notify_startup_command_received();
 
-        if (current_position >= BUF_SIZE - 1 || c == '\n' || c == '\r')
-        {
-            this->data[current_position] = '\0';
-            if (current_position > 0)
-            {
-                const nlohmann::json result = this->commandManager->executeFromJson(std::string_view(reinterpret_cast<const char*>(this->data)));
-                const auto resultMessage = result.dump() + "\n";
-                usb_serial_jtag_write_bytes_chunked(resultMessage.c_str(), resultMessage.length(), 1000 / 20);
-            }
-            current_position = 0;
-            continue;
-        }
-
-        this->data[current_position++] = c;
-    }
+    // lines and frames can arrive in pieces, the protocol keeps whatever is incomplete for the next read
+    // logs wait until the answers are out, the console is the same usb-jtag port
+    ConsoleGuard guard;
+    this->protocol.receive(this->temp_data, len, sink);
+    this->protocol.poll(sink);
 }
 
 void SerialManager::shutdown()
@@ -102,39 +126,56 @@ void SerialManager::shutdown()
     CLEAR_PERI_REG_MASK(USB_SERIAL_JTAG_CONF0_REG, USB_SERIAL_JTAG_DP_PULLUP);
 }
 
+// both the tinyusb task and the serial task pump, a chunk read by one of them has to be queued before the other
+// reads the next one, or lines and frames come out of the queue shuffled
+static SemaphoreHandle_t cdc_rx_lock = xSemaphoreCreateMutex();
+
+// moves what tinyusb has buffered into the queue, but only as much as the queue has room for
+// the rest stays in the cdc fifo, once that fills up the host gets NAKed and waits instead of us dropping bytes
+static void pump_cdc_rx()
+{
+    xSemaphoreTake(cdc_rx_lock, portMAX_DELAY);
+    cdc_command_packet_t packet;
+    while (tud_cdc_available() > 0 && uxQueueSpacesAvailable(cdcMessageQueue) > 0)
+    {
+        const auto read = tud_cdc_read(packet.data, sizeof(packet.data));
+        if (read == 0)
+        {
+            break;
+        }
+
+        // we should be safe here, given that the max buffer size is 64
+        packet.len = static_cast<uint8_t>(read);
+        xQueueSend(cdcMessageQueue, &packet, 0);
+    }
+    xSemaphoreGive(cdc_rx_lock);
+}
+
 void HandleCDCSerialManagerTask(void* pvParameters)
 {
 #ifndef CONFIG_USE_UART_FOR_COMMUNICATION
     auto const commandManager = static_cast<CommandManager*>(pvParameters);
-    static char buffer[BUF_SIZE];
-    auto idx = 0;
+    static uint8_t buffer[BUF_SIZE];
+    static SerialProtocol protocol(*commandManager, buffer, sizeof(buffer));
 
     cdc_command_packet_t packet;
     while (true)
     {
-        if (xQueueReceive(cdcMessageQueue, &packet, portMAX_DELAY) == pdTRUE)
+        CdcSink sink;
+        if (xQueueReceive(cdcMessageQueue, &packet, pdMS_TO_TICKS(100)) != pdTRUE)
         {
-            for (auto i = 0; i < packet.len; i++)
-            {
-                const char c = packet.data[i];
-
-                if (idx >= BUF_SIZE - 1 || c == '\n' || c == '\r')
-                {
-                    buffer[idx] = '\0';
-                    if (idx > 0)
-                    {
-                        const nlohmann::json result = commandManager->executeFromJson(std::string_view(reinterpret_cast<const char*>(buffer)));
-                        const auto resultMessage = result.dump() + "\n";
-                        tud_cdc_write(resultMessage.c_str(), resultMessage.length());
-                        tud_cdc_write_flush();
-                    }
-                    idx = 0;
-                    continue;
-                }
-
-                buffer[idx++] = c;
-            }
+            protocol.idle();
+            protocol.poll(sink);
+            tud_cdc_write_flush();
+            continue;
         }
+
+        protocol.receive(packet.data, packet.len, sink);
+        protocol.poll(sink);
+        tud_cdc_write_flush();
+
+        // we've made room in the queue, pick up whatever was left waiting in the fifo
+        pump_cdc_rx();
     }
 #endif
 }
@@ -146,19 +187,7 @@ extern "C" void tud_cdc_rx_cb(uint8_t itf)
 {
     // we can void the interface number
     (void)itf;
-    cdc_command_packet_t packet;
-    auto len = tud_cdc_available();
-
-    if (len > 0)
-    {
-        auto read = tud_cdc_read(packet.data, sizeof(packet.data));
-        if (read > 0)
-        {
-            // we should be safe here, given that the max buffer size is 64
-            packet.len = static_cast<uint8_t>(read);
-            xQueueSend(cdcMessageQueue, &packet, 1);
-        }
-    }
+    pump_cdc_rx();
 }
 
 extern "C" void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts)
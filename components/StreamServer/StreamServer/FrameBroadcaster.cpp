@@ -0,0 +1,274 @@
+#include "FrameBroadcaster.hpp"
+#include <helpers.hpp>
+
+static const char* BROADCASTER_TAG = "[FRAME_BROADCASTER]";
+
+FrameBroadcaster::FrameBroadcaster() {}
+
+esp_err_t FrameBroadcaster::init()
+{
+    if (this->lock != nullptr)
+        return ESP_OK;
+
+    this->lock = xSemaphoreCreateMutex();
+    if (this->lock == nullptr)
+    {
+        ESP_LOGE(BROADCASTER_TAG, "Failed to create subscriber lock");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+SubscriberHandle FrameBroadcaster::subscribe(int* active_count)
+{
+    if (this->lock == nullptr)
+        return INVALID_SUBSCRIBER;
+
+    SubscriberHandle handle = INVALID_SUBSCRIBER;
+    bool producer_failed = false;
+    xSemaphoreTake(this->lock, portMAX_DELAY);
+    for (int i = 0; i < MAX_SUBSCRIBERS; i++)
+    {
+        if (this->subscribers[i].active)
+            continue;
+
+        QueueHandle_t queue = xQueueCreate(1, sizeof(SharedFrame*));
+        if (queue == nullptr)
+            break;
+
+        this->subscribers[i].queue = queue;
+        this->subscribers[i].dropped = 0;
+        this->subscribers[i].active = true;
+        ++this->subscriber_count;
+        handle = i;
+        break;
+    }
+
+    // still under the lock, two clients connecting at once must not start two producers on the one camera
+    if (handle != INVALID_SUBSCRIBER && this->producer_handle == nullptr)
+    {
+        // same priority as the server task so neither side starves the other
+        if (xTaskCreate(&FrameBroadcaster::producerTask, "FrameProducer", 4096, this, tskIDLE_PRIORITY + 5, &this->producer_handle) != pdPASS)
+        {
+            this->producer_handle = nullptr;
+            vQueueDelete(this->subscribers[handle].queue);
+            this->subscribers[handle].queue = nullptr;
+            this->subscribers[handle].active = false;
+            --this->subscriber_count;
+            handle = INVALID_SUBSCRIBER;
+            producer_failed = true;
+        }
+    }
+    else if (handle != INVALID_SUBSCRIBER)
+    {
+        xTaskNotifyGive(this->producer_handle);
+    }
+    const int active = this->subscriber_count.load();
+    xSemaphoreGive(this->lock);
+
+    if (active_count)
+        *active_count = active;
+
+    if (producer_failed)
+    {
+        ESP_LOGE(BROADCASTER_TAG, "Failed to start the frame producer");
+        return INVALID_SUBSCRIBER;
+    }
+    if (handle == INVALID_SUBSCRIBER)
+    {
+        ESP_LOGW(BROADCASTER_TAG, "No free subscriber slots (max %d)", MAX_SUBSCRIBERS);
+        return INVALID_SUBSCRIBER;
+    }
+
+    ESP_LOGI(BROADCASTER_TAG, "Client %d subscribed, %d active", handle, active);
+    return handle;
+}
+
+int FrameBroadcaster::unsubscribe(SubscriberHandle handle)
+{
+    if (handle < 0 || handle >= MAX_SUBSCRIBERS)
+        return this->subscriber_count.load();
+
+    xSemaphoreTake(this->lock, portMAX_DELAY);
+    Subscriber& subscriber = this->subscribers[handle];
+    if (!subscriber.active)
+    {
+        xSemaphoreGive(this->lock);
+        return this->subscriber_count.load();
+    }
+
+    subscriber.active = false;
+    const int remaining = --this->subscriber_count;
+
+    // give back whatever was still waiting for this client
+    SharedFrame* pending = nullptr;
+    while (xQueueReceive(subscriber.queue, &pending, 0) == pdTRUE)
+        this->release(pending);
+
+    vQueueDelete(subscriber.queue);
+    subscriber.queue = nullptr;
+    const uint32_t dropped = subscriber.dropped;
+    xSemaphoreGive(this->lock);
+
+    ESP_LOGI(BROADCASTER_TAG, "Client %d unsubscribed (%lu frames dropped), %d active", handle, dropped, remaining);
+    return remaining;
+}
+
+SharedFrame* FrameBroadcaster::next(SubscriberHandle handle, TickType_t timeout)
+{
+    if (handle < 0 || handle >= MAX_SUBSCRIBERS)
+        return nullptr;
+
+    // only the owning client reads its queue, and it only gets deleted by that same client
+    QueueHandle_t queue = this->subscribers[handle].queue;
+    if (queue == nullptr)
+        return nullptr;
+
+    SharedFrame* frame = nullptr;
+    if (xQueueReceive(queue, &frame, timeout) != pdTRUE)
+        return nullptr;
+
+    return frame;
+}
+
+void FrameBroadcaster::release(SharedFrame* frame)
+{
+    if (frame == nullptr)
+        return;
+
+    if (frame->refs.fetch_sub(1) == 1)
+    {
+        esp_camera_fb_return(frame->fb);
+        frame->fb = nullptr;
+        frame->in_use.store(false);
+    }
+}
+
+void FrameBroadcaster::setFrameListener(void (*listener)(void* arg), void* arg)
+{
+    this->frame_listener_arg = arg;
+    this->frame_listener = listener;
+}
+
+SharedFrame* FrameBroadcaster::acquireSlot(camera_fb_t* fb)
+{
+    for (auto& slot : this->pool)
+    {
+        bool expected = false;
+        if (slot.in_use.compare_exchange_strong(expected, true))
+        {
+            slot.fb = fb;
+            camera_fb_timing_t timing = {};
+            esp_camera_fb_get_timing(fb, &timing);
+            slot.timing = {
+                .vsync_us = timing.vsync_us,
+                .eof_us = timing.eof_us,
+                .taken_us = timing.taken_us,
+            };
+            slot.metadata = FrameMetadata::capture(timing.sequence);
+            // this one belongs to the producer, it drops it right after publishing
+            slot.refs.store(1);
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+void FrameBroadcaster::publish(SharedFrame* frame)
+{
+    xSemaphoreTake(this->lock, portMAX_DELAY);
+    for (auto& subscriber : this->subscribers)
+    {
+        if (!subscriber.active)
+            continue;
+
+        // drop the oldest, a slow client should see the newest frame next and not a backlog
+        SharedFrame* stale = nullptr;
+        if (xQueueReceive(subscriber.queue, &stale, 0) == pdTRUE)
+        {
+            subscriber.dropped++;
+            this->release(stale);
+        }
+
+        frame->refs.fetch_add(1);
+        if (xQueueSend(subscriber.queue, &frame, 0) != pdTRUE)
+            frame->refs.fetch_sub(1);
+    }
+    xSemaphoreGive(this->lock);
+
+    this->release(frame);
+
+    if (this->frame_listener)
+        this->frame_listener(this->frame_listener_arg);
+}
+
+void FrameBroadcaster::producerTask(void* arg)
+{
+    static_cast<FrameBroadcaster*>(arg)->produce();
+}
+
+void FrameBroadcaster::produce()
+{
+    long last_window_start = 0;
+    int frame_count = 0;
+    // the rate control only ever gets frames from this task, so it starts over here too
+    JpegRateControl::controller().restart();
+
+    while (true)
+    {
+        if (this->subscriber_count.load() == 0)
+        {
+            // nobody is watching, don't keep the camera busy
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            last_window_start = 0;
+            frame_count = 0;
+            JpegRateControl::controller().restart();
+            continue;
+        }
+
+        camera_fb_t* fb = esp_camera_fb_get();
+        camera_jpeg_stats_t jpeg_stats = {};
+        esp_camera_get_jpeg_stats(&jpeg_stats);
+        if (!fb)
+        {
+            ESP_LOGE(BROADCASTER_TAG, "Camera capture failed");
+            JpegRateControl::controller().onCaptureFailed(jpeg_stats.fb_overflows);
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        JpegRateControl::controller().onFrame(fb->len, fb->timestamp.tv_sec * 1000000LL + fb->timestamp.tv_usec, jpeg_stats.fb_overflows);
+
+        const size_t frame_len = fb->len;
+        SharedFrame* frame = this->acquireSlot(fb);
+        if (frame == nullptr)
+        {
+            ESP_LOGW(BROADCASTER_TAG, "Frame pool exhausted, dropping frame");
+            esp_camera_fb_return(fb);
+            continue;
+        }
+
+        this->publish(frame);
+
+        if (esp_log_level_get(BROADCASTER_TAG) >= ESP_LOG_INFO)
+        {
+            if (last_window_start == 0)
+                last_window_start = Helpers::getTimeInMillis();
+
+            // Only log every 100 frames to reduce overhead
+            const int frame_window = 100;
+            if (++frame_count % frame_window == 0)
+            {
+                long window_end = Helpers::getTimeInMillis();
+                long window_ms = window_end - last_window_start;
+                last_window_start = window_end;
+                long fps = 0;
+                if (window_ms > 0)
+                {
+                    fps = (frame_window * 1000) / window_ms;
+                }
+                ESP_LOGI(BROADCASTER_TAG, "%i Frames Size: %uKB, Time: %lims (%lifps), clients: %d", frame_window, frame_len / 1024, window_ms, fps,
+                         this->subscriber_count.load());
+            }
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#ifndef FRAMEBROADCASTER_HPP
+#define FRAMEBROADCASTER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <FrameMetadata.hpp>
+#include <FrameTelemetry.hpp>
+#include <JpegRateControl.hpp>
+#include "esp_camera.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#ifndef CONFIG_STREAM_SERVER_MAX_CLIENTS
+#define CONFIG_STREAM_SERVER_MAX_CLIENTS 4
+#endif
+
+// A camera frame shared between every connected stream client.
+// The producer grabs it once, every subscriber that gets it holds a reference,
+// the camera buffer goes back to the driver once the last one lets go.
+struct SharedFrame
+{
+    camera_fb_t* fb = nullptr;
+    // camera side timestamps, every client adds its own send times to a copy
+    FrameTelemetry::FrameTiming timing;
+    // exposure, gain and illuminator when the frame was grabbed, the same for every client
+    FrameMetadata::Record metadata;
+    std::atomic<int> refs{0};
+    std::atomic<bool> in_use{false};
+};
+
+using SubscriberHandle = int;
+constexpr SubscriberHandle INVALID_SUBSCRIBER = -1;
+
+class FrameBroadcaster
+{
+   public:
+    static constexpr int MAX_SUBSCRIBERS = CONFIG_STREAM_SERVER_MAX_CLIENTS;
+    // every live SharedFrame pins one camera buffer, so this only has to cover fb_count
+    static constexpr int FRAME_POOL_SIZE = 8;
+
+    FrameBroadcaster();
+    // the broadcaster lives in static storage, so the rtos bits get created once the scheduler runs
+    esp_err_t init();
+
+    // registers a new client, starts pulling frames from the camera if it's the first one
+    // returns INVALID_SUBSCRIBER when all slots are taken, active_count gets the number of clients including this one
+    SubscriberHandle subscribe(int* active_count = nullptr);
+    // returns how many clients are left
+    int unsubscribe(SubscriberHandle handle);
+
+    // blocks until the next frame for this client arrives, nullptr on timeout
+    // the returned frame has to be handed back with release()
+    SharedFrame* next(SubscriberHandle handle, TickType_t timeout);
+    void release(SharedFrame* frame);
+
+    // called from the producer after each frame went out to the subscribers, so a server that doesn't
+    // block in next() knows when to look
+    void setFrameListener(void (*listener)(void* arg), void* arg);
+
+    int subscriberCount() const { return subscriber_count.load(); }
+
+   private:
+    struct Subscriber
+    {
+        bool active = false;
+        // depth of one - a new frame replaces a stale one instead of queueing up behind it
+        QueueHandle_t queue = nullptr;
+        uint32_t dropped = 0;
+    };
+
+    static void producerTask(void* arg);
+    void produce();
+    SharedFrame* acquireSlot(camera_fb_t* fb);
+    void publish(SharedFrame* frame);
+
+    SemaphoreHandle_t lock = nullptr;
+    TaskHandle_t producer_handle = nullptr;
+    void (*frame_listener)(void* arg) = nullptr;
+    void* frame_listener_arg = nullptr;
+    std::atomic<int> subscriber_count{0};
+    Subscriber subscribers[MAX_SUBSCRIBERS];
+    SharedFrame pool[FRAME_POOL_SIZE];
+};
+
+#endif
@@ -1,164 +1,231 @@
 #include "StreamServer.hpp"
+#include <algorithm>
 
 constexpr static const char* STREAM_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=" PART_BOUNDARY;
 constexpr static const char* STREAM_BOUNDARY = "\r\n--" PART_BOUNDARY "\r\n";
-constexpr static const char* STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\nX-Timestamp: %lli.%06li\r\n\r\n";
+constexpr static const char* STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\nX-Timestamp: %lli.%06li\r\n";
+
+// at most this much of a frame sits in a client's send buffer, mongoose copies what it sends into the heap
+// and a whole frame per client would be more than the stream tasks' stacks we got rid of
+constexpr static size_t STREAM_CHUNK = 4096;
 
 static const char* STREAM_SERVER_TAG = "[STREAM_SERVER]";
 
 StreamServer::StreamServer(const int STREAM_PORT, StateManager* stateManager) : STREAM_SERVER_PORT(STREAM_PORT), stateManager(stateManager) {}
 
-esp_err_t StreamHelpers::stream(httpd_req_t* req)
-{
-    camera_fb_t* fb = nullptr;
-    struct timeval _timestamp;
-
-    esp_err_t response = ESP_OK;
-    size_t _jpg_buf_len = 0;
-    uint8_t* _jpg_buf = nullptr;
+FrameBroadcaster StreamHelpers::broadcaster;
 
-    // Buffer for multipart header
-    char part_buf[256];
-    static int64_t last_frame = 0;
-    if (!last_frame)
-        last_frame = esp_timer_get_time();
+// link 0 of the rate control is UVC, every stream client reports its own after that
+static_assert(FrameBroadcaster::MAX_SUBSCRIBERS < JpegRateControl::MAX_LINKS, "not enough rate control links for every stream client");
 
-    // Pull event queue from user_ctx to send STREAM on/off notifications
-    auto* stateManager = static_cast<StateManager*>(req->user_ctx);
-    QueueHandle_t eventQueue = stateManager ? stateManager->GetEventQueue() : nullptr;
-    bool stream_on_sent = false;
+// what a stream connection is in the middle of, indexed by its subscriber handle,
+// which the connection itself keeps in its data
+struct StreamClient
+{
+    StateManager* stateManager = nullptr;
+    // the frame being queued, the camera buffer stays pinned until its last byte is in the send buffer
+    SharedFrame* frame = nullptr;
+    size_t offset = 0;
+    FrameTelemetry::FrameTiming timing;
+    // the first complete frame to this client counts as the stream start
+    int64_t start_us = 0;
+    // how fast this client takes frames, queueing only waits once the socket buffer is full so this
+    // overshoots while there's room and comes down to the real rate once the link is the limit
+    uint32_t link_rate = 0;
+};
+
+static StreamClient stream_clients[FrameBroadcaster::MAX_SUBSCRIBERS];
+
+static QueueHandle_t streamEventQueue(const StreamClient& client)
+{
+    return client.stateManager ? client.stateManager->GetEventQueue() : nullptr;
+}
 
-    response = httpd_resp_set_type(req, STREAM_CONTENT_TYPE);
-    if (response != ESP_OK)
-        return response;
+static SubscriberHandle connectionSubscriber(const mg_connection* connection)
+{
+    SubscriberHandle subscriber;
+    memcpy(&subscriber, connection->data, sizeof(subscriber));
+    return subscriber;
+}
 
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-    httpd_resp_set_hdr(req, "X-Framerate", "60");
+static void frameQueued(SubscriberHandle subscriber, StreamClient& client)
+{
+    const size_t frame_len = client.frame->fb->len;
+    StreamHelpers::broadcaster.release(client.frame);
+    client.frame = nullptr;
+
+    // the last bytes are at most a chunk ahead of the socket, close enough for the telemetry and the link rate
+    client.timing.complete_us = esp_timer_get_time();
+    FrameTelemetry::record(FrameTelemetry::Transport::HTTP, client.timing);
+    if (client.start_us != 0)
+    {
+        FrameTelemetry::recordStart(FrameTelemetry::Transport::HTTP, FrameTelemetry::StartStage::FirstFrame, client.start_us, client.timing.complete_us);
+        client.start_us = 0;
+    }
 
-    if (SendStreamEvent(eventQueue, StreamState_e::Stream_ON))
-        stream_on_sent = true;
+    const int64_t send_us = std::max<int64_t>(client.timing.complete_us - client.timing.start_us, 1);
+    const uint32_t sample = static_cast<uint32_t>(std::min<int64_t>(frame_len * 1000000LL / send_us, UINT32_MAX));
+    client.link_rate = client.link_rate ? static_cast<uint32_t>((static_cast<uint64_t>(client.link_rate) * 3 + sample) / 4) : sample;
+    JpegRateControl::controller().setLinkRate(1 + static_cast<size_t>(subscriber), client.link_rate);
+}
 
-    while (true)
+// tops the send buffer up to STREAM_CHUNK, starting the next frame once the last one is queued.
+// runs on every poll and after every write, so a client goes exactly as fast as its socket drains
+static void pumpStream(mg_connection* connection, SubscriberHandle subscriber, StreamClient& client)
+{
+    while (connection->send.len < STREAM_CHUNK)
     {
-        fb = esp_camera_fb_get();
-
-        if (!fb)
+        if (client.frame == nullptr)
         {
-            ESP_LOGE(STREAM_SERVER_TAG, "Camera capture failed");
-            vTaskDelay(pdMS_TO_TICKS(10));
+            client.frame = StreamHelpers::broadcaster.next(subscriber, 0);
+            if (client.frame == nullptr)
+                return;
+
+            camera_fb_t* fb = client.frame->fb;
+            client.offset = 0;
+            client.timing = client.frame->timing;
+            client.timing.start_us = esp_timer_get_time();
+
+            // Buffer for multipart header
+            char part_buf[256];
+            size_t hlen = snprintf(part_buf, sizeof(part_buf), STREAM_PART, fb->len, fb->timestamp.tv_sec, fb->timestamp.tv_usec);
+            // the frame's metadata as more headers, the blank line ends them
+            hlen += FrameMetadata::formatHeaders(client.frame->metadata, part_buf + hlen, sizeof(part_buf) - hlen - 2);
+            part_buf[hlen++] = '\r';
+            part_buf[hlen++] = '\n';
+            if (!mg_send(connection, STREAM_BOUNDARY, strlen(STREAM_BOUNDARY)) || !mg_send(connection, part_buf, hlen))
+            {
+                mg_error(connection, "out of memory");
+                return;
+            }
             continue;
         }
-        else
-        {
-            _timestamp.tv_sec = fb->timestamp.tv_sec;
-            _timestamp.tv_usec = fb->timestamp.tv_usec;
-            _jpg_buf_len = fb->len;
-            _jpg_buf = fb->buf;
-        }
-        if (response == ESP_OK)
-            response = httpd_resp_send_chunk(req, STREAM_BOUNDARY, strlen(STREAM_BOUNDARY));
-        if (response == ESP_OK)
-        {
-            size_t hlen = snprintf((char*)part_buf, sizeof(part_buf), STREAM_PART, _jpg_buf_len, _timestamp.tv_sec, _timestamp.tv_usec);
-            response = httpd_resp_send_chunk(req, (const char*)part_buf, hlen);
-        }
-        if (response == ESP_OK)
-            response = httpd_resp_send_chunk(req, (const char*)_jpg_buf, _jpg_buf_len);
-        if (fb)
-        {
-            esp_camera_fb_return(fb);
-            fb = NULL;
-            _jpg_buf = NULL;
-        }
-        else if (_jpg_buf)
+
+        camera_fb_t* fb = client.frame->fb;
+        const size_t length = std::min(fb->len - client.offset, STREAM_CHUNK - connection->send.len);
+        if (!mg_send(connection, fb->buf + client.offset, length))
         {
-            free(_jpg_buf);
-            _jpg_buf = NULL;
+            mg_error(connection, "out of memory");
+            return;
         }
-        if (response != ESP_OK)
-            break;
+        client.offset += length;
+        if (client.offset == fb->len)
+            frameQueued(subscriber, client);
+    }
+}
 
-        if (esp_log_level_get(STREAM_SERVER_TAG) >= ESP_LOG_INFO)
-        {
-            static long last_request_time = 0;
-            if (last_request_time == 0)
-            {
-                last_request_time = Helpers::getTimeInMillis();
-            }
+static void wakeServer(void* arg)
+{
+    static_cast<RestAPI*>(arg)->wake();
+}
 
-            // Only log every 100 frames to reduce overhead
-            const int frame_window = 100;
-            static int frame_count = 0;
-            if (++frame_count % frame_window == 0)
-            {
-                long request_end = Helpers::getTimeInMillis();
-                long window_ms = request_end - last_request_time;
-                last_request_time = request_end;
-                long fps = 0;
-                if (window_ms > 0)
-                {
-                    fps = (frame_window * 1000) / window_ms;
-                }
-                ESP_LOGI(STREAM_SERVER_TAG, "%i Frames Size: %uKB, Time: %lims (%lifps)", frame_window, _jpg_buf_len / 1024, window_ms, fps);
-            }
-        }
+void StreamHelpers::stream(mg_connection* connection, mg_http_message* message, void* context)
+{
+    int active_clients = 0;
+    SubscriberHandle subscriber = broadcaster.subscribe(&active_clients);
+    if (subscriber == INVALID_SUBSCRIBER)
+    {
+        mg_http_reply(connection, 503, "Content-Type: text/plain\r\n", "Too many stream clients");
+        return;
     }
-    last_frame = 0;
 
-    if (stream_on_sent)
-        SendStreamEvent(eventQueue, StreamState_e::Stream_OFF);
+    StreamClient& client = stream_clients[subscriber];
+    client = StreamClient{};
+    client.stateManager = static_cast<StateManager*>(context);
+    client.start_us = esp_timer_get_time();
 
-    return response;
+    // the connection is ours from here on, mongoose stops looking for requests on it since is_resp stays set
+    memcpy(connection->data, &subscriber, sizeof(subscriber));
+    connection->fn = &StreamHelpers::stream_event_handler;
+    connection->fn_data = nullptr;
+    mg_printf(connection, "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nAccess-Control-Allow-Origin: *\r\nX-Framerate: 60\r\n\r\n", STREAM_CONTENT_TYPE);
+
+    // the stream is ON as long as at least one client is watching
+    if (active_clients == 1)
+        SendStreamEvent(streamEventQueue(client), StreamState_e::Stream_ON);
 }
 
-esp_err_t StreamHelpers::ws_logs_handle(httpd_req_t* req)
+void StreamHelpers::stream_event_handler(mg_connection* connection, int event, void* event_data)
 {
-    auto ret = webSocketLogger.register_socket_client(req);
-    return ret;
+    const SubscriberHandle subscriber = connectionSubscriber(connection);
+    StreamClient& client = stream_clients[subscriber];
+
+    if (event == MG_EV_POLL || event == MG_EV_WRITE)
+    {
+        if (!connection->is_closing && !connection->is_draining)
+            pumpStream(connection, subscriber, client);
+    }
+    else if (event == MG_EV_READ)
+    {
+        // clients have nothing to say on a stream, don't let it pile up
+        connection->recv.len = 0;
+    }
+    else if (event == MG_EV_CLOSE)
+    {
+        if (client.frame != nullptr)
+        {
+            broadcaster.release(client.frame);
+            client.frame = nullptr;
+        }
+        JpegRateControl::controller().setLinkRate(1 + static_cast<size_t>(subscriber), 0);
+        if (broadcaster.unsubscribe(subscriber) == 0)
+            SendStreamEvent(streamEventQueue(client), StreamState_e::Stream_OFF);
+    }
 }
 
-esp_err_t StreamServer::startStreamServer()
+void StreamHelpers::ws_logs_handle(mg_connection* connection, mg_http_message* message, void* context)
 {
-    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.stack_size = 20480;
-    config.max_uri_handlers = 10;
-    config.server_port = STREAM_SERVER_PORT;
-    config.ctrl_port = STREAM_SERVER_PORT;
-    config.recv_wait_timeout = 5;    // 5 seconds for receiving
-    config.send_wait_timeout = 5;    // 5 seconds for sending
-    config.lru_purge_enable = true;  // Enable LRU purge for better connection handling
-
-    httpd_uri_t stream_page = {
-        .uri = "/",
-        .method = HTTP_GET,
-        .handler = &StreamHelpers::stream,
-        .user_ctx = this->stateManager,
-    };
-
-    httpd_uri_t logs_ws = {
-        .uri = "/ws",
-        .method = HTTP_GET,
-        .handler = &StreamHelpers::ws_logs_handle,
-        .user_ctx = nullptr,
-        .is_websocket = true,
-    };
-
-    int status = httpd_start(&camera_stream, &config);
-
-    if (status != ESP_OK)
+    mg_ws_upgrade(connection, message, nullptr);
+    // not an upgrade request, mongoose already answered it
+    if (!connection->is_websocket)
+        return;
+
+    connection->fn = &StreamHelpers::ws_event_handler;
+    connection->fn_data = nullptr;
+    webSocketLogger.register_socket_client(connection);
+}
+
+void StreamHelpers::ws_event_handler(mg_connection* connection, int event, void* event_data)
+{
+    // log lines from other tasks, see WebSocketLogger::log_message
+    if (event == MG_EV_WAKEUP)
+    {
+        const auto* line = static_cast<mg_str*>(event_data);
+        mg_ws_send(connection, line->buf, line->len, WEBSOCKET_OP_TEXT);
+    }
+    else if (event == MG_EV_CLOSE)
+    {
+        webSocketLogger.unregister_socket_client(connection);
+    }
+}
+
+esp_err_t StreamServer::startStreamServer(RestAPI& server)
+{
+    server.addHandler("/ws", &StreamHelpers::ws_logs_handle, nullptr);
+
+    char url[32];
+    snprintf(url, sizeof(url), "http://0.0.0.0:%d", STREAM_SERVER_PORT);
+    if (!server.listen(url))
     {
         ESP_LOGE(STREAM_SERVER_TAG, "Cannot start stream server.");
-        return status;
+        return ESP_FAIL;
     }
 
-    httpd_register_uri_handler(camera_stream, &logs_ws);
     if (this->stateManager->GetCameraState() != CameraState_e::Camera_Success)
     {
         ESP_LOGE(STREAM_SERVER_TAG, "Camera not initialized. Cannot start stream server. Logs server will be running.");
         return ESP_FAIL;
     }
 
-    httpd_register_uri_handler(camera_stream, &stream_page);
+    if (StreamHelpers::broadcaster.init() != ESP_OK)
+    {
+        ESP_LOGE(STREAM_SERVER_TAG, "Cannot set up the frame broadcaster. Logs server will be running.");
+        return ESP_FAIL;
+    }
+
+    // the server sleeps in select(), every new frame has to get it out of there
+    StreamHelpers::broadcaster.setFrameListener(&wakeServer, &server);
+    server.addHandler("/", &StreamHelpers::stream, this->stateManager);
 
     // Initial state is OFF
     if (this->stateManager)
@@ -167,4 +234,4 @@ esp_err_t StreamServer::startStreamServer()
     ESP_LOGI(STREAM_SERVER_TAG, "Stream server started on port %d", STREAM_SERVER_PORT);
 
     return ESP_OK;
-}
\ No newline at end of file
+}
@@ -5,10 +5,11 @@
 #define PART_BOUNDARY "123456789000000000000987654321"
 
 #include <StateManager.hpp>
+#include <FrameBroadcaster.hpp>
+#include <RestAPI.hpp>
 #include <WebSocketLogger.hpp>
 #include <helpers.hpp>
 #include "esp_camera.h"
-#include "esp_http_server.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 
@@ -16,23 +17,29 @@ extern WebSocketLogger webSocketLogger;
 
 namespace StreamHelpers
 {
-esp_err_t stream(httpd_req_t* req);
-esp_err_t ws_logs_handle(httpd_req_t* req);
+// one camera reader shared by all stream clients
+extern FrameBroadcaster broadcaster;
+
+// "/" and "/ws", they take the connection over from the server and keep it on the handlers below
+void stream(mg_connection* connection, mg_http_message* message, void* context);
+void ws_logs_handle(mg_connection* connection, mg_http_message* message, void* context);
+
+void stream_event_handler(mg_connection* connection, int event, void* event_data);
+void ws_event_handler(mg_connection* connection, int event, void* event_data);
 }  // namespace StreamHelpers
 
+// The MJPEG stream and the log socket. They used to have an esp_http_server of their own,
+// now they run on the RestAPI's loop, STREAM_PORT is just one more port of that server.
 class StreamServer
 {
    private:
     int STREAM_SERVER_PORT;
     StateManager* stateManager;
-    httpd_handle_t camera_stream = nullptr;
 
    public:
     StreamServer(const int STREAM_PORT, StateManager* StateManager);
-    esp_err_t startStreamServer();
-
-    esp_err_t stream(httpd_req_t* req);
-    esp_err_t ws_logs_handle(httpd_req_t* req);
+    // has to happen before the server's task starts polling
+    esp_err_t startStreamServer(RestAPI& server);
 };
 
-#endif
\ No newline at end of file
+#endif
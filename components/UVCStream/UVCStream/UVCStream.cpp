@@ -8,11 +8,10 @@
 
 static const char* UVC_STREAM_TAG = "[UVC DEVICE]";
 
-// Tracks whether a frame has been handed to TinyUSB and not yet returned.
-// Atomic because video_task and TinyUSB task (tud_suspend_cb) access it concurrently.
-static std::atomic<bool> s_frame_inflight{false};
 // Set by camera_stop_cb so camera_fb_get_cb skips new acquisitions during USB suspend.
 static std::atomic<bool> s_stopping{false};
+// when the host committed the stream that hasn't delivered a frame yet, 0 once it has
+static std::atomic<int64_t> s_start_us{0};
 
 extern "C"
 {
@@ -44,74 +43,147 @@ extern "C"
 }
 
 // single definition of shared framebuffer storage
-UVCStreamHelpers::fb_t UVCStreamHelpers::s_fb = {};
+UVCStreamHelpers::fb_t UVCStreamHelpers::s_fbs[UVCStreamHelpers::FB_SLOTS] = {};
 
-static void reset_pacing_state()
+// Slots are claimed by video_task in camera_fb_get_cb and released from either video_task,
+// the TinyUSB task (transfer complete, suspend) or here, the atomic swap makes sure a frame
+// only goes back to the camera once no matter who gets there first.
+static void release_slot(UVCStreamHelpers::fb_t& slot)
 {
-    s_frame_inflight.store(false);
+    if (camera_fb_t* cam_fb = slot.cam_fb_p.exchange(nullptr))
+    {
+        esp_camera_fb_return(cam_fb);
+    }
 }
 
-static esp_err_t UVCStreamHelpers::camera_start_cb(uvc_format_t format, int width, int height, int rate, void* cb_ctx)
+static UVCStreamHelpers::fb_t* slot_for(const uvc_fb_t* fb)
 {
-    ESP_LOGI(UVC_STREAM_TAG, "Camera Start");
-    ESP_LOGI(UVC_STREAM_TAG, "Format: %d, width: %d, height: %d, rate: %d", format, width, height, rate);
-    framesize_t frame_size = FRAMESIZE_240X240;
+    for (auto& slot : UVCStreamHelpers::s_fbs)
+    {
+        if (&slot.uvc_fb == fb)
+        {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+static void release_all_slots()
+{
+    for (auto& slot : UVCStreamHelpers::s_fbs)
+    {
+        release_slot(slot);
+    }
+}
+
+// the square sizes usb_device_uvc advertises, see uvc_frame_config.h
+static framesize_t frame_size_for(int width, int height)
+{
+    if (width != height)
+    {
+        return FRAMESIZE_INVALID;
+    }
+    switch (width)
+    {
+        case 320:
+            return FRAMESIZE_320X320;
+        case 240:
+            return FRAMESIZE_240X240;
+        case 128:
+            return FRAMESIZE_128X128;
+        case 96:
+            return FRAMESIZE_96X96;
+        default:
+            return FRAMESIZE_INVALID;
+    }
+}
+
+// XCLK for the committed rate. The sensor's frame rate follows its clock, so slow streams can run the
+// sensor slower too, everything faster gets the clock the camera was set up with.
+static uint32_t xclk_for_rate(int rate)
+{
+    static uint32_t full_rate_xclk = 0;
+    if (full_rate_xclk == 0)
+    {
+        full_rate_xclk = cameraHandler->getXclkFrequency();
+    }
+#if CONFIG_CAMERA_UVC_LOW_RATE_XCLK_FREQ > 0
+    if (rate <= 30)
+    {
+        return CONFIG_CAMERA_UVC_LOW_RATE_XCLK_FREQ;
+    }
+#endif
+    return full_rate_xclk;
+}
+
+// runs on the TinyUSB task inside the commit, only looks at what the host asked for
+static esp_err_t UVCStreamHelpers::camera_validate_cb(uvc_format_t format, int width, int height, int rate, void* cb_ctx)
+{
+    (void)rate;
+    (void)cb_ctx;
     auto* sensor = esp_camera_sensor_get();
     uint16_t pid = sensor ? sensor->id.PID : 0;
 
-    if (format != UVC_FORMAT_JPEG)
+    // Y800 comes straight off the sensor, YUV422 on the OV2640 gets its Y picked out by the driver
+    if (format != UVC_FORMAT_JPEG && format != UVC_FORMAT_GREY)
     {
-        ESP_LOGE(UVC_STREAM_TAG, "Only support MJPEG format");
+        ESP_LOGE(UVC_STREAM_TAG, "Only support MJPEG and GREY formats");
         return ESP_ERR_NOT_SUPPORTED;
     }
 
-    // Sensor-based allowance: OV3660 only 320x320; OV2640 only 240x240; others 240/320
-    if (pid == OV3660_PID)
+    const framesize_t frame_size = frame_size_for(width, height);
+    if (frame_size == FRAMESIZE_INVALID)
     {
-        if (width == 320 && height == 320)
-        {
-            frame_size = FRAMESIZE_320X320;
-        }
-        else
-        {
-            ESP_LOGE(UVC_STREAM_TAG, "OV3660 requires 320x320, requested %dx%d not allowed", width, height);
-            return ESP_ERR_NOT_SUPPORTED;
-        }
+        ESP_LOGE(UVC_STREAM_TAG, "Unsupported frame size %dx%d", width, height);
+        return ESP_ERR_NOT_SUPPORTED;
     }
-    else if (pid == OV2640_PID)
+
+    // the descriptors only list what the sensor's profile allows, this catches a host that commits something else anyway
+    if (pid == OV2640_PID && frame_size > FRAMESIZE_240X240)
     {
-        if (width == 240 && height == 240)
-        {
-            frame_size = FRAMESIZE_240X240;
-        }
-        else
-        {
-            ESP_LOGE(UVC_STREAM_TAG, "OV2640 limited to 240x240 for UVC, requested %dx%d", width, height);
-            return ESP_ERR_NOT_SUPPORTED;
-        }
+        ESP_LOGE(UVC_STREAM_TAG, "OV2640 limited to 240x240 for UVC, requested %dx%d", width, height);
+        return ESP_ERR_NOT_SUPPORTED;
     }
-    else
+    return ESP_OK;
+}
+
+// runs on video_task once the stream starts, the same task that captures, so a format switch
+// can restart the camera driver without anyone waiting on a frame from it
+static esp_err_t UVCStreamHelpers::camera_start_cb(uvc_format_t format, int width, int height, int rate, void* cb_ctx)
+{
+    const int64_t start_us = esp_timer_get_time();
+    ESP_LOGI(UVC_STREAM_TAG, "Camera Start");
+    ESP_LOGI(UVC_STREAM_TAG, "Format: %d, width: %d, height: %d, rate: %d", format, width, height, rate);
+
+    // the commit already went through camera_validate_cb
+    const framesize_t frame_size = frame_size_for(width, height);
+
+    // the frame in flight may still finish while we restart, it mustn't count towards the new stream
+    s_stopping.store(true);
+
+    // a stream that ended without a suspend can still hold frames, hand them back before starting over
+    release_all_slots();
+
+    // clock first, set_framesize reprograms the sensor PLL for whatever XCLK it's running at
+    cameraHandler->setXclkFrequency(xclk_for_rate(rate));
+    const int ret = cameraHandler->setPixelFormat(format == UVC_FORMAT_GREY ? PIXFORMAT_GRAYSCALE : PIXFORMAT_JPEG, frame_size);
+    if (ret != 0)
     {
-        // Fallback: accept 320 or 240
-        if (width == 320 && height == 320)
-        {
-            frame_size = FRAMESIZE_320X320;
-        }
-        else if (width == 240 && height == 240)
-        {
-            frame_size = FRAMESIZE_240X240;
-        }
-        else
-        {
-            ESP_LOGE(UVC_STREAM_TAG, "Unsupported frame size %dx%d", width, height);
-            return ESP_ERR_NOT_SUPPORTED;
-        }
+        // s_stopping stays set, nothing gets captured from a camera that didn't come back
+        ESP_LOGE(UVC_STREAM_TAG, "Camera can't stream format %d at %dx%d", format, width, height);
+        return ESP_FAIL;
     }
 
-    cameraHandler->setCameraResolution(frame_size);
-
+    // raw frames have a fixed size, there's no quality to trade for bandwidth
+#if CONFIG_CAMERA_JPEG_RATE_CONTROL
+    JpegRateControl::controller().setLinkRate(0, format == UVC_FORMAT_JPEG ? CONFIG_CAMERA_UVC_LINK_BUDGET_KBPS * 1024 : 0);
+#endif
+    JpegRateControl::controller().restart();
+    const int64_t configured_us = esp_timer_get_time();
+    FrameTelemetry::recordStart(FrameTelemetry::Transport::UVC, FrameTelemetry::StartStage::Configure, start_us, configured_us);
+    ESP_LOGI(UVC_STREAM_TAG, "Camera configured in %lld us", static_cast<long long>(configured_us - start_us));
+    s_start_us.store(start_us);
     s_stopping.store(false);
-    reset_pacing_state();
     SendStreamEvent(eventQueue, StreamState_e::Stream_ON);
 
     return ESP_OK;
@@ -122,16 +194,11 @@ static void UVCStreamHelpers::camera_stop_cb(void* cb_ctx)
     (void)cb_ctx;
     s_stopping.store(true);
 
-    // Always release camera FB to prevent frame buffer leaks.
+    // Always release camera FBs to prevent frame buffer leaks.
     // Even if a USB transfer is in flight the DMA has already read the data
     // from DRAM so returning the buffer here is safe.
-    if (s_fb.cam_fb_p)
-    {
-        esp_camera_fb_return(s_fb.cam_fb_p);
-        s_fb.cam_fb_p = nullptr;
-    }
-
-    reset_pacing_state();
+    release_all_slots();
+    JpegRateControl::controller().setLinkRate(0, 0);
 
     SendStreamEvent(eventQueue, StreamState_e::Stream_OFF);
 }
@@ -140,63 +207,103 @@ static uvc_fb_t* UVCStreamHelpers::camera_fb_get_cb(void* cb_ctx)
 {
     auto* mgr = static_cast<UVCStreamManager*>(cb_ctx);
 
-    // Guard against requesting a new frame while previous is still in flight
-    // or while the host has signalled a stop via tud_suspend_cb.
-    if (s_frame_inflight.load())
-    {
-        ESP_LOGD(UVC_STREAM_TAG, "fb_get: blocked by s_frame_inflight");
-        return nullptr;
-    }
+    // Guard against requesting a new frame while the host has signalled a stop via tud_suspend_cb.
     if (s_stopping.load())
     {
         ESP_LOGD(UVC_STREAM_TAG, "fb_get: blocked by s_stopping");
         return nullptr;
     }
 
-    // NOTE: Frame-rate pacing is already handled by video_task (interval_ms).
-    // A second, independent pacing layer here was causing double-throttling
-    // and excessive frame drops that could starve the USB host.
+    // no pacing here, video_task holds the frame back until the one-shot esp_timer armed from uvc_pacer
+    // says the committed interval is up. A second layer here would throttle twice and starve the host.
 
-    // Acquire a fresh frame
+    // Acquire a fresh frame, format switches happen on this task too (camera_start_cb) so the driver can't restart under us
     camera_fb_t* cam_fb = esp_camera_fb_get();
+    camera_jpeg_stats_t jpeg_stats = {};
+    esp_camera_get_jpeg_stats(&jpeg_stats);
     if (!cam_fb)
     {
+        JpegRateControl::controller().onCaptureFailed(jpeg_stats.fb_overflows);
         return nullptr;
     }
+    const bool is_jpeg = cam_fb->format == PIXFORMAT_JPEG;
+    if (is_jpeg)
+    {
+        JpegRateControl::controller().onFrame(cam_fb->len, cam_fb->timestamp.tv_sec * 1000000LL + cam_fb->timestamp.tv_usec, jpeg_stats.fb_overflows);
+    }
 
-    s_fb.cam_fb_p = cam_fb;
-    s_fb.uvc_fb.buf = cam_fb->buf;
-    s_fb.uvc_fb.len = cam_fb->len;
-    s_fb.uvc_fb.width = cam_fb->width;
-    s_fb.uvc_fb.height = cam_fb->height;
-    s_fb.uvc_fb.format = UVC_FORMAT_JPEG;
-    s_fb.uvc_fb.timestamp = cam_fb->timestamp;
-
-    // Validate size fits into transfer buffer
-    if (mgr && s_fb.uvc_fb.len > mgr->getUvcBufferSize())
+    // the host sized its buffers after what the descriptor advertised
+    if (mgr && cam_fb->len > mgr->getMaxFrameSize())
     {
-        ESP_LOGE(UVC_STREAM_TAG, "Frame size %d exceeds UVC buffer size %u", (int)s_fb.uvc_fb.len, (unsigned)mgr->getUvcBufferSize());
+        ESP_LOGE(UVC_STREAM_TAG, "Frame size %d exceeds max UVC frame size %u", (int)cam_fb->len, (unsigned)mgr->getMaxFrameSize());
         esp_camera_fb_return(cam_fb);
-        s_fb.cam_fb_p = nullptr;
         return nullptr;
     }
 
-    s_frame_inflight.store(true);
-    return &s_fb.uvc_fb;
+    for (auto& slot : s_fbs)
+    {
+        camera_fb_t* expected = nullptr;
+        if (!slot.cam_fb_p.compare_exchange_strong(expected, cam_fb))
+        {
+            continue;
+        }
+
+        slot.uvc_fb.buf = cam_fb->buf;
+        slot.uvc_fb.len = cam_fb->len;
+        slot.uvc_fb.width = cam_fb->width;
+        slot.uvc_fb.height = cam_fb->height;
+        slot.uvc_fb.format = is_jpeg ? UVC_FORMAT_JPEG : UVC_FORMAT_GREY;
+        slot.uvc_fb.timestamp = cam_fb->timestamp;
+
+        camera_fb_timing_t timing = {};
+        esp_camera_fb_get_timing(cam_fb, &timing);
+        slot.timing = {
+            .vsync_us = timing.vsync_us,
+            .eof_us = timing.eof_us,
+            .taken_us = timing.taken_us,
+        };
+        // rides in the payload header of the frame's first payload, next to its PTS
+        slot.uvc_fb.meta_len = FrameMetadata::encode(FrameMetadata::capture(timing.sequence), slot.uvc_fb.meta, sizeof(slot.uvc_fb.meta));
+        return &slot.uvc_fb;
+    }
+
+    // video_task never holds more than one frame on the wire and one waiting
+    ESP_LOGW(UVC_STREAM_TAG, "fb_get: no free slot, dropping frame");
+    esp_camera_fb_return(cam_fb);
+    return nullptr;
 }
 
 static void UVCStreamHelpers::camera_fb_return_cb(uvc_fb_t* fb, void* cb_ctx)
 {
     (void)cb_ctx;
-    // fb may be NULL when called from tud_video_frame_xfer_complete_cb
-    // (zero-copy path: video_task no longer copies into a separate buffer,
-    //  so the camera FB is returned here after USB finishes the transfer).
-    if (s_fb.cam_fb_p)
+    // called once USB finished reading the frame (zero-copy, the USB controller reads
+    // straight from the camera FB) or when video_task drops a frame it won't send
+    fb_t* slot = slot_for(fb);
+    if (!slot)
+    {
+        return;
+    }
+
+    // only frames that actually went out count, not the dropped ones or whatever a stop cut short
+    if (slot->timing.start_us != 0 && !s_stopping.load())
+    {
+        slot->timing.complete_us = esp_timer_get_time();
+        FrameTelemetry::record(FrameTelemetry::Transport::UVC, slot->timing);
+        if (const int64_t start_us = s_start_us.exchange(0))
+        {
+            FrameTelemetry::recordStart(FrameTelemetry::Transport::UVC, FrameTelemetry::StartStage::FirstFrame, start_us, slot->timing.complete_us);
+        }
+    }
+    release_slot(*slot);
+}
+
+static void UVCStreamHelpers::camera_xfer_start_cb(uvc_fb_t* fb, void* cb_ctx)
+{
+    (void)cb_ctx;
+    if (fb_t* slot = slot_for(fb))
     {
-        esp_camera_fb_return(s_fb.cam_fb_p);
-        s_fb.cam_fb_p = nullptr;
+        slot->timing.start_us = esp_timer_get_time();
     }
-    s_frame_inflight.store(false);
 }
 
 esp_err_t UVCStreamManager::setup()
@@ -214,26 +321,17 @@ esp_err_t UVCStreamManager::setup()
     }
     uvc_select_frame_profile(use_320);
 
-    // Allocate a fixed-size transfer buffer (compile-time constant)
-    uvc_buffer_size = UVCStreamManager::UVC_MAX_FRAMESIZE_SIZE;
-    if (uvc_buffer != nullptr)
-    {
-        free(uvc_buffer);
-    }
-    uvc_buffer = static_cast<uint8_t*>(malloc(uvc_buffer_size));
-    if (uvc_buffer == nullptr)
-    {
-        ESP_LOGE(UVC_STREAM_TAG, "Allocating buffer for UVC Device failed");
-        return ESP_FAIL;
-    }
-
+    // no transfer buffer, frames go to USB straight from the camera frame buffers,
+    // CameraManager already got the memory one used to take, see CAMERA_UVC_FB_BUDGET_KB
     uvc_device_config_t config = {
-        .uvc_buffer = uvc_buffer,
+        .uvc_buffer = nullptr,
         .uvc_buffer_size = UVCStreamManager::UVC_MAX_FRAMESIZE_SIZE,
         .start_cb = UVCStreamHelpers::camera_start_cb,
         .fb_get_cb = UVCStreamHelpers::camera_fb_get_cb,
         .fb_return_cb = UVCStreamHelpers::camera_fb_return_cb,
         .stop_cb = UVCStreamHelpers::camera_stop_cb,
+        .xfer_start_cb = UVCStreamHelpers::camera_xfer_start_cb,
+        .validate_cb = UVCStreamHelpers::camera_validate_cb,
         .cb_ctx = this,
     };
 
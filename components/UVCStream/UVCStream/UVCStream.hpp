@@ -6,7 +6,11 @@
 
 #ifdef CONFIG_GENERAL_INCLUDE_UVC_MODE
 #include <CameraManager.hpp>
+#include <FrameMetadata.hpp>
+#include <FrameTelemetry.hpp>
+#include <JpegRateControl.hpp>
 #include <StateManager.hpp>
+#include <atomic>
 #include "esp_camera.h"
 #include "esp_log.h"
 #include "esp_mac.h"
@@ -37,35 +41,46 @@ extern QueueHandle_t eventQueue;
 
 namespace UVCStreamHelpers
 {
+// one slot per camera frame buffer, with pipelining one is on the wire while the next one waits
+constexpr size_t FB_SLOTS = 2;
+
 typedef struct
 {
-    camera_fb_t* cam_fb_p;
+    // null while the slot is free, whoever swaps it back to null returns the frame to the camera
+    std::atomic<camera_fb_t*> cam_fb_p;
     uvc_fb_t uvc_fb;
+    // filled in as the frame moves along, recorded once USB is done with it
+    FrameTelemetry::FrameTiming timing;
 } fb_t;
 
-// single storage is defined in UVCStream.cpp
-extern fb_t s_fb;
+// storage is defined in UVCStream.cpp
+extern fb_t s_fbs[FB_SLOTS];
 
+static esp_err_t camera_validate_cb(uvc_format_t format, int width, int height, int rate, void* cb_ctx);
 static esp_err_t camera_start_cb(uvc_format_t format, int width, int height, int rate, void* cb_ctx);
 static void camera_stop_cb(void* cb_ctx);
 static uvc_fb_t* camera_fb_get_cb(void* cb_ctx);
 static void camera_fb_return_cb(uvc_fb_t* fb, void* cb_ctx);
+static void camera_xfer_start_cb(uvc_fb_t* fb, void* cb_ctx);
 }  // namespace UVCStreamHelpers
 
 class UVCStreamManager
 {
-    uint8_t* uvc_buffer = nullptr;
-    uint32_t uvc_buffer_size = 0;
-
    public:
-    // Compile-time buffer size; must be >= dwMaxVideoFrameBufferSize advertised
-    // in the USB descriptor (320*320*2 = 200 KB for the 320x320 profile).
+    // Largest frame we'll send, matches dwMaxVideoFrameBufferSize advertised in the USB
+    // descriptor (320*320*2 = 200 KB for the 320x320 profile). Frames go out straight from
+    // the camera frame buffer, so this is only a limit, the memory went to CameraManager instead.
     static constexpr uint32_t UVC_MAX_FRAMESIZE_SIZE = 200 * 1024;
     esp_err_t setup();
     esp_err_t start();
-    uint32_t getUvcBufferSize() const
+    uint32_t getMaxFrameSize() const
+    {
+        return UVC_MAX_FRAMESIZE_SIZE;
+    }
+    // inter-frame timing of the current stream, see uvc_device_stats_t
+    esp_err_t getStats(uvc_device_stats_t* stats) const
     {
-        return uvc_buffer_size;
+        return uvc_device_get_stats(0, stats);
     }
 };
 
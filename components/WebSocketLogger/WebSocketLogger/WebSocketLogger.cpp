@@ -2,70 +2,56 @@
 
 WebSocketLogger::WebSocketLogger()
 {
-    this->connected_socket_client = async_resp_arg{
-        .hd = nullptr,
-        .fd = -1,
-    };
-
     this->ws_log_buffer[0] = '\0';
 }
 
-void LoggerHelpers::ws_async_send(void* arg)
-{
-    char* log_buffer = webSocketLogger.get_websocket_log_buffer();
-
-    const auto* resp_arg = static_cast<struct async_resp_arg*>(arg);
-    const auto hd = resp_arg->hd;
-    const auto fd = resp_arg->fd;
-
-    auto websocket_packet = httpd_ws_frame_t{};
-
-    websocket_packet.payload = reinterpret_cast<uint8_t*>(log_buffer);
-    websocket_packet.len = strlen(log_buffer);
-    websocket_packet.type = HTTPD_WS_TYPE_TEXT;
-
-    httpd_ws_send_frame_async(hd, fd, &websocket_packet);
-}
-
 esp_err_t WebSocketLogger::log_message(const char* format, va_list args)
 {
     vsnprintf(this->ws_log_buffer, 100, format, args);
 
-    if (connected_socket_client.fd == -1 || connected_socket_client.hd == nullptr)
+    mg_mgr* mgr = this->manager.load();
+    const unsigned long id = this->connection_id.load();
+    if (mgr == nullptr || id == 0)
     {
         return ESP_FAIL;
     }
 
-    esp_err_t ret = httpd_queue_work(connected_socket_client.hd, LoggerHelpers::ws_async_send, &connected_socket_client);
-    if (ret != ESP_OK)
+    // the line gets copied into the pipe right here, the buffer is free again once this returns
+    if (!mg_wakeup(mgr, id, this->ws_log_buffer, strlen(this->ws_log_buffer)))
     {
-        connected_socket_client.fd = -1;
-        connected_socket_client.hd = nullptr;
+        this->connection_id.store(0);
+        return ESP_FAIL;
     }
 
-    return ret;
+    return ESP_OK;
 }
 
-esp_err_t WebSocketLogger::register_socket_client(httpd_req_t* req)
+esp_err_t WebSocketLogger::register_socket_client(mg_connection* connection)
 {
-    if (connected_socket_client.fd != -1 && connected_socket_client.hd != nullptr)
+    if (this->connection_id.load() != 0)
     {
         // we're already connected
         return ESP_OK;
     }
 
-    connected_socket_client.hd = req->handle;
-    connected_socket_client.fd = httpd_req_to_sockfd(req);
+    this->manager.store(connection->mgr);
+    this->connection_id.store(connection->id);
     return ESP_OK;
 }
 
-void WebSocketLogger::unregister_socket_client()
+void WebSocketLogger::unregister_socket_client(mg_connection* connection)
 {
-    connected_socket_client.fd = -1;
-    connected_socket_client.hd = nullptr;
+    // only the client that's actually registered, a second one that got turned away doesn't count
+    unsigned long id = connection->id;
+    this->connection_id.compare_exchange_strong(id, 0);
+}
+
+bool WebSocketLogger::is_client_connected()
+{
+    return this->connection_id.load() != 0;
 }
 
 char* WebSocketLogger::get_websocket_log_buffer()
 {
     return this->ws_log_buffer;
-}
\ No newline at end of file
+}
@@ -2,37 +2,31 @@
 #ifndef WEBSOCKETLOGGER_HPP
 #define WEBSOCKETLOGGER_HPP
 
-#include "esp_http_server.h"
+#include <mongoose.h>
+#include <atomic>
+#include "esp_err.h"
 #include "esp_log.h"
 
 #define WS_LOG_BUFFER_LEN 1024
 
-struct async_resp_arg
-{
-    httpd_handle_t hd;
-    int fd;
-};
-
-namespace LoggerHelpers
-{
-void ws_async_send(void* arg);
-}
-
+// Mirrors the log to one websocket client. Log lines come from every task, the socket belongs to the
+// server's loop, so lines go over mongoose's wake-up pipe and the loop sends them from MG_EV_WAKEUP.
 class WebSocketLogger
 {
-    async_resp_arg connected_socket_client{};
+    std::atomic<mg_mgr*> manager{nullptr};
+    std::atomic<unsigned long> connection_id{0};
     char ws_log_buffer[WS_LOG_BUFFER_LEN]{};
 
    public:
     WebSocketLogger();
 
     esp_err_t log_message(const char* format, va_list args);
-    esp_err_t register_socket_client(httpd_req_t* req);
-    void unregister_socket_client();
+    esp_err_t register_socket_client(mg_connection* connection);
+    void unregister_socket_client(mg_connection* connection);
     bool is_client_connected();
     char* get_websocket_log_buffer();
 };
 
 extern WebSocketLogger webSocketLogger;
 
-#endif
\ No newline at end of file
+#endif
@@ -18,6 +18,7 @@
 #include "esp_heap_caps.h"
 #include "ll_cam.h"
 #include "cam_hal.h"
+#include "jpeg_markers.h"
 
 #if (ESP_IDF_VERSION_MAJOR == 3) && (ESP_IDF_VERSION_MINOR == 3)
 #include "rom/ets_sys.h"
@@ -42,34 +43,38 @@
 static const char *TAG = "cam_hal";
 static cam_obj_t *cam_obj = NULL;
 
-static const uint32_t JPEG_SOI_MARKER = 0xFFD8FF;  // written in little-endian for esp32
 static const uint16_t JPEG_EOI_MARKER = 0xD9FF;  // written in little-endian for esp32
 
+static camera_jpeg_stats_t cam_jpeg_stats;
+// only written by the camera task, readers get it through cam_get_fb_timing()
+static uint32_t cam_frame_sequence;
+
 static int cam_verify_jpeg_soi(const uint8_t *inbuf, uint32_t length)
 {
-    for (uint32_t i = 0; i < length; i++) {
-        if (memcmp(&inbuf[i], &JPEG_SOI_MARKER, 3) == 0) {
-            //ESP_LOGW(TAG, "SOI: %d", (int) i);
-            return i;
-        }
+    int offset = jpeg_find_soi(inbuf, length);
+    cam_jpeg_stats.bytes_scanned += offset >= 0 ? offset + 3 : length;
+    if (offset != 0) {
+        cam_jpeg_stats.soi_misses++;
+    }
+    if (offset < 0) {
+        ESP_LOGW(TAG, "NO-SOI");
     }
-    ESP_LOGW(TAG, "NO-SOI");
-    return -1;
+    return offset;
 }
 
 static int cam_verify_jpeg_eoi(const uint8_t *inbuf, uint32_t length)
 {
-    int offset = -1;
-    uint8_t *dptr = (uint8_t *)inbuf + length - 2;
-    while (dptr > inbuf) {
-        if (memcmp(dptr, &JPEG_EOI_MARKER, 2) == 0) {
-            offset = dptr - inbuf;
-            //ESP_LOGW(TAG, "EOI: %d", length - (offset + 2));
-            return offset;
-        }
-        dptr--;
+    int offset = jpeg_find_eoi(inbuf, length);
+    cam_jpeg_stats.bytes_scanned += offset >= 0 ? length - offset : length;
+    if (offset < 0) {
+        cam_jpeg_stats.eoi_misses++;
+    } else {
+        //everything after the marker is DMA padding
+        cam_jpeg_stats.frames++;
+        cam_jpeg_stats.last_padding = length - (offset + sizeof(JPEG_EOI_MARKER));
+        cam_jpeg_stats.padding_trimmed += cam_jpeg_stats.last_padding;
     }
-    return -1;
+    return offset;
 }
 
 static bool cam_get_next_frame(int * frame_pos)
@@ -146,6 +151,7 @@ static void cam_task(void *arg)
                     if(!cam_obj->psram_mode){
                         if (cam_obj->fb_size < (frame_buffer_event->len + pixels_per_dma)) {
                             ESP_LOGW(TAG, "FB-OVF");
+                            cam_jpeg_stats.fb_overflows++;
                             ll_cam_stop(cam_obj);
                             DBG_PIN_SET(0);
                             continue;
@@ -156,11 +162,20 @@ static void cam_task(void *arg)
                             cam_obj->dma_half_buffer_size);
                     }
                     //Check for JPEG SOI in the first buffer. stop if not found
-                    if (cam_obj->jpeg_mode && cnt == 0 && cam_verify_jpeg_soi(frame_buffer_event->buf, frame_buffer_event->len) != 0) {
+                    //in direct mode nothing was copied, the first half buffer is already sitting in the frame
+                    size_t soi_len = cam_obj->psram_mode ? cam_obj->dma_half_buffer_size : frame_buffer_event->len;
+                    if (cam_obj->jpeg_mode && cnt == 0 && cam_verify_jpeg_soi(frame_buffer_event->buf, soi_len) != 0) {
                         ll_cam_stop(cam_obj);
                         cam_obj->state = CAM_STATE_IDLE;
                     }
                     cnt++;
+                    //the descriptor chain ends with the frame buffer, once it's full the rest of the JPEG is lost
+                    if (cam_obj->psram_mode && cam_obj->jpeg_mode && cnt >= cam_obj->dma_half_buffer_cnt) {
+                        ESP_LOGW(TAG, "FB-OVF");
+                        cam_jpeg_stats.fb_overflows++;
+                        ll_cam_stop(cam_obj);
+                        cam_obj->state = CAM_STATE_IDLE;
+                    }
 
                 } else if (cam_event == CAM_VSYNC_EVENT) {
                     //DBG_PIN_SET(1);
@@ -171,6 +186,7 @@ static void cam_task(void *arg)
                             if (!cam_obj->psram_mode) {
                                 if (cam_obj->fb_size < (frame_buffer_event->len + pixels_per_dma)) {
                                     ESP_LOGW(TAG, "FB-OVF");
+                                    cam_jpeg_stats.fb_overflows++;
                                     cnt--;
                                 } else {
                                     frame_buffer_event->len += ll_cam_memcpy(cam_obj,
@@ -186,7 +202,11 @@ static void cam_task(void *arg)
 
                         if (cam_obj->psram_mode) {
                             if (cam_obj->jpeg_mode) {
+                                //the last half buffer is partial, cam_take trims to the EOI marker
                                 frame_buffer_event->len = cnt * cam_obj->dma_half_buffer_size;
+                                if (frame_buffer_event->len > cam_obj->fb_size) {
+                                    frame_buffer_event->len = cam_obj->fb_size;
+                                }
                             } else {
                                 frame_buffer_event->len = cam_obj->recv_size;
                             }
@@ -196,6 +216,8 @@ static void cam_task(void *arg)
                                 ESP_LOGE(TAG, "FB-SIZE: %u != %u", frame_buffer_event->len, (unsigned) cam_obj->fb_size);
                             }
                         }
+                        cam_obj->frames[frame_pos].eof_us = esp_timer_get_time();
+                        cam_obj->frames[frame_pos].sequence = ++cam_frame_sequence;
                         //send frame
                         if(!cam_obj->frames[frame_pos].en && xQueueSend(cam_obj->frame_buffer_queue, (void *)&frame_buffer_event, 0) != pdTRUE) {
                             //pop frame buffer from the queue
@@ -230,7 +252,7 @@ static void cam_task(void *arg)
     }
 }
 
-static lldesc_t * allocate_dma_descriptors(uint32_t count, uint16_t size, uint8_t * buffer)
+static lldesc_t * allocate_dma_descriptors(uint32_t count, uint16_t size, uint8_t * buffer, bool ring)
 {
     lldesc_t *dma = (lldesc_t *)heap_caps_malloc(count * sizeof(lldesc_t), MALLOC_CAP_DMA);
     if (dma == NULL) {
@@ -246,6 +268,10 @@ static lldesc_t * allocate_dma_descriptors(uint32_t count, uint16_t size, uint8_
         dma[x].buf = (buffer + size * x);
         dma[x].empty = (uint32_t)&dma[(x + 1) % count];
     }
+    if (!ring) {
+        // stop at the end of the buffer instead of wrapping around onto the start of the frame
+        dma[count - 1].empty = 0;
+    }
     return dma;
 }
 
@@ -304,21 +330,26 @@ static esp_err_t cam_dma_config(const camera_config_t *config)
             cam_obj->frames[x].fb_offset = dma_align - ((uint32_t)cam_obj->frames[x].fb.buf & (dma_align - 1));
             cam_obj->frames[x].fb.buf += cam_obj->frames[x].fb_offset;
             ESP_LOGI(TAG, "Frame[%d]: Offset: %u, Addr: 0x%08X", x, cam_obj->frames[x].fb_offset, (unsigned) cam_obj->frames[x].fb.buf);
-            cam_obj->frames[x].dma = allocate_dma_descriptors(cam_obj->dma_node_cnt, cam_obj->dma_node_buffer_size, cam_obj->frames[x].fb.buf);
+            cam_obj->frames[x].dma = allocate_dma_descriptors(cam_obj->dma_node_cnt, cam_obj->dma_node_buffer_size, cam_obj->frames[x].fb.buf, !cam_obj->jpeg_mode);
             CAM_CHECK(cam_obj->frames[x].dma != NULL, "frame dma malloc failed", ESP_FAIL);
         }
         cam_obj->frames[x].en = 1;
     }
 
     if (!cam_obj->psram_mode) {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 3, 0)
+        // 16 byte aligned like the frame buffers, ll_cam_memcpy can use 128 bit loads on it then
+        cam_obj->dma_buffer = (uint8_t *)heap_caps_aligned_alloc(16, cam_obj->dma_buffer_size * sizeof(uint8_t), MALLOC_CAP_DMA);
+#else
         cam_obj->dma_buffer = (uint8_t *)heap_caps_malloc(cam_obj->dma_buffer_size * sizeof(uint8_t), MALLOC_CAP_DMA);
+#endif
         if(NULL == cam_obj->dma_buffer) {
             ESP_LOGE(TAG,"%s(%d): DMA buffer %d Byte malloc failed, the current largest free block:%d Byte", __FUNCTION__, __LINE__,
                      (int) cam_obj->dma_buffer_size, (int) heap_caps_get_largest_free_block(MALLOC_CAP_DMA));
             return ESP_FAIL;
         }
 
-        cam_obj->dma = allocate_dma_descriptors(cam_obj->dma_node_cnt, cam_obj->dma_node_buffer_size, cam_obj->dma_buffer);
+        cam_obj->dma = allocate_dma_descriptors(cam_obj->dma_node_cnt, cam_obj->dma_node_buffer_size, cam_obj->dma_buffer, true);
         CAM_CHECK(cam_obj->dma != NULL, "dma malloc failed", ESP_FAIL);
     }
 
@@ -333,6 +364,7 @@ esp_err_t cam_init(const camera_config_t *config)
     cam_obj = (cam_obj_t *)heap_caps_calloc(1, sizeof(cam_obj_t), MALLOC_CAP_DMA);
     CAM_CHECK(NULL != cam_obj, "lcd_cam object malloc error", ESP_ERR_NO_MEM);
 
+    memset(&cam_jpeg_stats, 0, sizeof(cam_jpeg_stats));
     cam_obj->swap_data = 0;
     cam_obj->vsync_pin = config->pin_vsync;
     cam_obj->vsync_invert = true;
@@ -369,6 +401,14 @@ esp_err_t cam_config(const camera_config_t *config, framesize_t frame_size, uint
     cam_obj->psram_mode = false;
 #else
     cam_obj->psram_mode = (config->xclk_freq_hz == 16000000);
+#endif
+    cam_obj->fb_internal = config->fb_location == CAMERA_FB_IN_DRAM;
+#if CONFIG_CAMERA_JPEG_DMA_DIRECT
+    // GDMA can fill internal RAM just as well, let JPEG frames land in the frame buffer directly
+    // and skip the bounce buffer plus the per-half-buffer copy in cam_task
+    if (cam_obj->jpeg_mode && cam_obj->fb_internal) {
+        cam_obj->psram_mode = true;
+    }
 #endif
     cam_obj->frame_cnt = config->fb_count;
     cam_obj->width = resolution[frame_size].width;
@@ -474,6 +514,24 @@ void cam_start(void)
     ll_cam_vsync_intr_enable(cam_obj, true);
 }
 
+static cam_frame_t *cam_frame_of(const camera_fb_t *fb)
+{
+    for (int x = 0; x < cam_obj->frame_cnt; x++) {
+        if (&cam_obj->frames[x].fb == fb) {
+            return &cam_obj->frames[x];
+        }
+    }
+    return NULL;
+}
+
+static void cam_set_taken_time(const camera_fb_t *fb)
+{
+    cam_frame_t *frame = cam_frame_of(fb);
+    if (frame) {
+        frame->taken_us = esp_timer_get_time();
+    }
+}
+
 camera_fb_t *cam_take(TickType_t timeout)
 {
     camera_fb_t *dma_buffer = NULL;
@@ -490,6 +548,7 @@ camera_fb_t *cam_take(TickType_t timeout)
     }
 #endif
     if (dma_buffer) {
+        cam_set_taken_time(dma_buffer);
         if(cam_obj->jpeg_mode){
             // find the end marker for JPEG. Data after that can be discarded
             int offset_e = cam_verify_jpeg_eoi(dma_buffer->buf, dma_buffer->len);
@@ -535,3 +594,26 @@ void cam_give_all(void) {
         cam_obj->frames[x].en = 1;
     }
 }
+
+esp_err_t cam_get_fb_timing(const camera_fb_t *fb, camera_fb_timing_t *timing)
+{
+    const cam_frame_t *frame = cam_frame_of(fb);
+    if (frame == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    timing->vsync_us = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+    timing->eof_us = frame->eof_us;
+    timing->taken_us = frame->taken_us;
+    timing->sequence = frame->sequence;
+    return ESP_OK;
+}
+
+void cam_get_jpeg_stats(camera_jpeg_stats_t *stats)
+{
+    *stats = cam_jpeg_stats;
+}
+
+void cam_reset_jpeg_stats(void)
+{
+    memset(&cam_jpeg_stats, 0, sizeof(cam_jpeg_stats));
+}
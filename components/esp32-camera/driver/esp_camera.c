@@ -490,3 +490,57 @@ void esp_camera_return_all(void) {
     cam_give_all();
 }
 
+esp_err_t esp_camera_fb_get_timing(const camera_fb_t *fb, camera_fb_timing_t *timing)
+{
+    if (fb == NULL || timing == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return cam_get_fb_timing(fb, timing);
+}
+
+esp_err_t esp_camera_get_jpeg_stats(camera_jpeg_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    cam_get_jpeg_stats(stats);
+    return ESP_OK;
+}
+
+void esp_camera_reset_jpeg_stats(void)
+{
+    if (s_state == NULL) {
+        return;
+    }
+    cam_reset_jpeg_stats();
+}
+
+esp_err_t esp_camera_get_sccb_stats(camera_sccb_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sccb_stats_t sccb;
+    SCCB_Get_Stats(&sccb);
+    stats->transactions = sccb.transactions;
+    stats->reads = sccb.reads;
+    stats->writes = sccb.writes;
+    stats->bursts = sccb.bursts;
+    stats->errors = sccb.errors;
+    stats->shadow_hits = sccb.shadow_hits;
+    stats->shadow_misses = sccb.shadow_misses;
+    stats->bytes = sccb.bytes;
+    return ESP_OK;
+}
+
+void esp_camera_reset_sccb_stats(void)
+{
+    SCCB_Reset_Stats();
+}
+
@@ -169,6 +169,43 @@ typedef struct {
     struct timeval timestamp;   /*!< Timestamp since boot of the first DMA buffer of the frame */
 } camera_fb_t;
 
+/**
+ * @brief JPEG marker scanning counters, accumulated since init or the last reset
+ */
+typedef struct {
+    uint32_t frames;            /*!< Frames handed out with a valid EOI marker */
+    uint32_t soi_misses;        /*!< Frames dropped because the first DMA buffer didn't start with SOI */
+    uint32_t eoi_misses;        /*!< Frames dropped because no EOI marker was found */
+    uint32_t fb_overflows;      /*!< Frames dropped because they didn't fit into the frame buffer */
+    uint32_t last_padding;      /*!< Bytes trimmed after the EOI marker of the last frame */
+    uint64_t bytes_scanned;     /*!< Bytes looked at while searching for SOI and EOI markers */
+    uint64_t padding_trimmed;   /*!< Bytes trimmed after EOI markers in total */
+} camera_jpeg_stats_t;
+
+/**
+ * @brief SCCB bus counters, accumulated since boot or the last reset
+ */
+typedef struct {
+    uint32_t transactions;      /*!< Bus transactions, a register read counts once */
+    uint32_t reads;             /*!< Registers read over the bus */
+    uint32_t writes;            /*!< Registers written */
+    uint32_t bursts;            /*!< Transactions that wrote more than one register */
+    uint32_t errors;            /*!< Transactions the sensor didn't acknowledge */
+    uint32_t shadow_hits;       /*!< Register reads answered from the shadow of written values */
+    uint32_t shadow_misses;     /*!< Shadow reads that had to go to the bus */
+    uint64_t bytes;             /*!< Register address and data bytes on the wire */
+} camera_sccb_stats_t;
+
+/**
+ * @brief Capture timestamps of a frame buffer, all in esp_timer microseconds since boot
+ */
+typedef struct {
+    int64_t vsync_us;           /*!< VSYNC that started the frame, same as camera_fb_t::timestamp */
+    int64_t eof_us;             /*!< Last DMA buffer of the frame arrived and the frame was queued */
+    int64_t taken_us;           /*!< esp_camera_fb_get() handed the frame out */
+    uint32_t sequence;          /*!< Frames completed since the driver started, gaps are frames dropped before they were taken */
+} camera_fb_timing_t;
+
 #define ESP_ERR_CAMERA_BASE 0x20000
 #define ESP_ERR_CAMERA_NOT_DETECTED             (ESP_ERR_CAMERA_BASE + 1)
 #define ESP_ERR_CAMERA_FAILED_TO_SET_FRAME_SIZE (ESP_ERR_CAMERA_BASE + 2)
@@ -242,6 +279,57 @@ esp_err_t esp_camera_load_from_nvs(const char *key);
  */
 void esp_camera_return_all(void);
 
+/**
+ * @brief Get the capture timestamps of a frame buffer
+ *
+ * Only valid between esp_camera_fb_get() and esp_camera_fb_return() of that buffer.
+ *
+ * @param fb     Frame buffer returned by esp_camera_fb_get()
+ * @param timing Where to store the timestamps
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if fb or timing is NULL
+ *      - ESP_ERR_INVALID_STATE if the driver hasn't been initialized yet
+ *      - ESP_ERR_NOT_FOUND if fb isn't one of the driver's frame buffers
+ */
+esp_err_t esp_camera_fb_get_timing(const camera_fb_t *fb, camera_fb_timing_t *timing);
+
+/**
+ * @brief Get the JPEG marker scanning counters
+ *
+ * @param stats Where to store the counters
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if stats is NULL
+ *      - ESP_ERR_INVALID_STATE if the driver hasn't been initialized yet
+ */
+esp_err_t esp_camera_get_jpeg_stats(camera_jpeg_stats_t *stats);
+
+/**
+ * @brief Reset the JPEG marker scanning counters
+ */
+void esp_camera_reset_jpeg_stats(void);
+
+/**
+ * @brief Get the SCCB bus counters
+ *
+ * Take a copy before and after a sensor call to see what that call cost on the bus.
+ *
+ * @param stats Where to store the counters
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t esp_camera_get_sccb_stats(camera_sccb_stats_t *stats);
+
+/**
+ * @brief Reset the SCCB bus counters
+ */
+void esp_camera_reset_sccb_stats(void);
+
 
 #ifdef __cplusplus
 }
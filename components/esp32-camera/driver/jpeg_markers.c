@@ -0,0 +1,117 @@
+// Copyright 2010-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+#include "jpeg_markers.h"
+
+#define WORD_ONES  0x01010101u
+#define WORD_HIGHS 0x80808080u
+
+// non-zero if any byte of the word is zero, exact - no false positives when it's zero
+static inline uint32_t word_has_zero_byte(uint32_t word)
+{
+    return (word - WORD_ONES) & ~word & WORD_HIGHS;
+}
+
+static inline uint32_t load_word(const uint8_t *ptr)
+{
+    uint32_t word;
+    memcpy(&word, ptr, sizeof(word));
+    return word;
+}
+
+static inline int is_soi(const uint8_t *buf, size_t pos)
+{
+    return buf[pos] == 0xFF && buf[pos + 1] == 0xD8 && buf[pos + 2] == 0xFF;
+}
+
+// pos is the index of the 0xD9 byte
+static inline int is_eoi(const uint8_t *buf, size_t pos)
+{
+    return buf[pos] == 0xD9 && buf[pos - 1] == 0xFF;
+}
+
+int jpeg_find_soi(const uint8_t *buf, size_t length)
+{
+    if (buf == NULL || length < 3) {
+        return -1;
+    }
+
+    const size_t last = length - 3;
+    size_t pos = 0;
+
+    // byte-wise up to the first aligned word
+    while (pos <= last && ((uintptr_t)(buf + pos) & 3)) {
+        if (is_soi(buf, pos)) {
+            return pos;
+        }
+        pos++;
+    }
+
+    // a word without any 0xFF can't start a marker
+    for (; pos + 4 <= length; pos += 4) {
+        if (!word_has_zero_byte(~load_word(buf + pos))) {
+            continue;
+        }
+        for (size_t i = pos; i < pos + 4 && i <= last; i++) {
+            if (is_soi(buf, i)) {
+                return i;
+            }
+        }
+    }
+
+    for (; pos <= last; pos++) {
+        if (is_soi(buf, pos)) {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+int jpeg_find_eoi(const uint8_t *buf, size_t length)
+{
+    if (buf == NULL || length < 3) {
+        return -1;
+    }
+
+    // walk the position of the 0xD9 byte down from the end, a marker at offset 0 doesn't count
+    size_t pos = length - 1;
+
+    // byte-wise until pos is the last byte of an aligned word
+    while (pos >= 2 && ((uintptr_t)(buf + pos + 1) & 3)) {
+        if (is_eoi(buf, pos)) {
+            return pos - 1;
+        }
+        pos--;
+    }
+
+    // a word without any 0xD9 can't end a marker
+    while (pos >= 5) {
+        if (word_has_zero_byte(load_word(buf + pos - 3) ^ 0xD9D9D9D9u)) {
+            for (size_t i = 0; i < 4; i++) {
+                if (is_eoi(buf, pos - i)) {
+                    return pos - i - 1;
+                }
+            }
+        }
+        pos -= 4;
+    }
+
+    for (; pos >= 2; pos--) {
+        if (is_eoi(buf, pos)) {
+            return pos - 1;
+        }
+    }
+    return -1;
+}
@@ -57,6 +57,12 @@ void cam_give(camera_fb_t *dma_buffer);
 
 void cam_give_all(void);
 
+esp_err_t cam_get_fb_timing(const camera_fb_t *fb, camera_fb_timing_t *timing);
+
+void cam_get_jpeg_stats(camera_jpeg_stats_t *stats);
+
+void cam_reset_jpeg_stats(void);
+
 #ifdef __cplusplus
 }
 #endif
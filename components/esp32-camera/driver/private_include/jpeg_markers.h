@@ -0,0 +1,52 @@
+// Copyright 2010-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Find the first JPEG SOI marker (FF D8 FF) in a buffer
+ *
+ * Scans a 32 bit word at a time and only looks at single bytes in words that contain 0xFF.
+ * No hardware dependencies, so the same code runs in the host tests.
+ *
+ * @param buf    Buffer to search
+ * @param length Number of valid bytes in buf
+ *
+ * @return Offset of the marker, or -1 if there is none
+ */
+int jpeg_find_soi(const uint8_t *buf, size_t length);
+
+/**
+ * @brief Find the last JPEG EOI marker (FF D9) in a buffer
+ *
+ * Scans backwards a 32 bit word at a time and only looks at single bytes in words that contain 0xD9.
+ * A marker at offset 0 is not reported, same as the byte-wise search it replaces.
+ *
+ * @param buf    Buffer to search
+ * @param length Number of valid bytes in buf
+ *
+ * @return Offset of the 0xFF byte of the marker, or -1 if there is none
+ */
+int jpeg_find_eoi(const uint8_t *buf, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,7 +8,10 @@
  */
 #ifndef __SCCB_H__
 #define __SCCB_H__
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "sccb_regs.h"
 int SCCB_Init(int pin_sda, int pin_scl);
 int SCCB_Use_Port(int sccb_i2c_port);
 int SCCB_Deinit(void);
@@ -17,6 +20,16 @@ uint8_t SCCB_Read(uint8_t slv_addr, uint8_t reg);
 int SCCB_Write(uint8_t slv_addr, uint8_t reg, uint8_t data);
 uint8_t SCCB_Read16(uint8_t slv_addr, uint16_t reg);
 int SCCB_Write16(uint8_t slv_addr, uint16_t reg, uint8_t data);
+// one transaction for consecutive registers, split into SCCB_BURST_MAX sized ones if longer
+int SCCB_Write16_Burst(uint8_t slv_addr, uint16_t reg, const uint8_t *data, size_t len);
+// the last value written to reg if there is one, read from the sensor otherwise,
+// only for registers the sensor doesn't change by itself
+uint8_t SCCB_Read16_Shadow(uint8_t slv_addr, uint16_t reg);
+// the last value written to reg, false if the shadow doesn't know it, never touches the bus
+bool SCCB_Shadow_Get(uint8_t slv_addr, uint16_t reg, uint8_t *value);
 uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg);
 int SCCB_Write_Addr16_Val16(uint8_t slv_addr, uint16_t reg, uint16_t data);
+void SCCB_Shadow_Clear(void);
+void SCCB_Get_Stats(sccb_stats_t *stats);
+void SCCB_Reset_Stats(void);
 #endif // __SCCB_H__
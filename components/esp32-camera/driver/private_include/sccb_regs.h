@@ -0,0 +1,112 @@
+// Copyright 2010-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Register bookkeeping shared by both SCCB drivers: a shadow of the values written to 16 bit
+ * register sensors, the bus counters and the run detection used for burst writes.
+ * No hardware dependencies and no locking, the SCCB driver serializes the calls.
+ */
+
+#define SCCB_SHADOW_SLOTS 512   /*!< Registers the shadow can hold, a power of two */
+#define SCCB_BURST_MAX    32    /*!< Most registers written in one burst transaction */
+
+/**
+ * @brief SCCB bus counters, accumulated since boot or the last reset
+ */
+typedef struct {
+    uint32_t transactions;      /*!< Bus transactions, a register read counts once */
+    uint32_t reads;             /*!< Registers read over the bus */
+    uint32_t writes;            /*!< Registers written */
+    uint32_t bursts;            /*!< Transactions that wrote more than one register */
+    uint32_t errors;            /*!< Transactions the sensor didn't acknowledge */
+    uint32_t shadow_hits;       /*!< Register reads answered from the shadow */
+    uint32_t shadow_misses;     /*!< Shadow reads that had to go to the bus */
+    uint64_t bytes;             /*!< Register address and data bytes on the wire */
+} sccb_stats_t;
+
+/**
+ * @brief Remember the value just written to a register
+ *
+ * Once the table is three quarters full new registers are no longer added, known ones still get updated.
+ */
+void sccb_shadow_store(uint8_t slv_addr, uint16_t reg, uint8_t value);
+
+/**
+ * @brief Remember a run of values just written to consecutive registers starting at reg
+ */
+void sccb_shadow_store_run(uint8_t slv_addr, uint16_t reg, const uint8_t *values, size_t count);
+
+/**
+ * @brief Look up the last value written to a register, counts a shadow hit or miss
+ *
+ * @return true and the value if the register was written since the last clear
+ */
+bool sccb_shadow_lookup(uint8_t slv_addr, uint16_t reg, uint8_t *value);
+
+/**
+ * @brief Forget everything, after a sensor reset or when the bus goes away
+ */
+void sccb_shadow_clear(void);
+
+/**
+ * @brief Number of registers in the shadow
+ */
+size_t sccb_shadow_size(void);
+
+/**
+ * @brief Count one bus transaction
+ *
+ * @param reads  Registers read by it
+ * @param writes Registers written by it
+ * @param bytes  Register address and data bytes it moved
+ * @param ok     false if the sensor didn't acknowledge it
+ */
+void sccb_stats_count(uint32_t reads, uint32_t writes, uint32_t bytes, bool ok);
+
+/**
+ * @brief Copy the counters
+ */
+void sccb_stats_get(sccb_stats_t *stats);
+
+/**
+ * @brief Zero the counters
+ */
+void sccb_stats_reset(void);
+
+/**
+ * @brief Length of the run of consecutive registers at the start of an OmniVision register table
+ *
+ * The tables are {reg, value} pairs ending in a 0x0000 entry, 0xFFFF entries are delays.
+ * Both end a run, regs[0] itself has to be a real register.
+ *
+ * @param regs    Table position to start at
+ * @param max_len Longest run to report
+ *
+ * @return Number of entries, 1 up to max_len, that can go out as one burst
+ */
+size_t sccb_reg_run(const uint16_t (*regs)[2], size_t max_len);
+
+#ifdef __cplusplus
+}
+#endif
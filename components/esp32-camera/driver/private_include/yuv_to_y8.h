@@ -0,0 +1,42 @@
+// Copyright 2010-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Keep only the luminance of YUYV (YUV422) data
+ *
+ * Takes every even byte, 8 input bytes to 4 output bytes a round, a tail shorter than 8 bytes is left out.
+ * out may be the same buffer as in, it never gets ahead of the bytes still to be read.
+ * No hardware dependencies, so the same code runs in the host tests. On the ESP32-S3
+ * ll_cam_memcpy runs the aligned bulk of a buffer through the PIE unit and this does the rest.
+ *
+ * @param out Where the Y bytes go, len / 2 bytes
+ * @param in  YUYV data
+ * @param len Number of input bytes
+ *
+ * @return Number of bytes the output covers, len / 2
+ */
+size_t yuyv_to_y8(uint8_t *out, const uint8_t *in, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -11,6 +11,7 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include "sccb.h"
+#include "sccb_regs.h"
 #include "sensor.h"
 #include <stdio.h>
 #include "sdkconfig.h"
@@ -57,24 +58,38 @@ typedef struct
 
 static device_t devices[MAX_DEVICES];
 static uint8_t device_count = 0;
+// 7 bit address -> index into devices + 1, every register access goes through this
+static uint8_t device_index[128];
 static int sccb_i2c_port;
 static bool sccb_owns_i2c_port;
+// guards the shadow and the counters in sccb_regs.c
+static portMUX_TYPE regs_lock = portMUX_INITIALIZER_UNLOCKED;
 
 i2c_master_dev_handle_t *get_handle_from_address(uint8_t slv_addr)
 {
-    for (uint8_t i = 0; i < device_count; i++)
+    if (slv_addr < sizeof(device_index) && device_index[slv_addr])
     {
-
-        if (slv_addr == devices[i].address)
-        {
-            return &(devices[i].dev_handle);
-        }
+        return &(devices[device_index[slv_addr] - 1].dev_handle);
     }
 
     ESP_LOGE(TAG, "Device with address %02x not found", slv_addr);
     return NULL;
 }
 
+static void count_transaction(uint32_t reads, uint32_t writes, uint32_t bytes, esp_err_t ret)
+{
+    taskENTER_CRITICAL(&regs_lock);
+    sccb_stats_count(reads, writes, bytes, ret == ESP_OK);
+    taskEXIT_CRITICAL(&regs_lock);
+}
+
+static void shadow_store_run(uint8_t slv_addr, uint16_t reg, const uint8_t *values, size_t count)
+{
+    taskENTER_CRITICAL(&regs_lock);
+    sccb_shadow_store_run(slv_addr, reg, values, count);
+    taskEXIT_CRITICAL(&regs_lock);
+}
+
 int SCCB_Install_Device(uint8_t slv_addr)
 {
     esp_err_t ret;
@@ -108,6 +123,7 @@ int SCCB_Install_Device(uint8_t slv_addr)
 
     devices[device_count].address = slv_addr;
     device_count++;
+    device_index[slv_addr & 0x7f] = device_count;
     return 0;
 }
 
@@ -119,6 +135,7 @@ int SCCB_Init(int pin_sda, int pin_scl)
 
     sccb_i2c_port = SCCB_I2C_PORT_DEFAULT;
     sccb_owns_i2c_port = true;
+    SCCB_Shadow_Clear();
     ESP_LOGI(TAG, "sccb_i2c_port=%d", sccb_i2c_port);
 
     i2c_master_bus_config_t i2c_mst_config = {
@@ -152,6 +169,7 @@ int SCCB_Use_Port(int i2c_num)
         return ESP_ERR_INVALID_ARG;
     }
     sccb_i2c_port = i2c_num;
+    SCCB_Shadow_Clear();
 
     return ESP_OK;
 }
@@ -173,6 +191,8 @@ int SCCB_Deinit(void)
         devices[i].address = 0;
     }
     device_count = 0;
+    memset(device_index, 0, sizeof(device_index));
+    SCCB_Shadow_Clear();
 
     if (!sccb_owns_i2c_port)
     {
@@ -243,6 +263,7 @@ uint8_t SCCB_Read(uint8_t slv_addr, uint8_t reg)
     tx_buffer[0] = reg;
 
     esp_err_t ret = i2c_master_transmit_receive(dev_handle, tx_buffer, 1, rx_buffer, 1, TIMEOUT_MS);
+    count_transaction(1, 0, 2, ret);
 
     if (ret != ESP_OK)
     {
@@ -261,6 +282,7 @@ int SCCB_Write(uint8_t slv_addr, uint8_t reg, uint8_t data)
     tx_buffer[1] = data;
 
     esp_err_t ret = i2c_master_transmit(dev_handle, tx_buffer, 2, TIMEOUT_MS);
+    count_transaction(0, 1, 2, ret);
 
     if (ret != ESP_OK)
     {
@@ -270,25 +292,46 @@ int SCCB_Write(uint8_t slv_addr, uint8_t reg, uint8_t data)
     return ret == ESP_OK ? 0 : -1;
 }
 
-uint8_t SCCB_Read16(uint8_t slv_addr, uint16_t reg)
+static esp_err_t read16(uint8_t slv_addr, uint16_t reg, uint8_t *data)
 {
     i2c_master_dev_handle_t dev_handle = *(get_handle_from_address(slv_addr));
 
-    uint8_t rx_buffer[1];
-
     uint16_t reg_htons = LITTLETOBIG(reg);
     uint8_t *reg_u8 = (uint8_t *)&reg_htons;
 
-    esp_err_t ret = i2c_master_transmit_receive(dev_handle, reg_u8, 2, rx_buffer, 1, TIMEOUT_MS);
+    esp_err_t ret = i2c_master_transmit_receive(dev_handle, reg_u8, 2, data, 1, TIMEOUT_MS);
+    count_transaction(1, 0, 3, ret);
 
     if (ret != ESP_OK)
     {
-        ESP_LOGE(TAG, "W [%04x]=%02x fail\n", reg, rx_buffer[0]);
+        ESP_LOGE(TAG, "W [%04x]=%02x fail\n", reg, *data);
     }
 
+    return ret;
+}
+
+uint8_t SCCB_Read16(uint8_t slv_addr, uint16_t reg)
+{
+    uint8_t rx_buffer[1];
+    read16(slv_addr, reg, rx_buffer);
     return rx_buffer[0];
 }
 
+uint8_t SCCB_Read16_Shadow(uint8_t slv_addr, uint16_t reg)
+{
+    uint8_t data = 0;
+
+    taskENTER_CRITICAL(&regs_lock);
+    bool hit = sccb_shadow_lookup(slv_addr, reg, &data);
+    taskEXIT_CRITICAL(&regs_lock);
+
+    if (!hit && read16(slv_addr, reg, &data) == ESP_OK)
+    {
+        shadow_store_run(slv_addr, reg, &data, 1);
+    }
+    return data;
+}
+
 int SCCB_Write16(uint8_t slv_addr, uint16_t reg, uint8_t data)
 {
     i2c_master_dev_handle_t dev_handle = *(get_handle_from_address(slv_addr));
@@ -299,12 +342,57 @@ int SCCB_Write16(uint8_t slv_addr, uint16_t reg, uint8_t data)
     tx_buffer[2] = data;
 
     esp_err_t ret = i2c_master_transmit(dev_handle, tx_buffer, 3, TIMEOUT_MS);
+    count_transaction(0, 1, 3, ret);
 
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "W [%04x]=%02x fail\n", reg, data);
+        return -1;
     }
-    return ret == ESP_OK ? 0 : -1;
+    shadow_store_run(slv_addr, reg, &data, 1);
+    return 0;
+}
+
+int SCCB_Write16_Burst(uint8_t slv_addr, uint16_t reg, const uint8_t *data, size_t len)
+{
+#if CONFIG_SCCB_BURST_WRITE
+    i2c_master_dev_handle_t dev_handle = *(get_handle_from_address(slv_addr));
+
+    uint8_t tx_buffer[2 + SCCB_BURST_MAX];
+
+    while (len)
+    {
+        // the sensor increments the register address after every data byte
+        size_t chunk = len < SCCB_BURST_MAX ? len : SCCB_BURST_MAX;
+        tx_buffer[0] = reg >> 8;
+        tx_buffer[1] = reg & 0x00ff;
+        memcpy(&tx_buffer[2], data, chunk);
+
+        esp_err_t ret = i2c_master_transmit(dev_handle, tx_buffer, 2 + chunk, TIMEOUT_MS);
+        count_transaction(0, chunk, 2 + chunk, ret);
+
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "W [%04x..%04x] fail\n", reg, reg + chunk - 1);
+            return -1;
+        }
+        shadow_store_run(slv_addr, reg, data, chunk);
+
+        reg += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+    return 0;
+#else
+    for (size_t i = 0; i < len; i++)
+    {
+        if (SCCB_Write16(slv_addr, reg + i, data[i]))
+        {
+            return -1;
+        }
+    }
+    return 0;
+#endif
 }
 
 uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg)
@@ -317,6 +405,7 @@ uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg)
     uint8_t *reg_u8 = (uint8_t *)&reg_htons;
 
     esp_err_t ret = i2c_master_transmit_receive(dev_handle, reg_u8, 2, rx_buffer, 2, TIMEOUT_MS);
+    count_transaction(2, 0, 4, ret);
     uint16_t data = ((uint16_t)rx_buffer[0] << 8) | (uint16_t)rx_buffer[1];
 
     if (ret != ESP_OK)
@@ -338,10 +427,42 @@ int SCCB_Write_Addr16_Val16(uint8_t slv_addr, uint16_t reg, uint16_t data)
     tx_buffer[3] = data & 0x00ff;
 
     esp_err_t ret = i2c_master_transmit(dev_handle, tx_buffer, 4, TIMEOUT_MS);
+    count_transaction(0, 2, 4, ret);
 
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "W [%04x]=%02x fail\n", reg, data);
+        return -1;
     }
-    return ret == ESP_OK ? 0 : -1;
+    shadow_store_run(slv_addr, reg, &tx_buffer[2], 2);
+    return 0;
+}
+
+bool SCCB_Shadow_Get(uint8_t slv_addr, uint16_t reg, uint8_t *value)
+{
+    taskENTER_CRITICAL(&regs_lock);
+    bool hit = sccb_shadow_lookup(slv_addr, reg, value);
+    taskEXIT_CRITICAL(&regs_lock);
+    return hit;
+}
+
+void SCCB_Shadow_Clear(void)
+{
+    taskENTER_CRITICAL(&regs_lock);
+    sccb_shadow_clear();
+    taskEXIT_CRITICAL(&regs_lock);
+}
+
+void SCCB_Get_Stats(sccb_stats_t *stats)
+{
+    taskENTER_CRITICAL(&regs_lock);
+    sccb_stats_get(stats);
+    taskEXIT_CRITICAL(&regs_lock);
+}
+
+void SCCB_Reset_Stats(void)
+{
+    taskENTER_CRITICAL(&regs_lock);
+    sccb_stats_reset();
+    taskEXIT_CRITICAL(&regs_lock);
 }
@@ -12,6 +12,7 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include "sccb.h"
+#include "sccb_regs.h"
 #include "sensor.h"
 #include <stdio.h>
 #include "sdkconfig.h"
@@ -46,6 +47,22 @@ const int SCCB_I2C_PORT_DEFAULT = 0;
 
 static int sccb_i2c_port;
 static bool sccb_owns_i2c_port;
+// guards the shadow and the counters in sccb_regs.c
+static portMUX_TYPE regs_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void count_transaction(uint32_t reads, uint32_t writes, uint32_t bytes, esp_err_t ret)
+{
+    taskENTER_CRITICAL(&regs_lock);
+    sccb_stats_count(reads, writes, bytes, ret == ESP_OK);
+    taskEXIT_CRITICAL(&regs_lock);
+}
+
+static void shadow_store_run(uint8_t slv_addr, uint16_t reg, const uint8_t *values, size_t count)
+{
+    taskENTER_CRITICAL(&regs_lock);
+    sccb_shadow_store_run(slv_addr, reg, values, count);
+    taskEXIT_CRITICAL(&regs_lock);
+}
 
 int SCCB_Init(int pin_sda, int pin_scl)
 {
@@ -57,6 +74,7 @@ int SCCB_Init(int pin_sda, int pin_scl)
 
     sccb_i2c_port = SCCB_I2C_PORT_DEFAULT;
     sccb_owns_i2c_port = true;
+    SCCB_Shadow_Clear();
     ESP_LOGI(TAG, "sccb_i2c_port=%d", sccb_i2c_port);
 
     conf.mode = I2C_MODE_MASTER;
@@ -81,11 +99,13 @@ int SCCB_Use_Port(int i2c_num) { // sccb use an already initialized I2C port
         return ESP_ERR_INVALID_ARG;
     }
     sccb_i2c_port = i2c_num;
+    SCCB_Shadow_Clear();
     return ESP_OK;
 }
 
 int SCCB_Deinit(void)
 {
+    SCCB_Shadow_Clear();
     if (!sccb_owns_i2c_port) {
         return ESP_OK;
     }
@@ -126,6 +146,7 @@ uint8_t SCCB_Read(uint8_t slv_addr, uint8_t reg)
     i2c_master_stop(cmd);
     ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
     i2c_cmd_link_delete(cmd);
+    count_transaction(0, 0, 1, ret);
     if(ret != ESP_OK) return -1;
     cmd = i2c_cmd_link_create();
     i2c_master_start(cmd);
@@ -134,6 +155,7 @@ uint8_t SCCB_Read(uint8_t slv_addr, uint8_t reg)
     i2c_master_stop(cmd);
     ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
     i2c_cmd_link_delete(cmd);
+    count_transaction(1, 0, 1, ret);
     if(ret != ESP_OK) {
         ESP_LOGE(TAG, "SCCB_Read Failed addr:0x%02x, reg:0x%02x, data:0x%02x, ret:%d", slv_addr, reg, data, ret);
     }
@@ -151,15 +173,15 @@ int SCCB_Write(uint8_t slv_addr, uint8_t reg, uint8_t data)
     i2c_master_stop(cmd);
     ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
     i2c_cmd_link_delete(cmd);
+    count_transaction(0, 1, 2, ret);
     if(ret != ESP_OK) {
         ESP_LOGE(TAG, "SCCB_Write Failed addr:0x%02x, reg:0x%02x, data:0x%02x, ret:%d", slv_addr, reg, data, ret);
     }
     return ret == ESP_OK ? 0 : -1;
 }
 
-uint8_t SCCB_Read16(uint8_t slv_addr, uint16_t reg)
+static esp_err_t read16(uint8_t slv_addr, uint16_t reg, uint8_t *data)
 {
-    uint8_t data=0;
     esp_err_t ret = ESP_FAIL;
     uint16_t reg_htons = LITTLETOBIG(reg);
     uint8_t *reg_u8 = (uint8_t *)&reg_htons;
@@ -171,16 +193,40 @@ uint8_t SCCB_Read16(uint8_t slv_addr, uint16_t reg)
     i2c_master_stop(cmd);
     ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
     i2c_cmd_link_delete(cmd);
-    if(ret != ESP_OK) return -1;
+    count_transaction(0, 0, 2, ret);
+    if(ret != ESP_OK) {
+        *data = 0xff;
+        return ret;
+    }
     cmd = i2c_cmd_link_create();
     i2c_master_start(cmd);
     i2c_master_write_byte(cmd, ( slv_addr << 1 ) | READ_BIT, ACK_CHECK_EN);
-    i2c_master_read_byte(cmd, &data, NACK_VAL);
+    i2c_master_read_byte(cmd, data, NACK_VAL);
     i2c_master_stop(cmd);
     ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
     i2c_cmd_link_delete(cmd);
+    count_transaction(1, 0, 1, ret);
     if(ret != ESP_OK) {
-        ESP_LOGE(TAG, "W [%04x]=%02x fail\n", reg, data);
+        ESP_LOGE(TAG, "W [%04x]=%02x fail\n", reg, *data);
+    }
+    return ret;
+}
+
+uint8_t SCCB_Read16(uint8_t slv_addr, uint16_t reg)
+{
+    uint8_t data=0;
+    read16(slv_addr, reg, &data);
+    return data;
+}
+
+uint8_t SCCB_Read16_Shadow(uint8_t slv_addr, uint16_t reg)
+{
+    uint8_t data=0;
+    taskENTER_CRITICAL(&regs_lock);
+    bool hit = sccb_shadow_lookup(slv_addr, reg, &data);
+    taskEXIT_CRITICAL(&regs_lock);
+    if (!hit && read16(slv_addr, reg, &data) == ESP_OK) {
+        shadow_store_run(slv_addr, reg, &data, 1);
     }
     return data;
 }
@@ -200,10 +246,50 @@ int SCCB_Write16(uint8_t slv_addr, uint16_t reg, uint8_t data)
     i2c_master_stop(cmd);
     ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
     i2c_cmd_link_delete(cmd);
+    count_transaction(0, 1, 3, ret);
     if(ret != ESP_OK) {
         ESP_LOGE(TAG, "W [%04x]=%02x %d fail\n", reg, data, i++);
+        return -1;
     }
-    return ret == ESP_OK ? 0 : -1;
+    shadow_store_run(slv_addr, reg, &data, 1);
+    return 0;
+}
+
+int SCCB_Write16_Burst(uint8_t slv_addr, uint16_t reg, const uint8_t *data, size_t len)
+{
+#if CONFIG_SCCB_BURST_WRITE
+    while (len) {
+        // the sensor increments the register address after every data byte
+        size_t chunk = len < SCCB_BURST_MAX ? len : SCCB_BURST_MAX;
+        esp_err_t ret = ESP_FAIL;
+        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, ( slv_addr << 1 ) | WRITE_BIT, ACK_CHECK_EN);
+        i2c_master_write_byte(cmd, reg >> 8, ACK_CHECK_EN);
+        i2c_master_write_byte(cmd, reg & 0xff, ACK_CHECK_EN);
+        i2c_master_write(cmd, (uint8_t *)data, chunk, ACK_CHECK_EN);
+        i2c_master_stop(cmd);
+        ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
+        i2c_cmd_link_delete(cmd);
+        count_transaction(0, chunk, 2 + chunk, ret);
+        if(ret != ESP_OK) {
+            ESP_LOGE(TAG, "W [%04x..%04x] fail\n", reg, reg + chunk - 1);
+            return -1;
+        }
+        shadow_store_run(slv_addr, reg, data, chunk);
+        reg += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+    return 0;
+#else
+    for (size_t i = 0; i < len; i++) {
+        if (SCCB_Write16(slv_addr, reg + i, data[i])) {
+            return -1;
+        }
+    }
+    return 0;
+#endif
 }
 
 uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg)
@@ -221,6 +307,7 @@ uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg)
     i2c_master_stop(cmd);
     ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
     i2c_cmd_link_delete(cmd);
+    count_transaction(0, 0, 2, ret);
     if(ret != ESP_OK) return -1;
 
     cmd = i2c_cmd_link_create();
@@ -231,6 +318,7 @@ uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg)
     i2c_master_stop(cmd);
     ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
     i2c_cmd_link_delete(cmd);
+    count_transaction(2, 0, 2, ret);
     if(ret != ESP_OK) {
         ESP_LOGE(TAG, "W [%04x]=%04x fail\n", reg, data);
     }
@@ -254,8 +342,40 @@ int SCCB_Write_Addr16_Val16(uint8_t slv_addr, uint16_t reg, uint16_t data)
     i2c_master_stop(cmd);
     ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
     i2c_cmd_link_delete(cmd);
+    count_transaction(0, 2, 4, ret);
     if(ret != ESP_OK) {
         ESP_LOGE(TAG, "W [%04x]=%04x fail\n", reg, data);
+        return -1;
     }
-    return ret == ESP_OK ? 0 : -1;
+    shadow_store_run(slv_addr, reg, data_u8, 2);
+    return 0;
+}
+
+bool SCCB_Shadow_Get(uint8_t slv_addr, uint16_t reg, uint8_t *value)
+{
+    taskENTER_CRITICAL(&regs_lock);
+    bool hit = sccb_shadow_lookup(slv_addr, reg, value);
+    taskEXIT_CRITICAL(&regs_lock);
+    return hit;
+}
+
+void SCCB_Shadow_Clear(void)
+{
+    taskENTER_CRITICAL(&regs_lock);
+    sccb_shadow_clear();
+    taskEXIT_CRITICAL(&regs_lock);
+}
+
+void SCCB_Get_Stats(sccb_stats_t *stats)
+{
+    taskENTER_CRITICAL(&regs_lock);
+    sccb_stats_get(stats);
+    taskEXIT_CRITICAL(&regs_lock);
+}
+
+void SCCB_Reset_Stats(void)
+{
+    taskENTER_CRITICAL(&regs_lock);
+    sccb_stats_reset();
+    taskEXIT_CRITICAL(&regs_lock);
 }
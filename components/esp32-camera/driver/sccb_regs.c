@@ -0,0 +1,138 @@
+// Copyright 2010-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+#include "sccb_regs.h"
+
+#define SHADOW_MASK  (SCCB_SHADOW_SLOTS - 1)
+#define SHADOW_LIMIT (SCCB_SHADOW_SLOTS / 4 * 3)
+
+#define REG_TAIL  0x0000
+#define REG_DELAY 0xFFFF
+
+// open addressing with linear probing, slv_addr 0 marks a free slot (it's the general call address)
+typedef struct {
+    uint16_t reg;
+    uint8_t slv_addr;
+    uint8_t value;
+} shadow_slot_t;
+
+static shadow_slot_t s_shadow[SCCB_SHADOW_SLOTS];
+static size_t s_shadow_used;
+static sccb_stats_t s_stats;
+
+static inline uint32_t shadow_hash(uint8_t slv_addr, uint16_t reg)
+{
+    const uint32_t key = ((uint32_t)slv_addr << 16) | reg;
+    return (key * 2654435761u) >> 16;
+}
+
+// the slot holding the register, or the free slot where it would go, NULL if neither exists
+static shadow_slot_t *shadow_find(uint8_t slv_addr, uint16_t reg)
+{
+    uint32_t index = shadow_hash(slv_addr, reg) & SHADOW_MASK;
+    for (size_t probes = 0; probes < SCCB_SHADOW_SLOTS; probes++) {
+        shadow_slot_t *slot = &s_shadow[index];
+        if (slot->slv_addr == 0 || (slot->slv_addr == slv_addr && slot->reg == reg)) {
+            return slot;
+        }
+        index = (index + 1) & SHADOW_MASK;
+    }
+    return NULL;
+}
+
+void sccb_shadow_store(uint8_t slv_addr, uint16_t reg, uint8_t value)
+{
+    shadow_slot_t *slot = shadow_find(slv_addr, reg);
+    if (slot == NULL) {
+        return;
+    }
+    if (slot->slv_addr == 0) {
+        // keep the probe chains short, a full table only costs bus reads
+        if (s_shadow_used >= SHADOW_LIMIT) {
+            return;
+        }
+        slot->slv_addr = slv_addr;
+        slot->reg = reg;
+        s_shadow_used++;
+    }
+    slot->value = value;
+}
+
+void sccb_shadow_store_run(uint8_t slv_addr, uint16_t reg, const uint8_t *values, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        sccb_shadow_store(slv_addr, reg + i, values[i]);
+    }
+}
+
+bool sccb_shadow_lookup(uint8_t slv_addr, uint16_t reg, uint8_t *value)
+{
+    const shadow_slot_t *slot = shadow_find(slv_addr, reg);
+    if (slot == NULL || slot->slv_addr == 0) {
+        s_stats.shadow_misses++;
+        return false;
+    }
+    s_stats.shadow_hits++;
+    *value = slot->value;
+    return true;
+}
+
+void sccb_shadow_clear(void)
+{
+    memset(s_shadow, 0, sizeof(s_shadow));
+    s_shadow_used = 0;
+}
+
+size_t sccb_shadow_size(void)
+{
+    return s_shadow_used;
+}
+
+void sccb_stats_count(uint32_t reads, uint32_t writes, uint32_t bytes, bool ok)
+{
+    s_stats.transactions++;
+    s_stats.reads += reads;
+    s_stats.writes += writes;
+    s_stats.bytes += bytes;
+    if (writes > 1) {
+        s_stats.bursts++;
+    }
+    if (!ok) {
+        s_stats.errors++;
+    }
+}
+
+void sccb_stats_get(sccb_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+void sccb_stats_reset(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+size_t sccb_reg_run(const uint16_t (*regs)[2], size_t max_len)
+{
+    size_t len = 1;
+    while (len < max_len) {
+        const uint16_t reg = regs[len][0];
+        if (reg == REG_TAIL || reg == REG_DELAY || reg != (uint16_t)(regs[0][0] + len)) {
+            break;
+        }
+        len++;
+    }
+    return len;
+}
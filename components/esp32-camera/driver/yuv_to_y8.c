@@ -0,0 +1,31 @@
+// Copyright 2010-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "yuv_to_y8.h"
+
+// A load and a store per byte, packing the Y bytes into words costs more than that on the Xtensa
+// (an extract and a shift for each of them) and hosts vectorize this loop on their own.
+size_t yuyv_to_y8(uint8_t *out, const uint8_t *in, size_t len)
+{
+    const size_t end = len / 8;
+    for (size_t i = 0; i < end; ++i) {
+        out[0] = in[0];
+        out[1] = in[2];
+        out[2] = in[4];
+        out[3] = in[6];
+        out += 4;
+        in += 8;
+    }
+    return len / 2;
+}
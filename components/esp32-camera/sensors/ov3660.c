@@ -36,8 +36,13 @@ static int read_reg(uint8_t slv_addr, const uint16_t reg){
     return ret;
 }
 
+// for control registers only the driver writes, answered from the SCCB shadow once they've been written
+static int read_reg_shadow(uint8_t slv_addr, const uint16_t reg){
+    return SCCB_Read16_Shadow(slv_addr, reg);
+}
+
 static int check_reg_mask(uint8_t slv_addr, uint16_t reg, uint8_t mask){
-    return (read_reg(slv_addr, reg) & mask) == mask;
+    return (read_reg_shadow(slv_addr, reg) & mask) == mask;
 }
 
 static int read_reg16(uint8_t slv_addr, const uint16_t reg){
@@ -60,6 +65,10 @@ static int write_reg(uint8_t slv_addr, const uint16_t reg, uint8_t value){
     int ret = 0;
 #ifndef REG_DEBUG_ON
     ret = SCCB_Write16(slv_addr, reg, value);
+    if (ret == 0 && reg == SYSTEM_CTROL0 && (value & 0x80)) {
+        // software reset, everything the shadow knows is back to its default
+        SCCB_Shadow_Clear();
+    }
 #else
     int old_value = read_reg(slv_addr, reg);
     if (old_value < 0) {
@@ -83,44 +92,113 @@ static int set_reg_bits(uint8_t slv_addr, uint16_t reg, uint8_t offset, uint8_t
 {
     int ret = 0;
     uint8_t c_value, new_value;
-    ret = read_reg(slv_addr, reg);
+    ret = read_reg_shadow(slv_addr, reg);
     if(ret < 0) {
         return ret;
     }
     c_value = ret;
     new_value = (c_value & ~(mask << offset)) | ((value & mask) << offset);
+    if (new_value == c_value) {
+        return 0;
+    }
     ret = write_reg(slv_addr, reg, new_value);
     return ret;
 }
 
+static int write_burst(uint8_t slv_addr, const uint16_t reg, const uint8_t *values, size_t count){
+#ifndef REG_DEBUG_ON
+    return SCCB_Write16_Burst(slv_addr, reg, values, count);
+#else
+    for (size_t i = 0; i < count; i++) {
+        if (write_reg(slv_addr, reg + i, values[i])) {
+            return -1;
+        }
+    }
+    return 0;
+#endif
+}
+
+static bool in_shadow(uint8_t slv_addr, const uint16_t reg, uint8_t value){
+    uint8_t current;
+    return SCCB_Shadow_Get(slv_addr, reg, &current) && current == value;
+}
+
+// only the registers that don't already hold the wanted value according to the shadow, in as few bursts as that takes
+static int write_burst_delta(uint8_t slv_addr, const uint16_t reg, const uint8_t *values, size_t count){
+    size_t i = 0;
+    while (i < count) {
+        if (in_shadow(slv_addr, reg + i, values[i])) {
+            i++;
+            continue;
+        }
+        // every burst starts with three bytes of addressing, short gaps of unchanged registers are cheaper to rewrite
+        size_t last = i;
+        for (size_t j = i + 1; j < count && j - last <= 3; j++) {
+            if (!in_shadow(slv_addr, reg + j, values[j])) {
+                last = j;
+            }
+        }
+        if (write_burst(slv_addr, reg + i, &values[i], last + 1 - i)) {
+            return -1;
+        }
+        i = last + 1;
+    }
+    return 0;
+}
+
+static int write_reg_delta(uint8_t slv_addr, const uint16_t reg, uint8_t value){
+    return write_burst_delta(slv_addr, reg, &value, 1);
+}
+
 static int write_regs(uint8_t slv_addr, const uint16_t (*regs)[2])
 {
     int i = 0, ret = 0;
+    uint8_t values[SCCB_BURST_MAX];
     while (!ret && regs[i][0] != REGLIST_TAIL) {
         if (regs[i][0] == REG_DLY) {
             vTaskDelay(regs[i][1] / portTICK_PERIOD_MS);
-        } else {
-            ret = write_reg(slv_addr, regs[i][0], regs[i][1]);
+            i++;
+            continue;
+        }
+        // runs of consecutive registers go out as one transaction
+        const uint16_t reg = regs[i][0];
+        const size_t count = sccb_reg_run(&regs[i], SCCB_BURST_MAX);
+        bool reset = false;
+        for (size_t j = 0; j < count; j++) {
+            values[j] = regs[i + j][1];
+            reset |= (reg + j == SYSTEM_CTROL0) && (values[j] & 0x80);
+        }
+        ret = write_burst(slv_addr, reg, values, count);
+        if (ret == 0 && reset) {
+            SCCB_Shadow_Clear();
         }
-        i++;
+        i += count;
     }
     return ret;
 }
 
 static int write_reg16(uint8_t slv_addr, const uint16_t reg, uint16_t value)
 {
-    if (write_reg(slv_addr, reg, value >> 8) || write_reg(slv_addr, reg + 1, value)) {
-        return -1;
-    }
-    return 0;
+    const uint8_t values[2] = { value >> 8, value };
+    return write_burst(slv_addr, reg, values, 2) ? -1 : 0;
 }
 
 static int write_addr_reg(uint8_t slv_addr, const uint16_t reg, uint16_t x_value, uint16_t y_value)
 {
-    if (write_reg16(slv_addr, reg, x_value) || write_reg16(slv_addr, reg + 2, y_value)) {
-        return -1;
+    const uint8_t values[4] = { x_value >> 8, x_value, y_value >> 8, y_value };
+    return write_burst(slv_addr, reg, values, 4) ? -1 : 0;
+}
+
+// the 0x3800-0x3813 timing block (window, output size, totals, ISP offset), whatever changed of it
+static int write_timing_regs(uint8_t slv_addr, int startX, int startY, int endX, int endY, int outputX, int outputY, int totalX, int totalY, int offsetX, int offsetY)
+{
+    const uint16_t words[10] = { startX, startY, endX, endY, outputX, outputY, totalX, totalY, offsetX, offsetY };
+    uint8_t values[20];
+    for (size_t i = 0; i < 10; i++) {
+        values[i * 2] = words[i] >> 8;
+        values[i * 2 + 1] = words[i];
     }
-    return 0;
+    return write_burst_delta(slv_addr, X_ADDR_ST_H, values, sizeof(values));
 }
 
 #define write_reg_bits(slv_addr, reg, mask, enable) set_reg_bits(slv_addr, reg, 0, mask, enable?mask:0)
@@ -164,6 +242,9 @@ static int wait_sccb_ready(sensor_t *sensor, int timeout_ms)
     return -1;
 }
 
+// XCLK the PLL registers in the shadow were last locked at
+static int pll_locked_xclk_hz;
+
 static int set_pll(sensor_t *sensor, bool bypass, uint8_t multiplier, uint8_t sys_div, uint8_t pre_div, bool root_2x, uint8_t seld5, bool pclk_manual, uint8_t pclk_div){
     int ret = 0;
     if(multiplier > 31 || sys_div > 15 || pre_div > 3 || pclk_div > 31 || seld5 > 3){
@@ -171,39 +252,51 @@ static int set_pll(sensor_t *sensor, bool bypass, uint8_t multiplier, uint8_t sy
         return -1;
     }
 
+    // Adapt charge-pump bits (0x303C[6:4]) to REFIN instead of a hard-coded 001.
+    // PLL loop bandwidth scales with REFIN; a wrong CP code increases
+    // jitter transfer. Empirical upstream values:
+    //   REFIN <  7 MHz       -> code 001 (0x10)
+    //   REFIN in [7,11] MHz  -> code 010 (0x20)
+    //   REFIN > 11 MHz       -> code 011 (0x30)
+    const int pre_div_val_x10[] = { 10, 15, 20, 30 }; // pre_div idx -> multiplier *10
+    const int refin_x10 = (sensor->xclk_freq_hz / 100000) * 10 / pre_div_val_x10[pre_div & 0x3];
+    uint8_t cp_code;
+    if (refin_x10 < 70) {
+        cp_code = 0x10;
+    } else if (refin_x10 <= 110) {
+        cp_code = 0x20;
+    } else {
+        cp_code = 0x30;
+    }
+    // SC_PLLS_CTRL0..3 are consecutive, one transaction
+    const uint8_t plls[4] = {
+        bypass?0x80:0x00,
+        multiplier & 0x1f,
+        cp_code | (sys_div & 0x0f),
+        (pre_div & 0x3) << 4 | seld5 | (root_2x?0x40:0x00),
+    };
+    const uint8_t pclk_ratio = pclk_div & 0x1f;
+    const uint8_t vfifo = pclk_manual?0x22:0x20;
+
+    // same clock tree as the sensor already runs, a frame size change between modes that share it
+    // (or a host reopening the stream) doesn't need the PLL to relock
+    if (sensor->xclk_freq_hz == pll_locked_xclk_hz
+        && in_shadow(sensor->slv_addr, SC_PLLS_CTRL0, plls[0]) && in_shadow(sensor->slv_addr, SC_PLLS_CTRL1, plls[1])
+        && in_shadow(sensor->slv_addr, SC_PLLS_CTRL2, plls[2]) && in_shadow(sensor->slv_addr, SC_PLLS_CTRL3, plls[3])
+        && in_shadow(sensor->slv_addr, PCLK_RATIO, pclk_ratio) && in_shadow(sensor->slv_addr, VFIFO_CTRL0C, vfifo)) {
+        ESP_LOGD(TAG, "PLL unchanged, no relock");
+        return 0;
+    }
+
     calc_sysclk(sensor->xclk_freq_hz, bypass, multiplier, sys_div, pre_div, root_2x, seld5, pclk_manual, pclk_div);
 
-    ret = write_reg(sensor->slv_addr, SC_PLLS_CTRL0, bypass?0x80:0x00);
-    if (ret == 0) {
-        ret = write_reg(sensor->slv_addr, SC_PLLS_CTRL1, multiplier & 0x1f);
-    }
-    if (ret == 0) {
-        // Adapt charge-pump bits (0x303C[6:4]) to REFIN instead of a hard-coded 001.
-        // PLL loop bandwidth scales with REFIN; a wrong CP code increases
-        // jitter transfer. Empirical upstream values:
-        //   REFIN <  7 MHz       -> code 001 (0x10)
-        //   REFIN in [7,11] MHz  -> code 010 (0x20)
-        //   REFIN > 11 MHz       -> code 011 (0x30)
-        const int pre_div_val_x10[] = { 10, 15, 20, 30 }; // pre_div idx -> multiplier *10
-        const int refin_x10 = (sensor->xclk_freq_hz / 100000) * 10 / pre_div_val_x10[pre_div & 0x3];
-        uint8_t cp_code;
-        if (refin_x10 < 70) {
-            cp_code = 0x10;
-        } else if (refin_x10 <= 110) {
-            cp_code = 0x20;
-        } else {
-            cp_code = 0x30;
-        }
-        ret = write_reg(sensor->slv_addr, SC_PLLS_CTRL2, cp_code | (sys_div & 0x0f));
-    }
-    if (ret == 0) {
-        ret = write_reg(sensor->slv_addr, SC_PLLS_CTRL3, (pre_div & 0x3) << 4 | seld5 | (root_2x?0x40:0x00));
-    }
+    pll_locked_xclk_hz = 0;
+    ret = write_burst_delta(sensor->slv_addr, SC_PLLS_CTRL0, plls, sizeof(plls));
     if (ret == 0) {
-        ret = write_reg(sensor->slv_addr, PCLK_RATIO, pclk_div & 0x1f);
+        ret = write_reg_delta(sensor->slv_addr, PCLK_RATIO, pclk_ratio);
     }
     if (ret == 0) {
-        ret = write_reg(sensor->slv_addr, VFIFO_CTRL0C, pclk_manual?0x22:0x20);
+        ret = write_reg_delta(sensor->slv_addr, VFIFO_CTRL0C, vfifo);
     }
     if(ret){
         ESP_LOGE(TAG, "set_sensor_pll FAILED!");
@@ -216,6 +309,7 @@ static int set_pll(sensor_t *sensor, bool bypass, uint8_t multiplier, uint8_t sy
         ESP_LOGE(TAG, "SCCB not ready after PLL config (sensor may not have locked)");
         return -1;
     }
+    pll_locked_xclk_hz = sensor->xclk_freq_hz;
     return 0;
 }
 
@@ -333,21 +427,21 @@ static int set_image_options(sensor_t *sensor)
         case 7: reg4514 = 0xaa; break;//v-flip+h-mirror
     }
 
-    if(write_reg(sensor->slv_addr, TIMING_TC_REG20, reg20)
-        || write_reg(sensor->slv_addr, TIMING_TC_REG21, reg21)
-        || write_reg(sensor->slv_addr, 0x4514, reg4514)){
+    const uint8_t reg20_21[2] = { reg20, reg21 };
+    if(write_burst_delta(sensor->slv_addr, TIMING_TC_REG20, reg20_21, 2)
+        || write_reg_delta(sensor->slv_addr, 0x4514, reg4514)){
         ESP_LOGE(TAG, "Setting Image Options Failed");
         ret = -1;
     }
 
     if (sensor->status.binning) {
-        ret  = write_reg(sensor->slv_addr, 0x4520, 0x0b)
-            || write_reg(sensor->slv_addr, X_INCREMENT, 0x31)//odd:3, even: 1
-            || write_reg(sensor->slv_addr, Y_INCREMENT, 0x31);//odd:3, even: 1
+        const uint8_t increments[2] = { 0x31, 0x31 };//odd:3, even: 1 for x and y
+        ret  = write_reg_delta(sensor->slv_addr, 0x4520, 0x0b)
+            || write_burst_delta(sensor->slv_addr, X_INCREMENT, increments, 2);
     } else {
-        ret  = write_reg(sensor->slv_addr, 0x4520, 0xb0)
-            || write_reg(sensor->slv_addr, X_INCREMENT, 0x11)//odd:1, even: 1
-            || write_reg(sensor->slv_addr, Y_INCREMENT, 0x11);//odd:1, even: 1
+        const uint8_t increments[2] = { 0x11, 0x11 };//odd:1, even: 1 for x and y
+        ret  = write_reg_delta(sensor->slv_addr, 0x4520, 0xb0)
+            || write_burst_delta(sensor->slv_addr, X_INCREMENT, increments, 2);
     }
 
     ESP_LOGD(TAG, "Set Image Options: Compression: %u, Binning: %u, V-Flip: %u, H-Mirror: %u, Reg-4514: 0x%02x",
@@ -374,20 +468,12 @@ static int set_framesize(sensor_t *sensor, framesize_t framesize)
     sensor->status.scale = !((w == settings.max_width && h == settings.max_height)
         || (w == (settings.max_width / 2) && h == (settings.max_height / 2)));
 
-    ret  = write_addr_reg(sensor->slv_addr, X_ADDR_ST_H, settings.start_x, settings.start_y)
-        || write_addr_reg(sensor->slv_addr, X_ADDR_END_H, settings.end_x, settings.end_y)
-        || write_addr_reg(sensor->slv_addr, X_OUTPUT_SIZE_H, w, h);
-
-    if (ret) {
-        goto fail;
-    }
-
     if (sensor->status.binning) {
-        ret  = write_addr_reg(sensor->slv_addr, X_TOTAL_SIZE_H, settings.total_x, (settings.total_y / 2) + 1)
-            || write_addr_reg(sensor->slv_addr, X_OFFSET_H, 8, 2);
+        ret = write_timing_regs(sensor->slv_addr, settings.start_x, settings.start_y, settings.end_x, settings.end_y,
+            w, h, settings.total_x, (settings.total_y / 2) + 1, 8, 2);
     } else {
-        ret  = write_addr_reg(sensor->slv_addr, X_TOTAL_SIZE_H, settings.total_x, settings.total_y)
-            || write_addr_reg(sensor->slv_addr, X_OFFSET_H, 16, 6);
+        ret = write_timing_regs(sensor->slv_addr, settings.start_x, settings.start_y, settings.end_x, settings.end_y,
+            w, h, settings.total_x, settings.total_y, 16, 6);
     }
 
     if (ret == 0) {
@@ -985,7 +1071,9 @@ static int get_reg(sensor_t *sensor, int reg, int mask)
 static int set_reg(sensor_t *sensor, int reg, int mask, int value)
 {
     int ret = 0, ret2 = 0;
-    if(mask > 0xFF){
+    if(mask == 0xFF || mask == 0xFFFF || mask == 0xFFFFFF){
+        // every bit gets replaced, the old value doesn't matter
+    } else if(mask > 0xFF){
         ret = read_reg16(sensor->slv_addr, reg);
         if(ret >= 0 && mask > 0xFFFF){
             ret2 = read_reg(sensor->slv_addr, reg+2);
@@ -1018,11 +1106,7 @@ static int set_reg(sensor_t *sensor, int reg, int mask, int value)
 static int set_res_raw(sensor_t *sensor, int startX, int startY, int endX, int endY, int offsetX, int offsetY, int totalX, int totalY, int outputX, int outputY, bool scale, bool binning)
 {
     int ret = 0;
-    ret  = write_addr_reg(sensor->slv_addr, X_ADDR_ST_H, startX, startY)
-        || write_addr_reg(sensor->slv_addr, X_ADDR_END_H, endX, endY)
-        || write_addr_reg(sensor->slv_addr, X_OFFSET_H, offsetX, offsetY)
-        || write_addr_reg(sensor->slv_addr, X_TOTAL_SIZE_H, totalX, totalY)
-        || write_addr_reg(sensor->slv_addr, X_OUTPUT_SIZE_H, outputX, outputY)
+    ret  = write_timing_regs(sensor->slv_addr, startX, startY, endX, endY, outputX, outputY, totalX, totalY, offsetX, offsetY)
         || write_reg_bits(sensor->slv_addr, ISP_CONTROL_01, 0x20, scale);
     if(!ret){
         sensor->status.scale = scale;
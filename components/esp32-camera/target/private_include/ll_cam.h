@@ -88,6 +88,11 @@ typedef enum {
 typedef struct {
     camera_fb_t fb;
     uint8_t en;
+    //esp_timer time of the DMA EOF that completed the frame and of the cam_take that handed it out
+    int64_t eof_us;
+    int64_t taken_us;
+    //number of the frame since the driver started, counts frames dropped before anyone took them too
+    uint32_t sequence;
     //for RGB/YUV modes
     lldesc_t *dma;
     size_t fb_offset;
@@ -125,7 +130,8 @@ typedef struct {
     uint32_t frame_cnt;
     uint32_t recv_size;
     bool swap_data;
-    bool psram_mode;
+    bool psram_mode;    // DMA writes straight into the frame buffers, no ping-pong copy
+    bool fb_internal;   // frame buffers are in internal RAM, so DMA bursts can stay on
 
     //for RGB/YUV modes
     uint16_t width;
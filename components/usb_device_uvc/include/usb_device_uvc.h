@@ -20,8 +20,11 @@ extern "C" {
 typedef enum {
     UVC_FORMAT_JPEG,            /*!< JPEG format */
     UVC_FORMAT_H264,            /*!< H264 format */
+    UVC_FORMAT_GREY,            /*!< Uncompressed 8 bit luminance (Y800), width * height bytes */
 } uvc_format_t;
 
+#define UVC_FB_META_MAX 32     /*!< Most vendor metadata bytes a frame can carry */
+
 /**
  * @brief Frame buffer structure
  */
@@ -32,13 +35,23 @@ typedef struct {
     size_t height;              /*!< Height of the image frame in pixels */
     uvc_format_t format;        /*!< Format of the frame data */
     struct timeval timestamp;   /*!< Timestamp since boot of the frame */
+    uint8_t meta[UVC_FB_META_MAX]; /*!< Optional vendor metadata, goes out behind PTS/SCR in the frame's first payload header */
+    size_t meta_len;            /*!< Bytes used in meta, 0 for none */
 } uvc_fb_t;
 
 /**
  * @brief type of callback function when host open the UVC device
+ * @note  Runs on the video task once the stream starts, not in the commit, so it may take its time.
+ *        A failure leaves the stream without frames until the host commits again.
  */
 typedef esp_err_t (*uvc_input_start_cb_t)(uvc_format_t format, int width, int height, int rate, void *cb_ctx);
 
+/**
+ * @brief type of callback function that checks a format the host is committing
+ * @note  Runs on the TinyUSB task inside the commit, so it must not block. Anything but ESP_OK fails the commit.
+ */
+typedef esp_err_t (*uvc_input_validate_cb_t)(uvc_format_t format, int width, int height, int rate, void *cb_ctx);
+
 /**
  * @brief type of callback function when host request a new frame buffer
  */
@@ -54,19 +67,49 @@ typedef void (*uvc_input_fb_return_cb_t)(uvc_fb_t *fb, void *cb_ctx);
  */
 typedef void (*uvc_input_stop_cb_t)(void *cb_ctx);
 
+/**
+ * @brief type of callback function when a frame buffer starts going out over USB
+ */
+typedef void (*uvc_input_xfer_start_cb_t)(uvc_fb_t *fb, void *cb_ctx);
+
 /**
  * @brief Configuration for the UVC device
  */
 typedef struct {
-    uint8_t *uvc_buffer;                   /*!< UVC transfer buffer */
-    uint32_t uvc_buffer_size;              /*!< UVC transfer buffer size, should bigger than one frame size */
+    uint8_t *uvc_buffer;                   /*!< optional, unused since frames are sent straight from the frame buffer, may be NULL */
+    uint32_t uvc_buffer_size;              /*!< largest frame that will be sent, bigger ones are dropped */
     uvc_input_start_cb_t start_cb;         /*!< callback function of host open the UVC device with the specific format and resolution */
     uvc_input_fb_get_cb_t fb_get_cb;       /*!< callback function of host request a new frame buffer */
     uvc_input_fb_return_cb_t fb_return_cb; /*!< callback function of the frame buffer is no longer used */
     uvc_input_stop_cb_t stop_cb;           /*!< callback function of host close the UVC device */
+    uvc_input_xfer_start_cb_t xfer_start_cb; /*!< optional, callback function of a frame buffer handed to the USB stack */
+    uvc_input_validate_cb_t validate_cb;   /*!< optional, callback function of host committing a format, before start_cb runs with it */
     void *cb_ctx;                          /*!< callback context, for user specific usage */
 } uvc_device_config_t;
 
+/**
+ * @brief Frame timing of the UVC stream, reset whenever the host starts streaming
+ */
+typedef struct {
+    uint32_t frames_sent;               /*!< Transfers started */
+    uint32_t frames_dropped;            /*!< Frames dropped because of an invalid size */
+    uint32_t capture_failures;          /*!< fb_get_cb calls that returned no frame */
+    uint32_t start_failures;            /*!< start_cb calls that failed, the stream sends nothing until the next commit */
+    uint32_t prefetched;                /*!< Frames that were already captured when the previous transfer finished */
+    uint32_t last_interval_us;          /*!< Time between the starts of the last two transfers */
+    uint32_t min_interval_us;           /*!< Shortest time between two transfer starts */
+    uint32_t max_interval_us;           /*!< Longest time between two transfer starts */
+    uint32_t avg_interval_us;           /*!< Average time between two transfer starts */
+    uint32_t last_latency_us;           /*!< Camera timestamp to transfer start of the last frame */
+    uint32_t avg_latency_us;            /*!< Average camera timestamp to transfer start */
+    uint32_t target_interval_us;        /*!< Frame interval the host committed */
+    uint32_t last_late_us;              /*!< How late the last transfer started against its slot in the schedule */
+    uint32_t max_late_us;               /*!< Latest transfer start against its slot */
+    uint32_t avg_late_us;               /*!< Average transfer start against its slot */
+    uint32_t resyncs;                   /*!< Times the schedule restarted because frames fell more than one interval behind */
+    uint32_t payload_headers;           /*!< Frames whose first payload header carried SCR, PTS and the metadata, stays 0 if TinyUSB sends its own */
+} uvc_device_stats_t;
+
 /**
  * @brief Configure the UVC device by uvc device number
  *
@@ -87,6 +130,16 @@ esp_err_t uvc_device_config(int index, uvc_device_config_t *config);
  */
 esp_err_t uvc_device_init(void);
 
+/**
+ * @brief Get the frame timing of the current (or last) stream
+ *
+ * @param index UVC device index number
+ * @param stats Where to store the timing
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if the index is invalid or stats is NULL
+ */
+esp_err_t uvc_device_get_stats(int index, uvc_device_stats_t *stats);
+
 // Select active frame profile before uvc_device_init: true -> 320x320 only, false -> 240x240 only
 void uvc_select_frame_profile(bool use_320);
 bool uvc_is_frame_profile_320(void);
@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileCopyrightText: 2022-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief UVC payload header with the presentation time and the source clock reference
+ *
+ * PTS is the sensor's VSYNC of the frame and the STC part of the SCR the time the payload went out,
+ * both on the device clock in units of dwClockFrequency. The SCR pairs that STC with the USB frame
+ * number (SOF) read at the same moment, which lets the host map device time onto its own bus clock and
+ * put the capture time of every frame on its timeline, instead of timestamping frames when they arrive.
+ * No hardware dependencies, usb_device_uvc.c reads the clocks and the host tests run the same code.
+ */
+
+#define UVC_HEADER_FID      (1U << 0)   /*!< Frame ID, toggles every frame */
+#define UVC_HEADER_EOF      (1U << 1)   /*!< End of frame */
+#define UVC_HEADER_PTS      (1U << 2)   /*!< dwPresentationTime present */
+#define UVC_HEADER_SCR      (1U << 3)   /*!< scrSourceClock present */
+#define UVC_HEADER_EOH      (1U << 7)   /*!< End of header */
+
+#define UVC_HEADER_MAX_LEN  12          /*!< bHeaderLength with both PTS and SCR */
+#define UVC_SOF_MASK        0x7FF       /*!< The SCR carries an 11 bit USB frame number */
+
+/**
+ * @brief Device time in ticks of the UVC clock
+ *
+ * The result wraps at 32 bits the way the header fields do, consecutive calls stay consistent across the wrap.
+ *
+ * @param us           Microseconds since boot, esp_timer_get_time() or a frame's VSYNC timestamp
+ * @param frequency_hz dwClockFrequency of the video control interface
+ */
+uint32_t uvc_clock_ticks(int64_t us, uint32_t frequency_hz);
+
+/**
+ * @brief Write a payload header, keeping the FID and EOF bits already in hdr[1]
+ *
+ * @param hdr     Start of the payload, at least UVC_HEADER_MAX_LEN bytes
+ * @param has_pts false leaves out the PTS, for frames without a capture time
+ * @param pts     Capture time of the frame, in clock ticks
+ * @param stc     Device clock when the payload is queued, in clock ticks
+ * @param sof     USB frame number read together with stc, only the low 11 bits are sent
+ *
+ * @return bHeaderLength, where the payload data starts
+ */
+size_t uvc_clock_fill_header(uint8_t *hdr, bool has_pts, uint32_t pts, uint32_t stc, uint16_t sof);
+
+/**
+ * @brief Write the two byte header without PTS and SCR, keeping FID and EOF
+ *
+ * The clock fields only have to come once per frame, the payloads after the first one of a frame skip
+ * them. With 64 byte bulk packets they would otherwise cost a sixth of the bandwidth.
+ *
+ * @return bHeaderLength
+ */
+size_t uvc_clock_short_header(uint8_t *hdr);
+
+/**
+ * @brief Append vendor bytes behind the fields of a header written by one of the functions above
+ *
+ * Hosts skip them through bHeaderLength, the ones that look (the Linux metadata node, libusb based
+ * readers) find them right after the SCR.
+ *
+ * @param hdr  Header to extend, bHeaderLength plus len must stay below 256
+ * @param data Bytes to append
+ * @param len  Number of bytes
+ *
+ * @return the new bHeaderLength, the old one if it wouldn't fit
+ */
+size_t uvc_clock_append(uint8_t *hdr, const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: 2022-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Frame pacing of one UVC stream
+ *
+ * Keeps an absolute schedule in microseconds, so an interval like 16666.7 us (60 fps) doesn't get
+ * truncated to whole milliseconds and the rounding doesn't add up from frame to frame.
+ * No hardware dependencies, video_task wakes itself up at uvc_pacer_due() with an esp_timer and the
+ * host tests run the same code against a simulated clock.
+ */
+typedef struct {
+    uint32_t interval_us;       /*!< Committed frame interval */
+    uint32_t remainder;         /*!< Sub-microsecond part of the interval, in 100 ns units */
+    uint32_t fraction;          /*!< Accumulated sub-microsecond part, in 100 ns units */
+    int64_t next_due_us;        /*!< Earliest start of the next transfer, 0 before the first frame */
+    uint32_t frames;            /*!< Frames that went out on schedule or late */
+    uint32_t resyncs;           /*!< Times the schedule was moved because we fell more than a frame behind */
+    uint32_t last_late_us;      /*!< How late the last transfer started against its slot */
+    uint32_t max_late_us;       /*!< Latest start of this stream */
+    uint64_t late_sum_us;       /*!< For the average */
+} uvc_pacer_t;
+
+/**
+ * @brief Start pacing a stream
+ *
+ * @param pacer            Pacer to reset
+ * @param frame_interval   dwFrameInterval the host committed, in 100 ns units
+ */
+void uvc_pacer_start(uvc_pacer_t *pacer, uint32_t frame_interval);
+
+/**
+ * @brief When the next transfer may start, 0 if it may start right away
+ */
+static inline int64_t uvc_pacer_due(const uvc_pacer_t *pacer)
+{
+    return pacer->next_due_us;
+}
+
+/**
+ * @brief A transfer started, book it and schedule the next one
+ *
+ * @param pacer  Pacer of the stream
+ * @param now_us Time the transfer started
+ */
+void uvc_pacer_sent(uvc_pacer_t *pacer, int64_t now_us);
+
+/**
+ * @brief Average lateness of the transfers so far
+ */
+uint32_t uvc_pacer_avg_late_us(const uvc_pacer_t *pacer);
+
+#ifdef __cplusplus
+}
+#endif
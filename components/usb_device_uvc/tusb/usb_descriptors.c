@@ -81,30 +81,36 @@ uint8_t const *tud_descriptor_device_cb(void)
 // Endpoint numbers for UVC video IN endpoints (device -> host)
 #define EPNUM_CAM1_VIDEO_IN 0x83
 
-// Single-size MJPEG bulk descriptors; we return either 320 or 240 variant at runtime
-#define TUD_CAM1_VIDEO_CAPTURE_DESC_LEN (TUD_VIDEO_CAPTURE_DESC_MJPEG_BULK_LEN)
-
-#define CONFIG_TOTAL_LEN_320 (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_CAM1_VIDEO_CAPTURE_DESC_LEN)
-#define CONFIG_TOTAL_LEN_240 (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_CAM1_VIDEO_CAPTURE_DESC_LEN)
+// MJPEG bulk descriptors with every frame size of the profile, each at UVC_FRAME_RATE_HIGH/DEFAULT/LOW.
+// We return either the 320 or the 240 variant at runtime, frame order matches UVC_FRAMES_INFO_320/240.
+// With CONFIG_UVC_CAM1_GREY_FORMAT both also carry the raw Y800 format as bFormatIndex 2.
+#define CONFIG_TOTAL_LEN_320 (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_VIDEO_CAPTURE_DESC_MJPEG_RATES_BULK_LEN(UVC_FRAME_NUM_320))
+#define CONFIG_TOTAL_LEN_240 (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_VIDEO_CAPTURE_DESC_MJPEG_RATES_BULK_LEN(UVC_FRAME_NUM_240))
 
 static uint8_t const desc_fs_configuration_320[] = {
     TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN_320, 0, 200),
     TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, 6, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, 64),
-    // Camera 1, single-size MJPEG over BULK 320x320
-    TUD_VIDEO_CAPTURE_DESCRIPTOR_MJPEG_BULK(STRID_UVC_CAM1, ITF_NUM_VIDEO_CONTROL, EPNUM_CAM1_VIDEO_IN,
-                                            320, 320, CONFIG_UVC_CAM1_FRAMERATE,
-                                            CFG_TUD_CAM1_VIDEO_STREAMING_EP_BUFSIZE),
+    // Camera 1, MJPEG over BULK 320x320, 240x240, 128x128 (+ Y800 128x128, 96x96)
+    TUD_VIDEO_CAPTURE_DESCRIPTOR_MJPEG_RATES_BULK(STRID_UVC_CAM1, ITF_NUM_VIDEO_CONTROL, EPNUM_CAM1_VIDEO_IN,
+                                                  CFG_TUD_CAM1_VIDEO_STREAMING_EP_BUFSIZE, UVC_FRAME_NUM_320,
+                                                  TUD_VIDEO_DESC_CS_VS_FRM_MJPEG_RATES(1, UVC_FRAME_SIZE_LARGE, UVC_FRAME_SIZE_LARGE),
+                                                  TUD_VIDEO_DESC_CS_VS_FRM_MJPEG_RATES(2, UVC_FRAME_SIZE_MEDIUM, UVC_FRAME_SIZE_MEDIUM),
+                                                  TUD_VIDEO_DESC_CS_VS_FRM_MJPEG_RATES(3, UVC_FRAME_SIZE_SMALL, UVC_FRAME_SIZE_SMALL)),
 };
 
 static uint8_t const desc_fs_configuration_240[] = {
     TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN_240, 0, 200),
     TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, 6, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, 64),
-    // Camera 1, single-size MJPEG over BULK 240x240
-    TUD_VIDEO_CAPTURE_DESCRIPTOR_MJPEG_BULK(STRID_UVC_CAM1, ITF_NUM_VIDEO_CONTROL, EPNUM_CAM1_VIDEO_IN,
-                                            240, 240, CONFIG_UVC_CAM1_FRAMERATE,
-                                            CFG_TUD_CAM1_VIDEO_STREAMING_EP_BUFSIZE),
+    // Camera 1, MJPEG over BULK 240x240, 128x128 (+ Y800 128x128, 96x96)
+    TUD_VIDEO_CAPTURE_DESCRIPTOR_MJPEG_RATES_BULK(STRID_UVC_CAM1, ITF_NUM_VIDEO_CONTROL, EPNUM_CAM1_VIDEO_IN,
+                                                  CFG_TUD_CAM1_VIDEO_STREAMING_EP_BUFSIZE, UVC_FRAME_NUM_240,
+                                                  TUD_VIDEO_DESC_CS_VS_FRM_MJPEG_RATES(1, UVC_FRAME_SIZE_MEDIUM, UVC_FRAME_SIZE_MEDIUM),
+                                                  TUD_VIDEO_DESC_CS_VS_FRM_MJPEG_RATES(2, UVC_FRAME_SIZE_SMALL, UVC_FRAME_SIZE_SMALL)),
 };
 
+_Static_assert(sizeof(desc_fs_configuration_320) == CONFIG_TOTAL_LEN_320, "320 descriptor length mismatch");
+_Static_assert(sizeof(desc_fs_configuration_240) == CONFIG_TOTAL_LEN_240, "240 descriptor length mismatch");
+
 // Invoked when received GET CONFIGURATION DESCRIPTOR
 // Application return pointer to descriptor
 // Descriptor contents must exist long enough for transfer to complete
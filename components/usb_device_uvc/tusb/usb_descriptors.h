@@ -29,7 +29,7 @@
 #define _USB_DESCRIPTORS_H_
 
 #include "uvc_frame_config.h"
-/* Time stamp base clock. It is a deprecated parameter. */
+/* Time stamp base clock, the unit of PTS and SCR in the payload headers (see uvc_clock.h). */
 #define UVC_CLOCK_FREQUENCY    27000000
 /* video capture path */
 #define UVC_ENTITY_CAP_INPUT_TERMINAL  0x01
@@ -600,6 +600,118 @@ enum {
         /* EP */ \
         TUD_VIDEO_DESC_EP_BULK(_epin, _epsize, 1)
 
+/* MJPEG frame with the discrete UVC_FRAME_RATE_* intervals (UVC 1.5 MJPEG payload, 26 + 4 bytes per interval) */
+#define UVC_FRAME_INTERVAL(_fps) (10000000 / (_fps))
+
+#define TUD_VIDEO_DESC_CS_VS_FRM_MJPEG_RATES_LEN (26 + 4 * UVC_FRAME_RATE_NUM)
+
+#define TUD_VIDEO_DESC_CS_VS_FRM_MJPEG_RATES(_frmidx, _width, _height) \
+  TUD_VIDEO_DESC_CS_VS_FRM_MJPEG_RATES_LEN, TUSB_DESC_CS_INTERFACE, VIDEO_CS_ITF_VS_FRAME_MJPEG, _frmidx, /*bmCapabilities*/0, \
+  U16_TO_U8S_LE(_width), U16_TO_U8S_LE(_height), \
+  /*dwMinBitRate*/U32_TO_U8S_LE((_width) * (_height) * 16 * UVC_FRAME_RATE_LOW), \
+  /*dwMaxBitRate*/U32_TO_U8S_LE((_width) * (_height) * 16 * UVC_FRAME_RATE_HIGH), \
+  /*dwMaxVideoFrameBufferSize*/U32_TO_U8S_LE((_width) * (_height) * 16 / 8), \
+  /*dwDefaultFrameInterval*/U32_TO_U8S_LE(UVC_FRAME_INTERVAL(UVC_FRAME_RATE_DEFAULT)), \
+  /*bFrameIntervalType*/UVC_FRAME_RATE_NUM, \
+  U32_TO_U8S_LE(UVC_FRAME_INTERVAL(UVC_FRAME_RATE_HIGH)), \
+  U32_TO_U8S_LE(UVC_FRAME_INTERVAL(UVC_FRAME_RATE_DEFAULT)), \
+  U32_TO_U8S_LE(UVC_FRAME_INTERVAL(UVC_FRAME_RATE_LOW))
+
+/* Y800: 8 bit luminance only, FourCC 'Y800' in the usual {xxxxxxxx-0000-0010-8000-00AA00389B71} GUID */
+#ifndef TUD_VIDEO_GUID_Y800
+#define TUD_VIDEO_GUID_Y800 0x59,0x38,0x30,0x30,0x00,0x00,0x10,0x00,0x80,0x00,0x00,0xAA,0x00,0x38,0x9B,0x71
+#endif
+
+/* Uncompressed frame with two discrete intervals, the first (faster) one is the default. Same layout as the MJPEG one */
+#define TUD_VIDEO_DESC_CS_VS_FRM_GREY_RATES_LEN (26 + 4 * 2)
+
+#define TUD_VIDEO_DESC_CS_VS_FRM_GREY_RATES(_frmidx, _width, _height, _fps_high, _fps_low) \
+  TUD_VIDEO_DESC_CS_VS_FRM_GREY_RATES_LEN, TUSB_DESC_CS_INTERFACE, VIDEO_CS_ITF_VS_FRAME_UNCOMPRESSED, _frmidx, /*bmCapabilities*/0, \
+  U16_TO_U8S_LE(_width), U16_TO_U8S_LE(_height), \
+  /*dwMinBitRate*/U32_TO_U8S_LE((_width) * (_height) * 8 * (_fps_low)), \
+  /*dwMaxBitRate*/U32_TO_U8S_LE((_width) * (_height) * 8 * (_fps_high)), \
+  /*dwMaxVideoFrameBufferSize*/U32_TO_U8S_LE((_width) * (_height)), \
+  /*dwDefaultFrameInterval*/U32_TO_U8S_LE(UVC_FRAME_INTERVAL(_fps_high)), \
+  /*bFrameIntervalType*/2, \
+  U32_TO_U8S_LE(UVC_FRAME_INTERVAL(_fps_high)), \
+  U32_TO_U8S_LE(UVC_FRAME_INTERVAL(_fps_low))
+
+/* The Y800 format with its frames, appended after the MJPEG one when CONFIG_UVC_CAM1_GREY_FORMAT is set.
+ * Frame order matches UVC_FRAMES_INFO_GREY */
+#if UVC_GREY_FORMAT
+#define UVC_FORMAT_BMA_CONTROLS 0, 0
+#define TUD_VIDEO_DESC_GREY_FORMAT_LEN (\
+    TUD_VIDEO_DESC_CS_VS_FMT_UNCOMPR_LEN\
+    + (UVC_GREY_FRAME_NUM * TUD_VIDEO_DESC_CS_VS_FRM_GREY_RATES_LEN)\
+    + TUD_VIDEO_DESC_CS_VS_COLOR_MATCHING_LEN\
+  )
+#define TUD_VIDEO_DESC_GREY_FORMAT(_fmtidx) \
+  TUD_VIDEO_DESC_CS_VS_FMT_UNCOMPR(_fmtidx, /*bNumFrameDescriptors*/UVC_GREY_FRAME_NUM, TUD_VIDEO_GUID_Y800, /*bBitsPerPixel*/8, \
+    /*bDefaultFrameIndex*/1, 0, 0, 0, /*bCopyProtect*/0), \
+    TUD_VIDEO_DESC_CS_VS_FRM_GREY_RATES(1, UVC_GREY_FRAME_SIZE_LARGE, UVC_GREY_FRAME_SIZE_LARGE, \
+                                        UVC_GREY_FRAME_RATE_LARGE_HIGH, UVC_GREY_FRAME_RATE_LARGE_LOW), \
+    TUD_VIDEO_DESC_CS_VS_FRM_GREY_RATES(2, UVC_GREY_FRAME_SIZE_SMALL, UVC_GREY_FRAME_SIZE_SMALL, \
+                                        UVC_GREY_FRAME_RATE_SMALL_HIGH, UVC_GREY_FRAME_RATE_SMALL_LOW), \
+    TUD_VIDEO_DESC_CS_VS_COLOR_MATCHING(VIDEO_COLOR_PRIMARIES_BT709, VIDEO_COLOR_XFER_CH_BT709, VIDEO_COLOR_COEF_SMPTE170M),
+#else
+#define UVC_FORMAT_BMA_CONTROLS 0
+#define TUD_VIDEO_DESC_GREY_FORMAT_LEN 0
+#define TUD_VIDEO_DESC_GREY_FORMAT(_fmtidx)
+#endif
+
+#define TUD_VIDEO_CAPTURE_DESC_MJPEG_RATES_BULK_LEN(n) (\
+    TUD_VIDEO_DESC_IAD_LEN\
+    /* control */\
+    + TUD_VIDEO_DESC_STD_VC_LEN\
+    + (TUD_VIDEO_DESC_CS_VC_LEN + 1/*bInCollection*/)\
+    + TUD_VIDEO_DESC_CAMERA_TERM_LEN\
+    + TUD_VIDEO_DESC_OUTPUT_TERM_LEN\
+    /* Interface 1, Alternate 0 */\
+    + TUD_VIDEO_DESC_STD_VS_LEN\
+    + (TUD_VIDEO_DESC_CS_VS_IN_LEN + UVC_FORMAT_NUM/*bNumFormats x bControlSize*/)\
+    + TUD_VIDEO_DESC_CS_VS_FMT_MJPEG_LEN\
+    + ((n) * TUD_VIDEO_DESC_CS_VS_FRM_MJPEG_RATES_LEN)\
+    + TUD_VIDEO_DESC_CS_VS_COLOR_MATCHING_LEN\
+    + TUD_VIDEO_DESC_GREY_FORMAT_LEN\
+    + 7/* Endpoint */\
+  )
+
+/* Bulk MJPEG capture with _nframes TUD_VIDEO_DESC_CS_VS_FRM_MJPEG_RATES frames passed after _epsize */
+#define TUD_VIDEO_CAPTURE_DESCRIPTOR_MJPEG_RATES_BULK(_stridx, _itf, _epin, _epsize, _nframes, ...) \
+  TUD_VIDEO_DESC_IAD(_itf, /* 2 Interfaces */ 0x02, _stridx), \
+  /* Video control 0 */ \
+  TUD_VIDEO_DESC_STD_VC(_itf, 0, _stridx), \
+    TUD_VIDEO_DESC_CS_VC( /* UVC 1.5*/ 0x0150, \
+         /* wTotalLength - bLength */ \
+         TUD_VIDEO_DESC_CAMERA_TERM_LEN + TUD_VIDEO_DESC_OUTPUT_TERM_LEN, \
+         UVC_CLOCK_FREQUENCY, _itf + 1), \
+      TUD_VIDEO_DESC_CAMERA_TERM(UVC_ENTITY_CAP_INPUT_TERMINAL, 0, 0,\
+                                 /*wObjectiveFocalLengthMin*/0, /*wObjectiveFocalLengthMax*/0,\
+                                 /*wObjectiveFocalLength*/0, /*bmControls*/0), \
+      TUD_VIDEO_DESC_OUTPUT_TERM(UVC_ENTITY_CAP_OUTPUT_TERMINAL, VIDEO_TT_STREAMING, 0, 1, 0), \
+  /* Video stream alt. 0 */ \
+  TUD_VIDEO_DESC_STD_VS(_itf + 1, 0, 1, _stridx), \
+    /* Video stream header for without still image capture */ \
+    TUD_VIDEO_DESC_CS_VS_INPUT( /*bNumFormats*/UVC_FORMAT_NUM, \
+        /*wTotalLength - bLength */\
+        TUD_VIDEO_DESC_CS_VS_FMT_MJPEG_LEN\
+        + ((_nframes) * TUD_VIDEO_DESC_CS_VS_FRM_MJPEG_RATES_LEN)\
+        + TUD_VIDEO_DESC_CS_VS_COLOR_MATCHING_LEN\
+        + TUD_VIDEO_DESC_GREY_FORMAT_LEN,\
+        _epin, /*bmInfo*/0, /*bTerminalLink*/UVC_ENTITY_CAP_OUTPUT_TERMINAL, \
+        /*bStillCaptureMethod*/0, /*bTriggerSupport*/0, /*bTriggerUsage*/0, \
+        /*bmaControls*/UVC_FORMAT_BMA_CONTROLS), \
+      /* Video stream format */ \
+      TUD_VIDEO_DESC_CS_VS_FMT_MJPEG(/*bFormatIndex*/1, /*bNumFrameDescriptors*/_nframes, \
+        /*bmFlags*/0, /*bDefaultFrameIndex*/1, 0, 0, 0, /*bCopyProtect*/0), \
+        /* Video stream frame formats */ \
+        __VA_ARGS__, \
+        TUD_VIDEO_DESC_CS_VS_COLOR_MATCHING(VIDEO_COLOR_PRIMARIES_BT709, VIDEO_COLOR_XFER_CH_BT709, VIDEO_COLOR_COEF_SMPTE170M), \
+      /* Second video stream format, raw luminance */ \
+      TUD_VIDEO_DESC_GREY_FORMAT(/*bFormatIndex*/2) \
+        /* EP */ \
+        TUD_VIDEO_DESC_EP_BULK(_epin, _epsize, 1)
+
 #endif //CFG_TUD_VIDEO
 
 /**
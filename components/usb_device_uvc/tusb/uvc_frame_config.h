@@ -24,6 +24,10 @@
 #define UVC_CAM1_BULK_MODE
 #endif
 
+#ifdef CONFIG_UVC_CAM1_GREY_FORMAT
+#define UVC_GREY_FORMAT 1
+#endif
+
 #ifndef UVC_CAM2_FRAME_WIDTH
 #define UVC_CAM2_FRAME_WIDTH UVC_CAM1_FRAME_WIDTH
 #endif
@@ -43,7 +47,40 @@ typedef struct
     int rate;
 } uvc_frame_info_t;
 
-#define UVC_FRAME_NUM 1
+// Square frame sizes advertised to the host. The 320 profile (OV3660 and others) lists all three,
+// the 240 profile (OV2640) leaves out the large one.
+#define UVC_FRAME_SIZE_LARGE 320
+#define UVC_FRAME_SIZE_MEDIUM 240
+#define UVC_FRAME_SIZE_SMALL 128
+
+#define UVC_FRAME_NUM_320 3
+#define UVC_FRAME_NUM_240 2
+#define UVC_FRAME_NUM UVC_FRAME_NUM_320
+
+// Every frame size comes with the same discrete frame rates, the host picks one at commit
+// and video_task paces to it. The middle one is the default.
+#define UVC_FRAME_RATE_HIGH 90
+#define UVC_FRAME_RATE_DEFAULT 60
+#define UVC_FRAME_RATE_LOW 30
+#define UVC_FRAME_RATE_NUM 3
+
+// Uncompressed 8 bit luminance (Y800, GREY on Linux) as a second format next to MJPEG, the same for both profiles.
+// A raw frame is width * height bytes and full speed bulk carries a bit over 1 MB/s, so only the small sizes
+// are listed and each gets the two rates that still fit, the higher one is the default.
+#define UVC_GREY_FRAME_SIZE_LARGE 128
+#define UVC_GREY_FRAME_SIZE_SMALL 96
+#define UVC_GREY_FRAME_RATE_LARGE_HIGH 60
+#define UVC_GREY_FRAME_RATE_LARGE_LOW 30
+#define UVC_GREY_FRAME_RATE_SMALL_HIGH 90
+#define UVC_GREY_FRAME_RATE_SMALL_LOW 60
+#define UVC_GREY_FRAME_NUM 2
+
+#if UVC_GREY_FORMAT
+#define UVC_FORMAT_NUM 2
+#else
+#define UVC_FORMAT_NUM 1
+#endif
 
-extern const uvc_frame_info_t UVC_FRAMES_INFO_320[UVC_FRAME_NUM];
-extern const uvc_frame_info_t UVC_FRAMES_INFO_240[UVC_FRAME_NUM];
+extern const uvc_frame_info_t UVC_FRAMES_INFO_320[UVC_FRAME_NUM_320];
+extern const uvc_frame_info_t UVC_FRAMES_INFO_240[UVC_FRAME_NUM_240];
+extern const uvc_frame_info_t UVC_FRAMES_INFO_GREY[UVC_GREY_FRAME_NUM];
@@ -15,24 +15,51 @@
 #else
 #include "esp_private/usb_phy.h"
 #endif
+#if CONFIG_UVC_PAYLOAD_PTS_SCR
+#include "soc/usb_dwc_struct.h"
+#endif
 #include "tusb.h"
 #include "usb_device_uvc.h"
 #include "tusb/uvc_frame_config.h"
+#include "tusb/usb_descriptors.h"
+#include "uvc_pacer.h"
+#include "uvc_clock.h"
 
 static const char *TAG = "usbd_uvc";
 
 #define UVC_CAM_NUM 1
 
-const uvc_frame_info_t UVC_FRAMES_INFO_320[UVC_FRAME_NUM] = {
-    {320, 320, 60},
+// same order as the frame descriptors in tusb/usb_descriptors.c, bFrameIndex - 1 indexes these
+const uvc_frame_info_t UVC_FRAMES_INFO_320[UVC_FRAME_NUM_320] = {
+    {UVC_FRAME_SIZE_LARGE, UVC_FRAME_SIZE_LARGE, UVC_FRAME_RATE_DEFAULT},
+    {UVC_FRAME_SIZE_MEDIUM, UVC_FRAME_SIZE_MEDIUM, UVC_FRAME_RATE_DEFAULT},
+    {UVC_FRAME_SIZE_SMALL, UVC_FRAME_SIZE_SMALL, UVC_FRAME_RATE_DEFAULT},
+};
+
+const uvc_frame_info_t UVC_FRAMES_INFO_240[UVC_FRAME_NUM_240] = {
+    {UVC_FRAME_SIZE_MEDIUM, UVC_FRAME_SIZE_MEDIUM, UVC_FRAME_RATE_DEFAULT},
+    {UVC_FRAME_SIZE_SMALL, UVC_FRAME_SIZE_SMALL, UVC_FRAME_RATE_DEFAULT},
 };
 
-const uvc_frame_info_t UVC_FRAMES_INFO_240[UVC_FRAME_NUM] = {
-    {240, 240, 60},
+// bFormatIndex 2, both profiles
+const uvc_frame_info_t UVC_FRAMES_INFO_GREY[UVC_GREY_FRAME_NUM] = {
+    {UVC_GREY_FRAME_SIZE_LARGE, UVC_GREY_FRAME_SIZE_LARGE, UVC_GREY_FRAME_RATE_LARGE_HIGH},
+    {UVC_GREY_FRAME_SIZE_SMALL, UVC_GREY_FRAME_SIZE_SMALL, UVC_GREY_FRAME_RATE_SMALL_HIGH},
 };
 
+// written by the commit on the TinyUSB task, taken by video_task under s_xfer_lock
+typedef struct
+{
+    bool valid;
+    uvc_format_t format;
+    int width;
+    int height;
+    int rate;
+    uint32_t frame_interval;
+} uvc_commit_t;
+
 static const uvc_frame_info_t *s_active_frames = UVC_FRAMES_INFO_320;
-static int s_active_frame_num = UVC_FRAME_NUM;
+static int s_active_frame_num = UVC_FRAME_NUM_320;
 static bool s_use_320 = true;
 
 typedef struct
@@ -44,16 +71,30 @@ typedef struct
     uvc_format_t format[UVC_CAM_NUM];
     uvc_device_config_t user_config[UVC_CAM_NUM];
     TaskHandle_t uvc_task_hdl[UVC_CAM_NUM];
-    uint32_t interval_ms[UVC_CAM_NUM];
+    uint32_t frame_interval[UVC_CAM_NUM];       // committed dwFrameInterval, 100 ns units
+    uvc_commit_t commit[UVC_CAM_NUM];           // what the host committed last, start_cb runs with it on video_task
+    uvc_pacer_t pacer[UVC_CAM_NUM];
+    esp_timer_handle_t pace_timer[UVC_CAM_NUM];
+    uvc_fb_t *xfer_fb[UVC_CAM_NUM];             // frame TinyUSB is currently reading from
+    uvc_device_stats_t stats[UVC_CAM_NUM];
+    int64_t last_xfer_us[UVC_CAM_NUM];
+    uint64_t interval_sum_us[UVC_CAM_NUM];
+    uint64_t latency_sum_us[UVC_CAM_NUM];
+    uint32_t pts[UVC_CAM_NUM];                  // VSYNC of the frame in flight, UVC clock ticks
+    bool pts_valid[UVC_CAM_NUM];
+    bool first_payload[UVC_CAM_NUM];            // the next header is the frame's first one
+    uint8_t meta[UVC_CAM_NUM][UVC_FB_META_MAX]; // copied, the frame may go back before its last payload is out
+    uint8_t meta_len[UVC_CAM_NUM];
 } uvc_device_t;
 
 static uvc_device_t s_uvc_device;
+static portMUX_TYPE s_xfer_lock = portMUX_INITIALIZER_UNLOCKED;
 
 void uvc_select_frame_profile(bool use_320)
 {
     s_use_320 = use_320;
     s_active_frames = use_320 ? UVC_FRAMES_INFO_320 : UVC_FRAMES_INFO_240;
-    s_active_frame_num = UVC_FRAME_NUM;
+    s_active_frame_num = use_320 ? UVC_FRAME_NUM_320 : UVC_FRAME_NUM_240;
 }
 
 bool uvc_is_frame_profile_320(void)
@@ -79,11 +120,6 @@ static esp_err_t usb_phy_init(void)
     return ESP_OK;
 }
 
-static inline uint32_t get_time_millis(void)
-{
-    return (uint32_t)(esp_timer_get_time() / 1000);
-}
-
 static void tusb_device_task(void *arg)
 {
     while (1)
@@ -130,112 +166,322 @@ void tud_resume_cb(void)
 //--------------------------------------------------------------------+
 // USB Video
 //--------------------------------------------------------------------+
+// The frame in flight is handed back either by the transfer complete callback (TinyUSB task)
+// or by video_task when the stream goes away, whoever gets here first.
+static uvc_fb_t *take_xfer_fb(int index)
+{
+    portENTER_CRITICAL(&s_xfer_lock);
+    uvc_fb_t *fb = s_uvc_device.xfer_fb[index];
+    s_uvc_device.xfer_fb[index] = NULL;
+    portEXIT_CRITICAL(&s_xfer_lock);
+    return fb;
+}
+
+static void release_fb(int index, uvc_fb_t *fb)
+{
+    if (fb) {
+        s_uvc_device.user_config[index].fb_return_cb(fb, s_uvc_device.user_config[index].cb_ctx);
+    }
+}
+
+static void reset_stats(int index)
+{
+    memset(&s_uvc_device.stats[index], 0, sizeof(uvc_device_stats_t));
+    s_uvc_device.last_xfer_us[index] = 0;
+    s_uvc_device.interval_sum_us[index] = 0;
+    s_uvc_device.latency_sum_us[index] = 0;
+}
+
+static void record_xfer_start(int index, uvc_fb_t *pic)
+{
+    uvc_device_stats_t *stats = &s_uvc_device.stats[index];
+    int64_t now = esp_timer_get_time();
+
+    int64_t captured = (int64_t)pic->timestamp.tv_sec * 1000000 + pic->timestamp.tv_usec;
+    bool valid = captured > 0 && captured <= now;
+    if (valid) {
+        stats->last_latency_us = (uint32_t)(now - captured);
+        s_uvc_device.latency_sum_us[index] += stats->last_latency_us;
+    }
+    // set before the transfer starts, the first payload header is built inside tud_video_n_frame_xfer()
+    s_uvc_device.pts[index] = valid ? uvc_clock_ticks(captured, UVC_CLOCK_FREQUENCY) : 0;
+    s_uvc_device.pts_valid[index] = valid;
+    size_t meta_len = pic->meta_len < UVC_FB_META_MAX ? pic->meta_len : UVC_FB_META_MAX;
+    memcpy(s_uvc_device.meta[index], pic->meta, meta_len);
+    s_uvc_device.meta_len[index] = (uint8_t)meta_len;
+    s_uvc_device.first_payload[index] = true;
+
+    if (s_uvc_device.last_xfer_us[index]) {
+        uint32_t interval = (uint32_t)(now - s_uvc_device.last_xfer_us[index]);
+        stats->last_interval_us = interval;
+        if (stats->min_interval_us == 0 || interval < stats->min_interval_us) {
+            stats->min_interval_us = interval;
+        }
+        if (interval > stats->max_interval_us) {
+            stats->max_interval_us = interval;
+        }
+        s_uvc_device.interval_sum_us[index] += interval;
+    }
+    s_uvc_device.last_xfer_us[index] = now;
+    stats->frames_sent++;
+
+    if (s_uvc_device.user_config[index].xfer_start_cb) {
+        s_uvc_device.user_config[index].xfer_start_cb(pic, s_uvc_device.user_config[index].cb_ctx);
+    }
+}
+
+#if CONFIG_UVC_PAYLOAD_PTS_SCR
+// number of the last SOF the controller saw, the DWC OTG core keeps it in DSTS
+static uint16_t usb_sof_count(void)
+{
+#if CONFIG_TINYUSB_RHPORT_HS
+    // high speed counts microframes, the SCR wants the 1 ms frame number
+    return (uint16_t)(USB_DWC_HS.dsts_reg.soffn >> 3);
+#else
+    return (uint16_t)USB_DWC.dsts_reg.soffn;
+#endif
+}
+
+// Called by TinyUSB's video_device.c (see patches/tinyusb-video-payload-header.patch) for every payload
+// it sends, with FID and EOF already set. Runs in video_task for a frame's first payload and in the
+// TinyUSB task for the rest. Only the first one carries PTS, SCR and the frame's metadata, the rest
+// keep the two byte header so bulk packets don't lose bandwidth to them.
+uint_fast16_t uvc_payload_header_cb(uint8_t *hdr)
+{
+    if (!s_uvc_device.first_payload[0]) {
+        return uvc_clock_short_header(hdr);
+    }
+    s_uvc_device.first_payload[0] = false;
+
+    uint32_t stc = uvc_clock_ticks(esp_timer_get_time(), UVC_CLOCK_FREQUENCY);
+    uint16_t sof = usb_sof_count();
+    s_uvc_device.stats[0].payload_headers++;
+    uvc_clock_fill_header(hdr, s_uvc_device.pts_valid[0], s_uvc_device.pts[0], stc, sof);
+    return uvc_clock_append(hdr, s_uvc_device.meta[0], s_uvc_device.meta_len[0]);
+}
+#endif
+
+// what wakes video_task, everything else is a timeout
+#define UVC_EVT_XFER_DONE   (1UL << 0)  // TinyUSB finished sending the frame
+#define UVC_EVT_PACE        (1UL << 1)  // the next frame's slot came up
+#define UVC_EVT_COMMIT      (1UL << 2)  // the host committed a stream
+
+// how long video_task sleeps without an event, long enough to not cost anything while nobody
+// is streaming, short enough to notice a stream that went away without telling us
+#define UVC_IDLE_WAIT_MS    100
+// after a commit the stream usually starts within a few ticks, check for it a little more often
+#define UVC_ARM_TICKS       20
+
+static uint32_t wait_events(TickType_t timeout)
+{
+    uint32_t events = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &events, timeout);
+    return events;
+}
+
+// sets the camera up for the last commit, on video_task so the TinyUSB task (and CDC with it) doesn't wait for a camera restart
+static bool start_stream(int index)
+{
+    portENTER_CRITICAL(&s_xfer_lock);
+    uvc_commit_t commit = s_uvc_device.commit[index];
+    portEXIT_CRITICAL(&s_xfer_lock);
+    if (!commit.valid) {
+        return false;
+    }
+
+    s_uvc_device.frame_interval[index] = commit.frame_interval;
+    esp_err_t ret = s_uvc_device.user_config[index].start_cb(commit.format, commit.width, commit.height, commit.rate,
+                                                             s_uvc_device.user_config[index].cb_ctx);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "camera start failed: %s, no frames until the host commits again", esp_err_to_name(ret));
+        s_uvc_device.stats[index].start_failures++;
+        return false;
+    }
+    return true;
+}
+
+static void pace_timer_cb(void *arg)
+{
+    int index = (int)(intptr_t)arg;
+    xTaskNotify(s_uvc_device.uvc_task_hdl[index], UVC_EVT_PACE, eSetBits);
+}
+
 static void video_task(void *arg)
 {
-    uint32_t start_ms = 0;
     uint32_t frame_num = 0;
     uint32_t frame_len = 0;
     uint32_t already_start = 0;
     uint32_t tx_busy = 0;
-    uint8_t *uvc_buffer = s_uvc_device.user_config[0].uvc_buffer;
+    uint32_t events = 0;
+    uint32_t arming = 0;
+    bool started = false;
     uint32_t uvc_buffer_size = s_uvc_device.user_config[0].uvc_buffer_size;
-    uvc_fb_t *pic = NULL;
+    uvc_pacer_t *pacer = &s_uvc_device.pacer[0];
+    esp_timer_handle_t pace_timer = s_uvc_device.pace_timer[0];
+    // with pipelining the next frame is fetched as soon as the current transfer starts,
+    // so it's already waiting when the transfer finishes instead of being captured after it
+#if CONFIG_UVC_CAM1_PIPELINED
+    const bool pipelined = true;
+#else
+    const bool pipelined = false;
+#endif
+    uvc_fb_t *next = NULL;
 
     while (1)
     {
         if (!tud_video_n_streaming(0, 0))
         {
+            if (already_start)
+            {
+                // the host went away mid-transfer, nothing is going to complete anymore
+                esp_timer_stop(pace_timer);
+                release_fb(0, next);
+                release_fb(0, take_xfer_fb(0));
+                next = NULL;
+
+                uvc_device_stats_t stats;
+                uvc_device_get_stats(0, &stats);
+                ESP_LOGI(TAG, "stream ended: %" PRIu32 " frames, interval avg/min/max %" PRIu32 "/%" PRIu32 "/%" PRIu32 " us (target %" PRIu32 "), late avg/max %" PRIu32 "/%" PRIu32 " us, resyncs %" PRIu32 ", latency avg %" PRIu32 " us, prefetched %" PRIu32,
+                         stats.frames_sent, stats.avg_interval_us, stats.min_interval_us, stats.max_interval_us, stats.target_interval_us,
+                         stats.avg_late_us, stats.max_late_us, stats.resyncs, stats.avg_latency_us, stats.prefetched);
+            }
             already_start = 0;
             frame_num = 0;
             tx_busy = 0;
-            // Drain any stale transfer-complete notification left over from
-            // the previous streaming session so it cannot desynchronize
-            // tx_busy and s_frame_inflight on the next session start.
-            ulTaskNotifyTake(pdTRUE, 0);
-            vTaskDelay(1);
+            // Nothing to do until the host commits a stream, so sleep instead of polling every tick.
+            // Whatever arrives in the meantime, like the transfer-complete notification of the
+            // stream that just ended, is thrown away here so it can't desynchronize tx_busy on the
+            // next session start.
+            events = wait_events(arming ? 1 : pdMS_TO_TICKS(UVC_IDLE_WAIT_MS));
+            arming = (events & UVC_EVT_COMMIT) ? UVC_ARM_TICKS : (arming ? arming - 1 : 0);
+            events = 0;
             continue;
         }
 
-        if (!already_start)
+        if (!already_start || (events & UVC_EVT_COMMIT))
         {
+            // TinyUSB may still be reading the old stream's frame straight out of the camera's buffer, and the
+            // restart hands that buffer back and deinits the camera under it. Wait for the transfer to finish
+            // first, its completion then belongs to the old stream and not to the first frame of the new one.
+            if (tx_busy && !(events & UVC_EVT_XFER_DONE))
+            {
+                events |= wait_events(pdMS_TO_TICKS(UVC_IDLE_WAIT_MS));
+                continue;
+            }
+            events &= ~UVC_EVT_XFER_DONE;
+            tx_busy = 0;
+            release_fb(0, take_xfer_fb(0));
+
+            // a commit while streaming switches formats, the frame we're holding is from the old one
+            release_fb(0, next);
+            next = NULL;
             already_start = 1;
-            start_ms = get_time_millis();
+            arming = 0;
+            events &= ~UVC_EVT_COMMIT;
+            reset_stats(0);
+            started = start_stream(0);
+            uvc_pacer_start(pacer, s_uvc_device.frame_interval[0]);
         }
 
-        uint32_t cur = get_time_millis();
-        if (cur - start_ms < s_uvc_device.interval_ms[0])
+        if (!started)
         {
-            vTaskDelay(1);
+            // the camera isn't running what the host asked for, wait for the next commit or the end of the stream
+            events |= wait_events(pdMS_TO_TICKS(UVC_IDLE_WAIT_MS));
             continue;
         }
 
+        if (!next && (pipelined || !tx_busy))
+        {
+            ESP_LOGD(TAG, "frame %" PRIu32 " taking picture...", frame_num);
+            next = s_uvc_device.user_config[0].fb_get_cb(s_uvc_device.user_config[0].cb_ctx);
+            if (next)
+            {
+                ESP_LOGD(TAG, "Picture taken! Its size was: %zu bytes", next->len);
+                if (next->len == 0 || next->len > uvc_buffer_size)
+                {
+                    ESP_LOGW(TAG, "frame size invalid (len=%zu), dropping frame", next->len);
+                    s_uvc_device.stats[0].frames_dropped++;
+                    release_fb(0, next);
+                    next = NULL;
+                    continue;
+                }
+            }
+            else
+            {
+                ESP_LOGE(TAG, "Failed to capture picture");
+                s_uvc_device.stats[0].capture_failures++;
+                if (!tx_busy)
+                {
+                    vTaskDelay(pdMS_TO_TICKS(30));
+                    continue;
+                }
+            }
+        }
+
         if (tx_busy)
         {
-            uint32_t xfer_done = ulTaskNotifyTake(pdTRUE, 1);
-            if (xfer_done == 0)
+            if (!(events & UVC_EVT_XFER_DONE))
             {
+                // the timeout only brings us back to check the stream is still there
+                events |= wait_events(pdMS_TO_TICKS(UVC_IDLE_WAIT_MS));
                 continue;
             }
+            events &= ~UVC_EVT_XFER_DONE;
             ++frame_num;
             tx_busy = 0;
+            if (next)
+            {
+                s_uvc_device.stats[0].prefetched++;
+            }
         }
 
-        start_ms += s_uvc_device.interval_ms[0];
-        // Prevent burst catch-up if we fell far behind (e.g. preemption)
-        if (cur - start_ms > 3 * s_uvc_device.interval_ms[0])
+        if (!next)
         {
-            start_ms = cur;
-        }
-        ESP_LOGD(TAG, "frame %" PRIu32 " taking picture...", frame_num);
-        pic = s_uvc_device.user_config[0].fb_get_cb(s_uvc_device.user_config[0].cb_ctx);
-        if (pic)
-        {
-            ESP_LOGD(TAG, "Picture taken! Its size was: %zu bytes", pic->len);
-        }
-        else
-        {
-            ESP_LOGE(TAG, "Failed to capture picture");
-            vTaskDelay(pdMS_TO_TICKS(30));
             continue;
         }
 
-        if (pic->len == 0 || pic->len > uvc_buffer_size)
+        // Sleep until the frame's slot instead of checking the clock every tick, the timer fires
+        // at the microsecond and the schedule doesn't lose the fraction of a millisecond 60 fps needs
+        int64_t now = esp_timer_get_time();
+        int64_t due = uvc_pacer_due(pacer);
+        if (now < due)
         {
-            ESP_LOGW(TAG, "frame size invalid (len=%zu), dropping frame", pic->len);
-            s_uvc_device.user_config[0].fb_return_cb(pic, s_uvc_device.user_config[0].cb_ctx);
+            esp_timer_stop(pace_timer);
+            esp_timer_start_once(pace_timer, (uint64_t)(due - now));
+            events |= wait_events(pdMS_TO_TICKS(UVC_IDLE_WAIT_MS));
             continue;
         }
-        frame_len = pic->len;
+        uvc_pacer_sent(pacer, now);
+
+        frame_len = next->len;
         // Transfer directly from camera frame buffer — avoids a full-frame
         // memcpy and lets the DMA-capable DRAM buffer go straight to USB.
         // fb_return is deferred to xfer_complete callback (see below).
-        // Drain any stale notification from a previous transfer that
-        // completed after tx_busy was already cleared (e.g. during a
-        // stream stop/start cycle).  Without this, the stale notification
-        // causes ulTaskNotifyTake to succeed immediately on the NEXT
-        // iteration, clearing tx_busy before the current transfer
-        // finishes — desynchronizing tx_busy and s_frame_inflight.
-        ulTaskNotifyTake(pdTRUE, 0);
+        // Drop any stale completion from a transfer that finished after
+        // tx_busy was already cleared (e.g. during a stream stop/start cycle).
+        // Without this it would clear tx_busy on the NEXT iteration, before
+        // the current transfer finishes.
+        events &= ~UVC_EVT_XFER_DONE;
+        ulTaskNotifyValueClear(NULL, UVC_EVT_XFER_DONE);
+        portENTER_CRITICAL(&s_xfer_lock);
+        s_uvc_device.xfer_fb[0] = next;
+        portEXIT_CRITICAL(&s_xfer_lock);
         tx_busy = 1;
-        tud_video_n_frame_xfer(0, 0, (void *)pic->buf, frame_len);
+        record_xfer_start(0, next);
+        tud_video_n_frame_xfer(0, 0, (void *)next->buf, frame_len);
         ESP_LOGD(TAG, "frame %" PRIu32 " transfer start, size %" PRIu32, frame_num, frame_len);
+        next = NULL;
     }
 }
 
 void tud_video_frame_xfer_complete_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx)
 {
-    (void)ctl_idx;
     (void)stm_idx;
     // Return the camera frame buffer now that USB has finished reading it.
     // This was deferred from video_task to avoid the memcpy into a separate
     // transfer buffer — the USB controller reads directly from the camera FB.
-    if (s_uvc_device.user_config[ctl_idx].fb_return_cb)
-    {
-        // fb_get_cb stores the pic pointer internally (s_fb / s_frame_inflight);
-        // fb_return_cb will retrieve and release it.
-        s_uvc_device.user_config[ctl_idx].fb_return_cb(NULL, s_uvc_device.user_config[ctl_idx].cb_ctx);
-    }
-    xTaskNotifyGive(s_uvc_device.uvc_task_hdl[ctl_idx]);
+    release_fb(ctl_idx, take_xfer_fb(ctl_idx));
+    xTaskNotify(s_uvc_device.uvc_task_hdl[ctl_idx], UVC_EVT_XFER_DONE, eSetBits);
 }
 
 int tud_video_commit_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx,
@@ -244,23 +490,52 @@ int tud_video_commit_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx,
     (void)ctl_idx;
     (void)stm_idx;
     /* convert unit to ms from 100 ns */
+    ESP_LOGI(TAG, "bFormatIndex: %u", parameters->bFormatIndex);
     ESP_LOGI(TAG, "bFrameIndex: %u", parameters->bFrameIndex);
     ESP_LOGI(TAG, "dwFrameInterval: %" PRIu32 "", parameters->dwFrameInterval);
-    if (parameters->bFrameIndex == 0 || parameters->bFrameIndex > s_active_frame_num)
+
+    // format 1 is MJPEG with the frames of the active profile, format 2 the raw Y800 one
+    uvc_format_t format = s_uvc_device.format[ctl_idx];
+    const uvc_frame_info_t *frames = s_active_frames;
+    int frame_num = s_active_frame_num;
+#if UVC_GREY_FORMAT
+    if (parameters->bFormatIndex == 2)
+    {
+        format = UVC_FORMAT_GREY;
+        frames = UVC_FRAMES_INFO_GREY;
+        frame_num = UVC_GREY_FRAME_NUM;
+    }
+#endif
+    if (parameters->bFormatIndex == 0 || parameters->bFormatIndex > UVC_FORMAT_NUM ||
+        parameters->bFrameIndex == 0 || parameters->bFrameIndex > frame_num || parameters->dwFrameInterval == 0)
     {
         return VIDEO_ERROR_OUT_OF_RANGE;
     }
-    s_uvc_device.interval_ms[ctl_idx] = parameters->dwFrameInterval / 10000;
     int frame_index = parameters->bFrameIndex - 1;
-    const uvc_frame_info_t *info = &s_active_frames[frame_index];
-    esp_err_t ret = s_uvc_device.user_config[ctl_idx].start_cb(s_uvc_device.format[ctl_idx], info->width,
-                                                               info->height, info->rate, s_uvc_device.user_config[ctl_idx].cb_ctx);
-
-    if (ret != ESP_OK)
+    const uvc_frame_info_t *info = &frames[frame_index];
+    // the rate the host actually committed to, rounded to whole fps (90 fps is 111111 * 100 ns)
+    int rate = (int)((10000000 + parameters->dwFrameInterval / 2) / parameters->dwFrameInterval);
+    if (s_uvc_device.user_config[ctl_idx].validate_cb &&
+        s_uvc_device.user_config[ctl_idx].validate_cb(format, info->width, info->height, rate, s_uvc_device.user_config[ctl_idx].cb_ctx) != ESP_OK)
     {
-        ESP_LOGE(TAG, "camera init failed");
+        ESP_LOGE(TAG, "format rejected");
         return VIDEO_ERROR_OUT_OF_RANGE;
     }
+
+    // the camera restart takes a while, it happens on video_task and the TinyUSB task goes back to the bus
+    // the interval stays in 100 ns units, the pacer does the rounding so 60 fps stays 16666.7 us and not 16 ms
+    portENTER_CRITICAL(&s_xfer_lock);
+    s_uvc_device.commit[ctl_idx] = (uvc_commit_t) {
+        .valid = true,
+        .format = format,
+        .width = info->width,
+        .height = info->height,
+        .rate = rate,
+        .frame_interval = parameters->dwFrameInterval,
+    };
+    portEXIT_CRITICAL(&s_xfer_lock);
+    // wake video_task up, it sleeps while nothing is streaming
+    xTaskNotify(s_uvc_device.uvc_task_hdl[ctl_idx], UVC_EVT_COMMIT, eSetBits);
     return VIDEO_ERROR_NONE;
 }
 #endif
@@ -273,15 +548,37 @@ esp_err_t uvc_device_config(int index, uvc_device_config_t *config)
     ESP_RETURN_ON_FALSE(config->fb_get_cb != NULL, ESP_ERR_INVALID_ARG, TAG, "fb_get_cb is NULL");
     ESP_RETURN_ON_FALSE(config->fb_return_cb != NULL, ESP_ERR_INVALID_ARG, TAG, "fb_return_cb is NULL");
     ESP_RETURN_ON_FALSE(config->stop_cb != NULL, ESP_ERR_INVALID_ARG, TAG, "stop_cb is NULL");
-    ESP_RETURN_ON_FALSE(config->uvc_buffer != NULL, ESP_ERR_INVALID_ARG, TAG, "uvc_buffer is NULL");
     ESP_RETURN_ON_FALSE(config->uvc_buffer_size > 0, ESP_ERR_INVALID_ARG, TAG, "uvc_buffer_size is 0");
 
     s_uvc_device.user_config[index] = *config;
-    s_uvc_device.interval_ms[index] = 1000 / (index == 0 ? UVC_CAM1_FRAME_RATE : UVC_CAM2_FRAME_RATE);
+    s_uvc_device.frame_interval[index] = 10000000 / (index == 0 ? UVC_CAM1_FRAME_RATE : UVC_CAM2_FRAME_RATE);
     s_uvc_device.uvc_init[index] = true;
     return ESP_OK;
 }
 
+esp_err_t uvc_device_get_stats(int index, uvc_device_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(index >= 0 && index < UVC_CAM_NUM, ESP_ERR_INVALID_ARG, TAG, "index is invalid");
+    ESP_RETURN_ON_FALSE(stats != NULL, ESP_ERR_INVALID_ARG, TAG, "stats is NULL");
+
+    *stats = s_uvc_device.stats[index];
+    // the first transfer of a stream has no interval
+    if (stats->frames_sent > 1) {
+        stats->avg_interval_us = (uint32_t)(s_uvc_device.interval_sum_us[index] / (stats->frames_sent - 1));
+    }
+    if (stats->frames_sent > 0) {
+        stats->avg_latency_us = (uint32_t)(s_uvc_device.latency_sum_us[index] / stats->frames_sent);
+    }
+
+    const uvc_pacer_t *pacer = &s_uvc_device.pacer[index];
+    stats->target_interval_us = pacer->interval_us;
+    stats->last_late_us = pacer->last_late_us;
+    stats->max_late_us = pacer->max_late_us;
+    stats->avg_late_us = uvc_pacer_avg_late_us(pacer);
+    stats->resyncs = pacer->resyncs;
+    return ESP_OK;
+}
+
 esp_err_t uvc_device_init(void)
 {
     ESP_RETURN_ON_FALSE(s_uvc_device.uvc_init[0], ESP_ERR_INVALID_STATE, TAG, "uvc device 0 not init");
@@ -305,6 +602,12 @@ esp_err_t uvc_device_init(void)
     BaseType_t core_id = (CONFIG_UVC_TINYUSB_TASK_CORE < 0) ? tskNO_AFFINITY : CONFIG_UVC_TINYUSB_TASK_CORE;
     xTaskCreatePinnedToCore(tusb_device_task, "TinyUSB", 4096, NULL, CONFIG_UVC_TINYUSB_TASK_PRIORITY, NULL, core_id);
 #if (CFG_TUD_VIDEO)
+    const esp_timer_create_args_t pace_timer_args = {
+        .callback = pace_timer_cb,
+        .arg = (void *)(intptr_t)0,
+        .name = "uvc_pace",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&pace_timer_args, &s_uvc_device.pace_timer[0]), TAG, "pace timer create failed");
     core_id = (CONFIG_UVC_CAM1_TASK_CORE < 0) ? tskNO_AFFINITY : CONFIG_UVC_CAM1_TASK_CORE;
     xTaskCreatePinnedToCore(video_task, "UVC", 4096, NULL, CONFIG_UVC_CAM1_TASK_PRIORITY, &s_uvc_device.uvc_task_hdl[0], core_id);
 #endif
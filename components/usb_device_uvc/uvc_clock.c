@@ -0,0 +1,63 @@
+/*
+ * SPDX-FileCopyrightText: 2022-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <string.h>
+#include "uvc_clock.h"
+
+uint32_t uvc_clock_ticks(int64_t us, uint32_t frequency_hz)
+{
+    // whole seconds and the rest separately, so us * frequency can't overflow 64 bits after a few days
+    uint64_t seconds = (uint64_t)us / 1000000;
+    uint64_t rest = (uint64_t)us % 1000000;
+    return (uint32_t)(seconds * frequency_hz + rest * frequency_hz / 1000000);
+}
+
+static void put_le32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+size_t uvc_clock_fill_header(uint8_t *hdr, bool has_pts, uint32_t pts, uint32_t stc, uint16_t sof)
+{
+    size_t len = 2;
+    uint8_t info = (hdr[1] & (UVC_HEADER_FID | UVC_HEADER_EOF)) | UVC_HEADER_SCR | UVC_HEADER_EOH;
+
+    if (has_pts) {
+        put_le32(&hdr[len], pts);
+        len += 4;
+        info |= UVC_HEADER_PTS;
+    }
+    // scrSourceClock: 32 bit STC, then the SOF counter in bits 0..10 of the last two bytes
+    put_le32(&hdr[len], stc);
+    hdr[len + 4] = (uint8_t)sof;
+    hdr[len + 5] = (uint8_t)((sof >> 8) & (UVC_SOF_MASK >> 8));
+    len += 6;
+
+    hdr[0] = (uint8_t)len;
+    hdr[1] = info;
+    return len;
+}
+
+size_t uvc_clock_short_header(uint8_t *hdr)
+{
+    hdr[0] = 2;
+    hdr[1] = (hdr[1] & (UVC_HEADER_FID | UVC_HEADER_EOF)) | UVC_HEADER_EOH;
+    return 2;
+}
+
+size_t uvc_clock_append(uint8_t *hdr, const uint8_t *data, size_t len)
+{
+    size_t header_len = hdr[0];
+    if (header_len + len > UINT8_MAX) {
+        return header_len;
+    }
+    memcpy(&hdr[header_len], data, len);
+    header_len += len;
+    hdr[0] = (uint8_t)header_len;
+    return header_len;
+}
@@ -0,0 +1,52 @@
+/*
+ * SPDX-FileCopyrightText: 2022-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <string.h>
+#include "uvc_pacer.h"
+
+void uvc_pacer_start(uvc_pacer_t *pacer, uint32_t frame_interval)
+{
+    memset(pacer, 0, sizeof(*pacer));
+    // dwFrameInterval is in 100 ns, keep what doesn't fit into whole microseconds and carry it over
+    pacer->interval_us = frame_interval / 10;
+    pacer->remainder = frame_interval % 10;
+}
+
+void uvc_pacer_sent(uvc_pacer_t *pacer, int64_t now_us)
+{
+    if (pacer->next_due_us == 0) {
+        // the first frame of a stream goes out right away and starts the schedule
+        pacer->next_due_us = now_us;
+    } else {
+        uint32_t late = now_us > pacer->next_due_us ? (uint32_t)(now_us - pacer->next_due_us) : 0;
+        pacer->last_late_us = late;
+        if (late > pacer->max_late_us) {
+            pacer->max_late_us = late;
+        }
+        pacer->late_sum_us += late;
+    }
+    pacer->frames++;
+
+    pacer->next_due_us += pacer->interval_us;
+    pacer->fraction += pacer->remainder;
+    if (pacer->fraction >= 10) {
+        pacer->fraction -= 10;
+        pacer->next_due_us++;
+    }
+
+    // more than a whole frame behind (slow camera, preemption): start over from now instead of
+    // sending what we missed back to back, the host wants evenly spaced frames, not a burst
+    if (now_us - pacer->next_due_us > (int64_t)pacer->interval_us) {
+        pacer->next_due_us = now_us + pacer->interval_us;
+        pacer->fraction = 0;
+        pacer->resyncs++;
+    }
+}
+
+uint32_t uvc_pacer_avg_late_us(const uvc_pacer_t *pacer)
+{
+    // the first frame has no slot to be late for
+    return pacer->frames > 1 ? (uint32_t)(pacer->late_sum_us / (pacer->frames - 1)) : 0;
+}
@@ -6,7 +6,7 @@ static const char* TAG = "WiFiScanner";
 
 WiFiScanner::WiFiScanner() {}
 
-std::vector<WiFiNetwork> WiFiScanner::scanNetworks(int timeout_ms)
+std::vector<WiFiNetwork> WiFiScanner::scanNetworks(int timeout_ms, ScanProgress progress, void* context)
 {
     std::vector<WiFiNetwork> scan_results;
 
@@ -29,7 +29,8 @@ std::vector<WiFiNetwork> WiFiScanner::scanNetworks(int timeout_ms)
     std::vector<wifi_ap_record_t> all_records;
     int64_t start_time = esp_timer_get_time() / 1000;  // Convert to ms
 
-    for (uint8_t ch = 1; ch <= 13; ch++)
+    constexpr uint8_t channels = 13;
+    for (uint8_t ch = 1; ch <= channels; ch++)
     {
         // Check if we've exceeded the timeout
         int64_t current_time = esp_timer_get_time() / 1000;
@@ -68,6 +69,10 @@ std::vector<WiFiNetwork> WiFiScanner::scanNetworks(int timeout_ms)
                 delete[] ch_records;
             }
         }
+        if (progress != nullptr)
+        {
+            progress(context, ch, channels);
+        }
         vTaskDelay(pdMS_TO_TICKS(50));
     }
 
@@ -16,11 +16,14 @@ struct WiFiNetwork
     wifi_auth_mode_t auth_mode;
 };
 
+// called after every channel, a scan takes a few seconds and whoever asked for it can tell how far it got
+using ScanProgress = void (*)(void* context, uint8_t channel, uint8_t channels);
+
 class WiFiScanner
 {
    public:
     WiFiScanner();
-    std::vector<WiFiNetwork> scanNetworks(int timeout_ms = 15000);
+    std::vector<WiFiNetwork> scanNetworks(int timeout_ms = 15000, ScanProgress progress = nullptr, void* context = nullptr);
 
    private:
     std::vector<WiFiNetwork> networks;
@@ -268,7 +268,7 @@ void WiFiManager::SetupAccessPoint()
     ESP_LOGI(WIFI_MANAGER_TAG, "AP started.");
 }
 
-std::vector<WiFiNetwork> WiFiManager::ScanNetworks(int timeout_ms)
+std::vector<WiFiNetwork> WiFiManager::ScanNetworks(int timeout_ms, ScanProgress progress, void* context)
 {
     wifi_mode_t current_mode;
     esp_err_t err = esp_wifi_get_mode(&current_mode);
@@ -316,7 +316,7 @@ std::vector<WiFiNetwork> WiFiManager::ScanNetworks(int timeout_ms)
         vTaskDelay(pdMS_TO_TICKS(2000));
 
         // Perform scan
-        auto networks = wifiScanner->scanNetworks(timeout_ms);
+        auto networks = wifiScanner->scanNetworks(timeout_ms, progress, context);
 
         // Restore AP-only mode
         ESP_LOGI(WIFI_MANAGER_TAG, "Restoring AP-only mode");
@@ -332,7 +332,7 @@ std::vector<WiFiNetwork> WiFiManager::ScanNetworks(int timeout_ms)
     }
 
     // If already in STA or APSTA mode, scan directly
-    return wifiScanner->scanNetworks(timeout_ms);
+    return wifiScanner->scanNetworks(timeout_ms, progress, context);
 }
 
 WiFiState_e WiFiManager::GetCurrentWiFiState()
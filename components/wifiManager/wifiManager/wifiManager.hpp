@@ -50,7 +50,7 @@ class WiFiManager
    public:
     WiFiManager(std::shared_ptr<ProjectConfig> deviceConfig, QueueHandle_t eventQueue, StateManager* stateManager);
     void Begin();
-    std::vector<WiFiNetwork> ScanNetworks(int timeout_ms = 15000);
+    std::vector<WiFiNetwork> ScanNetworks(int timeout_ms = 15000, ScanProgress progress = nullptr, void* context = nullptr);
     WiFiState_e GetCurrentWiFiState();
     void TryConnectToStoredNetworks();
 };
@@ -245,10 +245,11 @@ void startWiFiMode()
     // don't enable in SETUP mode
     if (mode == StreamingMode::WIFI)
     {
-        streamServer.startStreamServer();
+        // port 80 joins the REST API's loop, one task serves the stream, the logs and the commands
+        streamServer.startStreamServer(*restAPI);
     }
-    xTaskCreate(HandleRestAPIPollTask, "HandleRestAPIPollTask", 2024 * 2, restAPI.get(),
-                1,  // it's the rest API, we only serve commands over it so we don't really need a higher priority
+    xTaskCreate(HandleRestAPIPollTask, "HandleRestAPIPollTask", 1024 * 6, restAPI.get(),
+                tskIDLE_PRIORITY + 5,  // same as the frame producer, stream sends used to run at this priority in their own tasks
                 nullptr);
 #else
     ESP_LOGW("[MAIN]", "Wireless is disabled by configuration; skipping WiFi/mDNS/REST startup.");
@@ -296,6 +297,9 @@ extern "C" void app_main(void)
     dependencyRegistry->registerService<LogManager>(DependencyType::log_manager, logMgr);
 #endif
 
+    // from here on scan_networks and connect_wifi run on a task of their own, serial and the rest api only queue them
+    commandManager->startJobs();
+
     // add endpoint to check firmware version
 
     // esp_log_set_vprintf(&websocket_logger);
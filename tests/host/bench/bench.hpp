@@ -0,0 +1,194 @@
+#pragma once
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+// What the host benches share: their command line and how their checks report.
+//
+// A bench lists its checks in a table of names. Run as it is, it does every check and then the timing. With
+// --check NAME it only does that one check and skips the timing, which is how ctest runs them - one test per
+// check, so a failing test says which behaviour broke rather than which bench.
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace bench
+{
+struct Check
+{
+    const char* name;
+    const char* description;
+};
+
+namespace detail
+{
+inline size_t failures = 0;
+}  // namespace detail
+
+// something the running check found wrong, the first few get printed
+[[gnu::format(printf, 1, 2)]] inline void fail(const char* format, ...)
+{
+    if (detail::failures++ >= 10)
+        return;
+    std::printf("FAILED: ");
+    va_list args;
+    va_start(args, format);
+    std::vprintf(format, args);
+    va_end(args);
+    std::printf("\n");
+}
+
+inline double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    const auto index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+class Args
+{
+   public:
+    template <size_t N>
+    explicit Args(const Check (&checks)[N]) : checks(checks, checks + N)
+    {
+    }
+
+    // --name N, anything outside of [min, max] is taken as the closer end
+    template <typename T>
+        requires std::is_arithmetic_v<T>
+    void option(const char* name, T& value, const char* help, T min = std::numeric_limits<T>::lowest(), T max = std::numeric_limits<T>::max())
+    {
+        this->options.push_back({name, "N", help,
+                                 [&value, min, max](const char* text)
+                                 {
+                                     const double parsed = std::strtod(text, nullptr);
+                                     if (parsed <= static_cast<double>(min))
+                                         value = min;
+                                     else if (parsed >= static_cast<double>(max))
+                                         value = max;
+                                     else
+                                         value = static_cast<T>(parsed);
+                                 }});
+    }
+
+    // --name TEXT, kept as it was given
+    void option(const char* name, const char*& value, const char* metavar, const char* help)
+    {
+        this->options.push_back({name, metavar, help, [&value](const char* text) { value = text; }});
+    }
+
+    // the exit code main() has to return after --help or something it doesn't know, -1 to carry on
+    int parse(int argc, char** argv)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            const std::string_view arg = argv[i];
+            if (arg == "--help")
+            {
+                this->usage(argv[0]);
+                return 0;
+            }
+            if (i + 1 == argc)
+            {
+                this->usage(argv[0]);
+                return 2;
+            }
+
+            if (arg == "--check" && this->find(argv[i + 1]) != nullptr)
+            {
+                this->selected = argv[++i];
+                continue;
+            }
+            const auto option = std::find_if(this->options.begin(), this->options.end(), [&](const Option& option) { return arg == option.name; });
+            if (option == this->options.end())
+            {
+                this->usage(argv[0]);
+                return 2;
+            }
+            option->set(argv[++i]);
+        }
+        return -1;
+    }
+
+    // runs the check unless --check asked for another one, says how it went and returns false if it failed.
+    // It fails when it calls fail() or returns false
+    template <typename Fn>
+    bool run(const char* name, Fn&& fn)
+    {
+        if (this->find(name) == nullptr)
+        {
+            std::printf("no check called %s in the table\n", name);
+            return false;
+        }
+        if (this->selected != nullptr && std::strcmp(this->selected, name) != 0)
+            return true;
+
+        detail::failures = 0;
+        bool ok = true;
+        if constexpr (std::is_void_v<std::invoke_result_t<Fn>>)
+            fn();
+        else
+            ok = fn();
+        ok = ok && detail::failures == 0;
+        std::printf("check %-20s %s\n", name, ok ? "ok" : "FAILED");
+        return ok;
+    }
+
+    // false when only one check was asked for
+    bool timing() const
+    {
+        return this->selected == nullptr;
+    }
+
+   private:
+    struct Option
+    {
+        const char* name;
+        const char* metavar;
+        const char* help;
+        std::function<void(const char*)> set;
+    };
+
+    const Check* find(std::string_view name) const
+    {
+        const auto check = std::find_if(this->checks.begin(), this->checks.end(), [&](const Check& check) { return name == check.name; });
+        return check != this->checks.end() ? &*check : nullptr;
+    }
+
+    void usage(const char* program) const
+    {
+        size_t width = std::strlen("--check");
+        std::printf("usage: %s", program);
+        for (const auto& option : this->options)
+        {
+            std::printf(" [%s %s]", option.name, option.metavar);
+            width = std::max(width, std::strlen(option.name));
+        }
+        std::printf(" [--check NAME]\n");
+
+        for (const auto& option : this->options)
+            std::printf("  %-*s  %s\n", static_cast<int>(width), option.name, option.help);
+        std::printf("  %-*s  only run this check, without the timing:\n", static_cast<int>(width), "--check");
+
+        size_t name_width = 0;
+        for (const auto& check : this->checks)
+            name_width = std::max(name_width, std::strlen(check.name));
+        for (const auto& check : this->checks)
+            std::printf("  %-*s    %-*s  %s\n", static_cast<int>(width), "", static_cast<int>(name_width), check.name, check.description);
+    }
+
+    std::vector<Check> checks;
+    std::vector<Option> options;
+    const char* selected = nullptr;
+};
+}  // namespace bench
+
+#endif  // BENCH_HPP
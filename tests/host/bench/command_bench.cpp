@@ -0,0 +1,496 @@
+// Microbenchmark for the serial command path.
+//
+// Every case runs one request line through the same steps SerialManager does on the device:
+// executeFromJson() streaming into a ResponseWriter, then the trailing "\n". For each case we report
+// latency percentiles, heap allocations per request, bytes allocated per request and the peak heap
+// growth while the request was in flight - the last one is what matters on a device with ~300 KB of DRAM.
+//
+// Before that every command has to answer with success, a request must not leave anything allocated
+// behind once it's done and a batch of pings as long as a serial line has to go through. Any of them
+// failing fails the run.
+//
+// usage: command_bench [--iterations N] [--filter TEXT] [--json PATH] [--check NAME]
+
+#include <malloc.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <CommandManager.hpp>
+#include <FanManager.hpp>
+#include <LEDManager.hpp>
+#include <wifiManager.hpp>
+
+#include "bench.hpp"
+
+// allocation tracking
+
+namespace
+{
+struct HeapCounters
+{
+    std::atomic<bool> enabled{false};
+    std::atomic<size_t> allocations{0};
+    std::atomic<size_t> allocated_bytes{0};
+    std::atomic<long long> live_bytes{0};
+    std::atomic<long long> peak_bytes{0};
+};
+
+HeapCounters heap;
+
+void* tracked_alloc(size_t size, size_t alignment)
+{
+    void* ptr = nullptr;
+    if (alignment > alignof(std::max_align_t))
+    {
+        if (posix_memalign(&ptr, alignment, size ? size : 1) != 0)
+            ptr = nullptr;
+    }
+    else
+    {
+        ptr = std::malloc(size ? size : 1);
+    }
+
+    if (!ptr)
+    {
+        std::fputs("out of memory\n", stderr);
+        std::abort();
+    }
+
+    if (heap.enabled.load(std::memory_order_relaxed))
+    {
+        const auto usable = static_cast<long long>(malloc_usable_size(ptr));
+        heap.allocations.fetch_add(1, std::memory_order_relaxed);
+        heap.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+        const long long live = heap.live_bytes.fetch_add(usable, std::memory_order_relaxed) + usable;
+        long long peak = heap.peak_bytes.load(std::memory_order_relaxed);
+        while (live > peak && !heap.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        {
+        }
+    }
+    return ptr;
+}
+
+void tracked_free(void* ptr)
+{
+    if (!ptr)
+        return;
+    // frees of blocks allocated before tracking was turned on would make the live count drift,
+    // every case starts and ends with tracking on so the drift cancels out per request
+    if (heap.enabled.load(std::memory_order_relaxed))
+        heap.live_bytes.fetch_sub(static_cast<long long>(malloc_usable_size(ptr)), std::memory_order_relaxed);
+    std::free(ptr);
+}
+}  // namespace
+
+void* operator new(size_t size)
+{
+    return tracked_alloc(size, alignof(std::max_align_t));
+}
+void* operator new[](size_t size)
+{
+    return tracked_alloc(size, alignof(std::max_align_t));
+}
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return tracked_alloc(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return tracked_alloc(size, static_cast<size_t>(alignment));
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return tracked_alloc(size, alignof(std::max_align_t));
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return tracked_alloc(size, alignof(std::max_align_t));
+}
+void operator delete(void* ptr) noexcept
+{
+    tracked_free(ptr);
+}
+void operator delete[](void* ptr) noexcept
+{
+    tracked_free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept
+{
+    tracked_free(ptr);
+}
+void operator delete[](void* ptr, size_t) noexcept
+{
+    tracked_free(ptr);
+}
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    tracked_free(ptr);
+}
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    tracked_free(ptr);
+}
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+    tracked_free(ptr);
+}
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+    tracked_free(ptr);
+}
+
+// benchmark cases
+
+namespace
+{
+struct BenchCase
+{
+    const char* name;
+    const char* request;
+};
+
+// one line per request, the same shape tools/openiris_device.py sends
+const BenchCase BENCH_CASES[] = {
+    {"ping", R"({"commands":[{"command":"ping"}]})"},
+    {"pause", R"({"commands":[{"command":"pause","data":{"pause":false}}]})"},
+    {"get_config", R"({"commands":[{"command":"get_config"}]})"},
+    {"set_wifi", R"({"commands":[{"command":"set_wifi","data":{"name":"main","ssid":"OpenIris","password":"hunter22","channel":0,"power":0}}]})"},
+    {"update_wifi", R"({"commands":[{"command":"update_wifi","data":{"name":"main","password":"hunter23"}}]})"},
+    {"update_ap_wifi", R"({"commands":[{"command":"update_ap_wifi","data":{"ssid":"OpenIrisAP","password":"12345678","channel":6}}]})"},
+    {"get_wifi_status", R"({"commands":[{"command":"get_wifi_status"}]})"},
+    {"connect_wifi", R"({"commands":[{"command":"connect_wifi"}]})"},
+    {"scan_networks", R"({"commands":[{"command":"scan_networks","data":{"timeout_ms":1000}}]})"},
+    {"set_mdns", R"({"commands":[{"command":"set_mdns","data":{"hostname":"openiristracker"}}]})"},
+    {"get_mdns_name", R"({"commands":[{"command":"get_mdns_name"}]})"},
+    {"update_camera", R"({"commands":[{"command":"update_camera","data":{"vflip":1,"quality":8,"brightness":2}}]})"},
+    {"update_ota_credentials", R"({"commands":[{"command":"update_ota_credentials","data":{"login":"openiris","password":"openiris","port":3232}}]})"},
+    {"switch_mode", R"({"commands":[{"command":"switch_mode","data":{"mode":"uvc"}}]})"},
+    {"get_device_mode", R"({"commands":[{"command":"get_device_mode"}]})"},
+    {"set_led_duty_cycle", R"({"commands":[{"command":"set_led_duty_cycle","data":{"dutyCycle":50}}]})"},
+    {"get_led_duty_cycle", R"({"commands":[{"command":"get_led_duty_cycle"}]})"},
+    {"get_serial", R"({"commands":[{"command":"get_serial"}]})"},
+    {"get_who_am_i", R"({"commands":[{"command":"get_who_am_i"}]})"},
+    {"get_stream_stats", R"({"commands":[{"command":"get_stream_stats"}]})"},
+    {"set_vie_window", R"({"commands":[{"command":"set_vie_window","data":{"offset_x":352,"offset_y":224,"width":320,"height":320}}]})"},
+    {"get_vie_window", R"({"commands":[{"command":"get_vie_window"}]})"},
+    // what the setup tool sends when it opens the settings summary
+    {"batch_summary",
+     R"({"commands":[{"command":"get_who_am_i"},{"command":"get_serial"},{"command":"get_device_mode"},{"command":"get_led_duty_cycle"},{"command":"get_mdns_name"},{"command":"get_wifi_status"}]})"},
+};
+
+const bench::Check CHECKS[] = {
+    {"responses", "every command answers with success"},
+    {"heap", "a request frees everything it allocated"},
+    {"full_batch", "a batch of pings as long as a serial line can be parses and every one of them answers"},
+};
+
+// SerialManager's BUF_SIZE, a line has to fit in there with its NUL
+constexpr size_t SERIAL_LINE_BYTES = 1024;
+
+// requests per command for the heap check, the first one is a warm-up that doesn't count
+constexpr size_t HEAP_CHECK_REQUESTS = 20;
+
+struct CaseResult
+{
+    std::string name;
+    size_t iterations = 0;
+    double p50_us = 0;
+    double p99_us = 0;
+    double max_us = 0;
+    double mean_us = 0;
+    double allocs_per_call = 0;
+    double bytes_per_call = 0;
+    long long peak_heap = 0;
+    long long retained_per_call = 0;
+    size_t response_bytes = 0;
+    bool ok = true;
+    std::string failure;
+};
+
+// stands in for the usb / cdc transport, the bytes just go nowhere
+class DiscardSink : public ResponseSink
+{
+   public:
+    void write(const char* data, size_t length) override
+    {
+        (void)data;
+        bytes += length;
+    }
+
+    size_t bytes = 0;
+};
+
+// only used outside of the measured loop, to look at what the response actually says
+class StringSink : public ResponseSink
+{
+   public:
+    void write(const char* data, size_t length) override
+    {
+        text.append(data, length);
+    }
+
+    std::string text;
+};
+
+void run_request(const CommandManager& commandManager, std::string_view request, ResponseSink& sink)
+{
+    // mirrors SerialManager::try_receive()
+    ResponseWriter writer(sink);
+    commandManager.executeFromJson(request, writer);
+    writer.raw("\n");
+    writer.flush();
+}
+
+bool check_response(const std::string& line, std::string& failure)
+{
+    auto parsed = nlohmann::json::parse(line, nullptr, false);
+    if (parsed.is_discarded() || !parsed.contains("results"))
+    {
+        failure = "malformed response: " + line;
+        return false;
+    }
+
+    for (const auto& entry : parsed["results"])
+    {
+        if (!entry.contains("result") || entry["result"].value("status", "") != "success")
+        {
+            failure = "command failed: " + entry.dump();
+            return false;
+        }
+    }
+    return true;
+}
+
+CaseResult run_case(const CommandManager& commandManager, const BenchCase& benchCase, size_t iterations)
+{
+    CaseResult result;
+    result.name = benchCase.name;
+    result.iterations = iterations;
+
+    // the first request loads config from nvs, fills caches etc, don't let it skew the numbers
+    StringSink warmup;
+    run_request(commandManager, benchCase.request, warmup);
+    result.response_bytes = warmup.text.size();
+    if (!check_response(warmup.text, result.failure))
+    {
+        result.ok = false;
+        return result;
+    }
+
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    size_t total_allocs = 0;
+    size_t total_bytes = 0;
+    long long total_retained = 0;
+
+    for (size_t i = 0; i < iterations; i++)
+    {
+        heap.allocations = 0;
+        heap.allocated_bytes = 0;
+        heap.live_bytes = 0;
+        heap.peak_bytes = 0;
+        heap.enabled = true;
+
+        const auto start = std::chrono::steady_clock::now();
+        {
+            DiscardSink sink;
+            run_request(commandManager, benchCase.request, sink);
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        heap.enabled = false;
+
+        samples.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        total_allocs += heap.allocations;
+        total_bytes += heap.allocated_bytes;
+        total_retained += heap.live_bytes;
+        result.peak_heap = std::max(result.peak_heap, heap.peak_bytes.load());
+    }
+
+    double sum = 0;
+    for (const double sample : samples)
+        sum += sample;
+    std::sort(samples.begin(), samples.end());
+
+    result.p50_us = bench::percentile(samples, 0.50);
+    result.p99_us = bench::percentile(samples, 0.99);
+    result.max_us = samples.back();
+    result.mean_us = sum / static_cast<double>(iterations);
+    result.allocs_per_call = static_cast<double>(total_allocs) / static_cast<double>(iterations);
+    result.bytes_per_call = static_cast<double>(total_bytes) / static_cast<double>(iterations);
+    result.retained_per_call = total_retained / static_cast<long long>(iterations);
+    return result;
+}
+
+// as many pings as fit on one line, far more tokens than the parser keeps inline
+void verify_full_batch(const CommandManager& commandManager)
+{
+    const std::string_view ping = R"({"command":"ping"})";
+    std::string request = R"({"commands":[)";
+    size_t commands = 0;
+    while (request.size() + ping.size() + 3 < SERIAL_LINE_BYTES)
+    {
+        request += commands++ ? "," : "";
+        request += ping;
+    }
+    request += "]}";
+
+    StringSink sink;
+    std::string failure;
+    run_request(commandManager, request, sink);
+    if (!check_response(sink.text, failure))
+    {
+        bench::fail("%zu pings in %zu bytes: %s", commands, request.size(), failure.c_str());
+        return;
+    }
+    const auto answered = nlohmann::json::parse(sink.text)["results"].size();
+    if (answered != commands)
+        bench::fail("%zu pings in %zu bytes, %zu answers", commands, request.size(), answered);
+}
+
+void write_json(const char* path, const std::vector<CaseResult>& results)
+{
+    nlohmann::json report = nlohmann::json::array();
+    for (const auto& r : results)
+    {
+        report.push_back({
+            {"name", r.name},
+            {"ok", r.ok},
+            {"iterations", r.iterations},
+            {"p50_us", r.p50_us},
+            {"p99_us", r.p99_us},
+            {"max_us", r.max_us},
+            {"mean_us", r.mean_us},
+            {"allocs_per_call", r.allocs_per_call},
+            {"bytes_per_call", r.bytes_per_call},
+            {"peak_heap_bytes", r.peak_heap},
+            {"retained_bytes_per_call", r.retained_per_call},
+            {"response_bytes", r.response_bytes},
+        });
+    }
+
+    FILE* file = std::fopen(path, "w");
+    if (!file)
+    {
+        std::fprintf(stderr, "could not open %s for writing\n", path);
+        return;
+    }
+    const std::string text = report.dump(2);
+    std::fwrite(text.data(), 1, text.size(), file);
+    std::fputc('\n', file);
+    std::fclose(file);
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    size_t iterations = 2000;
+    const char* filter = nullptr;
+    const char* json_path = nullptr;
+
+    bench::Args args(CHECKS);
+    args.option("--iterations", iterations, "timed requests per command (default 2000)", size_t(1));
+    args.option("--filter", filter, "TEXT", "only the commands with this in their name");
+    args.option("--json", json_path, "PATH", "write the results there as well");
+    if (const int exit_code = args.parse(argc, argv); exit_code >= 0)
+        return exit_code;
+
+    // the same wiring app_main() does, minus the hardware
+    static Preferences preferences;
+    auto deviceConfig = std::make_shared<ProjectConfig>(&preferences);
+    preferences.begin("openiris", false);
+    deviceConfig->load();
+
+    auto dependencyRegistry = std::make_shared<DependencyRegistry>();
+    dependencyRegistry->registerService<ProjectConfig>(DependencyType::project_config, deviceConfig);
+    dependencyRegistry->registerService<CameraManager>(DependencyType::camera_manager, std::make_shared<CameraManager>(deviceConfig));
+    dependencyRegistry->registerService<WiFiManager>(DependencyType::wifi_manager, std::make_shared<WiFiManager>());
+    dependencyRegistry->registerService<LEDManager>(DependencyType::led_manager, std::make_shared<LEDManager>(deviceConfig));
+    dependencyRegistry->registerService<FanManager>(DependencyType::fan_manager, std::make_shared<FanManager>(deviceConfig));
+    const CommandManager commandManager(dependencyRegistry);
+
+    // a few seconds of 60fps frames on both transports, so get_stream_stats has full histograms to write
+    for (int frame = 0; frame < 300; frame++)
+    {
+        const int64_t vsync = 1000000 + frame * 16666;
+        const FrameTelemetry::FrameTiming timing{vsync, vsync + 8000, vsync + 8200 + (frame % 7) * 300, vsync + 8500, vsync + 12000 + (frame % 50) * 400};
+        FrameTelemetry::record(FrameTelemetry::Transport::UVC, timing);
+        FrameTelemetry::record(FrameTelemetry::Transport::HTTP, timing);
+    }
+    // and a handful of stream starts, some reopening the same format, some switching
+    for (int start = 0; start < 10; start++)
+    {
+        const int64_t commit = 1000000 + start * 2000000;
+        FrameTelemetry::recordStart(FrameTelemetry::Transport::UVC, FrameTelemetry::StartStage::Configure, commit, commit + (start % 3 ? 900 : 60000));
+        FrameTelemetry::recordStart(FrameTelemetry::Transport::UVC, FrameTelemetry::StartStage::FirstFrame, commit, commit + (start % 3 ? 30000 : 95000));
+        FrameTelemetry::recordStart(FrameTelemetry::Transport::HTTP, FrameTelemetry::StartStage::FirstFrame, commit, commit + 25000);
+    }
+
+    const auto selected = [&](const BenchCase& benchCase) { return !filter || std::strstr(benchCase.name, filter); };
+
+    bool ok = args.run("responses",
+                       [&]
+                       {
+                           for (const auto& benchCase : BENCH_CASES)
+                           {
+                               if (!selected(benchCase))
+                                   continue;
+                               StringSink sink;
+                               std::string failure;
+                               run_request(commandManager, benchCase.request, sink);
+                               if (!check_response(sink.text, failure))
+                                   bench::fail("%s: %s", benchCase.name, failure.c_str());
+                           }
+                       });
+    ok &= args.run("heap",
+                   [&]
+                   {
+                       for (const auto& benchCase : BENCH_CASES)
+                       {
+                           if (!selected(benchCase))
+                               continue;
+                           const auto result = run_case(commandManager, benchCase, HEAP_CHECK_REQUESTS);
+                           if (!result.ok)
+                               bench::fail("%s: %s", benchCase.name, result.failure.c_str());
+                           else if (result.retained_per_call != 0)
+                               bench::fail("%s keeps %lld bytes per request", benchCase.name, result.retained_per_call);
+                       }
+                   });
+    ok &= args.run("full_batch", [&] { verify_full_batch(commandManager); });
+    if (!ok || !args.timing())
+        return ok ? 0 : 1;
+
+    std::vector<CaseResult> results;
+
+    std::printf("%-24s %10s %10s %10s %10s %12s %12s %10s %8s\n", "command", "p50 us", "p99 us", "max us", "allocs", "bytes/call", "peak heap", "retained",
+                "resp");
+    for (const auto& benchCase : BENCH_CASES)
+    {
+        if (!selected(benchCase))
+            continue;
+
+        auto result = run_case(commandManager, benchCase, iterations);
+        if (!result.ok)
+        {
+            std::printf("%-24s FAILED: %s\n", result.name.c_str(), result.failure.c_str());
+        }
+        else
+        {
+            std::printf("%-24s %10.2f %10.2f %10.2f %10.1f %12.0f %12lld %10lld %8zu\n", result.name.c_str(), result.p50_us, result.p99_us, result.max_us,
+                        result.allocs_per_call, result.bytes_per_call, result.peak_heap, result.retained_per_call, result.response_bytes);
+        }
+        results.push_back(std::move(result));
+    }
+
+    if (json_path)
+        write_json(json_path, results);
+    return 0;
+}
@@ -0,0 +1,378 @@
+// Long commands on the job worker, the way scan_networks and connect_wifi run on the device.
+//
+// A scan used to run on the task that received it, 13 channels of 100-200 ms plus a 50 ms gap each, and every
+// command sent in the meantime waited behind it. The host WiFiManager takes as long as the device with
+// --dwell-ms per channel. The bench times scan_networks once the old way and once as a job, and while the job
+// runs keeps sending ping and get_led_duty_cycle through executeFromJson, the way the serial task would,
+// polling get_job_status in between.
+//
+// The checks: the scan answers with a job id right away, the cheap commands next to it take less than a
+// millisecond at the median, the progress doesn't go backwards and the result is the whole scan, as json and as
+// cbor. The last one fills every slot and makes sure the next long command gets turned away instead of piling up.
+//
+// usage: command_jobs_bench [--dwell-ms N] [--networks N] [--check NAME]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <CommandManager.hpp>
+#include <FanManager.hpp>
+#include <LEDManager.hpp>
+#include <wifiManager.hpp>
+
+#include "bench.hpp"
+
+namespace
+{
+const bench::Check CHECKS[] = {
+    {"submit", "scan_networks answers with a job id right away"},
+    {"responsive", "ping and get_led_duty_cycle stay under a millisecond at the median while the scan runs"},
+    {"progress", "get_job_status reports progress that only climbs, up to 100"},
+    {"result", "the finished job holds the whole scan, read as json and as cbor"},
+    {"slots", "with every slot busy the next long command is turned away, finished jobs make room again"},
+};
+
+// what the setup tool keeps asking while it waits for a scan
+const char* const CHEAP_REQUESTS[] = {
+    R"({"commands":[{"command":"ping"}]})",
+    R"({"commands":[{"command":"get_led_duty_cycle"}]})",
+};
+
+const std::string SCAN = R"({"commands":[{"command":"scan_networks","data":{"timeout_ms":15000}}]})";
+
+constexpr double MAX_CHEAP_MEDIAN_US = 1000;
+// a submit copies the payload and queues the slot, anything near a channel's dwell means it ran the scan
+constexpr double MAX_SUBMIT_MS = 5;
+constexpr auto STATUS_POLL_INTERVAL = std::chrono::milliseconds(20);
+
+class StringSink : public ResponseSink
+{
+   public:
+    void write(const char* data, size_t length) override
+    {
+        text.append(data, length);
+    }
+
+    std::string text;
+};
+
+// mirrors SerialManager::try_receive(), hands back the one result of the line
+nlohmann::json run_request(const CommandManager& commandManager, std::string_view request)
+{
+    StringSink sink;
+    ResponseWriter writer(sink);
+    commandManager.executeFromJson(request, writer);
+    writer.raw("\n");
+    writer.flush();
+
+    const auto parsed = nlohmann::json::parse(sink.text, nullptr, false);
+    if (parsed.is_discarded() || !parsed.contains("results") || parsed["results"].empty())
+        return nlohmann::json();
+    return parsed["results"][0]["result"];
+}
+
+double elapsed_us(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool succeeded(const nlohmann::json& result)
+{
+    return result.is_object() && result.value("status", "") == "success";
+}
+
+std::shared_ptr<DependencyRegistry> make_registry(const std::shared_ptr<ProjectConfig>& deviceConfig, size_t networks, int dwell_ms)
+{
+    auto registry = std::make_shared<DependencyRegistry>();
+    registry->registerService<ProjectConfig>(DependencyType::project_config, deviceConfig);
+    registry->registerService<CameraManager>(DependencyType::camera_manager, std::make_shared<CameraManager>(deviceConfig));
+    registry->registerService<WiFiManager>(DependencyType::wifi_manager, std::make_shared<WiFiManager>(networks, dwell_ms));
+    registry->registerService<LEDManager>(DependencyType::led_manager, std::make_shared<LEDManager>(deviceConfig));
+    registry->registerService<FanManager>(DependencyType::fan_manager, std::make_shared<FanManager>(deviceConfig));
+    return registry;
+}
+
+nlohmann::json job_status(const CommandManager& commandManager, uint32_t id)
+{
+    const std::string request = R"({"commands":[{"command":"get_job_status","data":{"id":)" + std::to_string(id) + "}}]}";
+    return run_request(commandManager, request);
+}
+
+// polls until the job is done, false if it never got there or the progress went backwards
+bool wait_for_job(const CommandManager& commandManager, uint32_t id, nlohmann::json& status, std::string& failure)
+{
+    int last_progress = -1;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        const auto result = job_status(commandManager, id);
+        if (!succeeded(result))
+        {
+            failure = "get_job_status failed: " + result.dump();
+            return false;
+        }
+        status = result["data"];
+        const int progress = status.value("progress", -1);
+        if (progress < last_progress)
+        {
+            failure = "progress went from " + std::to_string(last_progress) + " back to " + std::to_string(progress);
+            return false;
+        }
+        last_progress = progress;
+        if (status.value("state", "") == "done")
+            return true;
+        std::this_thread::sleep_for(STATUS_POLL_INTERVAL);
+    }
+    failure = "job " + std::to_string(id) + " never finished";
+    return false;
+}
+
+uint32_t job_id(const nlohmann::json& result)
+{
+    if (!succeeded(result) || !result["data"].is_object() || !result["data"].contains("job_id"))
+        return 0;
+    return result["data"]["job_id"].get<uint32_t>();
+}
+
+// one scan the old way and one as a job with the cheap commands next to it, what all but the slots check look at
+struct ScanRun
+{
+    nlohmann::json inlineResult;
+    double inline_ms = 0;
+    double submit_ms = 0;
+    uint32_t id = 0;
+    // to within a poll interval
+    double job_ms = 0;
+    std::vector<double> cheap;
+    std::vector<int> progress;
+    nlohmann::json status;
+    // the same status read over cbor
+    nlohmann::json cborStatus;
+    // set when the run couldn't get as far as the end of the job
+    std::string failure;
+};
+
+ScanRun run_scan(const CommandManager& inlineManager, const CommandManager& jobManager, CommandJobs& jobs, size_t networks)
+{
+    ScanRun run;
+    auto start = std::chrono::steady_clock::now();
+    run.inlineResult = run_request(inlineManager, SCAN);
+    run.inline_ms = elapsed_us(start) / 1000;
+    if (!succeeded(run.inlineResult) || run.inlineResult["data"]["networks"].size() != networks)
+    {
+        run.failure = "the scan without the worker didn't come back with " + std::to_string(networks) + " networks: " + run.inlineResult.dump();
+        return run;
+    }
+
+    const auto submit_start = std::chrono::steady_clock::now();
+    const auto submitted = run_request(jobManager, SCAN);
+    run.submit_ms = elapsed_us(submit_start) / 1000;
+    if ((run.id = job_id(submitted)) == 0)
+    {
+        run.failure = "scan_networks didn't answer with a job: " + submitted.dump();
+        return run;
+    }
+
+    // the cheap commands keep going while the worker scans, get_job_status in between like a tool waiting on it
+    auto next_poll = std::chrono::steady_clock::now();
+    size_t request = 0;
+    while (true)
+    {
+        if (std::chrono::steady_clock::now() >= next_poll)
+        {
+            const auto result = job_status(jobManager, run.id);
+            if (!succeeded(result))
+            {
+                run.failure = "get_job_status: " + result.dump();
+                return run;
+            }
+            run.status = result["data"];
+            run.progress.push_back(run.status.value("progress", -1));
+            if (run.status.value("state", "") == "done")
+                break;
+            next_poll += STATUS_POLL_INTERVAL;
+        }
+
+        start = std::chrono::steady_clock::now();
+        const auto result = run_request(jobManager, CHEAP_REQUESTS[request++ % std::size(CHEAP_REQUESTS)]);
+        run.cheap.push_back(elapsed_us(start));
+        if (!succeeded(result))
+        {
+            run.failure = "a command next to the scan failed: " + result.dump();
+            return run;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+
+    run.job_ms = elapsed_us(submit_start) / 1000;
+    std::sort(run.cheap.begin(), run.cheap.end());
+
+    StringSink cborSink;
+    ResponseWriter cborWriter(cborSink, ResponseWriter::Encoding::Cbor);
+    jobs.writeStatus(run.id, cborWriter);
+    cborWriter.flush();
+    run.cborStatus = nlohmann::json::from_cbor(cborSink.text, true, false);
+    return run;
+}
+
+void verify_submit(const ScanRun& run)
+{
+    if (run.submit_ms > MAX_SUBMIT_MS)
+        bench::fail("submitting the scan took %.2f ms", run.submit_ms);
+}
+
+void verify_responsive(const ScanRun& run)
+{
+    const double p50 = bench::percentile(run.cheap, 0.50);
+    if (run.cheap.empty() || p50 > MAX_CHEAP_MEDIAN_US)
+        bench::fail("commands next to the scan took %.1f us at the median", p50);
+}
+
+void verify_progress(const ScanRun& run)
+{
+    if (run.progress.empty() || !std::is_sorted(run.progress.begin(), run.progress.end()) || run.progress.back() != 100)
+        bench::fail("progress has to climb to 100");
+}
+
+void verify_result(const ScanRun& run)
+{
+    const nlohmann::json& status = run.status;
+    if (status.value("status", "") != "success" || status.value("command", "") != "scan_networks" || !status.contains("result") ||
+        status["result"]["networks"] != run.inlineResult["data"]["networks"])
+    {
+        bench::fail("the job's result isn't the scan: %s", status.dump().c_str());
+    }
+
+    // the result is kept as json text, over cbor it has to come out as the same document
+    if (run.cborStatus.is_discarded() || run.cborStatus != status)
+        bench::fail("the job's status over cbor differs from the json one: %s", run.cborStatus.dump().c_str());
+}
+
+// every slot taken, the next one has to be turned away, and finished jobs make room again
+void verify_slots(const CommandManager& jobManager)
+{
+    // connect_wifi needs a network to go for
+    const char* setWifi = R"({"commands":[{"command":"set_wifi","data":{"name":"main","ssid":"OpenIris","password":"hunter22","channel":0,"power":0}}]})";
+    if (!succeeded(run_request(jobManager, setWifi)))
+    {
+        bench::fail("set_wifi");
+        return;
+    }
+    std::vector<uint32_t> ids;
+    for (size_t i = 0; i < CommandJobs::MAX_JOBS; i++)
+    {
+        const uint32_t queued = job_id(run_request(jobManager, i % 2 ? R"({"commands":[{"command":"connect_wifi"}]})" : SCAN));
+        if (queued == 0)
+        {
+            bench::fail("job %zu of %zu wasn't queued", i + 1, CommandJobs::MAX_JOBS);
+            return;
+        }
+        ids.push_back(queued);
+    }
+
+    const auto refused = run_request(jobManager, SCAN);
+    if (succeeded(refused))
+        bench::fail("a job got queued with every slot busy: %s", refused.dump().c_str());
+
+    const auto listed = run_request(jobManager, R"({"commands":[{"command":"get_job_status"}]})");
+    if (!succeeded(listed) || listed["data"]["jobs"].size() != CommandJobs::MAX_JOBS)
+        bench::fail("get_job_status without an id should list %zu jobs: %s", CommandJobs::MAX_JOBS, listed.dump().c_str());
+
+    for (const uint32_t queued : ids)
+    {
+        std::string failure;
+        nlohmann::json done;
+        if (!wait_for_job(jobManager, queued, done, failure))
+        {
+            bench::fail("%s", failure.c_str());
+            return;
+        }
+        if (done.value("status", "") != "success")
+            bench::fail("job %u: %s", queued, done.dump().c_str());
+    }
+
+    if (job_id(run_request(jobManager, SCAN)) == 0)
+        bench::fail("finished jobs didn't make room for new ones");
+    if (succeeded(job_status(jobManager, ids.front())))
+        bench::fail("job %u should have given its slot to a newer one", ids.front());
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    int dwell_ms = 200;
+    size_t networks = 40;
+
+    bench::Args args(CHECKS);
+    args.option("--dwell-ms", dwell_ms, "time the simulated scan spends on each of the 13 channels (default 200)", 0);
+    args.option("--networks", networks, "networks the scan finds (default 40)", size_t(1));
+    if (const int exit_code = args.parse(argc, argv); exit_code >= 0)
+        return exit_code;
+
+    // the same wiring app_main() does, minus the hardware
+    static Preferences preferences;
+    auto deviceConfig = std::make_shared<ProjectConfig>(&preferences);
+    preferences.begin("openiris", false);
+    deviceConfig->load();
+
+    // one manager as it was, one with the worker running, each registers its jobs in its own registry
+    const CommandManager inlineManager(make_registry(deviceConfig, networks, dwell_ms));
+    const auto jobRegistry = make_registry(deviceConfig, networks, dwell_ms);
+    CommandManager jobManager(jobRegistry);
+    if (!jobManager.startJobs())
+    {
+        std::printf("FAILED: the job worker didn't start\n");
+        return 1;
+    }
+
+    // the scan takes seconds, so it runs once, for the first check that needs it
+    std::optional<ScanRun> scanRun;
+    const auto scan = [&]() -> const ScanRun&
+    {
+        if (!scanRun)
+        {
+            scanRun = run_scan(inlineManager, jobManager, *jobRegistry->resolve<CommandJobs>(DependencyType::command_jobs), networks);
+            if (!scanRun->failure.empty())
+                std::printf("the scan run stopped early: %s\n", scanRun->failure.c_str());
+        }
+        return *scanRun;
+    };
+    const auto with_scan = [&](void (*verify)(const ScanRun&))
+    {
+        return [&scan, verify]
+        {
+            if (!scan().failure.empty())
+                bench::fail("%s", scan().failure.c_str());
+            else
+                verify(scan());
+        };
+    };
+
+    bool ok = args.run("submit", with_scan(verify_submit));
+    ok &= args.run("responsive", with_scan(verify_responsive));
+    ok &= args.run("progress", with_scan(verify_progress));
+    ok &= args.run("result", with_scan(verify_result));
+    ok &= args.run("slots", [&] { verify_slots(jobManager); });
+    if (!ok || !args.timing())
+        return ok ? 0 : 1;
+
+    const ScanRun& run = scan();
+    std::printf("\n%-34s %10.2f ms\n", "scan_networks without the worker", run.inline_ms);
+    std::printf("%-34s %10.3f ms (job %u, done after %.0f ms)\n", "scan_networks as a job", run.submit_ms, run.id, run.job_ms);
+    std::printf("%-34s %10zu requests, p50 %.1f us, p99 %.1f us, max %.1f us\n", "ping/get_led_duty_cycle meanwhile", run.cheap.size(),
+                bench::percentile(run.cheap, 0.50), bench::percentile(run.cheap, 0.99), run.cheap.empty() ? 0 : run.cheap.back());
+    std::printf("%-34s", "progress seen");
+    for (size_t i = 0; i < run.progress.size(); i++)
+    {
+        if (i == 0 || run.progress[i] != run.progress[i - 1])
+            std::printf(" %d", run.progress[i]);
+    }
+    std::printf("\n");
+    return 0;
+}
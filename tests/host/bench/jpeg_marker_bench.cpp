@@ -0,0 +1,231 @@
+// Microbenchmark for the JPEG marker search in the camera driver.
+//
+// cam_task() looks for SOI at the start of the first DMA buffer of every frame and cam_take() looks for the
+// last EOI to trim the DMA padding off the end. Both run once per frame, on a buffer the size of the frame,
+// so this is a couple of hundred KB/s of byte compares on the device at 60 fps.
+//
+// Before timing anything every picture in components/esp32-camera/test/pictures is checked against the
+// byte-wise memcmp search the driver used to have - at every alignment, with and without padding, with
+// the markers stripped - plus a pile of random buffers full of 0xFF and 0xD9. Any mismatch fails the run.
+//
+// usage: jpeg_marker_bench [--iterations N] [--pictures DIR] [--check NAME]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <jpeg_markers.h>
+
+#include "bench.hpp"
+
+namespace
+{
+const bench::Check CHECKS[] = {
+    {"pictures", "the test pictures at every alignment, padded, shifted and stripped"},
+    {"random", "short random buffers made of marker bytes"},
+};
+
+// the search cam_hal.c had before, kept as the reference
+const uint8_t JPEG_SOI_MARKER[] = {0xFF, 0xD8, 0xFF};
+const uint8_t JPEG_EOI_MARKER[] = {0xFF, 0xD9};
+
+int reference_find_soi(const uint8_t* inbuf, size_t length)
+{
+    // the old loop compared past the end of the buffer, this one stops where the marker still fits
+    for (size_t i = 0; i + 3 <= length; i++)
+    {
+        if (memcmp(&inbuf[i], JPEG_SOI_MARKER, 3) == 0)
+            return i;
+    }
+    return -1;
+}
+
+int reference_find_eoi(const uint8_t* inbuf, size_t length)
+{
+    if (length < 2)
+        return -1;
+    const uint8_t* dptr = inbuf + length - 2;
+    while (dptr > inbuf)
+    {
+        if (memcmp(dptr, JPEG_EOI_MARKER, 2) == 0)
+            return dptr - inbuf;
+        dptr--;
+    }
+    return -1;
+}
+
+struct Picture
+{
+    std::string name;
+    std::vector<uint8_t> data;
+};
+
+std::vector<Picture> load_pictures(const std::filesystem::path& directory)
+{
+    std::vector<Picture> pictures;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+        if (entry.path().extension() != ".jpeg" && entry.path().extension() != ".jpg")
+            continue;
+
+        std::ifstream file(entry.path(), std::ios::binary);
+        Picture picture{entry.path().filename().string(), std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {})};
+        if (!picture.data.empty())
+            pictures.push_back(std::move(picture));
+    }
+    std::sort(pictures.begin(), pictures.end(), [](const Picture& a, const Picture& b) { return a.name < b.name; });
+    return pictures;
+}
+
+void compare(const char* what, const std::string& name, const uint8_t* buffer, size_t length)
+{
+    const int expected_soi = reference_find_soi(buffer, length);
+    const int actual_soi = jpeg_find_soi(buffer, length);
+    const int expected_eoi = reference_find_eoi(buffer, length);
+    const int actual_eoi = jpeg_find_eoi(buffer, length);
+
+    if (expected_soi != actual_soi || expected_eoi != actual_eoi)
+        bench::fail("%s %s len=%zu align=%u: soi %d vs %d, eoi %d vs %d", what, name.c_str(), length,
+                    static_cast<unsigned>(reinterpret_cast<uintptr_t>(buffer) & 3), expected_soi, actual_soi, expected_eoi, actual_eoi);
+}
+
+void verify_pictures(const std::vector<Picture>& pictures)
+{
+    std::mt19937 random(1234);
+    static constexpr size_t PADDINGS[] = {0, 1, 2, 3, 4, 5, 7, 63, 1000};
+
+    for (const auto& picture : pictures)
+    {
+        const size_t size = picture.data.size();
+        std::vector<uint8_t> storage(size + 1024 + 8);
+
+        for (size_t align = 0; align < 4; align++)
+        {
+            uint8_t* buffer = storage.data() + align;
+            for (const size_t padding : PADDINGS)
+            {
+                std::memcpy(buffer, picture.data.data(), size);
+                // whatever the DMA left behind, sometimes zeros, sometimes stale bytes of an older frame
+                for (size_t i = 0; i < padding; i++)
+                    buffer[size + i] = (padding & 1) ? 0 : static_cast<uint8_t>(random());
+                compare("picture", picture.name, buffer, size + padding);
+
+                // the frame started late, SOI somewhere in the middle
+                compare("shifted", picture.name, buffer + 1 + (padding % 5), size + padding - 1 - (padding % 5));
+            }
+
+            // no markers at all
+            std::memcpy(buffer, picture.data.data(), size);
+            buffer[0] = 0;
+            buffer[size - 1] = 0;
+            compare("stripped", picture.name, buffer, size);
+
+            // every short prefix and suffix, the head and tail handling lives there
+            for (size_t length = 0; length < 16; length++)
+            {
+                compare("prefix", picture.name, buffer, length);
+                compare("suffix", picture.name, buffer + size - length, length);
+            }
+        }
+    }
+}
+
+void verify_random()
+{
+    std::mt19937 random(4321);
+    std::vector<uint8_t> storage(256 + 8);
+    // mostly marker bytes, so partial markers are everywhere
+    static constexpr uint8_t ALPHABET[] = {0xFF, 0xD8, 0xD9, 0x00, 0xFF, 0xFF};
+
+    for (size_t round = 0; round < 20000; round++)
+    {
+        const size_t align = random() % 4;
+        const size_t length = random() % 256;
+        uint8_t* buffer = storage.data() + align;
+        for (size_t i = 0; i < length; i++)
+            buffer[i] = ALPHABET[random() % sizeof(ALPHABET)];
+        compare("random", "-", buffer, length);
+    }
+}
+
+template <typename Fn>
+double measure(size_t iterations, Fn&& fn)
+{
+    // warm up the caches, then keep the best of a few runs so a noisy neighbour doesn't show up as a regression
+    fn();
+    double best = 1e30;
+    for (int run = 0; run < 5; run++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+            fn();
+        const auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::micro>(end - start).count() / iterations);
+    }
+    return best;
+}
+
+// keeps the compiler from dropping the searches
+volatile int sink;
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    size_t iterations = 2000;
+    const char* pictures_dir = OPENIRIS_TEST_PICTURES;
+
+    bench::Args args(CHECKS);
+    args.option("--iterations", iterations, "timed searches per picture and run (default 2000)", size_t(1));
+    args.option("--pictures", pictures_dir, "DIR", "the JPEGs to search (default components/esp32-camera/test/pictures)");
+    if (const int exit_code = args.parse(argc, argv); exit_code >= 0)
+        return exit_code;
+
+    const auto pictures = load_pictures(pictures_dir);
+    if (pictures.empty())
+    {
+        std::printf("no pictures found in %s\n", pictures_dir);
+        return 1;
+    }
+
+    bool ok = args.run("pictures", [&] { verify_pictures(pictures); });
+    ok &= args.run("random", verify_random);
+    if (!ok || !args.timing())
+        return ok ? 0 : 1;
+
+    // what cam_take() sees: the frame plus a DMA buffer's worth of padding that has to be walked over
+    static constexpr size_t DMA_PADDING = 4092;
+
+    std::printf("%-20s %8s %14s %14s %14s %14s %8s\n", "picture", "bytes", "eoi old us", "eoi new us", "soi miss old", "soi miss new", "speedup");
+    for (const auto& picture : pictures)
+    {
+        std::vector<uint8_t> frame(picture.data);
+        frame.resize(frame.size() + DMA_PADDING, 0);
+
+        const double eoi_old = measure(iterations, [&] { sink = reference_find_eoi(frame.data(), frame.size()); });
+        const double eoi_new = measure(iterations, [&] { sink = jpeg_find_eoi(frame.data(), frame.size()); });
+
+        // a frame that started mid-stream, the whole first buffer gets searched for nothing
+        std::vector<uint8_t> garbage(picture.data.begin() + 2, picture.data.end());
+        for (size_t i = 0; i + 2 < garbage.size(); i++)
+        {
+            if (garbage[i] == 0xFF && garbage[i + 1] == 0xD8)
+                garbage[i + 1] = 0;
+        }
+        const double soi_old = measure(iterations, [&] { sink = reference_find_soi(garbage.data(), garbage.size()); });
+        const double soi_new = measure(iterations, [&] { sink = jpeg_find_soi(garbage.data(), garbage.size()); });
+
+        std::printf("%-20s %8zu %14.3f %14.3f %14.3f %14.3f %7.1fx\n", picture.name.c_str(), frame.size(), eoi_old, eoi_new, soi_old, soi_new,
+                    (eoi_old + soi_old) / (eoi_new + soi_new));
+    }
+    return 0;
+}
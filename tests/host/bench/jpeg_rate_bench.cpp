@@ -0,0 +1,268 @@
+// Simulation of the JPEG rate control in components/Helpers/Helpers/JpegRateControl.cpp.
+//
+// A sensor produces frames whose size follows the scene and the quality setting, a quality change only shows
+// up a frame later, and every frame has to go over a link that takes so many bytes per second. The same
+// scenes run once at the fixed quality 8 the camera used to be set to and once through the controller.
+// A frame bigger than the camera's frame buffer is dropped by the driver and only shows up in its overflow
+// counter, if nothing fits for the whole capture timeout the caller gets no frame at all. Whatever the link
+// can't carry within a frame interval queues up in front of the next frame - that backlog is the extra
+// latency. Flares build up over a quarter of a second, about what the sensor's auto exposure takes.
+//
+// The controller has to keep drops to the odd frame when a scene flares up, get the link load under 100%
+// within a second, leave a scene that fits alone and get back to the best quality once the scene calms
+// down. Anything else fails the run.
+//
+// usage: jpeg_rate_bench [--seconds N] [--check NAME]
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include <JpegRateControl.hpp>
+
+#include "bench.hpp"
+
+namespace
+{
+const bench::Check CHECKS[] = {
+    {"drops", "no more than the odd frame too big for the frame buffer, never a capture timeout"},
+    {"link_load", "the link load under 100% a second after a flare starts"},
+    {"steady_scene", "a scene that fits the link keeps its quality"},
+    {"recovery", "the best quality back within 10 s of a flare"},
+};
+
+constexpr uint32_t FRAME_BUFFER_BYTES = 51200;
+constexpr int FIXED_QUALITY = 8;
+// esp_camera_fb_get gives up after this long without a frame
+constexpr int64_t CAPTURE_TIMEOUT_US = 4000000;
+constexpr double RAMP_SECONDS = 0.25;
+
+struct Scenario
+{
+    const char* name;
+    uint32_t fps;
+    uint32_t link_bytes_per_second;
+    // size of a frame at quality 8 in the calm part, and while it flares up
+    uint32_t calm_bytes;
+    uint32_t flare_bytes;
+    // the flare, in seconds from the start
+    uint32_t flare_from_s;
+    uint32_t flare_to_s;
+    // true if the link can't carry the flare even at the worst quality
+    bool saturated;
+};
+
+const Scenario SCENARIOS[] = {
+    {"uvc 60fps dark", 60, 900 * 1024, 10000, 10000, 0, 0, false},
+    {"uvc 60fps IR flare", 60, 900 * 1024, 10000, 40000, 10, 30, false},
+    {"uvc 90fps IR flare", 90, 900 * 1024, 7000, 22000, 10, 30, false},
+    {"uvc 60fps overexposed", 60, 900 * 1024, 12000, 70000, 10, 30, true},
+    {"wifi 30fps 400KB/s", 30, 400 * 1024, 9000, 25000, 10, 30, false},
+};
+
+// JPEG size against the OV quality scale, roughly inverse to the quantizer, calibrated to 1.0 at quality 8
+uint32_t frame_size(uint32_t scene_bytes, int quality, std::mt19937& random)
+{
+    std::uniform_real_distribution<double> noise(0.92, 1.08);
+    return static_cast<uint32_t>(scene_bytes * 12.0 / (quality + 4) * noise(random));
+}
+
+// scene size at quality 8 for a frame, ramping up into the flare and back down after it
+double scene_size(const Scenario& scenario, uint32_t frame)
+{
+    const double t = static_cast<double>(frame) / scenario.fps;
+    double flare = 0;
+    if (scenario.flare_to_s > scenario.flare_from_s)
+    {
+        flare = std::min(std::clamp((t - scenario.flare_from_s) / RAMP_SECONDS, 0.0, 1.0),
+                         std::clamp((scenario.flare_to_s - t) / RAMP_SECONDS, 0.0, 1.0));
+    }
+    return scenario.calm_bytes + flare * (static_cast<double>(scenario.flare_bytes) - scenario.calm_bytes);
+}
+
+struct Result
+{
+    uint32_t dropped = 0;
+    double max_backlog_ms = 0;
+    // worst one second link load in the part after the controller had a second to react
+    double max_settled_load = 0;
+    double average_load = 0;
+    int max_quality = 0;
+    int final_quality = 0;
+    uint32_t adjustments = 0;
+    // capture timeouts, every one a 4 s gap in the stream
+    uint32_t timeouts = 0;
+    // frames from the end of the flare until the best quality was back
+    int64_t recovery_frames = -1;
+};
+
+int sensor_quality = FIXED_QUALITY;
+
+void apply_quality(int quality, void* context)
+{
+    (void)context;
+    sensor_quality = quality;
+}
+
+Result run(const Scenario& scenario, uint32_t seconds, bool controlled)
+{
+    Result result;
+    std::mt19937 random(7);
+
+    auto& controller = JpegRateControl::controller();
+    JpegRateControl::Settings settings;
+    settings.enabled = controlled;
+    settings.best_quality = FIXED_QUALITY;
+    settings.worst_quality = 30;
+    settings.max_frame_bytes = FRAME_BUFFER_BYTES;
+    controller.configure(settings, apply_quality, nullptr);
+    controller.setLinkRate(0, scenario.link_bytes_per_second);
+    controller.restart();
+    sensor_quality = FIXED_QUALITY;
+
+    const uint32_t frames = seconds * scenario.fps;
+    const int64_t interval_us = 1000000 / scenario.fps;
+    const double bytes_per_frame_slot = static_cast<double>(scenario.link_bytes_per_second) / scenario.fps;
+    const uint32_t flare_from = scenario.flare_from_s * scenario.fps;
+    const uint32_t flare_to = scenario.flare_to_s * scenario.fps;
+
+    // the quality the sensor is running with, a change lands one frame later
+    int active_quality = FIXED_QUALITY;
+    double backlog = 0;
+    uint64_t total_bytes = 0;
+    uint64_t second_bytes = 0;
+    uint32_t overflows = 0;
+    int64_t last_delivered_us = 1000000;
+
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        const int64_t captured_us = 1000000 + frame * interval_us;
+        const uint32_t bytes = frame_size(static_cast<uint32_t>(scene_size(scenario, frame)), active_quality, random);
+        active_quality = sensor_quality;
+
+        if (bytes > FRAME_BUFFER_BYTES)
+        {
+            // the driver drops it, the caller keeps waiting for one that fits
+            result.dropped++;
+            overflows++;
+            backlog = std::max(0.0, backlog - bytes_per_frame_slot);
+            if (captured_us - last_delivered_us >= CAPTURE_TIMEOUT_US)
+            {
+                result.timeouts++;
+                last_delivered_us = captured_us;
+                controller.onCaptureFailed(overflows);
+            }
+        }
+        else
+        {
+            total_bytes += bytes;
+            second_bytes += bytes;
+            backlog = std::max(0.0, backlog + bytes - bytes_per_frame_slot);
+            result.max_backlog_ms = std::max(result.max_backlog_ms, backlog / scenario.link_bytes_per_second * 1000);
+            last_delivered_us = captured_us;
+            controller.onFrame(bytes, captured_us, overflows);
+        }
+        result.max_quality = std::max(result.max_quality, sensor_quality);
+
+        if ((frame + 1) % scenario.fps == 0)
+        {
+            // skip the second the flare starts in, that's the one the controller gets to react
+            const bool reacting = frame >= flare_from && frame < flare_from + scenario.fps;
+            if (!reacting)
+                result.max_settled_load = std::max(result.max_settled_load, static_cast<double>(second_bytes) / scenario.link_bytes_per_second);
+            second_bytes = 0;
+        }
+
+        if (frame >= flare_to && flare_to > flare_from && result.recovery_frames < 0 && sensor_quality == FIXED_QUALITY)
+            result.recovery_frames = frame - flare_to;
+    }
+
+    result.average_load = static_cast<double>(total_bytes) / seconds / scenario.link_bytes_per_second;
+    result.final_quality = sensor_quality;
+    result.adjustments = controller.status().adjustments;
+    return result;
+}
+
+void verify_drops(uint32_t seconds)
+{
+    for (const auto& scenario : SCENARIOS)
+    {
+        const Result result = run(scenario, seconds, true);
+        if (result.dropped > 3)
+            bench::fail("%s: %u frames dropped for not fitting the frame buffer", scenario.name, result.dropped);
+        if (result.timeouts != 0)
+            bench::fail("%s: capture timed out %u times", scenario.name, result.timeouts);
+    }
+}
+
+void verify_link_load(uint32_t seconds)
+{
+    for (const auto& scenario : SCENARIOS)
+    {
+        if (scenario.saturated)
+            continue;
+        const Result result = run(scenario, seconds, true);
+        if (result.max_settled_load > 1.0)
+            bench::fail("%s: link at %.0f%% after the controller had a second to react", scenario.name, result.max_settled_load * 100);
+    }
+}
+
+void verify_steady_scene(uint32_t seconds)
+{
+    for (const auto& scenario : SCENARIOS)
+    {
+        if (scenario.flare_to_s > scenario.flare_from_s)
+            continue;
+        const Result result = run(scenario, seconds, true);
+        if (result.adjustments != 0)
+            bench::fail("%s: quality changed %u times on a scene that fits the link", scenario.name, result.adjustments);
+    }
+}
+
+void verify_recovery(uint32_t seconds)
+{
+    for (const auto& scenario : SCENARIOS)
+    {
+        if (scenario.flare_to_s <= scenario.flare_from_s || scenario.flare_to_s + 15 > seconds)
+            continue;
+        const Result result = run(scenario, seconds, true);
+        if (result.recovery_frames < 0 || result.recovery_frames > 10 * static_cast<int64_t>(scenario.fps))
+            bench::fail("%s: best quality not back within 10 s of the flare", scenario.name);
+    }
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t seconds = 60;
+
+    bench::Args args(CHECKS);
+    args.option("--seconds", seconds, "seconds of every scene, at least 45 (default 60)", uint32_t(45));
+    if (const int exit_code = args.parse(argc, argv); exit_code >= 0)
+        return exit_code;
+
+    bool ok = args.run("drops", [&] { verify_drops(seconds); });
+    ok &= args.run("link_load", [&] { verify_link_load(seconds); });
+    ok &= args.run("steady_scene", [&] { verify_steady_scene(seconds); });
+    ok &= args.run("recovery", [&] { verify_recovery(seconds); });
+    if (!ok || !args.timing())
+        return ok ? 0 : 1;
+
+    std::printf("%-24s %-6s %8s %9s %9s %9s %12s %6s %6s %8s\n", "scenario", "mode", "dropped", "timeouts", "avg load", "max load", "backlog ms", "max q",
+                "adj", "recov s");
+    for (const auto& scenario : SCENARIOS)
+    {
+        for (const bool controlled : {false, true})
+        {
+            const Result result = run(scenario, seconds, controlled);
+            std::printf("%-24s %-6s %8u %9u %8.0f%% %8.0f%% %12.1f %6d %6u %8.1f\n", scenario.name, controlled ? "rate" : "fixed", result.dropped,
+                        result.timeouts, result.average_load * 100, result.max_settled_load * 100, result.max_backlog_ms, result.max_quality, result.adjustments,
+                        result.recovery_frames < 0 ? 0.0 : static_cast<double>(result.recovery_frames) / scenario.fps);
+        }
+    }
+    return 0;
+}
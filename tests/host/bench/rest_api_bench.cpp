@@ -0,0 +1,444 @@
+// Request latency of the port 81 REST API, the real RestAPI class on the real mongoose, over loopback.
+//
+// The task serving it used to run mg_mgr_poll(&mgr, 100) and then vTaskDelay(1000), so a request sat in the
+// socket for up to a second before mongoose read it, and the response waited for the next round to go out.
+// Now the task blocks in mongoose's select() and nothing else. The same requests the tuning UI sends in a loop
+// go through three ways here: over one keep-alive connection, with a new connection for every request, and
+// (--legacy N of them) against the old poll-and-sleep loop for comparison.
+//
+// The checks: every request, the error paths included, comes back with its status and a body; a keep-alive
+// connection doesn't get closed under the client and the median stays far below the old poll interval; and
+// --soak N requests, wrong URLs and methods and job lookups by ?id= mixed in, don't grow the heap in use
+// between the end of a warm-up and the end of the run. Each request used to leak its RequestContext.
+//
+// usage: rest_api_bench [--requests N] [--legacy N] [--legacy-delay-ms N] [--soak N] [--check NAME]
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <CommandManager.hpp>
+#include <FanManager.hpp>
+#include <LEDManager.hpp>
+#include <RestAPI.hpp>
+#include <wifiManager.hpp>
+
+#include "bench.hpp"
+
+namespace
+{
+const bench::Check CHECKS[] = {
+    {"responses", "every request, the error paths too, answers with its status over keep-alive and fresh connections"},
+    {"latency", "--requests of each over keep-alive and fresh connections, the median far below the old poll interval"},
+    {"heap", "--soak requests, the heap in use ends up where it was after the warm-up"},
+};
+
+struct BenchCase
+{
+    const char* name;
+    const char* method;
+    const char* path;
+    const char* body;
+    int status = 200;
+};
+
+// what the provisioning and tuning UI hammers, the LED duty getter standing in for get_led_current,
+// which needs the monitoring hardware
+const BenchCase CASES[] = {
+    {"ping", "GET", "/api/ping/", ""},
+    {"get_led_duty_cycle", "GET", "/api/get/led_duty_cycle/", ""},
+    {"update_camera", "PATCH", "/api/update/camera/", R"({"vflip":1,"quality":8,"brightness":2})"},
+};
+
+// responses and the soak also go down the error paths, they answer through mg_http_reply instead of the writer
+const BenchCase SOAK_CASES[] = {
+    {"ping", "GET", "/api/ping/", ""},
+    {"get_led_duty_cycle", "GET", "/api/get/led_duty_cycle/", ""},
+    {"update_camera", "PATCH", "/api/update/camera/", R"({"vflip":1,"quality":8,"brightness":2})"},
+    {"get_config", "GET", "/api/get/config/", ""},
+    {"list_jobs", "GET", "/api/get/job/", ""},
+    {"unknown_job", "GET", "/api/get/job/?id=7", "", 400},
+    {"invalid_job_id", "GET", "/api/get/job/?id=seven", "", 400},
+    {"wrong_url", "GET", "/api/get/nothing/", "", 404},
+    {"wrong_method", "POST", "/api/get/serial_number/", "", 401},
+};
+
+constexpr size_t SOAK_REQUESTS_PER_CONNECTION = 1000;
+// a leaked context was ~100 bytes, so this is far below what even a short soak would show
+constexpr long long SOAK_MAX_GROWTH_BYTES = 32 * 1024;
+
+// anything near this means requests wait for a poll interval again
+constexpr double MAX_MEDIAN_MS = 50;
+
+enum class Mode
+{
+    KeepAlive,
+    Reconnect,
+    Legacy,
+};
+
+const char* mode_name(Mode mode)
+{
+    switch (mode)
+    {
+    case Mode::KeepAlive:
+        return "keep-alive";
+    case Mode::Reconnect:
+        return "reconnect";
+    case Mode::Legacy:
+        return "old loop";
+    }
+    return "";
+}
+
+struct Result
+{
+    const BenchCase* benchCase = nullptr;
+    Mode mode = Mode::KeepAlive;
+    size_t requests = 0;
+    double p50_ms = 0;
+    double p99_ms = 0;
+    double max_ms = 0;
+    size_t connections = 0;
+    std::string failure;
+};
+
+int open_connection(uint16_t port)
+{
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool send_all(int fd, const std::string& data)
+{
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        const ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// one request, one response read up to its Content-Length, the connection stays usable afterwards
+bool round_trip(int fd, const BenchCase& benchCase, std::string& failure)
+{
+    char request[512];
+    const size_t body_length = std::strlen(benchCase.body);
+    std::snprintf(request, sizeof(request), "%s %s HTTP/1.1\r\nHost: openiris\r\nContent-Length: %zu\r\n\r\n%s", benchCase.method, benchCase.path,
+                  body_length, benchCase.body);
+    if (!send_all(fd, request))
+    {
+        failure = "send failed";
+        return false;
+    }
+
+    std::string response;
+    size_t header_end = std::string::npos;
+    size_t content_length = 0;
+    char buffer[2048];
+    while (header_end == std::string::npos || response.size() < header_end + 4 + content_length)
+    {
+        const ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0)
+        {
+            failure = "connection closed by the server";
+            return false;
+        }
+        response.append(buffer, static_cast<size_t>(n));
+        if (header_end == std::string::npos && (header_end = response.find("\r\n\r\n")) != std::string::npos)
+        {
+            const size_t field = response.find("Content-Length:");
+            if (field == std::string::npos || field > header_end)
+            {
+                failure = "response without Content-Length";
+                return false;
+            }
+            content_length = std::strtoul(response.c_str() + field + 15, nullptr, 10);
+        }
+    }
+
+    char status[16];
+    std::snprintf(status, sizeof(status), "HTTP/1.1 %d", benchCase.status);
+    if (response.compare(0, std::strlen(status), status) != 0)
+    {
+        failure = response.substr(0, response.find("\r\n"));
+        return false;
+    }
+    if (content_length == 0)
+    {
+        failure = "empty body";
+        return false;
+    }
+    return true;
+}
+
+Result run_case(uint16_t port, const BenchCase& benchCase, Mode mode, size_t requests)
+{
+    Result result{&benchCase, mode, requests};
+    std::vector<double> samples;
+    samples.reserve(requests);
+    int fd = -1;
+
+    for (size_t i = 0; i < requests && result.failure.empty(); i++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        if (fd < 0)
+        {
+            if ((fd = open_connection(port)) < 0)
+            {
+                result.failure = "connect failed";
+                break;
+            }
+            result.connections++;
+        }
+        const bool ok = round_trip(fd, benchCase, result.failure);
+        samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+        if (!ok || mode == Mode::Reconnect)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd >= 0)
+        close(fd);
+
+    std::sort(samples.begin(), samples.end());
+    result.p50_ms = bench::percentile(samples, 0.50);
+    result.p99_ms = bench::percentile(samples, 0.99);
+    result.max_ms = samples.empty() ? 0 : samples.back();
+    if (result.failure.empty() && mode != Mode::Legacy && result.p50_ms > MAX_MEDIAN_MS)
+        result.failure = "median too high, the loop waits between polls";
+    return result;
+}
+
+// all of them one after the other over a kept-alive connection, then each once more on a connection of its own
+void verify_responses(uint16_t port)
+{
+    std::string failure;
+    int fd = -1;
+    for (const BenchCase& benchCase : SOAK_CASES)
+    {
+        if (fd < 0 && (fd = open_connection(port)) < 0)
+        {
+            bench::fail("connect failed");
+            return;
+        }
+        if (!round_trip(fd, benchCase, failure))
+        {
+            bench::fail("%s over keep-alive: %s", benchCase.name, failure.c_str());
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd >= 0)
+        close(fd);
+
+    for (const BenchCase& benchCase : SOAK_CASES)
+    {
+        if (const Result result = run_case(port, benchCase, Mode::Reconnect, 1); !result.failure.empty())
+            bench::fail("%s on a fresh connection: %s", benchCase.name, result.failure.c_str());
+    }
+}
+
+// keeps what it measured for the timing table
+void verify_latency(uint16_t port, size_t requests, std::vector<Result>& results)
+{
+    for (const Mode mode : {Mode::KeepAlive, Mode::Reconnect})
+    {
+        for (const BenchCase& benchCase : CASES)
+        {
+            results.push_back(run_case(port, benchCase, mode, requests));
+            if (!results.back().failure.empty())
+                bench::fail("%s %s: %s", benchCase.name, mode_name(mode), results.back().failure.c_str());
+        }
+    }
+}
+
+// mallinfo2 only sees the main arena, main() keeps the server thread in there with M_ARENA_MAX
+long long heap_in_use()
+{
+    return static_cast<long long>(mallinfo2().uordblks);
+}
+
+void verify_heap(uint16_t port, size_t requests)
+{
+    // the baseline is taken between connections, so the warm-up has to end on one
+    const size_t warmup = std::max<size_t>(std::min<size_t>(requests / 10, 10000) / SOAK_REQUESTS_PER_CONNECTION, 1) * SOAK_REQUESTS_PER_CONNECTION;
+    long long baseline = 0;
+    long long peak_growth = 0;
+    int fd = -1;
+    std::string failure;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < requests; i++)
+    {
+        if (i % SOAK_REQUESTS_PER_CONNECTION == 0)
+        {
+            if (fd >= 0)
+                close(fd);
+            // measured between connections, so no request is halfway through
+            if (i == warmup)
+                baseline = heap_in_use();
+            else if (i > warmup)
+                peak_growth = std::max(peak_growth, heap_in_use() - baseline);
+            if ((fd = open_connection(port)) < 0)
+            {
+                bench::fail("connect failed after %zu requests", i);
+                return;
+            }
+        }
+
+        const BenchCase& benchCase = SOAK_CASES[i % std::size(SOAK_CASES)];
+        if (!round_trip(fd, benchCase, failure))
+        {
+            bench::fail("%s after %zu requests: %s", benchCase.name, i, failure.c_str());
+            close(fd);
+            return;
+        }
+    }
+    close(fd);
+
+    // give the server a moment to see the last connection go
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const long long growth = heap_in_use() - baseline;
+    peak_growth = std::max(peak_growth, growth);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("soak: %zu requests in %.1f s, heap in use after %zu requests %lld bytes, growth since then %lld bytes (peak %lld), %.4f bytes/request\n",
+                requests, seconds, warmup, baseline, growth, peak_growth, static_cast<double>(growth) / static_cast<double>(requests - warmup));
+    if (peak_growth > SOAK_MAX_GROWTH_BYTES)
+        bench::fail("the heap keeps growing");
+}
+
+void print_result(const Result& result)
+{
+    if (!result.failure.empty())
+    {
+        std::printf("%-20s %-11s FAILED: %s\n", result.benchCase->name, mode_name(result.mode), result.failure.c_str());
+        return;
+    }
+    std::printf("%-20s %-11s %9zu %9.3f %9.3f %9.3f %12zu\n", result.benchCase->name, mode_name(result.mode), result.requests, result.p50_ms,
+                result.p99_ms, result.max_ms, result.connections);
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    size_t requests = 2000;
+    size_t legacy_requests = 5;
+    long legacy_delay_ms = 1000;
+    size_t soak_requests = 20000;
+
+    bench::Args args(CHECKS);
+    args.option("--requests", requests, "requests per case and mode (default 2000)", size_t(1));
+    args.option("--legacy", legacy_requests, "requests per case against the old poll-and-sleep loop, 0 to skip (default 5)", size_t(0));
+    args.option("--legacy-delay-ms", legacy_delay_ms, "the old loop's vTaskDelay (default 1000)", 1L);
+    args.option("--soak", soak_requests, "requests for the heap check (default 20000)", SOAK_REQUESTS_PER_CONNECTION * 2);
+    if (const int exit_code = args.parse(argc, argv); exit_code >= 0)
+        return exit_code;
+
+    mallopt(M_ARENA_MAX, 1);
+
+    // the same wiring app_main() does, minus the hardware
+    static Preferences preferences;
+    auto deviceConfig = std::make_shared<ProjectConfig>(&preferences);
+    preferences.begin("openiris", false);
+    deviceConfig->load();
+
+    auto dependencyRegistry = std::make_shared<DependencyRegistry>();
+    dependencyRegistry->registerService<ProjectConfig>(DependencyType::project_config, deviceConfig);
+    dependencyRegistry->registerService<CameraManager>(DependencyType::camera_manager, std::make_shared<CameraManager>(deviceConfig));
+    dependencyRegistry->registerService<WiFiManager>(DependencyType::wifi_manager, std::make_shared<WiFiManager>());
+    dependencyRegistry->registerService<LEDManager>(DependencyType::led_manager, std::make_shared<LEDManager>(deviceConfig));
+    dependencyRegistry->registerService<FanManager>(DependencyType::fan_manager, std::make_shared<FanManager>(deviceConfig));
+    auto commandManager = std::make_shared<CommandManager>(dependencyRegistry);
+
+    // port 0, whatever is free
+    RestAPI restAPI("http://127.0.0.1:0", commandManager);
+    restAPI.begin();
+    const uint16_t port = restAPI.port();
+    if (port == 0)
+    {
+        std::fprintf(stderr, "could not start the REST API\n");
+        return 1;
+    }
+
+    // stands in for HandleRestAPIPollTask, or for what it used to be while legacy_delay is set
+    std::atomic<bool> running{true};
+    std::atomic<long> legacy_delay{0};
+    std::thread server(
+        [&]
+        {
+            while (running.load())
+            {
+                const long delay = legacy_delay.load();
+                if (delay == 0)
+                {
+                    restAPI.poll();
+                }
+                else
+                {
+                    restAPI.poll(100);
+                    std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+                }
+            }
+        });
+
+    std::vector<Result> results;
+    bool ok = args.run("responses", [&] { verify_responses(port); });
+    ok &= args.run("latency", [&] { verify_latency(port, requests, results); });
+    ok &= args.run("heap", [&] { verify_heap(port, soak_requests); });
+
+    if (ok && args.timing())
+    {
+        std::printf("\n%-20s %-11s %9s %9s %9s %9s %12s\n", "request", "mode", "requests", "p50 ms", "p99 ms", "max ms", "connections");
+        for (const Result& result : results)
+            print_result(result);
+
+        legacy_delay.store(legacy_delay_ms);
+        for (const BenchCase& benchCase : CASES)
+        {
+            if (legacy_requests == 0)
+                break;
+            const Result result = run_case(port, benchCase, Mode::Legacy, legacy_requests);
+            print_result(result);
+            ok &= result.failure.empty();
+        }
+    }
+
+    running.store(false);
+    restAPI.wake();
+    server.join();
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,238 @@
+// Bus cost of the OV3660 register writes with and without burst writes and the shadow.
+//
+// The sensor drivers used to write every register in its own SCCB transaction and read a register back over
+// I2C before every read-modify-write. write_regs() now sends runs of consecutive registers as one burst
+// (sccb_reg_run() finds them), set_framesize() writes the 0x3800-0x3813 timing block in one go and
+// set_reg_bits() takes the old value from the shadow of written registers.
+//
+// Before counting anything the shadow table is checked against a std::map through a long random mix of
+// stores, lookups and clears, and every register table is replayed both ways into a model register file,
+// which has to come out the same. Any mismatch fails the run.
+//
+// usage: sccb_regs_bench [--iterations N] [--clock N] [--check NAME]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <sccb_regs.h>
+#include <sensor.h>
+#include <ov3660_settings.h>
+
+#include "bench.hpp"
+
+namespace
+{
+const bench::Check CHECKS[] = {
+    {"shadow", "the shadow answers like a std::map through random stores, lookups and clears"},
+    {"burst_replay", "every register table ends up the same written in bursts as one register at a time"},
+};
+
+volatile uint8_t sink;
+
+// the shadow has to answer exactly like a map, until it refuses new registers at three quarters full
+void verify_shadow()
+{
+    std::mt19937 random(17);
+    std::map<std::pair<uint8_t, uint16_t>, uint8_t> reference;
+    const uint8_t addresses[] = {0x3c, 0x30};
+
+    sccb_shadow_clear();
+    for (size_t op = 0; op < 200000; op++)
+    {
+        const uint8_t slv_addr = addresses[random() % 2];
+        // a register range a bit larger than the table, so it fills up now and then
+        const uint16_t reg = 0x3000 + random() % 700;
+        const uint32_t action = random() % 1000;
+        if (action == 0)
+        {
+            sccb_shadow_clear();
+            reference.clear();
+        }
+        else if (action < 450)
+        {
+            const uint8_t value = random();
+            const bool known = reference.count({slv_addr, reg});
+            sccb_shadow_store(slv_addr, reg, value);
+            if (known || reference.size() < SCCB_SHADOW_SLOTS / 4 * 3)
+                reference[{slv_addr, reg}] = value;
+        }
+        else
+        {
+            uint8_t value = 0;
+            const bool hit = sccb_shadow_lookup(slv_addr, reg, &value);
+            const auto it = reference.find({slv_addr, reg});
+            if (hit != (it != reference.end()) || (hit && value != it->second))
+                bench::fail("shadow lookup addr=0x%02x reg=0x%04x", slv_addr, reg);
+        }
+        if (sccb_shadow_size() != reference.size())
+        {
+            bench::fail("shadow size %zu instead of %zu after addr=0x%02x reg=0x%04x", sccb_shadow_size(), reference.size(), slv_addr, reg);
+            return;
+        }
+    }
+    sccb_shadow_clear();
+}
+
+struct BusCost
+{
+    size_t transactions = 0;
+    size_t bytes = 0;
+    size_t bits = 0;
+
+    // start, the device address and every byte with its ack bit, stop
+    void write(size_t count)
+    {
+        transactions++;
+        bytes += 2 + count;
+        bits += 2 + 9 * (1 + 2 + count);
+    }
+    // the register address, a repeated start and the data byte
+    void read()
+    {
+        transactions++;
+        bytes += 3;
+        bits += 3 + 9 * (1 + 2) + 9 * (1 + 1);
+    }
+};
+
+using Registers = std::map<uint16_t, uint8_t>;
+
+// what write_regs() did before, one transaction per register
+BusCost replay_single(const uint16_t (*regs)[2], Registers& state)
+{
+    BusCost cost;
+    for (size_t i = 0; regs[i][0] != REGLIST_TAIL; i++)
+    {
+        if (regs[i][0] == REG_DLY)
+            continue;
+        state[regs[i][0]] = regs[i][1];
+        cost.write(1);
+    }
+    return cost;
+}
+
+// what it does now, the driver's own run detection with the sensor incrementing the address
+BusCost replay_burst(const uint16_t (*regs)[2], Registers& state)
+{
+    BusCost cost;
+    size_t i = 0;
+    while (regs[i][0] != REGLIST_TAIL)
+    {
+        if (regs[i][0] == REG_DLY)
+        {
+            i++;
+            continue;
+        }
+        const size_t count = sccb_reg_run(&regs[i], SCCB_BURST_MAX);
+        for (size_t j = 0; j < count; j++)
+            state[regs[i][0] + j] = regs[i + j][1];
+        cost.write(count);
+        i += count;
+    }
+    return cost;
+}
+
+struct Table
+{
+    const char* name;
+    const uint16_t (*regs)[2];
+};
+
+const Table TABLES[] = {
+    {"sensor_default_regs", sensor_default_regs}, {"sensor_fmt_jpeg", sensor_fmt_jpeg},
+    {"sensor_fmt_raw", sensor_fmt_raw},           {"sensor_fmt_grayscale", sensor_fmt_grayscale},
+    {"sensor_fmt_yuv422", sensor_fmt_yuv422},     {"sensor_fmt_rgb565", sensor_fmt_rgb565},
+};
+
+void verify_burst_replay()
+{
+    for (const auto& table : TABLES)
+    {
+        Registers single_state, burst_state;
+        replay_single(table.regs, single_state);
+        replay_burst(table.regs, burst_state);
+        if (single_state != burst_state)
+            bench::fail("%s comes out different written in bursts", table.name);
+    }
+}
+
+double bus_ms(const BusCost& cost, double clock_hz)
+{
+    return cost.bits * 1000.0 / clock_hz;
+}
+
+void print_row(const char* name, size_t registers, const BusCost& before, const BusCost& after, double clock_hz)
+{
+    std::printf("%-26s %5zu %8zu %8zu %9.2f %8zu %8zu %9.2f %7.1fx\n", name, registers, before.transactions, before.bytes,
+                bus_ms(before, clock_hz), after.transactions, after.bytes, bus_ms(after, clock_hz),
+                bus_ms(before, clock_hz) / bus_ms(after, clock_hz));
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    size_t iterations = 20;
+    double clock_hz = 100000;
+
+    bench::Args args(CHECKS);
+    args.option("--iterations", iterations, "shadow lookups to time, in millions (default 20)", size_t(1));
+    args.option("--clock", clock_hz, "SCCB clock in Hz the bus times are worked out for (default 100000, CONFIG_SCCB_CLK_FREQ)", 1000.0);
+    if (const int exit_code = args.parse(argc, argv); exit_code >= 0)
+        return exit_code;
+
+    bool ok = args.run("shadow", verify_shadow);
+    ok &= args.run("burst_replay", verify_burst_replay);
+    if (!ok || !args.timing())
+        return ok ? 0 : 1;
+
+    std::printf("%-26s %5s %8s %8s %9s %8s %8s %9s %8s\n", "registers", "count", "old tx", "old B", "old ms", "new tx", "new B", "new ms",
+                "speedup");
+    for (const auto& table : TABLES)
+    {
+        Registers single_state, burst_state;
+        const BusCost before = replay_single(table.regs, single_state);
+        const BusCost after = replay_burst(table.regs, burst_state);
+        print_row(table.name, single_state.size(), before, after, clock_hz);
+    }
+
+    // set_framesize: five write_addr_reg() calls of four single writes, now one 20 byte burst
+    BusCost window_before, window_after;
+    for (size_t i = 0; i < 20; i++)
+        window_before.write(1);
+    window_after.write(20);
+    print_row("set_framesize window", 20, window_before, window_after, clock_hz);
+
+    // a profile's worth of set_reg_bits() on control registers, read back first before, answered by the shadow now
+    BusCost rmw_before, rmw_after;
+    for (size_t i = 0; i < 12; i++)
+    {
+        rmw_before.read();
+        rmw_before.write(1);
+        rmw_after.write(1);
+    }
+    print_row("12x set_reg_bits", 12, rmw_before, rmw_after, clock_hz);
+
+    // the shadow sits in front of every read-modify-write, it has to cost nothing next to the bus
+    for (uint16_t reg = 0; reg < 300; reg++)
+        sccb_shadow_store(0x3c, 0x3000 + reg * 7, reg);
+    const size_t lookups = iterations * 1000000;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lookups; i++)
+    {
+        uint8_t value = 0;
+        sccb_shadow_lookup(0x3c, 0x3000 + (i % 300) * 7, &value);
+        sink = value;
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::printf("shadow lookup: %.1f ns, one register read on the bus: %.1f us\n", ns / lookups,
+                (3 + 9 * 3 + 9 * 2) * 1e6 / clock_hz);
+    return 0;
+}
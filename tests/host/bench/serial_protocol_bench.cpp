@@ -0,0 +1,582 @@
+// Checks and times the two serial protocols SerialProtocol speaks: json lines and binary cbor frames.
+//
+// Before timing anything every command is sent both ways through the same SerialProtocol the device runs and
+// the decoded answers have to match. Then the framing gets poked at - bytes arriving one at a time, lines and
+// frames interleaved, a flipped bit, an oversized frame, an unknown type, a frame cut off half way. Any
+// mismatch fails the run.
+//
+// Then the tagged lines: a burst of them in one write has to come back in order with the right ids, and a
+// tagged line that starts a scan job gets the job's result pushed through poll() with its id once it's done -
+// only to the transport that sent it, only once, and never for untagged lines.
+//
+// Each of those is a check of its own, see --help.
+//
+// The timing is split in what the device spends on a request, what the host spends decoding the answer
+// (nlohmann::json::parse vs from_cbor, just like the python side) and the bytes that go over the wire.
+//
+// usage: serial_protocol_bench [--iterations N] [--check NAME]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <CommandManager.hpp>
+#include <FanManager.hpp>
+#include <LEDManager.hpp>
+#include <SerialProtocol.hpp>
+#include <wifiManager.hpp>
+
+#include "bench.hpp"
+
+namespace
+{
+const bench::Check CHECKS[] = {
+    {"parity", "json lines and binary frames give the same answers, fed in pieces of every size"},
+    {"framing", "corrupted, truncated, oversized and interleaved input"},
+    {"tagged_lines", "a burst of tagged lines comes back in order with its ids, invalid ids are errors"},
+    {"job_push", "a tagged job's result gets pushed once to its transport, an untagged one's never"},
+};
+
+using Bytes = std::vector<uint8_t>;
+using FrameType = SerialProtocol::FrameType;
+
+class BytesSink : public ResponseSink
+{
+   public:
+    void write(const char* data, size_t length) override
+    {
+        bytes.insert(bytes.end(), data, data + length);
+    }
+
+    Bytes bytes;
+};
+
+struct Frame
+{
+    uint8_t type;
+    uint8_t seq;
+    Bytes payload;
+};
+
+// the host side of the framing, what tools/openiris_device.py does
+bool parse_frames(const Bytes& wire, std::vector<Frame>& frames, std::string& text)
+{
+    size_t i = 0;
+    while (i < wire.size())
+    {
+        if (wire[i] != SerialProtocol::FRAME_SYNC)
+        {
+            text.push_back(static_cast<char>(wire[i++]));
+            continue;
+        }
+        if (i + SerialProtocol::FRAME_OVERHEAD > wire.size())
+            return false;
+
+        const size_t length = wire[i + 3] | (wire[i + 4] << 8);
+        if (i + SerialProtocol::FRAME_OVERHEAD + length > wire.size())
+            return false;
+
+        const uint16_t crc = SerialProtocol::crc16(&wire[i + 1], 4 + length);
+        const uint16_t expected = wire[i + 5 + length] | (wire[i + 6 + length] << 8);
+        if (crc != expected)
+            return false;
+
+        frames.push_back({wire[i + 1], wire[i + 2], Bytes(wire.begin() + i + 5, wire.begin() + i + 5 + length)});
+        i += SerialProtocol::FRAME_OVERHEAD + length;
+    }
+    return true;
+}
+
+Bytes make_frame(FrameType type, uint8_t seq, const Bytes& payload)
+{
+    BytesSink sink;
+    SerialProtocol::writeFrame(sink, type, seq, payload.data(), payload.size());
+    return sink.bytes;
+}
+
+Bytes make_line(std::string_view request)
+{
+    Bytes line(request.begin(), request.end());
+    line.push_back('\n');
+    return line;
+}
+
+Bytes make_command(uint8_t seq, std::string_view name, const nlohmann::json& data)
+{
+    Bytes payload{static_cast<uint8_t>(name.size())};
+    payload.insert(payload.end(), name.begin(), name.end());
+    if (!data.is_null())
+    {
+        const Bytes cbor = nlohmann::json::to_cbor(data);
+        payload.insert(payload.end(), cbor.begin(), cbor.end());
+    }
+    return make_frame(FrameType::Command, seq, payload);
+}
+
+struct Answer
+{
+    nlohmann::json data;
+    bool success = false;
+};
+
+// chunks up to the end frame of seq, decoded as one cbor item
+bool collect_response(const std::vector<Frame>& frames, uint8_t seq, Answer& answer)
+{
+    Bytes cbor;
+    for (const auto& frame : frames)
+    {
+        if (frame.seq != seq)
+            continue;
+        if (frame.type == static_cast<uint8_t>(FrameType::ResponseChunk))
+            cbor.insert(cbor.end(), frame.payload.begin(), frame.payload.end());
+        else if (frame.type == static_cast<uint8_t>(FrameType::ResponseEnd))
+        {
+            answer.data = nlohmann::json::from_cbor(cbor, true, false);
+            answer.success = frame.payload.size() == 1 && frame.payload[0] == 0;
+            return !answer.data.is_discarded();
+        }
+    }
+    return false;
+}
+
+// read only requests, so running them twice doesn't change the answer
+struct Request
+{
+    const char* name;
+    const char* commands;
+};
+
+const Request REQUESTS[] = {
+    {"ping", R"([{"command":"ping"}])"},
+    {"get_config", R"([{"command":"get_config"}])"},
+    {"get_device_mode", R"([{"command":"get_device_mode"}])"},
+    {"get_led_duty_cycle", R"([{"command":"get_led_duty_cycle"}])"},
+    {"get_serial", R"([{"command":"get_serial"}])"},
+    {"get_who_am_i", R"([{"command":"get_who_am_i"}])"},
+    {"get_stream_stats", R"([{"command":"get_stream_stats","data":{"reset":false}}])"},
+    {"no_such_command", R"([{"command":"no_such_command"}])"},
+    {"batch",
+     R"([{"command":"get_who_am_i"},{"command":"get_serial"},{"command":"get_device_mode"},{"command":"get_led_duty_cycle"},{"command":"get_mdns_name"}])"},
+};
+
+std::string line_request(const nlohmann::json& commands)
+{
+    return nlohmann::json{{"commands", commands}}.dump();
+}
+
+// every command of the batch as its own frame, all in one write
+Bytes frame_request(const nlohmann::json& commands, uint8_t first_seq)
+{
+    Bytes wire;
+    uint8_t seq = first_seq;
+    for (const auto& command : commands)
+    {
+        const Bytes frame = make_command(seq++, command["command"].get<std::string>(), command.contains("data") ? command["data"] : nlohmann::json());
+        wire.insert(wire.end(), frame.begin(), frame.end());
+    }
+    return wire;
+}
+
+class Harness
+{
+   public:
+    explicit Harness(const CommandManager& commandManager) : protocol(commandManager, buffer, sizeof(buffer)) {}
+
+    // feeds the bytes in pieces of step, returns what came back
+    Bytes send(const Bytes& wire, size_t step = SIZE_MAX)
+    {
+        BytesSink sink;
+        for (size_t i = 0; i < wire.size(); i += step)
+            protocol.receive(wire.data() + i, std::min(step, wire.size() - i), sink);
+        return sink.bytes;
+    }
+
+    SerialProtocol protocol;
+
+   private:
+    uint8_t buffer[1024];
+};
+
+void verify_parity(const CommandManager& commandManager)
+{
+    Harness harness(commandManager);
+    uint8_t seq = 0;
+
+    for (const auto& request : REQUESTS)
+    {
+        const auto commands = nlohmann::json::parse(request.commands);
+        for (const size_t step : {size_t(1), size_t(7), size_t(64), SIZE_MAX})
+        {
+            const Bytes line_answer = harness.send(make_line(line_request(commands)), step);
+            const auto from_line = nlohmann::json::parse(line_answer.begin(), line_answer.end(), nullptr, false);
+            if (from_line.is_discarded() || line_answer.back() != '\n')
+            {
+                bench::fail("json line: %.*s", static_cast<int>(line_answer.size()), reinterpret_cast<const char*>(line_answer.data()));
+                continue;
+            }
+
+            const uint8_t first_seq = seq;
+            seq += commands.size();
+            const Bytes frame_answer = harness.send(frame_request(commands, first_seq), step);
+            std::vector<Frame> frames;
+            std::string text;
+            if (!parse_frames(frame_answer, frames, text) || !text.empty())
+            {
+                bench::fail("binary frame: %s", request.name);
+                continue;
+            }
+
+            for (size_t i = 0; i < commands.size(); i++)
+            {
+                Answer answer;
+                if (!collect_response(frames, first_seq + i, answer))
+                {
+                    bench::fail("binary response: %s", request.name);
+                    continue;
+                }
+
+                // the json line answers unknown commands for the whole batch, the binary one per command
+                if (!from_line.contains("results"))
+                {
+                    if (answer.success || answer.data != "Unknown command")
+                        bench::fail("unknown command: %s", answer.data.dump().c_str());
+                    continue;
+                }
+
+                const auto& result = from_line["results"][i]["result"];
+                if (result["data"] != answer.data || (result["status"] == "success") != answer.success)
+                    bench::fail("parity: %s", (result.dump() + " vs " + answer.data.dump()).c_str());
+            }
+        }
+    }
+}
+
+void verify_framing(const CommandManager& commandManager)
+{
+    Harness harness(commandManager);
+    const auto ping = [](uint8_t seq) { return make_command(seq, "ping", nullptr); };
+
+    // hello
+    {
+        std::vector<Frame> frames;
+        std::string text;
+        if (!parse_frames(harness.send(make_frame(FrameType::Hello, 1, {})), frames, text) || frames.size() != 1 ||
+            frames[0].type != static_cast<uint8_t>(FrameType::HelloAck) || frames[0].payload.size() != 3 || frames[0].payload[0] != SerialProtocol::VERSION)
+            bench::fail("hello: no HELLO_ACK");
+    }
+
+    // a flipped bit gets a NACK, the next frame goes through
+    {
+        Bytes wire = ping(2);
+        wire[6] ^= 0x10;
+        const Bytes good = ping(3);
+        wire.insert(wire.end(), good.begin(), good.end());
+
+        std::vector<Frame> frames;
+        std::string text;
+        Answer response;
+        if (!parse_frames(harness.send(wire), frames, text) || frames.empty() || frames[0].type != static_cast<uint8_t>(FrameType::Nack) ||
+            frames[0].seq != 2 || frames[0].payload[0] != static_cast<uint8_t>(SerialProtocol::NackReason::BadCrc) || !collect_response(frames, 3, response))
+            bench::fail("crc: corrupted frame not NACKed or the next one got lost");
+    }
+
+    // bigger than the buffer, walked over and NACKed
+    {
+        const Bytes huge(3000, 0x42);
+        std::vector<Frame> frames;
+        std::string text;
+        if (!parse_frames(harness.send(make_frame(FrameType::Command, 4, huge)), frames, text) || frames.size() != 1 ||
+            frames[0].payload[0] != static_cast<uint8_t>(SerialProtocol::NackReason::TooLong))
+            bench::fail("oversized: no TooLong NACK");
+    }
+
+    // unknown type
+    {
+        std::vector<Frame> frames;
+        std::string text;
+        if (!parse_frames(harness.send(make_frame(static_cast<FrameType>(0x42), 5, {})), frames, text) || frames.size() != 1 ||
+            frames[0].payload[0] != static_cast<uint8_t>(SerialProtocol::NackReason::UnknownType))
+            bench::fail("unknown type: no UnknownType NACK");
+    }
+
+    // a frame that lost its tail, the link goes quiet, the next one starts clean
+    {
+        const Bytes cut = ping(6);
+        harness.send(Bytes(cut.begin(), cut.begin() + 8));
+        harness.protocol.idle();
+
+        std::vector<Frame> frames;
+        std::string text;
+        Answer response;
+        if (!parse_frames(harness.send(ping(7)), frames, text) || !collect_response(frames, 7, response))
+            bench::fail("idle: frame after a truncated one got lost");
+    }
+
+    // lines and frames back to back in one read
+    {
+        Bytes wire = make_line(R"({"commands":[{"command":"ping"}]})");
+        const Bytes frame = ping(8);
+        wire.insert(wire.end(), frame.begin(), frame.end());
+        const Bytes line = make_line(R"({"commands":[{"command":"get_serial"}]})");
+        wire.insert(wire.end(), line.begin(), line.end());
+
+        std::vector<Frame> frames;
+        std::string text;
+        Answer response;
+        if (!parse_frames(harness.send(wire, 5), frames, text) || !collect_response(frames, 8, response) ||
+            std::count(text.begin(), text.end(), '\n') != 2)
+            bench::fail("interleaved: %s", text.c_str());
+    }
+
+    // a command frame without a name, or with a name longer than the payload
+    for (const Bytes& payload : {Bytes{}, Bytes{0}, Bytes{9, 'p', 'i', 'n', 'g'}})
+    {
+        std::vector<Frame> frames;
+        std::string text;
+        if (!parse_frames(harness.send(make_frame(FrameType::Command, 9, payload)), frames, text) || frames.size() != 1 ||
+            frames[0].payload[0] != static_cast<uint8_t>(SerialProtocol::NackReason::BadPayload))
+            bench::fail("bad payload: no BadPayload NACK");
+    }
+
+    // data that isn't cbor
+    {
+        const Bytes payload{4, 'p', 'i', 'n', 'g', 0xFF, 0xFF};
+        std::vector<Frame> frames;
+        std::string text;
+        Answer response;
+        if (!parse_frames(harness.send(make_frame(FrameType::Command, 10, payload)), frames, text) || !collect_response(frames, 10, response) ||
+            response.success)
+            bench::fail("bad cbor: %s", response.data.dump().c_str());
+    }
+
+    // a line too long for the buffer gets an error, its tail doesn't run as a command of its own
+    {
+        std::string line = R"({"commands":[{"command":"ping","data":{"padding":")" + std::string(1500, 'x') + R"("}}]})";
+        const Bytes answer = harness.send(make_line(line));
+        const std::string text(answer.begin(), answer.end());
+        if (std::count(text.begin(), text.end(), '\n') != 1 || text.find("Invalid JSON") == std::string::npos)
+            bench::fail("long line: %s", text.c_str());
+    }
+}
+
+std::vector<nlohmann::json> parse_lines(const Bytes& answer, std::vector<std::string>* raw = nullptr)
+{
+    std::vector<nlohmann::json> lines;
+    size_t start = 0;
+    for (size_t i = 0; i < answer.size(); i++)
+    {
+        if (answer[i] != '\n')
+            continue;
+        const std::string line(answer.begin() + start, answer.begin() + i);
+        lines.push_back(nlohmann::json::parse(line, nullptr, false));
+        if (raw)
+            raw->push_back(line);
+        start = i + 1;
+    }
+    return lines;
+}
+
+// what the transport's poll() pushes within timeout, the jobs run on their own thread
+Bytes wait_for_push(Harness& harness, std::chrono::milliseconds timeout)
+{
+    BytesSink sink;
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (sink.bytes.empty() && std::chrono::steady_clock::now() < deadline)
+    {
+        harness.protocol.poll(sink);
+        if (sink.bytes.empty())
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return sink.bytes;
+}
+
+uint32_t job_id_of(const nlohmann::json& answer)
+{
+    const auto& data = answer["results"][0]["result"]["data"];
+    return data.is_object() && data.contains("job_id") ? data["job_id"].get<uint32_t>() : 0;
+}
+
+void verify_tagged_lines(const CommandManager& commandManager)
+{
+    Harness harness(commandManager);
+
+    // a burst in one write, the answers come back in order and carry their ids up front
+    {
+        Bytes wire;
+        for (uint32_t id = 100; id < 110; id++)
+        {
+            const char* command = id % 2 ? "get_serial" : "ping";
+            const Bytes line = make_line(R"({"id":)" + std::to_string(id) + R"(,"commands":[{"command":")" + command + R"("}]})");
+            wire.insert(wire.end(), line.begin(), line.end());
+        }
+
+        std::vector<std::string> raw;
+        const auto answers = parse_lines(harness.send(wire, 13), &raw);
+        if (answers.size() != 10)
+            bench::fail("burst: %zu answers", answers.size());
+        for (size_t i = 0; i < answers.size(); i++)
+        {
+            const std::string expected = R"({"id":)" + std::to_string(100 + i) + ",";
+            if (answers[i].is_discarded() || raw[i].rfind(expected, 0) != 0 || !answers[i].contains("results"))
+                bench::fail("burst: %s", raw[i].c_str());
+        }
+    }
+
+    // the error shapes keep the id too, a broken id is an error of its own
+    {
+        const auto unknown = parse_lines(harness.send(make_line(R"({"id":5,"commands":[{"command":"no_such_command"}]})")));
+        if (unknown.size() != 1 || unknown[0].value("id", 0) != 5)
+            bench::fail("tagged error: %s", (unknown.empty() ? "nothing" : unknown[0].dump()).c_str());
+
+        for (const char* id : {"-1", "1.5", "\"7\"", "4294967296", "null"})
+        {
+            const auto answer = parse_lines(harness.send(make_line(R"({"id":)" + std::string(id) + R"(,"commands":[{"command":"ping"}]})")));
+            if (answer.size() != 1 || !answer[0].contains("error") || answer[0].contains("id"))
+                bench::fail("invalid id: %s", id);
+        }
+    }
+}
+
+void verify_job_push(const CommandManager& commandManager)
+{
+    Harness harness(commandManager);
+    Harness other(commandManager);
+
+    // a tagged scan answers with its job right away, the ping behind it isn't held up, the result gets pushed once
+    {
+        Bytes wire = make_line(R"({"id":42,"commands":[{"command":"scan_networks"}]})");
+        const Bytes ping = make_line(R"({"id":43,"commands":[{"command":"ping"}]})");
+        wire.insert(wire.end(), ping.begin(), ping.end());
+
+        const auto answers = parse_lines(harness.send(wire));
+        const uint32_t job = answers.size() == 2 ? job_id_of(answers[0]) : 0;
+        if (job == 0 || answers[0]["id"] != 42 || answers[1]["id"] != 43)
+            bench::fail("tagged scan: %s", (answers.empty() ? "nothing" : answers[0].dump()).c_str());
+
+        if (!wait_for_push(other, std::chrono::milliseconds(200)).empty())
+            bench::fail("push: went to a transport that didn't start the job");
+
+        const auto pushed = parse_lines(wait_for_push(harness, std::chrono::seconds(10)));
+        if (pushed.size() != 1 || pushed[0]["id"] != 42 || pushed[0]["job"]["id"] != job || pushed[0]["job"]["state"] != "done" ||
+            pushed[0]["job"]["status"] != "success" || !pushed[0]["job"]["result"].is_object())
+            bench::fail("push: %s", (pushed.empty() ? "nothing" : pushed[0].dump()).c_str());
+
+        if (!wait_for_push(harness, std::chrono::milliseconds(50)).empty())
+            bench::fail("push: delivered twice");
+    }
+
+    // untagged, the host polls for it and nothing gets pushed
+    {
+        const auto answer = parse_lines(harness.send(make_line(R"({"commands":[{"command":"scan_networks"}]})")));
+        const uint32_t job = answer.size() == 1 ? job_id_of(answer[0]) : 0;
+        if (job == 0)
+            bench::fail("untagged scan: %s", (answer.empty() ? "nothing" : answer[0].dump()).c_str());
+
+        const std::string status = line_request(nlohmann::json::array({{{"command", "get_job_status"}, {"data", {{"id", job}}}}}));
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        bool done = false;
+        while (!done && std::chrono::steady_clock::now() < deadline)
+        {
+            const auto polled = parse_lines(harness.send(make_line(status)));
+            done = polled.size() == 1 && polled[0]["results"][0]["result"]["data"]["state"] == "done";
+            if (!done)
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        if (!done)
+            bench::fail("untagged scan: never finished");
+        if (!wait_for_push(harness, std::chrono::milliseconds(50)).empty())
+            bench::fail("untagged scan: got pushed");
+    }
+}
+
+template <typename Fn>
+double measure(size_t iterations, Fn&& fn)
+{
+    fn();
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    for (size_t i = 0; i < iterations; i++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const auto end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    size_t iterations = 2000;
+
+    bench::Args args(CHECKS);
+    args.option("--iterations", iterations, "timed runs of every request (default 2000)", size_t(1));
+    if (const int exit_code = args.parse(argc, argv); exit_code >= 0)
+        return exit_code;
+
+    // the same wiring app_main() does, minus the hardware
+    static Preferences preferences;
+    auto deviceConfig = std::make_shared<ProjectConfig>(&preferences);
+    preferences.begin("openiris", false);
+    deviceConfig->load();
+
+    auto dependencyRegistry = std::make_shared<DependencyRegistry>();
+    dependencyRegistry->registerService<ProjectConfig>(DependencyType::project_config, deviceConfig);
+    dependencyRegistry->registerService<CameraManager>(DependencyType::camera_manager, std::make_shared<CameraManager>(deviceConfig));
+    dependencyRegistry->registerService<WiFiManager>(DependencyType::wifi_manager, std::make_shared<WiFiManager>());
+    dependencyRegistry->registerService<LEDManager>(DependencyType::led_manager, std::make_shared<LEDManager>(deviceConfig));
+    dependencyRegistry->registerService<FanManager>(DependencyType::fan_manager, std::make_shared<FanManager>(deviceConfig));
+    const CommandManager commandManager(dependencyRegistry);
+
+    // jobs on, a scan that takes a moment so the lines behind it have something to overtake
+    auto jobsRegistry = std::make_shared<DependencyRegistry>();
+    jobsRegistry->registerService<ProjectConfig>(DependencyType::project_config, deviceConfig);
+    jobsRegistry->registerService<WiFiManager>(DependencyType::wifi_manager, std::make_shared<WiFiManager>(12, 5));
+    CommandManager jobsCommandManager(jobsRegistry);
+    jobsCommandManager.startJobs();
+
+    bool ok = args.run("parity", [&] { verify_parity(commandManager); });
+    ok &= args.run("framing", [&] { verify_framing(commandManager); });
+    ok &= args.run("tagged_lines", [&] { verify_tagged_lines(jobsCommandManager); });
+    ok &= args.run("job_push", [&] { verify_job_push(jobsCommandManager); });
+    if (!ok || !args.timing())
+        return ok ? 0 : 1;
+
+    std::printf("%-20s %12s %12s %12s %12s %10s %10s\n", "request", "json dev us", "frame dev us", "json host us", "frame host us", "json B",
+                "frame B");
+    Harness harness(commandManager);
+    for (const auto& request : REQUESTS)
+    {
+        const auto commands = nlohmann::json::parse(request.commands);
+        const Bytes line = make_line(line_request(commands));
+        const Bytes frames = frame_request(commands, 0);
+        const Bytes line_answer = harness.send(line);
+        const Bytes frame_answer = harness.send(frames);
+
+        const double line_device_us = measure(iterations, [&] { harness.send(line); });
+        const double frame_device_us = measure(iterations, [&] { harness.send(frames); });
+        const double line_host_us = measure(iterations, [&] {
+            volatile bool ok = !nlohmann::json::parse(line_answer.begin(), line_answer.end(), nullptr, false).is_discarded();
+            (void)ok;
+        });
+        const double frame_host_us = measure(iterations, [&] {
+            std::vector<Frame> parsed;
+            std::string text;
+            Answer answer;
+            volatile bool ok = parse_frames(frame_answer, parsed, text) && collect_response(parsed, 0, answer);
+            (void)ok;
+        });
+
+        std::printf("%-20s %12.2f %12.2f %12.2f %12.2f %10zu %10zu\n", request.name, line_device_us, frame_device_us, line_host_us, frame_host_us,
+                    line.size() + line_answer.size(), frames.size() + frame_answer.size());
+    }
+    return 0;
+}
@@ -0,0 +1,315 @@
+// Capture times through the UVC payload headers, against timestamping frames when they arrive.
+//
+// Hosts used to stamp every frame when it came off the bus, so the time between two frames carried the
+// jitter of the camera's readout, video_task's pacing, the USB schedule and the host's own stack. Now the
+// payload headers carry the VSYNC time as PTS and pair the device clock with the USB frame number as SCR
+// (uvc_clock.c). The host fits device clock against SOF over the last SCRs it got, the way uvcvideo does,
+// and maps each PTS onto its own bus clock.
+//
+// The simulated device clock runs off by a few hundred ppm, starts just before the 32 bit STC wraps and
+// the 11 bit SOF wraps every 2048 ms. Every header is parsed back first and has to hold exactly what went
+// in, metadata has to land right behind the SCR and the payloads after the first go out with the two byte
+// header. Then the reconstructed capture times have to be within a SOF period of the truth, never more than
+// half a SOF period off their average and much steadier from frame to frame than arrival times. Anything
+// else fails the run.
+//
+// usage: uvc_clock_bench [--frames N] [--fps N] [--check NAME]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include <uvc_clock.h>
+
+#include "bench.hpp"
+
+namespace
+{
+const bench::Check CHECKS[] = {
+    {"headers", "payload headers parse back to what went in, metadata and short headers included"},
+    {"ticks", "the device clock in ticks steps evenly, across the 32 bit wrap too"},
+    {"capture_times", "PTS and SCR give capture times within a SOF period and far steadier than arrival"},
+};
+
+constexpr uint32_t CLOCK_HZ = 27000000;     // UVC_CLOCK_FREQUENCY in tusb/usb_descriptors.h
+constexpr double DRIFT_PPM = 180;           // the ESP's crystal against the host's
+constexpr int64_t DEVICE_START_US = 159000000;  // 2^32 ticks at 27 MHz is 159.07 s, wrap early on
+constexpr size_t SCR_WINDOW = 32;
+constexpr size_t UVC_FB_META = 32;              // UVC_FB_META_MAX in usb_device_uvc.h
+
+struct Header
+{
+    size_t length = 0;
+    uint8_t info = 0;
+    uint32_t pts = 0;
+    uint32_t stc = 0;
+    uint16_t sof = 0;
+};
+
+uint32_t get_le32(const uint8_t* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+// what the host side reads out of a payload, straight from the UVC spec's layout
+Header parse(const uint8_t* payload)
+{
+    Header header;
+    header.length = payload[0];
+    header.info = payload[1];
+    size_t pos = 2;
+    if (header.info & UVC_HEADER_PTS)
+    {
+        header.pts = get_le32(&payload[pos]);
+        pos += 4;
+    }
+    if (header.info & UVC_HEADER_SCR)
+    {
+        header.stc = get_le32(&payload[pos]);
+        header.sof = (payload[pos + 4] | payload[pos + 5] << 8) & 0x7ff;
+    }
+    return header;
+}
+
+// header fields have to come back as written and FID and EOF have to survive
+void verify_headers()
+{
+    std::mt19937 random(3);
+    for (size_t i = 0; i < 100000; i++)
+    {
+        uint8_t payload[UVC_HEADER_MAX_LEN + 4] = {};
+        const uint8_t kept = random() & (UVC_HEADER_FID | UVC_HEADER_EOF);
+        payload[1] = kept | 0x70;  // stale bits from the previous payload have to go
+        const bool has_pts = random() % 4 != 0;
+        const uint32_t pts = random(), stc = random();
+        const uint16_t sof = random();
+        const size_t length = uvc_clock_fill_header(payload, has_pts, pts, stc, sof);
+        const Header header = parse(payload);
+        if (length != (has_pts ? 12u : 8u) || header.length != length)
+            bench::fail("header %zu: length %zu", i, length);
+        if ((header.info & (UVC_HEADER_FID | UVC_HEADER_EOF)) != kept || !(header.info & UVC_HEADER_EOH) ||
+            !(header.info & UVC_HEADER_SCR) || bool(header.info & UVC_HEADER_PTS) != has_pts || (header.info & 0x70))
+            bench::fail("header %zu: bmHeaderInfo 0x%02x", i, header.info);
+        if ((has_pts && header.pts != pts) || header.stc != stc || header.sof != (sof & UVC_SOF_MASK))
+            bench::fail("header %zu: PTS, STC or SOF changed", i);
+
+        // the frame's metadata goes right behind the SCR
+        uint8_t full[UVC_HEADER_MAX_LEN + UVC_FB_META] = {};
+        std::copy(payload, payload + length, full);
+        uint8_t meta[UVC_FB_META];
+        const size_t meta_len = random() % (UVC_FB_META + 1);
+        for (size_t j = 0; j < meta_len; j++)
+            meta[j] = random();
+        if (uvc_clock_append(full, meta, meta_len) != length + meta_len || full[0] != length + meta_len ||
+            !std::equal(meta, meta + meta_len, full + length))
+            bench::fail("header %zu: %zu bytes of metadata didn't land behind the SCR", i, meta_len);
+
+        // the payloads after the first go without the clock fields, FID and EOF stay
+        if (uvc_clock_short_header(full) != 2 || full[0] != 2 || full[1] != (kept | UVC_HEADER_EOH))
+            bench::fail("header %zu: short header bmHeaderInfo 0x%02x", i, full[1]);
+    }
+    uint8_t big[256] = {UVC_HEADER_MAX_LEN};
+    if (uvc_clock_append(big, big, 250) != UVC_HEADER_MAX_LEN)
+        bench::fail("metadata past bHeaderLength 255, got %u", big[0]);
+}
+
+// ticks between two instants have to depend only on the distance, also across the 32 bit wrap
+void verify_ticks()
+{
+    for (const uint32_t hz : {27000000u, 48000000u, 1000000u, 32768u})
+    {
+        for (int64_t us = 0; us < 400000000; us += 997)
+        {
+            const uint32_t step = uvc_clock_ticks(us + 1000, hz) - uvc_clock_ticks(us, hz);
+            const double expected = hz / 1000.0;
+            if (std::fabs(step - expected) > 1.0)
+            {
+                bench::fail("%u Hz: %u ticks per ms at %lld us", hz, step, static_cast<long long>(us));
+                break;
+            }
+        }
+    }
+}
+
+struct Stats
+{
+    std::vector<double> errors_us;
+
+    void add(double error_us) { this->errors_us.push_back(error_us); }
+
+    double mean() const
+    {
+        double sum = 0;
+        for (double e : this->errors_us)
+            sum += e;
+        return this->errors_us.empty() ? 0 : sum / this->errors_us.size();
+    }
+    // spread around the mean, a constant offset doesn't matter for velocities
+    double jitter_max() const
+    {
+        const double m = this->mean();
+        double worst = 0;
+        for (double e : this->errors_us)
+            worst = std::max(worst, std::fabs(e - m));
+        return worst;
+    }
+    // error of the interval between consecutive frames, what a velocity estimate divides by
+    double interval_rms() const
+    {
+        double sum = 0;
+        for (size_t i = 1; i < this->errors_us.size(); i++)
+        {
+            const double d = this->errors_us[i] - this->errors_us[i - 1];
+            sum += d * d;
+        }
+        return this->errors_us.size() > 1 ? std::sqrt(sum / (this->errors_us.size() - 1)) : 0;
+    }
+};
+
+// the host's side: SOF counts its own milliseconds, the SCRs tie the device clock to them
+struct HostClock
+{
+    struct Point
+    {
+        double sof_ms;
+        double stc;
+    };
+    std::deque<Point> points;
+    int64_t last_stc = -1;
+    int64_t stc_wraps = 0;
+
+    int64_t unwrap_stc(uint32_t stc)
+    {
+        int64_t full = this->stc_wraps + stc;
+        if (this->last_stc >= 0 && full < this->last_stc - (int64_t(1) << 31))
+        {
+            this->stc_wraps += int64_t(1) << 32;
+            full += int64_t(1) << 32;
+        }
+        this->last_stc = full;
+        return full;
+    }
+
+    // the host knows the current frame number when the payload arrives, the SOF in it is at most 2 s older
+    static int64_t unwrap_sof(uint16_t sof, int64_t host_frame)
+    {
+        return host_frame - ((host_frame - sof) & UVC_SOF_MASK);
+    }
+
+    void add(uint32_t stc, uint16_t sof, int64_t host_frame)
+    {
+        this->points.push_back({static_cast<double>(unwrap_sof(sof, host_frame)), static_cast<double>(unwrap_stc(stc))});
+        if (this->points.size() > SCR_WINDOW)
+            this->points.pop_front();
+    }
+
+    // PTS onto the host's bus clock, least squares over the window
+    double to_host_us(uint32_t pts) const
+    {
+        double mx = 0, my = 0;
+        for (const auto& p : this->points)
+        {
+            mx += p.stc;
+            my += p.sof_ms;
+        }
+        mx /= this->points.size();
+        my /= this->points.size();
+        double sxy = 0, sxx = 0;
+        for (const auto& p : this->points)
+        {
+            sxy += (p.stc - mx) * (p.sof_ms - my);
+            sxx += (p.stc - mx) * (p.stc - mx);
+        }
+        const double slope = sxx > 0 ? sxy / sxx : 1000.0 / CLOCK_HZ;
+        // the PTS is a few ms older than the newest STC, unwrap it against that one
+        const int64_t latest = this->last_stc;
+        const int64_t full_pts = latest - static_cast<uint32_t>(static_cast<uint32_t>(latest) - pts);
+        return (my + slope * (full_pts - mx)) * 1000.0;
+    }
+};
+
+struct Stream
+{
+    Stats arrival;
+    Stats pts;
+};
+
+// frames through the payload headers, capture times recovered from arrival and from PTS + SCR
+Stream simulate(size_t frames, double fps)
+{
+    std::mt19937 random(11);
+    std::uniform_real_distribution<double> readout_us(1500, 7000);   // VSYNC to the first payload, JPEG size and pacing
+    std::uniform_real_distribution<double> bus_us(200, 4000);        // until the host's stack hands the frame over
+    std::uniform_real_distribution<double> vsync_jitter_us(-30, 30);
+
+    // host time in us is the reference, SOF n starts at n ms, the device clock drifts against it
+    const double period_us = 1e6 / fps;
+    const auto device_us = [](double host_us) { return DEVICE_START_US + host_us * (1 + DRIFT_PPM * 1e-6); };
+
+    Stream stream;
+    HostClock host;
+    const size_t warmup = SCR_WINDOW;
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+        const double vsync = 5000 + frame * period_us + vsync_jitter_us(random);
+        const double sent = vsync + readout_us(random);
+        const double arrived = sent + bus_us(random);
+
+        // what uvc_payload_header_cb() puts in the first payload, SOFFN holds the frame that started last
+        uint8_t payload[UVC_HEADER_MAX_LEN] = {};
+        const int64_t sof_at_send = static_cast<int64_t>(std::floor(sent / 1000));
+        uvc_clock_fill_header(payload, true, uvc_clock_ticks(static_cast<int64_t>(device_us(vsync)), CLOCK_HZ),
+                              uvc_clock_ticks(static_cast<int64_t>(device_us(sent)), CLOCK_HZ), sof_at_send);
+
+        const Header header = parse(payload);
+        host.add(header.stc, header.sof, static_cast<int64_t>(std::floor(arrived / 1000)));
+        if (frame < warmup)
+            continue;
+        stream.arrival.add(arrived - vsync);
+        stream.pts.add(host.to_host_us(header.pts) - vsync);
+    }
+    return stream;
+}
+
+void verify_capture_times(size_t frames, double fps)
+{
+    const Stream stream = simulate(frames, fps);
+    // the SOF only says which millisecond the STC fell into, the fit settles on its middle
+    if (std::fabs(stream.pts.mean()) > 1000)
+        bench::fail("PTS %.1f us off VSYNC on average", stream.pts.mean());
+    if (stream.pts.jitter_max() > 500)
+        bench::fail("PTS up to %.1f us off their average", stream.pts.jitter_max());
+    if (stream.pts.interval_rms() * 4 > stream.arrival.interval_rms())
+        bench::fail("PTS interval error %.1f us rms, arrival %.1f us", stream.pts.interval_rms(), stream.arrival.interval_rms());
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    size_t frames = 20000;
+    double fps = 60;
+
+    bench::Args args(CHECKS);
+    args.option("--frames", frames, "frames to stream, at least 100 (default 20000)", size_t(100));
+    args.option("--fps", fps, "committed frame rate, 1 to 240 (default 60)", 1.0, 240.0);
+    if (const int exit_code = args.parse(argc, argv); exit_code >= 0)
+        return exit_code;
+
+    bool ok = args.run("headers", verify_headers);
+    ok &= args.run("ticks", verify_ticks);
+    ok &= args.run("capture_times", [&] { verify_capture_times(frames, fps); });
+    if (!ok || !args.timing())
+        return ok ? 0 : 1;
+
+    const Stream stream = simulate(frames, fps);
+    std::printf("%-22s %12s %14s %16s\n", "capture time from", "offset us", "max jitter us", "interval rms us");
+    std::printf("%-22s %12.1f %14.1f %16.1f\n", "arrival", stream.arrival.mean(), stream.arrival.jitter_max(), stream.arrival.interval_rms());
+    std::printf("%-22s %12.1f %14.1f %16.1f\n", "PTS + SCR", stream.pts.mean(), stream.pts.jitter_max(), stream.pts.interval_rms());
+    return 0;
+}
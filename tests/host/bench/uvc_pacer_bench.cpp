@@ -0,0 +1,244 @@
+// Simulation of the UVC frame pacing in usb_device_uvc.c, on a virtual clock.
+//
+// video_task used to check get_time_millis() against interval_ms once per tick (vTaskDelay(1)), so 60 fps
+// (dwFrameInterval 166666) ran on a 16 ms schedule, every frame left on a tick boundary and the task woke
+// up every millisecond whether there was anything to send or not. Now it sleeps until uvc_pacer_due() on a
+// one-shot esp_timer. Both loops are run here against the same camera - frames become ready at the
+// sensor's own rate, the task can't send one before it's there - and compared on the intervals the host
+// sees and how often the task had to wake up for them.
+//
+// The new pacer has to hit the committed interval on average, stay within the timer's wake-up latency of
+// it, and never send frames back to back to catch up after a stall. Anything else fails the run.
+//
+// usage: uvc_pacer_bench [--frames N] [--check NAME]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include <uvc_pacer.h>
+
+#include "bench.hpp"
+
+namespace
+{
+const bench::Check CHECKS[] = {
+    {"interval", "the committed interval on average and to within the timer's latency"},
+    {"no_bursts", "no frames back to back, not even to catch up after a stall"},
+};
+
+struct Scenario
+{
+    const char* name;
+    uint32_t frame_interval;   // dwFrameInterval, 100 ns units
+    double camera_period_us;   // how often the sensor finishes a frame
+    size_t stall_at_frame;     // 0 for none
+    int64_t stall_us;          // the task doesn't get to run for this long, preemption, a flash write
+};
+
+const Scenario SCENARIOS[] = {
+    {"60 fps, sensor 90", 166666, 1e6 / 90, 0, 0},
+    {"90 fps, sensor 100", 111111, 1e6 / 100, 0, 0},
+    {"30 fps, sensor 60", 333333, 1e6 / 60, 0, 0},
+    {"60 fps, sensor 55", 166666, 1e6 / 55, 0, 0},
+    {"60 fps, 120 ms stall", 166666, 1e6 / 90, 500, 120000},
+};
+
+// esp_timer callbacks run on their own task, they arrive a little after the deadline
+constexpr int64_t TIMER_LATENCY_MIN_US = 10;
+constexpr int64_t TIMER_LATENCY_MAX_US = 60;
+constexpr int64_t TICK_US = 1000;
+constexpr int64_t START_US = 1000000;
+
+struct Camera
+{
+    double period_us;
+    int64_t last_taken = -1;
+
+    // GRAB_LATEST, the newest frame that finished after the one we took last, waiting for it if need be
+    int64_t take(int64_t now)
+    {
+        int64_t index = static_cast<int64_t>(std::floor((now - START_US) / this->period_us));
+        if (index <= this->last_taken)
+        {
+            index = this->last_taken + 1;
+            now = START_US + static_cast<int64_t>(std::ceil(index * this->period_us));
+        }
+        this->last_taken = index;
+        return now;
+    }
+};
+
+struct Result
+{
+    std::vector<int64_t> sent;
+    size_t wakeups = 0;
+};
+
+// the loop as it was: one check per tick, millisecond interval
+Result run_tick_loop(const Scenario& scenario, size_t frames)
+{
+    Result result;
+    Camera camera{scenario.camera_period_us};
+    const uint32_t interval_ms = scenario.frame_interval / 10000;
+    int64_t now = START_US;
+    uint32_t start_ms = static_cast<uint32_t>(now / 1000);
+
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+        if (frame == scenario.stall_at_frame && scenario.stall_us)
+            now += scenario.stall_us;
+        now = camera.take(now);
+
+        while (static_cast<uint32_t>(now / 1000) - start_ms < interval_ms)
+        {
+            // vTaskDelay(1), back on the next tick
+            now = (now / TICK_US + 1) * TICK_US;
+            result.wakeups++;
+        }
+        const uint32_t cur = static_cast<uint32_t>(now / 1000);
+        start_ms += interval_ms;
+        if (cur - start_ms > 3 * interval_ms)
+            start_ms = cur;
+
+        result.sent.push_back(now);
+        result.wakeups++;
+    }
+    return result;
+}
+
+Result run_pacer(const Scenario& scenario, size_t frames)
+{
+    Result result;
+    Camera camera{scenario.camera_period_us};
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int64_t> latency(TIMER_LATENCY_MIN_US, TIMER_LATENCY_MAX_US);
+    uvc_pacer_t pacer;
+    uvc_pacer_start(&pacer, scenario.frame_interval);
+    int64_t now = START_US;
+
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+        if (frame == scenario.stall_at_frame && scenario.stall_us)
+            now += scenario.stall_us;
+        now = camera.take(now);
+
+        if (now < uvc_pacer_due(&pacer))
+        {
+            now = uvc_pacer_due(&pacer) + latency(random);
+            result.wakeups++;
+        }
+        uvc_pacer_sent(&pacer, now);
+
+        result.sent.push_back(now);
+        result.wakeups++;
+    }
+    return result;
+}
+
+struct Summary
+{
+    double fps;
+    double mean_us;
+    double stddev_us;
+    int64_t min_us;
+    int64_t max_us;
+    double wakeups_per_frame;
+};
+
+Summary summarize(const Result& result)
+{
+    Summary summary{};
+    std::vector<int64_t> intervals;
+    for (size_t i = 1; i < result.sent.size(); i++)
+        intervals.push_back(result.sent[i] - result.sent[i - 1]);
+
+    double sum = 0;
+    for (const int64_t interval : intervals)
+        sum += interval;
+    summary.mean_us = sum / intervals.size();
+
+    double squares = 0;
+    for (const int64_t interval : intervals)
+        squares += (interval - summary.mean_us) * (interval - summary.mean_us);
+    summary.stddev_us = std::sqrt(squares / intervals.size());
+
+    summary.min_us = *std::min_element(intervals.begin(), intervals.end());
+    summary.max_us = *std::max_element(intervals.begin(), intervals.end());
+    summary.fps = 1e6 / summary.mean_us;
+    summary.wakeups_per_frame = static_cast<double>(result.wakeups) / result.sent.size();
+    return summary;
+}
+
+// with a camera that keeps up and nothing stalling, every interval has to be the committed one give or take the timer
+void verify_interval(size_t frames)
+{
+    for (const auto& scenario : SCENARIOS)
+    {
+        const double target = scenario.frame_interval / 10.0;
+        if (scenario.camera_period_us >= target || scenario.stall_us)
+            continue;
+
+        const Summary summary = summarize(run_pacer(scenario, frames));
+        if (std::abs(summary.mean_us - target) >= 1.0)
+            bench::fail("%s: average interval %.1f us, committed %.1f us", scenario.name, summary.mean_us, target);
+        if (summary.max_us - target > TIMER_LATENCY_MAX_US + 1 || target - summary.min_us > TIMER_LATENCY_MAX_US + 1)
+            bench::fail("%s: intervals from %lld to %lld us, more than the timer latency off %.1f us", scenario.name,
+                        static_cast<long long>(summary.min_us), static_cast<long long>(summary.max_us), target);
+    }
+}
+
+// catching up after a stall or a slow camera is fine, doing it with frames back to back isn't
+void verify_bursts(size_t frames)
+{
+    for (const auto& scenario : SCENARIOS)
+    {
+        const double target = scenario.frame_interval / 10.0;
+        const Result result = run_pacer(scenario, frames);
+        size_t bursts = 0;
+        for (size_t i = 1; i < result.sent.size(); i++)
+        {
+            if (result.sent[i] - result.sent[i - 1] < target / 2)
+                bursts++;
+        }
+        if (bursts > (scenario.stall_us ? 1 : 0))
+            bench::fail("%s: %zu frames sent back to back", scenario.name, bursts);
+    }
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    size_t frames = 20000;
+
+    bench::Args args(CHECKS);
+    args.option("--frames", frames, "frames to send per scenario, at least 1000 (default 20000)", size_t(1000));
+    if (const int exit_code = args.parse(argc, argv); exit_code >= 0)
+        return exit_code;
+
+    bool ok = args.run("interval", [&] { verify_interval(frames); });
+    ok &= args.run("no_bursts", [&] { verify_bursts(frames); });
+    if (!ok || !args.timing())
+        return ok ? 0 : 1;
+
+    std::printf("%-22s %-6s %8s %10s %10s %8s %8s %12s\n", "scenario", "loop", "fps", "mean us", "stddev us", "min us", "max us", "wakeups/frm");
+    for (const auto& scenario : SCENARIOS)
+    {
+        const Result ticks = run_tick_loop(scenario, frames);
+        const Result paced = run_pacer(scenario, frames);
+        const Summary old_summary = summarize(ticks);
+        const Summary new_summary = summarize(paced);
+
+        for (const auto& [loop, summary] : {std::pair{"tick", old_summary}, std::pair{"timer", new_summary}})
+        {
+            std::printf("%-22s %-6s %8.2f %10.1f %10.1f %8lld %8lld %12.2f\n", scenario.name, loop, summary.fps, summary.mean_us, summary.stddev_us,
+                        static_cast<long long>(summary.min_us), static_cast<long long>(summary.max_us), summary.wakeups_per_frame);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,354 @@
+// Microbenchmark for the YUYV to Y8 conversion in the camera driver.
+//
+// Sensors without a Y8 mode (the OV2640) send YUYV for PIXFORMAT_GRAYSCALE and ll_cam_memcpy keeps every
+// even byte, one DMA half buffer at a time on the camera task. On the ESP32-S3 the 16 byte aligned bulk of
+// a buffer goes through the PIE unit (yuyv_to_y8_pie in target/esp32s3/ll_cam.c) and yuyv_to_y8 from
+// driver/yuv_to_y8.c does the rest, everywhere else yuyv_to_y8 does all of it.
+//
+// The PIE kernel can't run here, so it's modelled a register at a time, EE.VUNZIP.8 included, and goes
+// through the same aligned/unaligned split as ll_cam_memcpy. That, yuyv_to_y8 on its own and the SSE2
+// version of the kernel below are checked byte for byte against the loop the driver used to have - every
+// length up to a few hundred bytes, every input and output alignment, in place like cam_take does for
+// PSRAM frames, plus whole frames. Bytes past what the old loop wrote have to stay untouched. Any
+// difference fails the run.
+//
+// The timing is the host CPU's, bytes per cycle from the TSC where there is one. SSE2's PAND + PACKUSWB
+// does what EE.VUNZIP.8 does for the even bytes, so the kernel runs here in the same shape - two 128 bit
+// loads, one unzip, one 128 bit store per 32 bytes - next to the byte loop it replaces. The byte loop is
+// built without auto-vectorization (so is openiris_yuv_y8), the ESP's compiler has nothing to vectorize it with either.
+//
+// usage: yuv_y8_bench [--iterations N] [--check NAME]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__)
+#define NO_VECTORIZE __attribute__((optimize("no-tree-vectorize")))
+#else
+#define NO_VECTORIZE
+#endif
+
+#include <yuv_to_y8.h>
+
+#include "bench.hpp"
+
+namespace
+{
+const bench::Check CHECKS[] = {
+    {"lengths", "every length up to 320 bytes at every input and output alignment"},
+    {"in_place", "the same lengths converted in place, like cam_take does for PSRAM frames"},
+    {"frames", "whole half buffers and frames at the sizes the UVC formats stream"},
+};
+
+// the loop ll_cam_memcpy had before, kept as the reference
+NO_VECTORIZE size_t reference_yuyv_to_y8(uint8_t* out, const uint8_t* in, size_t len)
+{
+    size_t end = len / 8;
+    for (size_t i = 0; i < end; ++i)
+    {
+        out[0] = in[0];
+        out[1] = in[2];
+        out[2] = in[4];
+        out[3] = in[6];
+        out += 4;
+        in += 8;
+    }
+    return len / 2;
+}
+
+// yuyv_to_y8_pie, EE.VLD.128.IP ignores the low 4 address bits, ll_cam_memcpy only calls it aligned
+void pie_model(uint8_t* out, const uint8_t* in, size_t blocks)
+{
+    for (size_t block = 0; block < blocks; block++)
+    {
+        uint8_t q0[16];
+        uint8_t q1[16];
+        std::memcpy(q0, in, 16);
+        std::memcpy(q1, in + 16, 16);
+        in += 32;
+
+        // EE.VUNZIP.8 q0, q1: q0 gets the even bytes of q1:q0, q1 the odd ones
+        uint8_t even[16];
+        uint8_t odd[16];
+        for (int i = 0; i < 8; i++)
+        {
+            even[i] = q0[2 * i];
+            even[8 + i] = q1[2 * i];
+            odd[i] = q0[2 * i + 1];
+            odd[8 + i] = q1[2 * i + 1];
+        }
+        std::memcpy(q0, even, 16);
+        std::memcpy(q1, odd, 16);
+
+        std::memcpy(out, q0, 16);
+        out += 16;
+    }
+}
+
+using Kernel = void (*)(uint8_t*, const uint8_t*, size_t);
+
+// the YUV to grayscale branch of ll_cam_memcpy on the S3, with the kernel swapped out
+template <Kernel kernel>
+size_t ll_cam_memcpy_model(uint8_t* out, const uint8_t* in, size_t len)
+{
+    size_t done = 0;
+    if (len >= 32 && ((reinterpret_cast<uintptr_t>(in) | reinterpret_cast<uintptr_t>(out)) & 15) == 0)
+    {
+        done = len & ~static_cast<size_t>(31);
+        kernel(out, in, done / 32);
+    }
+    yuyv_to_y8(out + done / 2, in + done, len - done);
+    return len / 2;
+}
+
+#if defined(__SSE2__)
+// the PIE kernel in SSE2, masking off the odd bytes and packing the 16 bit lanes keeps the even ones
+void sse2_kernel(uint8_t* out, const uint8_t* in, size_t blocks)
+{
+    const __m128i even = _mm_set1_epi16(0x00FF);
+    for (size_t block = 0; block < blocks; block++)
+    {
+        const __m128i q0 = _mm_load_si128(reinterpret_cast<const __m128i*>(in));
+        const __m128i q1 = _mm_load_si128(reinterpret_cast<const __m128i*>(in + 16));
+        _mm_store_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(_mm_and_si128(q0, even), _mm_and_si128(q1, even)));
+        in += 32;
+        out += 16;
+    }
+}
+#endif
+
+using Convert = size_t (*)(uint8_t*, const uint8_t*, size_t);
+
+struct Candidate
+{
+    const char* name;
+    Convert convert;
+};
+
+const Candidate CANDIDATES[] = {
+    {"yuyv_to_y8", yuyv_to_y8},
+    {"ll_cam_memcpy (PIE model)", ll_cam_memcpy_model<pie_model>},
+#if defined(__SSE2__)
+    {"ll_cam_memcpy (SSE2)", ll_cam_memcpy_model<sse2_kernel>},
+#endif
+};
+
+constexpr uint8_t SENTINEL = 0xA5;
+
+void fill_random(uint8_t* data, size_t length, std::mt19937& random)
+{
+    for (size_t i = 0; i < length; i++)
+        data[i] = static_cast<uint8_t>(random());
+}
+
+// separate output buffer, the output sits at out_align and the input at in_align from a 16 byte boundary
+void compare(const Candidate& candidate, const std::vector<uint8_t>& input, size_t in_align, size_t out_align)
+{
+    const size_t length = input.size();
+    alignas(16) static uint8_t in_storage[1 << 18];
+    alignas(16) static uint8_t expected_storage[1 << 17];
+    alignas(16) static uint8_t actual_storage[1 << 17];
+
+    uint8_t* in = in_storage + in_align;
+    std::memcpy(in, input.data(), length);
+    const size_t out_bytes = length / 2 + 32;
+    uint8_t* expected = expected_storage + out_align;
+    uint8_t* actual = actual_storage + out_align;
+    std::memset(expected, SENTINEL, out_bytes);
+    std::memset(actual, SENTINEL, out_bytes);
+
+    const size_t expected_len = reference_yuyv_to_y8(expected, in, length);
+    const size_t actual_len = candidate.convert(actual, in, length);
+    if (expected_len != actual_len || std::memcmp(expected, actual, out_bytes) != 0)
+        bench::fail("%s len=%zu in_align=%zu out_align=%zu", candidate.name, length, in_align, out_align);
+}
+
+// out == in, what cam_take does with a PSRAM frame
+void compare_in_place(const Candidate& candidate, const std::vector<uint8_t>& input, size_t align)
+{
+    const size_t length = input.size();
+    alignas(16) static uint8_t expected_storage[1 << 18];
+    alignas(16) static uint8_t actual_storage[1 << 18];
+
+    uint8_t* expected = expected_storage + align;
+    uint8_t* actual = actual_storage + align;
+    std::memcpy(expected, input.data(), length);
+    std::memcpy(actual, input.data(), length);
+
+    const size_t expected_len = reference_yuyv_to_y8(expected, expected, length);
+    const size_t actual_len = candidate.convert(actual, actual, length);
+    if (expected_len != actual_len || std::memcmp(expected, actual, length) != 0)
+        bench::fail("%s in place len=%zu align=%zu", candidate.name, length, align);
+}
+
+void verify_lengths()
+{
+    std::mt19937 random(42);
+    std::vector<uint8_t> input;
+    for (const auto& candidate : CANDIDATES)
+    {
+        for (size_t length = 0; length <= 320; length++)
+        {
+            input.resize(length);
+            fill_random(input.data(), length, random);
+            for (size_t in_align = 0; in_align < 16; in_align++)
+            {
+                for (size_t out_align = 0; out_align < 16; out_align++)
+                    compare(candidate, input, in_align, out_align);
+            }
+        }
+    }
+}
+
+void verify_in_place()
+{
+    std::mt19937 random(43);
+    std::vector<uint8_t> input;
+    for (const auto& candidate : CANDIDATES)
+    {
+        for (size_t length = 0; length <= 320; length++)
+        {
+            input.resize(length);
+            fill_random(input.data(), length, random);
+            for (size_t align = 0; align < 16; align++)
+                compare_in_place(candidate, input, align);
+        }
+    }
+}
+
+// whole half buffers and frames at the sizes the UVC format streams, and the 240x240 MJPEG one
+void verify_frames()
+{
+    std::mt19937 random(44);
+    std::vector<uint8_t> input;
+    for (const auto& candidate : CANDIDATES)
+    {
+        for (const size_t length : {96 * 2 * 8, 128 * 2 * 16, 96 * 96 * 2, 128 * 128 * 2, 240 * 240 * 2})
+        {
+            input.resize(length);
+            fill_random(input.data(), length, random);
+            for (const size_t align : {0, 4, 8})
+            {
+                compare(candidate, input, align, 0);
+                compare(candidate, input, 0, align);
+                compare_in_place(candidate, input, align);
+            }
+        }
+    }
+}
+
+struct Timing
+{
+    double ns_per_call = 1e30;
+    double cycles_per_call = 0;
+};
+
+template <typename Fn>
+Timing measure(size_t iterations, Fn&& fn)
+{
+    // warm up the caches, then keep the best of a few runs so a noisy neighbour doesn't show up as a regression
+    fn();
+    Timing best;
+    for (int run = 0; run < 5; run++)
+    {
+#ifdef HAVE_TSC
+        const uint64_t start_tsc = __rdtsc();
+#endif
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+            fn();
+        const auto end = std::chrono::steady_clock::now();
+        const double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+        if (ns < best.ns_per_call)
+        {
+            best.ns_per_call = ns;
+#ifdef HAVE_TSC
+            best.cycles_per_call = static_cast<double>(__rdtsc() - start_tsc) / iterations;
+#endif
+        }
+    }
+    return best;
+}
+
+// keeps the compiler from dropping the conversions
+volatile size_t sink;
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    size_t iterations = 2000;
+
+    bench::Args args(CHECKS);
+    args.option("--iterations", iterations, "timed conversions per frame and run (default 2000)", size_t(1));
+    if (const int exit_code = args.parse(argc, argv); exit_code >= 0)
+        return exit_code;
+
+    bool ok = args.run("lengths", verify_lengths);
+    ok &= args.run("in_place", verify_in_place);
+    ok &= args.run("frames", verify_frames);
+    if (!ok || !args.timing())
+        return ok ? 0 : 1;
+
+    struct Frame
+    {
+        const char* name;
+        size_t bytes;
+    };
+    const Frame frames[] = {
+        {"96x96 YUYV", 96 * 96 * 2},
+        {"128x128 YUYV", 128 * 128 * 2},
+        {"240x240 YUYV", 240 * 240 * 2},
+    };
+
+    std::printf("%-14s %8s %12s %12s %12s %10s %10s %10s\n", "frame", "bytes", "old us", "y8 us", "128bit us", "old B/cyc", "y8 B/cyc",
+                "128bit B/cyc");
+    for (const auto& frame : frames)
+    {
+        std::mt19937 random(7);
+        alignas(16) static uint8_t in[240 * 240 * 2];
+        alignas(16) static uint8_t out[240 * 240];
+        fill_random(in, frame.bytes, random);
+
+        const Timing timings[] = {
+            measure(iterations, [&] { sink = reference_yuyv_to_y8(out, in, frame.bytes); }),
+            measure(iterations, [&] { sink = yuyv_to_y8(out, in, frame.bytes); }),
+#if defined(__SSE2__)
+            measure(iterations, [&] { sink = ll_cam_memcpy_model<sse2_kernel>(out, in, frame.bytes); }),
+#endif
+        };
+
+        std::printf("%-14s %8zu", frame.name, frame.bytes);
+        for (size_t i = 0; i < 3; i++)
+        {
+            if (i < std::size(timings))
+                std::printf(" %12.3f", timings[i].ns_per_call / 1000);
+            else
+                std::printf(" %12s", "n/a");
+        }
+        for (size_t i = 0; i < 3; i++)
+        {
+            if (i < std::size(timings) && timings[i].cycles_per_call > 0)
+                std::printf(" %10.2f", frame.bytes / timings[i].cycles_per_call);
+            else
+                std::printf(" %10s", "n/a");
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
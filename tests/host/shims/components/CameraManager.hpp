@@ -0,0 +1,36 @@
+// host stand-in for CameraManager, the command stack only needs the type and the window calls
+#pragma once
+#ifndef CAMERAMANAGER_HPP
+#define CAMERAMANAGER_HPP
+
+#include <ProjectConfig.hpp>
+#include <memory>
+
+struct VieWindow
+{
+    int offset_x = 0;
+    int offset_y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+class CameraManager
+{
+   public:
+    explicit CameraManager(std::shared_ptr<ProjectConfig> projectConfig) : projectConfig(projectConfig) {}
+
+    // an OV3660 at 320x320, windows land on its binned 1024x768 readout
+    int setVieWindow(int offsetX, int offsetY, int outputX, int outputY)
+    {
+        window = outputX && outputY ? VieWindow{offsetX, offsetY, outputX, outputY} : VieWindow{};
+        return 0;
+    }
+    VieWindow getVieWindow() const { return window; }
+    VieWindow getVieWindowBounds() const { return {0, 0, 1024, 768}; }
+
+   private:
+    std::shared_ptr<ProjectConfig> projectConfig;
+    VieWindow window;
+};
+
+#endif
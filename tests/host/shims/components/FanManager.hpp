@@ -0,0 +1,30 @@
+// host stand-in for FanManager
+#pragma once
+#ifndef _FANMANAGER_HPP_
+#define _FANMANAGER_HPP_
+
+#include <ProjectConfig.hpp>
+#include <cstdint>
+#include <memory>
+
+class FanManager
+{
+   public:
+    explicit FanManager(std::shared_ptr<ProjectConfig> deviceConfig) : deviceConfig(deviceConfig) {}
+
+    void setFanDutyCycle(uint8_t dutyPercent)
+    {
+        dutyCycle = dutyPercent;
+    }
+
+    uint8_t getFanDutyCycle() const
+    {
+        return dutyCycle;
+    }
+
+   private:
+    std::shared_ptr<ProjectConfig> deviceConfig;
+    uint8_t dutyCycle = 0;
+};
+
+#endif
@@ -0,0 +1,30 @@
+// host stand-in for LEDManager, remembers the last duty cycle instead of driving a pin
+#pragma once
+#ifndef _LEDMANAGER_HPP_
+#define _LEDMANAGER_HPP_
+
+#include <ProjectConfig.hpp>
+#include <cstdint>
+#include <memory>
+
+class LEDManager
+{
+   public:
+    explicit LEDManager(std::shared_ptr<ProjectConfig> deviceConfig) : deviceConfig(deviceConfig) {}
+
+    void setExternalLEDDutyCycle(uint8_t dutyPercent)
+    {
+        dutyCycle = dutyPercent;
+    }
+
+    uint8_t getExternalLEDDutyCycle() const
+    {
+        return deviceConfig ? deviceConfig->getDeviceConfig().led_external_pwm_duty_cycle : dutyCycle;
+    }
+
+   private:
+    std::shared_ptr<ProjectConfig> deviceConfig;
+    uint8_t dutyCycle = 0;
+};
+
+#endif
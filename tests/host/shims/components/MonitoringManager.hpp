@@ -0,0 +1,28 @@
+// host stand-in for MonitoringManager, monitoring is disabled in the host sdkconfig
+#pragma once
+
+struct BatteryStatus
+{
+    int voltage_mv;
+    float percentage;
+    bool valid;
+};
+
+class MonitoringManager
+{
+   public:
+    float getCurrentMilliAmps() const
+    {
+        return 0.0f;
+    }
+
+    BatteryStatus getBatteryStatus() const
+    {
+        return {0, 0.0f, false};
+    }
+
+    static constexpr bool isEnabled()
+    {
+        return false;
+    }
+};
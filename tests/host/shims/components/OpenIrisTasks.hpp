@@ -0,0 +1,17 @@
+// host stand-in for OpenIrisTasks, restarts are counted instead of performed
+#pragma once
+#ifndef OPENIRISTASKS_HPP
+#define OPENIRISTASKS_HPP
+
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "helpers.hpp"
+
+namespace OpenIrisTasks
+{
+void ScheduleRestart(int milliseconds);
+int GetScheduledRestarts();
+};
+
+#endif
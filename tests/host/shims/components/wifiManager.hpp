@@ -0,0 +1,83 @@
+// host stand-in for WiFiManager
+// scans return a fixed, configurable set of networks so scan_networks can be measured
+// with payloads as big as the ones a crowded room produces on the device, and can take
+// as long as the device does, channel by channel
+#pragma once
+#ifndef WIFIHANDLER_HPP
+#define WIFIHANDLER_HPP
+
+#include <ProjectConfig.hpp>
+#include <StateManager.hpp>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef enum
+{
+    WIFI_AUTH_OPEN = 0,
+    WIFI_AUTH_WEP,
+    WIFI_AUTH_WPA_PSK,
+    WIFI_AUTH_WPA2_PSK,
+    WIFI_AUTH_WPA_WPA2_PSK,
+    WIFI_AUTH_WPA2_ENTERPRISE,
+    WIFI_AUTH_WPA3_PSK,
+    WIFI_AUTH_WPA2_WPA3_PSK,
+} wifi_auth_mode_t;
+
+struct WiFiNetwork
+{
+    std::string ssid;
+    uint8_t channel;
+    int8_t rssi;
+    uint8_t mac[6];
+    wifi_auth_mode_t auth_mode;
+};
+
+using ScanProgress = void (*)(void* context, uint8_t channel, uint8_t channels);
+
+class WiFiManager
+{
+   public:
+    // the device dwells 100-200 ms on each of the 13 channels plus a 50 ms gap
+    explicit WiFiManager(size_t simulatedNetworks = 12, int channelDwellMs = 0) : simulatedNetworks(simulatedNetworks), channelDwellMs(channelDwellMs) {}
+
+    std::vector<WiFiNetwork> ScanNetworks(int timeout_ms = 15000, ScanProgress progress = nullptr, void* context = nullptr)
+    {
+        (void)timeout_ms;
+        constexpr uint8_t channels = 13;
+        for (uint8_t channel = 1; channel <= channels; channel++)
+        {
+            if (channelDwellMs > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(channelDwellMs));
+            if (progress != nullptr)
+                progress(context, channel, channels);
+        }
+
+        std::vector<WiFiNetwork> networks;
+        for (size_t i = 0; i < simulatedNetworks; i++)
+        {
+            char ssid[33];
+            std::snprintf(ssid, sizeof(ssid), "host-network-%02u", static_cast<unsigned>(i));
+            WiFiNetwork network{ssid, static_cast<uint8_t>(1 + i % 13), static_cast<int8_t>(-40 - static_cast<int>(i % 50)), {0x02, 0, 0, 0, 0, 0},
+                                WIFI_AUTH_WPA2_PSK};
+            network.mac[5] = static_cast<uint8_t>(i);
+            networks.push_back(network);
+        }
+        return networks;
+    }
+
+    WiFiState_e GetCurrentWiFiState()
+    {
+        return WiFiState_e::WiFiState_Disconnected;
+    }
+
+    void TryConnectToStoredNetworks() {}
+
+   private:
+    size_t simulatedNetworks;
+    int channelDwellMs;
+};
+
+#endif
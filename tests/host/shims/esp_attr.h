@@ -0,0 +1,6 @@
+// host stand-in for esp_attr.h, placement attributes mean nothing here
+#pragma once
+
+#define DRAM_ATTR
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
@@ -0,0 +1,270 @@
+// implementations behind the host stand-in headers
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "OpenIrisTasks.hpp"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_netif.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+static esp_log_level_t host_log_level()
+{
+    static const esp_log_level_t level = []
+    {
+        const char* env = std::getenv("OPENIRIS_HOST_LOG_LEVEL");
+        if (!env)
+            return ESP_LOG_NONE;
+        const int value = std::atoi(env);
+        if (value < ESP_LOG_NONE || value > ESP_LOG_VERBOSE)
+            return ESP_LOG_VERBOSE;
+        return static_cast<esp_log_level_t>(value);
+    }();
+    return level;
+}
+
+extern "C" void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...)
+{
+    if (level > host_log_level())
+        return;
+
+    static const char letters[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+    std::fprintf(stderr, "%c (%lld) %s: ", letters[level], static_cast<long long>(esp_timer_get_time() / 1000), tag);
+    va_list args;
+    va_start(args, format);
+    std::vfprintf(stderr, format, args);
+    va_end(args);
+    std::fputc('\n', stderr);
+}
+
+extern "C" esp_log_level_t esp_log_level_get(const char* /*tag*/)
+{
+    return host_log_level();
+}
+
+extern "C" void esp_log_level_set(const char* /*tag*/, esp_log_level_t /*level*/) {}
+
+extern "C" const char* esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
+
+// esp_timer
+
+struct esp_timer
+{
+    esp_timer_create_args_t args;
+    bool armed;
+};
+
+extern "C" int64_t esp_timer_get_time(void)
+{
+    static const auto boot = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - boot).count();
+}
+
+extern "C" esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle)
+{
+    if (!create_args || !out_handle)
+        return ESP_ERR_INVALID_ARG;
+    *out_handle = new esp_timer{*create_args, false};
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t /*timeout_us*/)
+{
+    if (!timer)
+        return ESP_ERR_INVALID_ARG;
+    timer->armed = true;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t /*period*/)
+{
+    return esp_timer_start_once(timer, 0);
+}
+
+extern "C" esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer)
+        return ESP_ERR_INVALID_ARG;
+    timer->armed = false;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    delete timer;
+    return ESP_OK;
+}
+
+// system
+
+extern "C" void esp_restart(void)
+{
+    std::fprintf(stderr, "esp_restart() called on host\n");
+    std::abort();
+}
+
+extern "C" uint32_t esp_get_free_heap_size(void)
+{
+    return 0;
+}
+
+extern "C" esp_err_t esp_read_mac(uint8_t* mac, esp_mac_type_t type)
+{
+    if (!mac)
+        return ESP_ERR_INVALID_ARG;
+    const uint8_t host_mac[6] = {0x02, 0x00, 0x4f, 0x49, 0x52, static_cast<uint8_t>(type)};
+    std::memcpy(mac, host_mac, sizeof(host_mac));
+    return ESP_OK;
+}
+
+extern "C" esp_netif_t* esp_netif_get_handle_from_ifkey(const char* /*if_key*/)
+{
+    return nullptr;
+}
+
+extern "C" esp_err_t esp_netif_get_ip_info(esp_netif_t* /*esp_netif*/, esp_netif_ip_info_t* /*ip_info*/)
+{
+    return ESP_FAIL;
+}
+
+// freertos
+
+extern "C" BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char* /*pcName*/, uint32_t /*usStackDepth*/, void* pvParameters,
+                                  UBaseType_t /*uxPriority*/, TaskHandle_t* pxCreatedTask)
+{
+    std::thread(pxTaskCode, pvParameters).detach();
+    if (pxCreatedTask)
+        *pxCreatedTask = nullptr;
+    return pdPASS;
+}
+
+extern "C" void vTaskDelay(TickType_t xTicksToDelay)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(xTicksToDelay * portTICK_PERIOD_MS));
+}
+
+extern "C" TickType_t xTaskGetTickCount(void)
+{
+    return static_cast<TickType_t>(esp_timer_get_time() / 1000 / portTICK_PERIOD_MS);
+}
+
+struct QueueDefinition
+{
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    std::deque<std::vector<uint8_t>> items;
+    std::mutex lock;
+    std::condition_variable changed;
+};
+
+static bool wait_for(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, TickType_t ticks, const auto& ready)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        cv.wait(lock, ready);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), ready);
+}
+
+extern "C" QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+    auto* queue = new QueueDefinition();
+    queue->length = uxQueueLength;
+    queue->itemSize = uxItemSize;
+    return queue;
+}
+
+extern "C" void vQueueDelete(QueueHandle_t xQueue)
+{
+    delete xQueue;
+}
+
+extern "C" BaseType_t xQueueSend(QueueHandle_t xQueue, const void* pvItemToQueue, TickType_t xTicksToWait)
+{
+    if (!xQueue)
+        return pdFAIL;
+
+    std::unique_lock lock(xQueue->lock);
+    if (!wait_for(lock, xQueue->changed, xTicksToWait, [&] { return xQueue->items.size() < xQueue->length; }))
+        return pdFAIL;
+
+    auto bytes = static_cast<const uint8_t*>(pvItemToQueue);
+    xQueue->items.emplace_back(bytes, bytes + xQueue->itemSize);
+    xQueue->changed.notify_all();
+    return pdPASS;
+}
+
+extern "C" BaseType_t xQueueReceive(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait)
+{
+    if (!xQueue)
+        return pdFAIL;
+
+    std::unique_lock lock(xQueue->lock);
+    if (!wait_for(lock, xQueue->changed, xTicksToWait, [&] { return !xQueue->items.empty(); }))
+        return pdFAIL;
+
+    std::memcpy(pvBuffer, xQueue->items.front().data(), xQueue->itemSize);
+    xQueue->items.pop_front();
+    xQueue->changed.notify_all();
+    return pdPASS;
+}
+
+extern "C" UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue)
+{
+    std::lock_guard lock(xQueue->lock);
+    return static_cast<UBaseType_t>(xQueue->items.size());
+}
+
+// firmware hooks the command stack calls into
+
+static std::atomic<int> s_scheduled_restarts{0};
+
+void OpenIrisTasks::ScheduleRestart(int /*milliseconds*/)
+{
+    s_scheduled_restarts++;
+}
+
+int OpenIrisTasks::GetScheduledRestarts()
+{
+    return s_scheduled_restarts.load();
+}
+
+void force_activate_streaming() {}
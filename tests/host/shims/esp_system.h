@@ -0,0 +1,15 @@
+// host stand-in for esp_system.h
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void esp_restart(void);
+uint32_t esp_get_free_heap_size(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,22 @@
+// host stand-in for the bits of FreeRTOS the shared headers reference
+// there's no scheduler, tasks are plain threads and queues a mutex and a condition variable
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(xTimeInMs) ((TickType_t)(((TickType_t)(xTimeInMs) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+#define tskIDLE_PRIORITY ((UBaseType_t)0U)
+#define BIT0 0x00000001
+#define BIT1 0x00000002
@@ -0,0 +1,6 @@
+// host stand-in for freertos/semphr.h
+#pragma once
+
+#include "queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
@@ -0,0 +1,21 @@
+// host stand-in for freertos/task.h
+#pragma once
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct tskTaskControlBlock* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+// a detached std::thread, stack size and priority don't mean anything here
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char* pcName, uint32_t usStackDepth, void* pvParameters, UBaseType_t uxPriority,
+                       TaskHandle_t* pxCreatedTask);
+void vTaskDelay(TickType_t xTicksToDelay);
+TickType_t xTaskGetTickCount(void);
+
+#ifdef __cplusplus
+}
+#endif
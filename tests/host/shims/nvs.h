@@ -0,0 +1,79 @@
+// host stand-in for nvs.h
+// backed by an in-memory map that lives for the whole process, types are tracked per key
+// so a get with the wrong type fails the same way it does on the device
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_ERR_NVS_BASE 0x1100
+#define ESP_ERR_NVS_NOT_INITIALIZED (ESP_ERR_NVS_BASE + 0x01)
+#define ESP_ERR_NVS_NOT_FOUND (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_TYPE_MISMATCH (ESP_ERR_NVS_BASE + 0x03)
+#define ESP_ERR_NVS_READ_ONLY (ESP_ERR_NVS_BASE + 0x04)
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE (ESP_ERR_NVS_BASE + 0x05)
+#define ESP_ERR_NVS_INVALID_NAME (ESP_ERR_NVS_BASE + 0x06)
+#define ESP_ERR_NVS_INVALID_HANDLE (ESP_ERR_NVS_BASE + 0x07)
+#define ESP_ERR_NVS_REMOVE_FAILED (ESP_ERR_NVS_BASE + 0x08)
+#define ESP_ERR_NVS_KEY_TOO_LONG (ESP_ERR_NVS_BASE + 0x09)
+#define ESP_ERR_NVS_PAGE_FULL (ESP_ERR_NVS_BASE + 0x0a)
+#define ESP_ERR_NVS_INVALID_STATE (ESP_ERR_NVS_BASE + 0x0b)
+#define ESP_ERR_NVS_INVALID_LENGTH (ESP_ERR_NVS_BASE + 0x0c)
+
+typedef uint32_t nvs_handle_t;
+typedef nvs_handle_t nvs_handle;
+
+typedef enum
+{
+    NVS_READONLY,
+    NVS_READWRITE
+} nvs_open_mode_t;
+typedef nvs_open_mode_t nvs_open_mode;
+
+typedef struct
+{
+    size_t used_entries;
+    size_t free_entries;
+    size_t available_entries;
+    size_t total_entries;
+    size_t namespace_count;
+} nvs_stats_t;
+
+esp_err_t nvs_open(const char* namespace_name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle);
+esp_err_t nvs_open_from_partition(const char* part_name, const char* namespace_name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle);
+void nvs_close(nvs_handle_t handle);
+esp_err_t nvs_commit(nvs_handle_t handle);
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key);
+esp_err_t nvs_erase_all(nvs_handle_t handle);
+esp_err_t nvs_get_stats(const char* part_name, nvs_stats_t* nvs_stats);
+
+esp_err_t nvs_set_i8(nvs_handle_t handle, const char* key, int8_t value);
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value);
+esp_err_t nvs_set_i16(nvs_handle_t handle, const char* key, int16_t value);
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char* key, uint16_t value);
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char* key, int32_t value);
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value);
+esp_err_t nvs_set_i64(nvs_handle_t handle, const char* key, int64_t value);
+esp_err_t nvs_set_u64(nvs_handle_t handle, const char* key, uint64_t value);
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length);
+
+esp_err_t nvs_get_i8(nvs_handle_t handle, const char* key, int8_t* out_value);
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value);
+esp_err_t nvs_get_i16(nvs_handle_t handle, const char* key, int16_t* out_value);
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char* key, uint16_t* out_value);
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char* key, int32_t* out_value);
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out_value);
+esp_err_t nvs_get_i64(nvs_handle_t handle, const char* key, int64_t* out_value);
+esp_err_t nvs_get_u64(nvs_handle_t handle, const char* key, uint64_t* out_value);
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,216 @@
+// in-memory NVS for the host build
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "nvs.h"
+#include "nvs_flash.h"
+
+namespace
+{
+enum class EntryType
+{
+    I8,
+    U8,
+    I16,
+    U16,
+    I32,
+    U32,
+    I64,
+    U64,
+    STR,
+    BLOB
+};
+
+struct Entry
+{
+    EntryType type;
+    std::vector<uint8_t> value;
+};
+
+struct Handle
+{
+    std::string ns;
+    bool readOnly;
+};
+
+// NVS keys are limited to 15 characters on the device, keep the same limit so
+// a key that works here also works there
+constexpr size_t NVS_KEY_NAME_MAX_SIZE = 16;
+
+std::mutex nvs_lock;
+std::map<std::string, std::map<std::string, Entry>> storage;
+std::map<nvs_handle_t, Handle> handles;
+nvs_handle_t next_handle = 1;
+
+Handle* find_handle(nvs_handle_t handle)
+{
+    auto it = handles.find(handle);
+    return it == handles.end() ? nullptr : &it->second;
+}
+
+esp_err_t set_entry(nvs_handle_t handle, const char* key, EntryType type, const void* data, size_t length)
+{
+    if (!key || std::strlen(key) >= NVS_KEY_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+
+    std::lock_guard lock(nvs_lock);
+    Handle* h = find_handle(handle);
+    if (!h)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (h->readOnly)
+        return ESP_ERR_NVS_READ_ONLY;
+
+    auto bytes = static_cast<const uint8_t*>(data);
+    storage[h->ns][key] = Entry{type, std::vector<uint8_t>(bytes, bytes + length)};
+    return ESP_OK;
+}
+
+esp_err_t get_entry(nvs_handle_t handle, const char* key, EntryType type, void* out, size_t* length, bool variable)
+{
+    std::lock_guard lock(nvs_lock);
+    Handle* h = find_handle(handle);
+    if (!h)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+
+    auto ns = storage.find(h->ns);
+    if (ns == storage.end())
+        return ESP_ERR_NVS_NOT_FOUND;
+    auto entry = ns->second.find(key);
+    if (entry == ns->second.end())
+        return ESP_ERR_NVS_NOT_FOUND;
+    if (entry->second.type != type)
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+
+    const auto& value = entry->second.value;
+    if (!variable)
+    {
+        std::memcpy(out, value.data(), value.size());
+        return ESP_OK;
+    }
+
+    // strings and blobs: a null buffer asks for the required length
+    if (out == nullptr)
+    {
+        *length = value.size();
+        return ESP_OK;
+    }
+    if (*length < value.size())
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    std::memcpy(out, value.data(), value.size());
+    *length = value.size();
+    return ESP_OK;
+}
+
+template <typename T>
+esp_err_t get_scalar(nvs_handle_t handle, const char* key, EntryType type, T* out)
+{
+    return get_entry(handle, key, type, out, nullptr, false);
+}
+}  // namespace
+
+extern "C" esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_flash_init_partition(const char* /*partition_label*/)
+{
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_flash_erase(void)
+{
+    std::lock_guard lock(nvs_lock);
+    storage.clear();
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_open(const char* namespace_name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle)
+{
+    if (!namespace_name || std::strlen(namespace_name) >= NVS_KEY_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_INVALID_NAME;
+
+    std::lock_guard lock(nvs_lock);
+    const nvs_handle_t handle = next_handle++;
+    handles[handle] = Handle{namespace_name, open_mode == NVS_READONLY};
+    *out_handle = handle;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_open_from_partition(const char* /*part_name*/, const char* namespace_name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle)
+{
+    return nvs_open(namespace_name, open_mode, out_handle);
+}
+
+extern "C" void nvs_close(nvs_handle_t handle)
+{
+    std::lock_guard lock(nvs_lock);
+    handles.erase(handle);
+}
+
+extern "C" esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    std::lock_guard lock(nvs_lock);
+    return find_handle(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+extern "C" esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key)
+{
+    std::lock_guard lock(nvs_lock);
+    Handle* h = find_handle(handle);
+    if (!h)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (h->readOnly)
+        return ESP_ERR_NVS_READ_ONLY;
+    return storage[h->ns].erase(key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+extern "C" esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    std::lock_guard lock(nvs_lock);
+    Handle* h = find_handle(handle);
+    if (!h)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (h->readOnly)
+        return ESP_ERR_NVS_READ_ONLY;
+    storage.erase(h->ns);
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_get_stats(const char* /*part_name*/, nvs_stats_t* nvs_stats)
+{
+    // roughly the default 24 KB nvs partition
+    constexpr size_t total_entries = 630;
+    std::lock_guard lock(nvs_lock);
+    size_t used = 0;
+    for (const auto& [ns, entries] : storage)
+        used += entries.size();
+    *nvs_stats = nvs_stats_t{used, total_entries - used, total_entries - used, total_entries, storage.size()};
+    return ESP_OK;
+}
+
+// clang-format off
+extern "C" esp_err_t nvs_set_i8(nvs_handle_t h, const char* k, int8_t v) { return set_entry(h, k, EntryType::I8, &v, sizeof(v)); }
+extern "C" esp_err_t nvs_set_u8(nvs_handle_t h, const char* k, uint8_t v) { return set_entry(h, k, EntryType::U8, &v, sizeof(v)); }
+extern "C" esp_err_t nvs_set_i16(nvs_handle_t h, const char* k, int16_t v) { return set_entry(h, k, EntryType::I16, &v, sizeof(v)); }
+extern "C" esp_err_t nvs_set_u16(nvs_handle_t h, const char* k, uint16_t v) { return set_entry(h, k, EntryType::U16, &v, sizeof(v)); }
+extern "C" esp_err_t nvs_set_i32(nvs_handle_t h, const char* k, int32_t v) { return set_entry(h, k, EntryType::I32, &v, sizeof(v)); }
+extern "C" esp_err_t nvs_set_u32(nvs_handle_t h, const char* k, uint32_t v) { return set_entry(h, k, EntryType::U32, &v, sizeof(v)); }
+extern "C" esp_err_t nvs_set_i64(nvs_handle_t h, const char* k, int64_t v) { return set_entry(h, k, EntryType::I64, &v, sizeof(v)); }
+extern "C" esp_err_t nvs_set_u64(nvs_handle_t h, const char* k, uint64_t v) { return set_entry(h, k, EntryType::U64, &v, sizeof(v)); }
+extern "C" esp_err_t nvs_set_str(nvs_handle_t h, const char* k, const char* v) { return set_entry(h, k, EntryType::STR, v, std::strlen(v) + 1); }
+extern "C" esp_err_t nvs_set_blob(nvs_handle_t h, const char* k, const void* v, size_t len) { return set_entry(h, k, EntryType::BLOB, v, len); }
+
+extern "C" esp_err_t nvs_get_i8(nvs_handle_t h, const char* k, int8_t* v) { return get_scalar(h, k, EntryType::I8, v); }
+extern "C" esp_err_t nvs_get_u8(nvs_handle_t h, const char* k, uint8_t* v) { return get_scalar(h, k, EntryType::U8, v); }
+extern "C" esp_err_t nvs_get_i16(nvs_handle_t h, const char* k, int16_t* v) { return get_scalar(h, k, EntryType::I16, v); }
+extern "C" esp_err_t nvs_get_u16(nvs_handle_t h, const char* k, uint16_t* v) { return get_scalar(h, k, EntryType::U16, v); }
+extern "C" esp_err_t nvs_get_i32(nvs_handle_t h, const char* k, int32_t* v) { return get_scalar(h, k, EntryType::I32, v); }
+extern "C" esp_err_t nvs_get_u32(nvs_handle_t h, const char* k, uint32_t* v) { return get_scalar(h, k, EntryType::U32, v); }
+extern "C" esp_err_t nvs_get_i64(nvs_handle_t h, const char* k, int64_t* v) { return get_scalar(h, k, EntryType::I64, v); }
+extern "C" esp_err_t nvs_get_u64(nvs_handle_t h, const char* k, uint64_t* v) { return get_scalar(h, k, EntryType::U64, v); }
+extern "C" esp_err_t nvs_get_str(nvs_handle_t h, const char* k, char* v, size_t* len) { return get_entry(h, k, EntryType::STR, v, len, true); }
+extern "C" esp_err_t nvs_get_blob(nvs_handle_t h, const char* k, void* v, size_t* len) { return get_entry(h, k, EntryType::BLOB, v, len, true); }
+// clang-format on
@@ -0,0 +1,26 @@
+// host sdkconfig - mirrors a wireless board with UVC support and no optional peripherals,
+// so every command takes the same branch it takes on the most common boards
+#pragma once
+
+#define CONFIG_IDF_TARGET "linux"
+#define CONFIG_IDF_TARGET_LINUX 1
+
+#define CONFIG_GENERAL_BOARD "host"
+#define CONFIG_GENERAL_VERSION "host"
+#define CONFIG_GENERAL_ADVERTISED_NAME "openiristracker"
+#define CONFIG_GENERAL_ENABLE_WIRELESS 1
+#define CONFIG_GENERAL_INCLUDE_UVC_MODE 1
+#define CONFIG_GENERAL_STARTUP_DELAY 20
+
+#define CONFIG_WIFI_SSID ""
+#define CONFIG_WIFI_BSSID ""
+#define CONFIG_WIFI_PASSWORD ""
+#define CONFIG_WIFI_AP_SSID "EyeTrackVR"
+#define CONFIG_WIFI_AP_PASSWORD "12345678"
+
+#define CONFIG_LED_EXTERNAL_CONTROL 1
+#define CONFIG_LED_EXTERNAL_PWM_FREQ 5000
+#define CONFIG_LED_EXTERNAL_PWM_DUTY_CYCLE 100
+
+#define CONFIG_CAMERA_USB_XCLK_FREQ_DEFAULT 10000000
+#define CONFIG_CAMERA_WIFI_XCLK_FREQ 16500000
@@ -128,6 +128,18 @@ def test_get_who_am_i(get_openiris_device):
     assert "who_am_i" in command_result["results"][0]["result"]["data"]
 
 
+def test_pipelined_commands(get_openiris_device):
+    device = get_openiris_device()
+    commands = [("ping", None), ("get_serial", None), ("get_who_am_i", None), ("some_invalid_command", None)] * 3
+    results = device.send_commands(commands)
+    # every answer lands where its command was, even with a window's worth of them in flight
+    assert len(results) == len(commands)
+    for (command, _), result in zip(commands, results):
+        assert has_command_failed(result) == (command == "some_invalid_command")
+        if not has_command_failed(result):
+            assert result["results"][0]["command"] == command
+
+
 @pytest.mark.has_capability("measure_current")
 def test_get_led_current_supported(get_openiris_device):
     device = get_openiris_device()
@@ -640,3 +652,40 @@ def test_update_camera(get_openiris_device, payload):
     device = get_openiris_device()
     result = device.send_command("update_camera", payload)
     assert not has_command_failed(result)
+
+
+@pytest.mark.parametrize(
+    "payload",
+    (
+        {},
+        {"width": 320},
+        {"width": "320", "height": 320},
+        {"offset_x": 10000, "offset_y": 0, "width": 320, "height": 320},
+        {"offset_x": 0, "offset_y": 0, "width": 100, "height": 100},
+    ),
+)
+def test_set_vie_window_invalid(get_openiris_device, payload):
+    device = get_openiris_device()
+    result = device.send_command("set_vie_window", payload)
+    assert has_command_failed(result)
+
+
+@pytest.mark.has_capability("wireless")
+def test_set_vie_window(ensure_board_in_mode, get_openiris_device):
+    device = ensure_board_in_mode("wifi", get_openiris_device())
+    window = device.send_command("get_vie_window")["results"][0]["result"]["data"]
+    assert window["readout_width"] >= 256 and window["readout_height"] >= 256
+
+    result = device.send_command("set_vie_window", {"offset_x": 8, "offset_y": 8, "width": 240, "height": 240})
+    assert not has_command_failed(result)
+    # same size somewhere else only moves it
+    result = device.send_command("set_vie_window", {"offset_x": 16, "offset_y": 0, "width": 240, "height": 240})
+    assert not has_command_failed(result)
+
+    window = device.send_command("get_vie_window")["results"][0]["result"]["data"]
+    assert (window["offset_x"], window["offset_y"], window["width"], window["height"]) == (16, 0, 240, 240)
+
+    result = device.send_command("set_vie_window", {"width": 0, "height": 0})
+    assert not has_command_failed(result)
+    window = device.send_command("get_vie_window")["results"][0]["result"]["data"]
+    assert window["width"] == 0
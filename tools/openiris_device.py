@@ -2,6 +2,16 @@ import time
 import json
 import serial
 
+try:
+    import serial_frames
+except ImportError:
+    from tools import serial_frames
+
+# how many tagged lines send_commands() keeps in flight, and how many bytes of them at most
+# the device reads them one after the other and the uart has 1 KB of rx buffer and no flow control
+DEFAULT_WINDOW = 8
+MAX_IN_FLIGHT_BYTES = 1024
+
 
 class OpenIrisDevice:
     def __init__(self, port: str, debug: bool, debug_commands: bool):
@@ -10,6 +20,14 @@ class OpenIrisDevice:
         self.debug_commands = debug_commands
         self.connection: serial.Serial | None = None
         self.connected = False
+        # set by negotiate_binary(), commands go out as crc checked frames instead of json lines
+        self.binary = False
+        self.frame_seq = 0
+        # every json line goes out with an id, the answer and any job result pushed later come back with it
+        self.request_id = 0
+        self.rx_buffer = ""
+        # messages that showed up while we were waiting for something else, by id
+        self.stashed: dict[int, list[dict]] = {}
 
     def __enter__(self):
         self.connected = self.__connect()
@@ -45,99 +63,327 @@ class OpenIrisDevice:
         if self.connection and self.connection.is_open:
             self.connection.close()
             print(f"🔌 Disconnected from {self.port}")
+        self.binary = False
+        self.rx_buffer = ""
+        self.stashed.clear()
+
+    def __next_seq(self) -> int:
+        self.frame_seq = (self.frame_seq + 1) & 0xFF
+        return self.frame_seq
+
+    def __read_frames(self, seq: int, until: set[int], timeout: int) -> list[tuple[int, bytes]]:
+        # everything with our seq until one of the frame types we're waiting for shows up
+        reader = serial_frames.FrameReader()
+        frames = []
+        start_time = time.time()
+        while time.time() - start_time < timeout:
+            if not self.connection.in_waiting:
+                time.sleep(0.01)
+                continue
+
+            for frame_type, frame_seq, payload in reader.feed(self.connection.read_all()):
+                if self.debug:
+                    print(f"Received frame: type={frame_type:#04x} seq={frame_seq} {payload.hex()}")
+                if frame_seq != seq:
+                    continue
+                frames.append((frame_type, payload))
+                if frame_type in until:
+                    return frames
+        return frames
+
+    def negotiate_binary(self, timeout: int = 2) -> bool:
+        """Switches to the binary protocol if the firmware speaks it, older ones just ignore the hello."""
+        if not self.connection or not self.connection.is_open:
+            return False
+
+        seq = self.__next_seq()
+        self.connection.reset_input_buffer()
+        self.connection.write(serial_frames.encode_frame(serial_frames.HELLO, seq))
+        frames = self.__read_frames(seq, {serial_frames.HELLO_ACK}, timeout)
+        self.binary = any(
+            frame_type == serial_frames.HELLO_ACK and payload[:1] == b"\x01"
+            for frame_type, payload in frames
+        )
+        return self.binary
+
+    def __send_binary_command(self, command: str, params: dict | None, timeout: int) -> dict:
+        seq = self.__next_seq()
+        frame = serial_frames.encode_command(seq, command, params or None)
+        if self.debug or self.debug_commands:
+            print(f"Sending command frame: {command} {params or ''}")
+
+        self.connection.reset_input_buffer()
+        self.connection.write(frame)
+        frames = self.__read_frames(
+            seq, {serial_frames.RESPONSE_END, serial_frames.NACK}, timeout
+        )
+        if not frames:
+            return {"error": "Command timeout"}
+
+        end_type, end_payload = frames[-1]
+        if end_type == serial_frames.NACK:
+            reason = serial_frames.NACK_REASONS.get(end_payload[0], "unknown")
+            return {"error": f"Command rejected: {reason}"}
+        if end_type != serial_frames.RESPONSE_END:
+            return {"error": "Command timeout"}
+
+        body = b"".join(
+            payload for frame_type, payload in frames if frame_type == serial_frames.RESPONSE_CHUNK
+        )
+        data = serial_frames.cbor_decode(body) if body else None
+        status = "success" if end_payload[:1] == b"\x00" else "error"
+        # same shape the json protocol gives back, so callers don't care which one is in use
+        return {"results": [{"command": command, "result": {"data": data, "status": status}}]}
+
+    def __next_request_id(self) -> int:
+        self.request_id = self.request_id % 0xFFFFFFFF + 1
+        return self.request_id
 
-    def __check_if_response_is_complete(self, response) -> dict | None:
+    def __parse_line(self, line: str) -> dict | None:
+        # the json starts at the first "{", lines without one are logs, the device holds those back while it answers
+        start = line.find("{")
+        if start < 0:
+            return None
         try:
-            if self.debug:
-                print(f"\nCHECKING: {response} \n")
-            return json.loads(response)
+            message = json.loads(line[start:])
         except ValueError:
             if self.debug:
-                print("\nCHECK FAILED\n")
+                print(f"\nCHECK FAILED: {line}\n")
             return None
+        return message if isinstance(message, dict) else None
 
-    def __read_response(self, timeout: int | None = None) -> dict | None:
-        # we can try and retrieve the response now.
-        # it should be more or less immediate, but some commands may take longer
-        # so we gotta timeout
-        timeout = timeout if timeout is not None else 15
+    def __read_message(self, timeout: float) -> dict | None:
+        """The next json message the device sends, None if nothing complete shows up in time."""
         start_time = time.time()
-        response_buffer = ""
-        while time.time() - start_time < timeout:
+        while True:
+            while "\n" in self.rx_buffer:
+                line, self.rx_buffer = self.rx_buffer.split("\n", 1)
+                if message := self.__parse_line(line.strip("\r")):
+                    if self.debug:
+                        print(f"Received message: {message}")
+                    return message
+
+            if time.time() - start_time >= timeout:
+                return None
             if self.connection.in_waiting:
-                packet = self.connection.read_all().decode("utf-8", errors="ignore")
-                if self.debug and packet.strip():
-                    print(f"Received: {packet}")
-                    print("-" * 10)
-                    print(f"Current buffer: {response_buffer}")
-                    print("-" * 10)
-
-                # we can't rely on new lines to detect if we're done
-                # nor can we assume that we're always gonna get valid json response
-                # but we can assume that if we're to get a valid response, it's gonna be json
-                # so we can start actually building the buffer only when
-                # some part of the packet starts with "{", and start building from there
-                # we can assume that no further data will be returned, so we can validate
-                # right after receiving the last packet
-                if (not response_buffer and "{" in packet) or response_buffer:
-                    # assume we just started building the buffer and we've received the first packet
-
-                    # alternative approach in case this doesn't work - we're always sending a valid json
-                    # so we can start building the buffer from the first packet and keep trying to find the
-                    # starting and ending brackets, extract that part and validate, if the message is complete, return
-                    if not response_buffer:
-                        starting_idx = packet.find("{")
-                        response_buffer = packet[starting_idx:]
-                    else:
-                        response_buffer += packet
-
-                    # and once we get something, we can validate if it's a valid json
-                    if parsed_response := self.__check_if_response_is_complete(
-                        response_buffer
-                    ):
-                        return parsed_response
-                    else:
-                        # if it's not a valid response just yet,
-                        # we might've stumbled a case where we got a valid response
-                        # but to the end of it, we've got some leftovers attached
-                        # so, we can try and find the ending
-                        ending_idx = response_buffer[::-1].find("}")
-                        if reparsed_response := self.__check_if_response_is_complete(
-                            response_buffer[: len(response_buffer) - ending_idx]
-                        ):
-                            return reparsed_response
+                self.rx_buffer += self.connection.read_all().decode("utf-8", errors="ignore")
             else:
-                time.sleep(0.1)
+                time.sleep(0.01)
+
+    def __read_tagged(self, request_id: int, timeout: float, job: bool = False) -> dict | None:
+        """The answer to request_id, or with job=True the result of the job it started, whatever else arrives is stashed."""
+        def wanted(message: dict) -> bool:
+            return ("job" in message) == job
+
+        stashed = self.stashed.get(request_id, [])
+        for message in stashed:
+            if wanted(message):
+                stashed.remove(message)
+                return message
+
+        deadline = time.time() + timeout
+        while (message := self.__read_message(max(0.0, deadline - time.time()))) is not None:
+            message_id = message.get("id")
+            # older firmware doesn't tag its answers, and a line it couldn't parse has no id to give back
+            if message_id is None and not job:
+                return message
+            if message_id == request_id and wanted(message):
+                return message
+            if message_id is not None:
+                self.stashed.setdefault(message_id, []).append(message)
         return None
 
+    def __write_line(self, command: str, params: dict | None) -> tuple[int, bytes]:
+        request_id = self.__next_request_id()
+        cmd_obj = {"id": request_id, "commands": [{"command": command}]}
+        if params:
+            cmd_obj["commands"][0]["data"] = params
+
+        # we're expecting the json string to end with a new line
+        # to signify we've finished sending the command
+        line = (json.dumps(cmd_obj) + "\n").encode()
+        if self.debug or self.debug_commands:
+            print(f"Sending command: {line.decode()}")
+        self.connection.write(line)
+        return request_id, line
+
+    def __reset_input(self):
+        # clean it out first, just to be sure we're starting fresh
+        self.connection.reset_input_buffer()
+        self.rx_buffer = ""
+        self.stashed.clear()
+
+    @staticmethod
+    def __job_response(command: str, job: dict) -> dict:
+        # same shape as if the command had answered right away
+        return {
+            "results": [
+                {
+                    "command": command,
+                    "result": {"data": job.get("result"), "status": job.get("status")},
+                }
+            ]
+        }
+
     def is_connected(self) -> bool:
         return self.connected
 
     def send_command(
-        self, command: str, params: dict | None = None, timeout: int | None = None
+        self,
+        command: str,
+        params: dict | None = None,
+        timeout: int | None = None,
+        wait_for_job: bool = True,
     ) -> dict:
+        """Sends one command and returns its response.
+
+        scan_networks and connect_wifi answer with a job id right away and keep running on the device,
+        unless wait_for_job is False this waits until the job is done and returns its result in the same
+        shape any other command's response has. The device pushes it once it's there, frames get it by
+        polling get_job_status.
+        """
+        request_id, response = self.__send_command(command, params, timeout)
+        if not wait_for_job:
+            return response
+
+        job_id = self.__get_job_id(response)
+        if job_id is None:
+            return response
+
+        timeout = timeout if timeout is not None else 30
+        if request_id is None:
+            return self.__wait_for_job(command, job_id, timeout)
+        pushed = self.__read_tagged(request_id, timeout, job=True)
+        if pushed is None:
+            return {"error": "Command timeout"}
+        return self.__job_response(command, pushed["job"])
+
+    def send_commands(
+        self,
+        commands: list[tuple[str, dict | None]],
+        timeout: int | None = None,
+        wait_for_job: bool = True,
+        window: int = DEFAULT_WINDOW,
+    ) -> list[dict]:
+        """Sends a batch of (command, params) and returns their responses in the same order.
+
+        Up to window of them are in flight at once, so provisioning a device is one burst instead of
+        a round trip per command. Jobs don't hold up the rest, their results come in whenever they're done.
+        Each command still runs on its own, one that fails doesn't stop the others.
+        """
         if not self.connection or not self.connection.is_open:
-            return {"error": "Device Not Connected"}
+            return [{"error": "Device Not Connected"} for _ in commands]
+        if self.binary:
+            return [self.send_command(command, params, timeout, wait_for_job) for command, params in commands]
 
-        cmd_obj = {"commands": [{"command": command}]}
-        if params:
-            cmd_obj["commands"][0]["data"] = params
+        timeout = timeout if timeout is not None else 15
+        responses: list[dict] = [{"error": "Command timeout"} for _ in commands]
+        # request id -> (index, bytes on the wire), in the order they went out
+        in_flight: dict[int, tuple[int, int]] = {}
+        jobs: dict[int, int] = {}
+        next_index = 0
+        try:
+            self.__reset_input()
+            while next_index < len(commands) or in_flight or jobs:
+                in_flight_bytes = sum(size for _, size in in_flight.values())
+                while (
+                    next_index < len(commands)
+                    and len(in_flight) < window
+                    and (not in_flight or in_flight_bytes < MAX_IN_FLIGHT_BYTES)
+                ):
+                    command, params = commands[next_index]
+                    request_id, line = self.__write_line(command, params)
+                    in_flight[request_id] = (next_index, len(line))
+                    in_flight_bytes += len(line)
+                    next_index += 1
+
+                message = self.__read_message(timeout)
+                if message is None:
+                    break
+
+                # untagged answers come from older firmware, which answers in order
+                request_id = message.get("id", next(iter(in_flight), None))
+                if "job" in message:
+                    if request_id in jobs:
+                        index = jobs.pop(request_id)
+                        responses[index] = self.__job_response(commands[index][0], message["job"])
+                    continue
+                if request_id not in in_flight:
+                    continue
+
+                index, _ = in_flight.pop(request_id)
+                message.pop("id", None)
+                responses[index] = message
+                if wait_for_job and self.__get_job_id(message) is not None:
+                    jobs[request_id] = index
+        except Exception as e:
+            for index in [index for index, _ in in_flight.values()] + list(jobs.values()):
+                responses[index] = {"error": f"Communication error: {e}"}
+            for index in range(next_index, len(commands)):
+                responses[index] = {"error": f"Communication error: {e}"}
+            return responses
+
+        for index in list(jobs.values()):
+            responses[index] = {"error": "Command timeout"}
+        return responses
+
+    @staticmethod
+    def __get_job_id(response: dict) -> int | None:
+        try:
+            result = response["results"][0]["result"]
+        except (KeyError, IndexError, TypeError):
+            return None
+        data = result.get("data")
+        if result.get("status") != "success" or not isinstance(data, dict):
+            return None
+        return data.get("job_id")
+
+    def __wait_for_job(self, command: str, job_id: int, timeout: int) -> dict:
+        start_time = time.time()
+        while time.time() - start_time < timeout:
+            _, response = self.__send_command("get_job_status", {"id": job_id}, 5)
+            if "error" in response:
+                return response
+
+            result = response["results"][0]["result"]
+            if result.get("status") != "success":
+                return response
+
+            job = result["data"]
+            if job.get("state") == "done":
+                return self.__job_response(command, job)
+
+            if self.debug:
+                print(f"Job {job_id} ({command}): {job.get('state')}, {job.get('progress')}%")
+            time.sleep(0.25)
+        return {"error": "Command timeout"}
+
+    def __send_command(
+        self, command: str, params: dict | None = None, timeout: int | None = None
+    ) -> tuple[int | None, dict]:
+        """The response without its id, the id comes back separately, None for frames and untagged answers."""
+        if not self.connection or not self.connection.is_open:
+            return None, {"error": "Device Not Connected"}
+
+        if self.binary:
+            try:
+                return None, self.__send_binary_command(
+                    command, params, timeout if timeout is not None else 15
+                )
+            except Exception as e:
+                return None, {"error": f"Communication error: {e}"}
 
-        # we're expecting the json string to end with a new line
-        # to signify we've finished sending the command
-        cmd_str = json.dumps(cmd_obj) + "\n"
         try:
-            # clean it out first, just to be sure we're starting fresh
-            self.connection.reset_input_buffer()
-            if self.debug or self.debug_commands:
-                print(f"Sending command: {cmd_str}")
-            self.connection.write(cmd_str.encode())
-            response = self.__read_response(timeout)
+            self.__reset_input()
+            request_id, _ = self.__write_line(command, params)
+            response = self.__read_tagged(request_id, timeout if timeout is not None else 15)
 
             if self.debug:
                 print(f"Received response: {response}")
 
-            return response or {"error": "Command timeout"}
+            if response is None:
+                return None, {"error": "Command timeout"}
+            return response.pop("id", None), response
 
         except Exception as e:
-            return {"error": f"Communication error: {e}"}
+            return None, {"error": f"Communication error: {e}"}
@@ -0,0 +1,188 @@
+"""Binary framing of the serial command protocol, the host side of SerialProtocol.
+
+A frame, both directions:
+
+    0xA5 | type | seq | length (u16 le) | payload | crc16 (u16 le)
+
+The crc is CRC-16/CCITT-FALSE over type, seq, length and payload. A COMMAND payload is
+the command name prefixed with its length, followed by the cbor encoded "data" if there is any.
+The device answers with RESPONSE_CHUNK frames carrying the cbor encoded result and a
+RESPONSE_END whose single payload byte is 0 on success.
+
+Only the bits of cbor the firmware produces are covered here, so there's no extra dependency.
+"""
+
+import struct
+
+FRAME_SYNC = 0xA5
+FRAME_OVERHEAD = 7
+
+HELLO = 0x01
+COMMAND = 0x02
+HELLO_ACK = 0x81
+RESPONSE_CHUNK = 0x82
+RESPONSE_END = 0x83
+NACK = 0xEE
+
+NACK_REASONS = {1: "bad crc", 2: "too long", 3: "unknown type", 4: "bad payload"}
+
+
+def crc16(data: bytes, crc: int = 0xFFFF) -> int:
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def encode_frame(frame_type: int, seq: int, payload: bytes = b"") -> bytes:
+    header = struct.pack("<BBH", frame_type, seq & 0xFF, len(payload))
+    crc = crc16(header + payload)
+    return bytes([FRAME_SYNC]) + header + payload + struct.pack("<H", crc)
+
+
+def encode_command(seq: int, command: str, data=None) -> bytes:
+    name = command.encode()
+    payload = bytes([len(name)]) + name
+    if data is not None:
+        payload += cbor_encode(data)
+    return encode_frame(COMMAND, seq, payload)
+
+
+class FrameReader:
+    """Picks frames out of whatever the port returns, anything else (like log lines) is skipped."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+
+    def feed(self, data: bytes) -> list[tuple[int, int, bytes]]:
+        self.buffer += data
+        frames = []
+        while True:
+            start = self.buffer.find(bytes([FRAME_SYNC]))
+            if start < 0:
+                self.buffer.clear()
+                return frames
+            del self.buffer[:start]
+            if len(self.buffer) < FRAME_OVERHEAD:
+                return frames
+
+            frame_type, seq, length = struct.unpack_from("<BBH", self.buffer, 1)
+            if len(self.buffer) < FRAME_OVERHEAD + length:
+                return frames
+
+            body = bytes(self.buffer[1 : 5 + length])
+            (crc,) = struct.unpack_from("<H", self.buffer, 5 + length)
+            if crc16(body) != crc:
+                # not a frame after all, or a damaged one, look for the next sync byte
+                del self.buffer[:1]
+                continue
+
+            frames.append((frame_type, seq, body[4:]))
+            del self.buffer[: FRAME_OVERHEAD + length]
+
+
+def cbor_encode(value) -> bytes:
+    def head(major: int, argument: int) -> bytes:
+        if argument < 24:
+            return bytes([(major << 5) | argument])
+        for info, fmt in ((24, ">B"), (25, ">H"), (26, ">I"), (27, ">Q")):
+            if argument < 1 << (8 * struct.calcsize(fmt)):
+                return bytes([(major << 5) | info]) + struct.pack(fmt, argument)
+        raise ValueError("integer too large for cbor")
+
+    if value is None:
+        return b"\xf6"
+    if value is True:
+        return b"\xf5"
+    if value is False:
+        return b"\xf4"
+    if isinstance(value, int):
+        return head(0, value) if value >= 0 else head(1, -1 - value)
+    if isinstance(value, float):
+        return b"\xfb" + struct.pack(">d", value)
+    if isinstance(value, str):
+        encoded = value.encode()
+        return head(3, len(encoded)) + encoded
+    if isinstance(value, (bytes, bytearray)):
+        return head(2, len(value)) + bytes(value)
+    if isinstance(value, (list, tuple)):
+        return head(4, len(value)) + b"".join(cbor_encode(item) for item in value)
+    if isinstance(value, dict):
+        return head(5, len(value)) + b"".join(
+            cbor_encode(key) + cbor_encode(item) for key, item in value.items()
+        )
+    raise TypeError(f"can't cbor encode {type(value).__name__}")
+
+
+def cbor_decode(data: bytes):
+    value, offset = _cbor_item(data, 0)
+    if offset != len(data):
+        raise ValueError("trailing bytes after cbor item")
+    return value
+
+
+_BREAK = object()
+
+
+def _cbor_item(data: bytes, offset: int):
+    initial = data[offset]
+    offset += 1
+    major, info = initial >> 5, initial & 0x1F
+
+    if initial == 0xFF:
+        return _BREAK, offset
+    if major == 7:
+        simple = {20: False, 21: True, 22: None, 23: None}
+        if info in simple:
+            return simple[info], offset
+        for size, fmt in ((25, ">e"), (26, ">f"), (27, ">d")):
+            if info == size:
+                width = struct.calcsize(fmt)
+                return struct.unpack_from(fmt, data, offset)[0], offset + width
+        raise ValueError(f"unsupported cbor simple value {info}")
+
+    indefinite = info == 31
+    argument = 0
+    if info < 24:
+        argument = info
+    elif info <= 27:
+        width = 1 << (info - 24)
+        argument = int.from_bytes(data[offset : offset + width], "big")
+        offset += width
+    elif not indefinite:
+        raise ValueError(f"invalid cbor additional info {info}")
+
+    if major == 0:
+        return argument, offset
+    if major == 1:
+        return -1 - argument, offset
+    if major in (2, 3):
+        if indefinite:
+            chunks = []
+            while True:
+                chunk, offset = _cbor_item(data, offset)
+                if chunk is _BREAK:
+                    break
+                chunks.append(chunk)
+            return ("" if major == 3 else b"").join(chunks), offset
+        raw = bytes(data[offset : offset + argument])
+        return (raw.decode() if major == 3 else raw), offset + argument
+    if major == 4:
+        items = []
+        while indefinite or len(items) < argument:
+            item, offset = _cbor_item(data, offset)
+            if item is _BREAK:
+                break
+            items.append(item)
+        return items, offset
+    if major == 5:
+        result = {}
+        while indefinite or len(result) < argument:
+            key, offset = _cbor_item(data, offset)
+            if key is _BREAK:
+                break
+            result[key], offset = _cbor_item(data, offset)
+        return result, offset
+    raise ValueError(f"unsupported cbor major type {major}")
@@ -566,6 +566,29 @@ def show_persistent_logs(device: OpenIrisDevice, *args, **kwargs):
     print(f"\n{logs}")
 
 
+def show_stream_stats(device: OpenIrisDevice, *args, **kwargs):
+    response = device.send_command("get_stream_stats")
+    if has_command_failed(response):
+        print(f"❌ Failed to get stream stats: {get_response_error(response)}")
+        return
+
+    data = response["results"][0]["result"]["data"]
+    for transport in ("uvc", "http"):
+        stages = data.get(transport, {})
+        if not stages.get("total", {}).get("count"):
+            print(f"ℹ️  {transport.upper()}: no frames sent yet")
+            continue
+
+        print(f"\n⏱️  {transport.upper()} frame latency (ms):")
+        print(f"  {'stage':<10} {'frames':>8} {'p50':>8} {'p90':>8} {'p99':>8} {'max':>8}")
+        for stage, histogram in stages.items():
+            print(
+                f"  {stage:<10} {histogram['count']:>8} "
+                f"{histogram['p50_us'] / 1000:>8.2f} {histogram['p90_us'] / 1000:>8.2f} "
+                f"{histogram['p99_us'] / 1000:>8.2f} {histogram['max_us'] / 1000:>8.2f}"
+            )
+
+
 def scan_networks(wifi_scanner: WiFiScanner, *args, **kwargs):
     use_custom_timeout = (
         input("Should we use a custom scan timeout? (y/n)\n>> ").strip().lower() == "y"
@@ -762,6 +785,7 @@ def handle_menu(menu_context: dict | None = None) -> str:
     debug_menu.add_action("📋 Show current session logs (RAM)", show_current_logs)
     debug_menu.add_action("💾 Show persistent logs (across reboots)", show_persistent_logs)
     debug_menu.add_action("🗑️  Clear persistent logs", clear_persistent_logs)
+    debug_menu.add_action("⏱️  Show stream latency stats", show_stream_stats)
 
     menu.show()
 